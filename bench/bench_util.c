@@ -0,0 +1,117 @@
+/**
+ * bench_util.c - 基准测试共用的工具实现
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "bench_util.h"
+#include "../include/writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+double now_seconds(void) {
+#ifdef _WIN32
+  return (double)clock() / CLOCKS_PER_SEC;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+char *read_source(const char *path, size_t *length) {
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return NULL;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *data = (char *)malloc(size + 1);
+  size_t n = fread(data, 1, size, file);
+  data[n] = '\0';
+  fclose(file);
+  if (length)
+    *length = n;
+  return data;
+}
+
+// ========== 随机数 ==========
+
+uint64_t random_state = 1;
+
+int next_random(int n) {
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return (int)((random_state * 0x2545F4914F6CDD1DULL >> 33) % (uint64_t)n);
+}
+
+// ========== 延迟 ==========
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+void sort_samples(double *samples, int count) {
+  qsort(samples, count, sizeof(double), compare_doubles);
+}
+
+double percentile(const double *sorted, int count, int pct) {
+  int index = (int)((long)count * pct / 100);
+  return sorted[index < count ? index : count - 1];
+}
+
+void report_latency(const char *name, double *samples, int count) {
+  sort_samples(samples, count);
+  printf("%-16s %7d %9.3f %9.3f %9.3f\n", name, count,
+         percentile(samples, count, 50) * 1e3,
+         percentile(samples, count, 99) * 1e3,
+         percentile(samples, count, 100) * 1e3);
+}
+
+// ========== 找编辑的位置 ==========
+
+int is_word(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c == '.';
+}
+
+int match_literal(const char *text, int length, int i) {
+  if (text[i] < '0' || text[i] > '9' || (i > 0 && is_word(text[i - 1])))
+    return 0;
+  int end = i;
+  while (end < length && text[end] >= '0' && text[end] <= '9')
+    end++;
+  return end >= length || text[end] != '.';
+}
+
+int match_signature(const char *text, int length, int i) {
+  return (i == 0 || text[i - 1] == '\n') && i + 6 <= length &&
+         strncmp(text + i, "int fn", 6) == 0;
+}
+
+int search(const char *text, int length,
+           int (*match)(const char *text, int length, int i)) {
+  int from = next_random(length + 1);
+  for (int pass = 0; pass < 2; pass++) {
+    int end = pass == 0 ? length : from;
+    for (int i = pass == 0 ? from : 0; i < end; i++)
+      if (match(text, length, i))
+        return i;
+  }
+  return -1;
+}
+
+// ========== 比较输出 ==========
+
+char *dump_ir(IRProgram *program) {
+  if (!program)
+    return NULL;
+  Writer *dump = writer_memory();
+  ir_dump(program, dump);
+  ir_program_free(program);
+  return writer_take(dump);
+}
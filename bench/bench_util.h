@@ -0,0 +1,61 @@
+/**
+ * bench_util.h - 基准测试共用的计时、读文件、随机数、延迟统计和找编辑位置
+ */
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include "../include/ir.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// 单调时钟的当前时间（秒），只用来算差值；Windows 上用 clock()
+double now_seconds(void);
+
+// 读取整个文件，末尾补 '\0'，由调用者 free；失败返回 NULL。
+// length 不为 NULL 时写入读到的字节数
+char *read_source(const char *path, size_t *length);
+
+// ========== 随机数 ==========
+
+// xorshift64* 的状态，不能为 0；--seed 直接写它
+extern uint64_t random_state;
+
+// [0, n)
+int next_random(int n);
+
+// ========== 延迟 ==========
+
+// 从小到大排序
+void sort_samples(double *samples, int count);
+
+// 排好序的 count 个样本的第 pct 百分位（100 是最大值）
+double percentile(const double *sorted, int count, int pct);
+
+// 排序并打印一行 "名字 个数 p50 p99 最大值"（毫秒）
+void report_latency(const char *name, double *samples, int count);
+
+// ========== 找编辑的位置 ==========
+
+// 可以出现在名字或数字里的字符
+int is_word(char c);
+
+// 整数常量的第一位（不是名字或浮点数的一部分）
+int match_literal(const char *text, int length, int i);
+
+// 行首的 "int fn"：progen 生成的返回 int 的函数定义
+int match_signature(const char *text, int length, int i);
+
+/**
+ * 从随机位置往后找第一个满足 match 的位置，找不到时从头再找；
+ * 返回 -1 表示没有
+ */
+int search(const char *text, int length,
+           int (*match)(const char *text, int length, int i));
+
+// ========== 比较输出 ==========
+
+// IR 的转储（调用者 free），并释放 program；program 为 NULL 时返回 NULL
+char *dump_ir(IRProgram *program);
+
+#endif // BENCH_UTIL_H
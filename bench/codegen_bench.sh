@@ -0,0 +1,48 @@
+#!/bin/sh
+# codegen_bench.sh - 比较生成代码和 gcc -O0 / -O2 的运行时间
+#
+# 用法: sh bench/codegen_bench.sh [compiler]
+# 每个程序分别用本编译器（默认和 -O）、gcc -O0、gcc -O2 编译，
+# 检查退出码一致并打印运行时间（毫秒）。
+
+COMPILER=${1:-bin/compiler}
+DIR=$(dirname "$0")/programs
+OUT=${TMPDIR:-/tmp}/codegen_bench.$$
+mkdir -p "$OUT"
+
+now_ms() {
+    echo $(($(date +%s%N) / 1000000))
+}
+
+run() {
+    start=$(now_ms)
+    "$1"
+    status=$?
+    end=$(now_ms)
+    echo "$status $((end - start))"
+}
+
+printf "%-10s %10s %10s %10s %10s\n" program ours ours-O gcc-O0 gcc-O2
+for src in "$DIR"/*.c; do
+    name=$(basename "$src" .c)
+    "$COMPILER" "$src" -o "$OUT/$name.ours" > /dev/null || exit 1
+    "$COMPILER" -O "$src" -o "$OUT/$name.ours-O" > /dev/null || exit 1
+    gcc -O0 -w -o "$OUT/$name.gcc-O0" "$src" || exit 1
+    gcc -O2 -w -o "$OUT/$name.gcc-O2" "$src" || exit 1
+
+    line=$(printf "%-10s" "$name")
+    expected=""
+    for kind in ours ours-O gcc-O0 gcc-O2; do
+        set -- $(run "$OUT/$name.$kind")
+        if [ -z "$expected" ]; then
+            expected=$1
+        elif [ "$1" != "$expected" ]; then
+            echo "$name: $kind exited with $1, expected $expected"
+            exit 1
+        fi
+        line="$line $(printf "%10s" "$2")"
+    done
+    echo "$line"
+done
+
+rm -rf "$OUT"
@@ -0,0 +1,268 @@
+/**
+ * dump_bench.c - IR 和 Token 转储的吞吐量（MB/s）
+ *
+ * 同样的文本用两种方式写到空设备，每项至少重复 MIN_SECONDS 秒：
+ *   printf: 每个字段一次 fprintf（原来 ir_print/print_token 的做法）
+ *   writer: ir_dump/token_dump，拼进 Writer 的大缓冲区，整数手写转换
+ * Token 事先扫描好放在数组里，只计输出的时间。
+ *
+ * 用法: bench_dump 文件...
+ */
+
+#include "../include/ir.h"
+#include "../include/lexer.h"
+#include "../include/parser.h"
+#include "../include/semantic.h"
+#include "../include/writer.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_SECONDS 0.2
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+static IRProgram *front_end(const char *source) {
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  ASTNode *ast = parser_parse(&parser);
+  SemanticAnalyzer *analyzer = semantic_init();
+  if (!parser_had_error(&parser))
+    semantic_analyze(analyzer, ast);
+  IRProgram *ir = NULL;
+  if (!parser_had_error(&parser) && !semantic_has_errors(analyzer))
+    ir = ir_generate(ast);
+  semantic_free(analyzer);
+  ast_free(ast);
+  return ir;
+}
+
+static int lex_all(const char *source, Token **tokens) {
+  int count = 0, capacity = 0;
+  Lexer lexer = lexer_init(source);
+  *tokens = NULL;
+  Token token;
+  do {
+    token = lexer_next_token(&lexer);
+    if (count >= capacity) {
+      capacity = capacity == 0 ? 256 : capacity * 2;
+      *tokens = (Token *)realloc(*tokens, sizeof(Token) * capacity);
+    }
+    (*tokens)[count++] = token;
+  } while (token.type != TOKEN_EOF);
+  return count;
+}
+
+// ========== 基线：每个字段一次 fprintf ==========
+
+static size_t printf_operand(FILE *out, IROperand op) {
+  switch (op.type) {
+  case OPERAND_TEMP:
+    return fprintf(out, "t%d", op.value.temp_id);
+  case OPERAND_VAR:
+  case OPERAND_FUNC:
+    return fprintf(out, "%s", op.value.name);
+  case OPERAND_INT:
+    return fprintf(out, "%d", op.value.int_val);
+  case OPERAND_FLOAT:
+    return fprintf(out, "%.2f", op.value.float_val);
+  case OPERAND_LABEL:
+    return fprintf(out, "L%d", op.value.label_id);
+  default:
+    return 0;
+  }
+}
+
+static size_t printf_ir(FILE *out, const IRProgram *program) {
+  size_t n = fprintf(out, "IR Instructions (%d total):\n", program->count);
+  n += fprintf(out, "========================================\n");
+  for (int i = 0; i < program->count; i++) {
+    const IRInstruction *instr = &program->instructions[i];
+    n += fprintf(out, "%4d: ", i);
+    switch (instr->opcode) {
+    case IR_LABEL:
+      n += printf_operand(out, instr->result);
+      n += fprintf(out, ":\n");
+      break;
+    case IR_GOTO:
+    case IR_ARG:
+      n += fprintf(out, instr->opcode == IR_GOTO ? "goto " : "arg ");
+      n += printf_operand(out, instr->result);
+      n += fprintf(out, "\n");
+      break;
+    case IR_IF:
+    case IR_IFFALSE:
+      n += fprintf(out, instr->opcode == IR_IF ? "if " : "iffalse ");
+      n += printf_operand(out, instr->arg1);
+      n += fprintf(out, " goto ");
+      n += printf_operand(out, instr->result);
+      n += fprintf(out, "\n");
+      break;
+    case IR_FUNC_BEGIN:
+      n += fprintf(out, "function ");
+      n += printf_operand(out, instr->result);
+      n += fprintf(out, ":\n");
+      break;
+    case IR_FUNC_END:
+      n += fprintf(out, "end function ");
+      n += printf_operand(out, instr->result);
+      n += fprintf(out, "\n\n");
+      break;
+    case IR_PARAM:
+      n += fprintf(out, "param ");
+      n += printf_operand(out, instr->arg1);
+      n += fprintf(out, "\n");
+      break;
+    case IR_CALL:
+      n += printf_operand(out, instr->result);
+      n += fprintf(out, " = call ");
+      n += printf_operand(out, instr->arg1);
+      n += fprintf(out, ", %d\n", instr->arg_count);
+      break;
+    case IR_TAILCALL:
+      n += fprintf(out, "tailcall ");
+      n += printf_operand(out, instr->arg1);
+      n += fprintf(out, ", %d\n", instr->arg_count);
+      break;
+    case IR_RETURN:
+      n += fprintf(out, "return");
+      if (instr->arg1.type != OPERAND_NONE) {
+        n += fprintf(out, " ");
+        n += printf_operand(out, instr->arg1);
+      }
+      n += fprintf(out, "\n");
+      break;
+    case IR_ASSIGN:
+      n += printf_operand(out, instr->result);
+      n += fprintf(out, " = ");
+      n += printf_operand(out, instr->arg1);
+      n += fprintf(out, "\n");
+      break;
+    case IR_NEG:
+    case IR_NOT:
+      n += printf_operand(out, instr->result);
+      n += fprintf(out, " = %s ", instr->opcode == IR_NEG ? "-" : "!");
+      n += printf_operand(out, instr->arg1);
+      n += fprintf(out, "\n");
+      break;
+    default:
+      n += printf_operand(out, instr->result);
+      n += fprintf(out, " = ");
+      n += printf_operand(out, instr->arg1);
+      n += fprintf(out, " %s ", ir_opcode_to_string(instr->opcode));
+      n += printf_operand(out, instr->arg2);
+      n += fprintf(out, "\n");
+      break;
+    }
+  }
+  n += fprintf(out, "========================================\n");
+  return n;
+}
+
+static size_t printf_tokens(FILE *out, const Token *tokens, int count) {
+  size_t n = 0;
+  for (int i = 0; i < count; i++)
+    n += fprintf(out, "[%-12s] \"%s\"\n", token_type_to_string(tokens[i].type),
+                 tokens[i].value);
+  return n;
+}
+
+// ========== 测量 ==========
+
+typedef enum { DUMP_IR, DUMP_TOKENS } What;
+
+/**
+ * 重复转储至少 MIN_SECONDS 秒，返回 MB/s；*bytes 是一次转储的字节数
+ */
+static double measure(What what, int buffered, FILE *sink,
+                      const IRProgram *ir, const Token *tokens, int count,
+                      size_t *bytes) {
+  Writer *out = buffered ? writer_from_file(sink) : NULL;
+  size_t total = 0;
+  int rounds = 0;
+  double start = now_seconds(), elapsed = 0;
+  while (elapsed < MIN_SECONDS) {
+    if (buffered) {
+      size_t before = out->bytes;
+      if (what == DUMP_IR) {
+        ir_dump(ir, out);
+      } else {
+        for (int i = 0; i < count; i++)
+          token_dump(&tokens[i], out);
+      }
+      *bytes = out->bytes - before;
+    } else {
+      *bytes = what == DUMP_IR ? printf_ir(sink, ir)
+                               : printf_tokens(sink, tokens, count);
+    }
+    total += *bytes;
+    rounds++;
+    if ((rounds & 63) == 0)
+      elapsed = now_seconds() - start;
+  }
+  if (out)
+    writer_close(out);
+  fflush(sink);
+  elapsed = now_seconds() - start;
+  return total / elapsed / 1e6;
+}
+
+static void run(const char *path, FILE *sink) {
+  char *source = read_source(path, NULL);
+  if (!source) {
+    fprintf(stderr, "bench: cannot read %s\n", path);
+    exit(1);
+  }
+  IRProgram *ir = front_end(source);
+  if (!ir) {
+    fprintf(stderr, "bench: %s failed to compile\n", path);
+    exit(1);
+  }
+  Token *tokens;
+  int count = lex_all(source, &tokens);
+
+  size_t ir_bytes, ir_check, token_bytes, token_check;
+  double ir_printf = measure(DUMP_IR, 0, sink, ir, tokens, count, &ir_check);
+  double ir_writer = measure(DUMP_IR, 1, sink, ir, tokens, count, &ir_bytes);
+  double tok_printf =
+      measure(DUMP_TOKENS, 0, sink, ir, tokens, count, &token_check);
+  double tok_writer =
+      measure(DUMP_TOKENS, 1, sink, ir, tokens, count, &token_bytes);
+  if (ir_bytes != ir_check || token_bytes != token_check) {
+    fprintf(stderr, "bench: %s: writer and printf output differ in size\n",
+            path);
+    exit(1);
+  }
+
+  printf("%-26s %8zu %11.1f %11.1f %6.1fx %9zu %11.1f %11.1f %6.1fx\n", path,
+         ir_bytes, ir_printf, ir_writer, ir_writer / ir_printf, token_bytes,
+         tok_printf, tok_writer, tok_writer / tok_printf);
+
+  free(tokens);
+  ir_program_free(ir);
+  free(source);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file...\n", argv[0]);
+    return 1;
+  }
+  FILE *sink = fopen(NULL_DEVICE, "wb");
+  if (!sink) {
+    fprintf(stderr, "bench: cannot open %s\n", NULL_DEVICE);
+    return 1;
+  }
+  printf("%-26s %8s %11s %11s %7s %9s %11s %11s %7s\n", "program", "IR bytes",
+         "printf MB/s", "writer MB/s", "speedup", "tok bytes", "printf MB/s",
+         "writer MB/s", "speedup");
+  for (int i = 1; i < argc; i++)
+    run(argv[i], sink);
+  fclose(sink);
+  return 0;
+}
@@ -0,0 +1,371 @@
+/**
+ * incremental_bench.c - 增量分析的编辑延迟
+ *
+ * 用 progen 生成大约 --lines 行（默认 100000）的程序，先用 document_open
+ * 从头分析一遍（每次编辑都重新编译时的代价），然后在随机位置做几类编辑，
+ * 每类 --edits 次（改完再改回来，两次都计时），记录 document_edit 加上
+ * document_diagnostics 的时间，输出 p50 / p99 / 最大值和平均重新分析的块数：
+ *   literal    把一个整数常量的第一位换成别的数字
+ *   newline    插入一个换行（后面所有块的位置和行号都要移动）
+ *   syntax     删掉一个分号（中间状态有语法错误）
+ *   signature  把一个函数的返回类型 int 改成 float（调用者要重新分析）
+ *
+ * --verify=N：改成做 N 次随机编辑（随机插入删除字符，以及上面几类），每次
+ *   都和从头编译比较：诊断和普通编译打印的文本相同，没有错误时 document_ir
+ *   和 ir_generate 转储的 IR 相同；大纲和名字查询（编辑所在的行逐个位置，
+ *   其余随机取样）和用 document_open 重新打开的相同。不一致时打印那次编辑
+ *   并返回 1。
+ *   每次都要从头编译，适合配小的 --lines。
+ *
+ * 用法: bench_incremental [--lines=N] [--edits=N] [--seed=N] [--verify=N]
+ */
+
+#include "../include/diag.h"
+#include "../include/incremental.h"
+#include "../include/parser.h"
+#include "../include/semantic.h"
+#include "bench_util.h"
+#include "progen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BYTES_PER_LINE 34 // progen 生成的程序平均每行的字节数
+#define TARGET_MS 5.0
+
+// ========== 找编辑的位置 ==========
+
+/**
+ * 一次编辑：把 [offset, offset + deleted) 换成 text
+ */
+typedef struct {
+  int offset;
+  int deleted;
+  char text[16];
+} Edit;
+
+// 行首（函数体里的语句之间）
+static int match_line(const char *text, int length, int i) {
+  return i > 0 && i < length && text[i - 1] == '\n' && text[i] == ' ';
+}
+
+static int match_semicolon(const char *text, int length, int i) {
+  (void)length;
+  return text[i] == ';';
+}
+
+/**
+ * 按种类生成一次编辑和把它改回来的编辑；找不到位置时返回 0
+ */
+static int plan_edit(const Document *doc, int kind, Edit *edit, Edit *undo) {
+  int at;
+  switch (kind) {
+  case 0: // literal
+    if ((at = search(doc->text, doc->length, match_literal)) < 0)
+      return 0;
+    *edit = (Edit){at, 1, {(char)('1' + (doc->text[at] - '0' + 1) % 9)}};
+    *undo = (Edit){at, 1, {doc->text[at]}};
+    return 1;
+  case 1: // newline
+    if ((at = search(doc->text, doc->length, match_line)) < 0)
+      return 0;
+    *edit = (Edit){at, 0, "\n"};
+    *undo = (Edit){at, 1, ""};
+    return 1;
+  case 2: // syntax
+    if ((at = search(doc->text, doc->length, match_semicolon)) < 0)
+      return 0;
+    *edit = (Edit){at, 1, ""};
+    *undo = (Edit){at, 0, ";"};
+    return 1;
+  default: // signature
+    if ((at = search(doc->text, doc->length, match_signature)) < 0)
+      return 0;
+    *edit = (Edit){at, 3, "float"};
+    *undo = (Edit){at, 5, "int"};
+    return 1;
+  }
+}
+
+static const char *const kind_names[] = {"literal", "newline", "syntax",
+                                         "signature"};
+#define KINDS 4
+
+// ========== 计时 ==========
+
+static double apply(Document *doc, const Edit *edit, long *reparsed,
+                    long *reanalyzed) {
+  double start = now_seconds();
+  document_edit(doc, edit->offset, edit->deleted, edit->text,
+                strlen(edit->text));
+  int count;
+  free(document_diagnostics(doc, &count));
+  double elapsed = now_seconds() - start;
+  *reparsed += doc->reparsed;
+  *reanalyzed += doc->reanalyzed;
+  return elapsed;
+}
+
+static int measure(Document *doc, int edits, double open_seconds) {
+  double *samples = (double *)malloc(sizeof(double) * edits * 2);
+  int failed = 0;
+  printf("%-10s %9s %9s %9s %10s %11s\n", "edit", "p50 ms", "p99 ms",
+         "max ms", "reparsed", "reanalyzed");
+  for (int kind = 0; kind < KINDS; kind++) {
+    int count = 0;
+    long reparsed = 0, reanalyzed = 0;
+    for (int i = 0; i < edits; i++) {
+      Edit edit, undo;
+      if (!plan_edit(doc, kind, &edit, &undo))
+        break;
+      samples[count++] = apply(doc, &edit, &reparsed, &reanalyzed);
+      samples[count++] = apply(doc, &undo, &reparsed, &reanalyzed);
+    }
+    if (count == 0)
+      continue;
+    sort_samples(samples, count);
+    double p50 = percentile(samples, count, 50) * 1e3;
+    double p99 = percentile(samples, count, 99) * 1e3;
+    printf("%-10s %9.3f %9.3f %9.3f %10.1f %11.1f\n", kind_names[kind], p50,
+           p99, percentile(samples, count, 100) * 1e3, (double)reparsed / count,
+           (double)reanalyzed / count);
+    if (p99 > TARGET_MS)
+      failed = 1;
+  }
+  printf("full analysis (document_open): %.3f ms\n", open_seconds * 1e3);
+  printf("p99 %s the %.0f ms target\n", failed ? "misses" : "meets",
+         TARGET_MS);
+  free(samples);
+  return 0;
+}
+
+// ========== 和从头编译比较 ==========
+
+/**
+ * 普通编译打印的诊断，没有错误时 *ir 是 IR 的转储（都由调用者 free）
+ */
+static char *compile_reference(const char *source, char **ir) {
+  Writer *out = writer_memory();
+  DiagHandler saved = diag_set_handler(diag_to_writer(out));
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  ASTNode *ast = parser_parse(&parser);
+  *ir = NULL;
+  if (!parser_had_error(&parser)) {
+    SemanticAnalyzer *analyzer = semantic_init();
+    semantic_analyze(analyzer, ast);
+    semantic_print_errors(analyzer);
+    if (!semantic_has_errors(analyzer)) {
+      *ir = dump_ir(ir_generate(ast));
+    }
+    semantic_free(analyzer);
+  }
+  ast_free(ast);
+  diag_set_handler(saved);
+  return writer_take(out);
+}
+
+static char *document_output(Document *doc, char **ir) {
+  Writer *out = writer_memory();
+  DiagHandler saved = diag_set_handler(diag_to_writer(out));
+  document_print_diagnostics(doc);
+  diag_set_handler(saved);
+
+  IRProgram *program = document_ir(doc);
+  *ir = program ? dump_ir(program) : NULL;
+  return writer_take(out);
+}
+
+/**
+ * 随机编辑：多数是插入或删除几个字符，其余是上面几类有意义的编辑
+ */
+static void random_edit(const Document *doc, Edit *edit) {
+  static const char *const snippets[] = {
+      ";", "{", "}", "(", ")", "x", "fn1", "int ", "float ", "\n", " ",
+      "7", "2.5", "fn0(1)", "return ", "/*", "*/", "=", "+", "if (",
+      "else ", "int q;", "\"", "'", "@", "v0", ",", "void "};
+  int choice = next_random(10);
+  Edit undo;
+  if (choice < 2 && plan_edit(doc, next_random(KINDS), edit, &undo))
+    return;
+  edit->offset = next_random(doc->length + 1);
+  if (choice < 6) {
+    edit->deleted = 0;
+    strcpy(edit->text, snippets[next_random(
+                           (int)(sizeof(snippets) / sizeof(snippets[0])))]);
+  } else {
+    int room = doc->length - edit->offset;
+    edit->deleted = room > 0 ? next_random(room < 8 ? room + 1 : 9) : 0;
+    edit->text[0] = '\0';
+  }
+}
+
+#define NAVIGATION_SAMPLES 64 // 编辑所在的行之外随机查询的位置数
+
+/**
+ * 把 offset 处的名字查询写进 out
+ */
+static void describe_reference(const Document *doc, int offset, Writer *out) {
+  int line = 1, line_start = 0;
+  for (int i = 0; i < offset; i++)
+    if (doc->text[i] == '\n') {
+      line++;
+      line_start = i + 1;
+    }
+  DocumentReference ref;
+  if (!document_reference_at(doc, line, offset - line_start + 1, &ref))
+    return;
+  writer_printf(out, "%d:%d %d:%d len %d decl %d:%d %s\n", line,
+                offset - line_start + 1, ref.line, ref.column, ref.length,
+                ref.decl_line, ref.decl_column, ref.detail ? ref.detail : "");
+}
+
+/**
+ * 大纲和 offsets 处的名字查询写成文本（调用者 free）
+ */
+static char *describe_navigation(const Document *doc, const int *offsets,
+                                 int count) {
+  Writer *out = writer_memory();
+  int symbol_count;
+  DocumentSymbol *symbols = document_symbols(doc, &symbol_count);
+  for (int i = 0; i < symbol_count; i++) {
+    const DocumentSymbol *sym = &symbols[i];
+    writer_printf(out, "%s %d:%d %d:%d-%d:%d %s\n", sym->name, sym->line,
+                  sym->column, sym->start_line, sym->start_column,
+                  sym->end_line, sym->end_column, sym->detail);
+  }
+  free(symbols);
+  for (int i = 0; i < count; i++)
+    describe_reference(doc, offsets[i], out);
+  return writer_take(out);
+}
+
+/**
+ * 要查询的位置：编辑所在的行的每个位置，加上随机取样
+ */
+static int *navigation_offsets(const Document *doc, int offset, int *count) {
+  int start = offset, end = offset;
+  while (start > 0 && doc->text[start - 1] != '\n')
+    start--;
+  while (end < doc->length && doc->text[end] != '\n')
+    end++;
+  int *offsets = (int *)malloc(sizeof(int) *
+                               (end - start + 1 + NAVIGATION_SAMPLES));
+  *count = 0;
+  for (int i = start; i <= end; i++)
+    offsets[(*count)++] = i;
+  for (int i = 0; i < NAVIGATION_SAMPLES; i++)
+    offsets[(*count)++] = next_random(doc->length + 1);
+  return offsets;
+}
+
+/**
+ * 和重新打开的文档比较大纲和名字查询，一致时返回 1
+ */
+static int same_navigation(const Document *doc, int offset) {
+  Document *fresh = document_open(doc->text, doc->length);
+  int count;
+  int *offsets = navigation_offsets(doc, offset, &count);
+  char *expected = describe_navigation(fresh, offsets, count);
+  char *actual = describe_navigation(doc, offsets, count);
+  int same = strcmp(expected, actual) == 0;
+  if (!same)
+    fprintf(stderr, "--- document_open:\n%s--- document_edit:\n%s", expected,
+            actual);
+  free(expected);
+  free(actual);
+  free(offsets);
+  document_free(fresh);
+  return same;
+}
+
+static int verify(Document *doc, int edits) {
+  for (int i = 0; i < edits; i++) {
+    Edit edit;
+    random_edit(doc, &edit);
+    document_edit(doc, edit.offset, edit.deleted, edit.text,
+                  strlen(edit.text));
+
+    char *expected_ir, *actual_ir;
+    char *expected = compile_reference(doc->text, &expected_ir);
+    char *actual = document_output(doc, &actual_ir);
+    int same = strcmp(expected, actual) == 0 &&
+               (expected_ir == NULL) == (actual_ir == NULL) &&
+               (!expected_ir || strcmp(expected_ir, actual_ir) == 0);
+    if (!same) {
+      fprintf(stderr,
+              "verify: mismatch after edit %d (offset %d, deleted %d, "
+              "inserted \"%s\")\n--- compiler:\n%s--- document:\n%s",
+              i + 1, edit.offset, edit.deleted, edit.text, expected, actual);
+      if (strcmp(expected, actual) == 0)
+        fprintf(stderr, "(diagnostics match, IR differs)\n");
+    } else if (!same_navigation(doc, edit.offset)) {
+      fprintf(stderr,
+              "verify: navigation differs after edit %d (offset %d, "
+              "deleted %d, inserted \"%s\")\n",
+              i + 1, edit.offset, edit.deleted, edit.text);
+      same = 0;
+    }
+    free(expected);
+    free(actual);
+    free(expected_ir);
+    free(actual_ir);
+    if (!same)
+      return 1;
+  }
+  printf("verify: %d random edit(s) match a full compile\n", edits);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int lines = 100000;
+  int edits = 200;
+  int verify_edits = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--lines=", 8) == 0) {
+      lines = atoi(argv[i] + 8);
+    } else if (strncmp(argv[i], "--edits=", 8) == 0) {
+      edits = atoi(argv[i] + 8);
+    } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+      random_state = strtoull(argv[i] + 7, NULL, 10) | 1;
+    } else if (strncmp(argv[i], "--verify=", 9) == 0) {
+      verify_edits = atoi(argv[i] + 9);
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--lines=N] [--edits=N] [--seed=N] [--verify=N]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (lines < 1 || edits < 1) {
+    fprintf(stderr, "bench: --lines and --edits must be at least 1\n");
+    return 1;
+  }
+
+  ProgenOptions options = progen_default_options();
+  options.seed = random_state;
+  options.size = (size_t)lines * BYTES_PER_LINE;
+  size_t length;
+  char *source = progen_generate(&options, &length);
+  int actual_lines = 0;
+  for (size_t i = 0; i < length; i++)
+    if (source[i] == '\n')
+      actual_lines++;
+
+  double start = now_seconds();
+  Document *doc = document_open(source, length);
+  double open_seconds = now_seconds() - start;
+  free(source);
+  printf("%d line(s), %d byte(s), %d chunk(s)\n", actual_lines, doc->length,
+         doc->chunk_count);
+  if (document_has_errors(doc)) {
+    document_print_diagnostics(doc);
+    fprintf(stderr, "bench: generated program does not compile\n");
+    return 1;
+  }
+
+  int status = verify_edits > 0 ? verify(doc, verify_edits)
+                                : measure(doc, edits, open_seconds);
+  document_free(doc);
+  return status;
+}
@@ -0,0 +1,117 @@
+/**
+ * irbin_bench.c - 二进制 IR 的写出和读回速度，和从源码重新编译对比
+ *
+ * 对每个输入程序分别重复（每项至少 MIN_SECONDS 秒，取平均）：
+ *   front:  词法 + 语法 + 语义分析 + ir_generate（缓存未命中时的代价）
+ *   encode: irbin_encode
+ *   view:   irbin_view（只检查头部，映射后就能用的部分）
+ *   load:   irbin_view + irbin_verify + irbin_to_program（缓存命中时的代价）
+ * 最后一列是 front / load。
+ *
+ * 用法: bench_irbin 文件...
+ */
+
+#include "../include/ir.h"
+#include "../include/irbin.h"
+#include "../include/lexer.h"
+#include "../include/parser.h"
+#include "../include/semantic.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_SECONDS 0.2
+
+static IRProgram *front_end(const char *source) {
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  ASTNode *ast = parser_parse(&parser);
+  SemanticAnalyzer *analyzer = semantic_init();
+  if (!parser_had_error(&parser))
+    semantic_analyze(analyzer, ast);
+  IRProgram *ir = NULL;
+  if (!parser_had_error(&parser) && !semantic_has_errors(analyzer))
+    ir = ir_generate(ast);
+  semantic_free(analyzer);
+  ast_free(ast);
+  return ir;
+}
+
+typedef enum { STEP_FRONT, STEP_ENCODE, STEP_VIEW, STEP_LOAD } Step;
+
+/**
+ * 重复一个步骤至少 MIN_SECONDS 秒，返回每次的微秒数
+ */
+static double measure(Step step, const char *source, const IRProgram *ir,
+                      const unsigned char *image, size_t size) {
+  int rounds = 0;
+  double start = now_seconds(), elapsed = 0;
+  while (elapsed < MIN_SECONDS) {
+    switch (step) {
+    case STEP_FRONT:
+      ir_program_free(front_end(source));
+      break;
+    case STEP_ENCODE: {
+      size_t encoded;
+      free(irbin_encode(ir, &encoded));
+      break;
+    }
+    case STEP_VIEW:
+      irbin_close(irbin_view(image, size));
+      break;
+    case STEP_LOAD: {
+      IRImage *view = irbin_view(image, size);
+      if (!view || !irbin_verify(view))
+        exit(1);
+      ir_program_free(irbin_to_program(view));
+      irbin_close(view);
+      break;
+    }
+    }
+    rounds++;
+    elapsed = now_seconds() - start;
+  }
+  return elapsed / rounds * 1e6;
+}
+
+static void run(const char *path) {
+  char *source = read_source(path, NULL);
+  if (!source) {
+    fprintf(stderr, "bench: cannot read %s\n", path);
+    exit(1);
+  }
+  IRProgram *ir = front_end(source);
+  if (!ir) {
+    fprintf(stderr, "bench: %s failed to compile\n", path);
+    exit(1);
+  }
+
+  size_t size;
+  unsigned char *image = irbin_encode(ir, &size);
+  double front_us = measure(STEP_FRONT, source, ir, image, size);
+  double encode_us = measure(STEP_ENCODE, source, ir, image, size);
+  double view_us = measure(STEP_VIEW, source, ir, image, size);
+  double load_us = measure(STEP_LOAD, source, ir, image, size);
+
+  printf("%-26s %7d %8zu %9.2f %10.2f %8.3f %9.2f %9.1f %7.1fx\n", path,
+         ir->count, size, front_us, encode_us, view_us, load_us,
+         size / load_us, front_us / load_us);
+
+  free(image);
+  ir_program_free(ir);
+  free(source);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file...\n", argv[0]);
+    return 1;
+  }
+  printf("%-26s %7s %8s %9s %10s %8s %9s %9s %8s\n", "program", "instrs",
+         "bytes", "front(us)", "encode(us)", "view(us)", "load(us)",
+         "load MB/s", "speedup");
+  for (int i = 1; i < argc; i++)
+    run(argv[i]);
+  return 0;
+}
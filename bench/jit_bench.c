@@ -0,0 +1,79 @@
+/**
+ * jit_bench.c - JIT 编译延迟和运行时间
+ *
+ * 对每个输入程序先跑一遍前端得到 IR，然后：
+ *   compile: 反复 jit_compile + jit_free，取平均（IR → 可执行内存）
+ *   run:     调用一次 main 的墙上时间
+ *
+ * 用法: bench_jit 文件...
+ */
+
+#include "../include/ir.h"
+#include "../include/jit.h"
+#include "../include/lexer.h"
+#include "../include/parser.h"
+#include "../include/semantic.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_SECONDS 0.2
+
+static void run(const char *path) {
+  char *source = read_source(path, NULL);
+  if (!source) {
+    fprintf(stderr, "bench: cannot read %s\n", path);
+    exit(1);
+  }
+
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  ASTNode *ast = parser_parse(&parser);
+  SemanticAnalyzer *analyzer = semantic_init();
+  if (!parser_had_error(&parser))
+    semantic_analyze(analyzer, ast);
+  if (parser_had_error(&parser) || semantic_has_errors(analyzer)) {
+    fprintf(stderr, "bench: %s failed to compile\n", path);
+    exit(1);
+  }
+  IRProgram *ir = ir_generate(ast);
+
+  int rounds = 0;
+  double start = now_seconds(), elapsed = 0;
+  while (elapsed < MIN_SECONDS) {
+    JitProgram *jit = jit_compile(ir);
+    if (!jit)
+      exit(1);
+    jit_free(jit);
+    rounds++;
+    elapsed = now_seconds() - start;
+  }
+  double compile_us = elapsed / rounds * 1e6;
+
+  JitProgram *jit = jit_compile(ir);
+  start = now_seconds();
+  int result = jit_run_main(jit);
+  double run_ms = (now_seconds() - start) * 1e3;
+  jit_free(jit);
+
+  printf("%-28s %8d %12.1f %10.1f %8d\n", path, ir->count, compile_us, run_ms,
+         result);
+
+  ir_program_free(ir);
+  semantic_free(analyzer);
+  ast_free(ast);
+  free(source);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file...\n", argv[0]);
+    return 1;
+  }
+  printf("%-28s %8s %12s %10s %8s\n", "program", "instrs", "compile(us)",
+         "run(ms)", "result");
+  for (int i = 1; i < argc; i++)
+    run(argv[i]);
+  return 0;
+}
@@ -0,0 +1,204 @@
+/**
+ * lib_bench.c - 通过 compiler.h 在进程内编译，和每次启动一个编译器进程对比
+ *
+ * 对每个输入程序（每项至少重复 MIN_SECONDS 秒）：
+ *   call:    compiler_compile_object + compiler_free 的微秒数（单线程）
+ *   process: system("compiler -q -c ...") 的微秒数（给了 --cli=PATH 时）
+ *   allocs:  一次编译经过上下文分配器的分配次数；同时检查全部释放
+ *   shared:  所有核心共用一个上下文时每秒编译的次数，
+ *            并检查每个线程得到的目标文件和单线程的完全相同
+ *
+ * 用法: bench_lib [--cli=PATH] 文件...
+ */
+
+#include "../include/compiler.h"
+#include "../include/pool.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_SECONDS 0.2
+#define SHARED_JOBS 256
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+// ========== 计数的分配器（单线程使用） ==========
+
+typedef struct {
+  long allocations;
+  long live; // 还没释放的块数
+} Counts;
+
+static void *count_allocate(void *user, size_t size) {
+  Counts *counts = (Counts *)user;
+  counts->allocations++;
+  counts->live++;
+  return malloc(size);
+}
+
+static void *count_reallocate(void *user, void *ptr, size_t size) {
+  Counts *counts = (Counts *)user;
+  counts->allocations++;
+  if (!ptr)
+    counts->live++;
+  return realloc(ptr, size);
+}
+
+static void count_release(void *user, void *ptr) {
+  Counts *counts = (Counts *)user;
+  if (ptr)
+    counts->live--;
+  free(ptr);
+}
+
+static void on_error(void *user, const char *message) {
+  fprintf(stderr, "%s: %s\n", (const char *)user, message);
+}
+
+// ========== 多线程共用一个上下文 ==========
+
+typedef struct {
+  CompilerContext *context;
+  const char *source;
+  size_t length;
+  const unsigned char *expected;
+  size_t expected_size;
+  int *mismatch; // 每个任务一个
+} Shared;
+
+static void shared_job(void *arg, int index) {
+  Shared *shared = (Shared *)arg;
+  unsigned char *data;
+  size_t size;
+  int status = compiler_compile_object(shared->context, shared->source,
+                                       shared->length, &data, &size);
+  shared->mismatch[index] =
+      status != 0 || size != shared->expected_size ||
+      memcmp(data, shared->expected, size) != 0;
+  compiler_free(shared->context, data);
+}
+
+static void run(const char *path, const char *cli) {
+  size_t length;
+  char *source = read_source(path, &length);
+  if (!source) {
+    fprintf(stderr, "bench: cannot read %s\n", path);
+    exit(1);
+  }
+
+  Counts counts = {0, 0};
+  CompilerAllocator allocator = {count_allocate, count_reallocate,
+                                 count_release, &counts};
+  CompilerConfig config = compiler_default_config();
+  config.flags = COMPILER_OPTIMIZE;
+  config.allocator = &allocator;
+  config.diagnostic = on_error;
+  config.diagnostic_user = (void *)path;
+  CompilerContext *context = compiler_create(&config);
+
+  unsigned char *expected;
+  size_t expected_size;
+  if (compiler_compile_object(context, source, length, &expected,
+                              &expected_size) != 0) {
+    fprintf(stderr, "bench: %s failed to compile\n", path);
+    exit(1);
+  }
+
+  // 单线程调用
+  int rounds = 0;
+  long before = counts.allocations;
+  double start = now_seconds(), elapsed = 0;
+  while (elapsed < MIN_SECONDS) {
+    unsigned char *data;
+    size_t size;
+    compiler_compile_object(context, source, length, &data, &size);
+    compiler_free(context, data);
+    rounds++;
+    elapsed = now_seconds() - start;
+  }
+  double call_us = elapsed / rounds * 1e6;
+  double allocs = (double)(counts.allocations - before) / rounds;
+
+  // 每次一个进程
+  double process_us = 0;
+  if (cli) {
+    char command[1024];
+    snprintf(command, sizeof(command), "%s -q -O -c %s -o %s", cli, path,
+             NULL_DEVICE);
+    rounds = 0;
+    start = now_seconds();
+    elapsed = 0;
+    while (elapsed < MIN_SECONDS) {
+      if (system(command) != 0) {
+        fprintf(stderr, "bench: '%s' failed\n", command);
+        exit(1);
+      }
+      rounds++;
+      elapsed = now_seconds() - start;
+    }
+    process_us = elapsed / rounds * 1e6;
+  }
+
+  // 所有线程共用一个上下文（标准库分配器，计数的分配器不是线程安全的）
+  CompilerConfig shared_config = config;
+  shared_config.allocator = NULL;
+  Shared shared = {compiler_create(&shared_config), source, length, expected,
+                   expected_size, (int *)calloc(SHARED_JOBS, sizeof(int))};
+  rounds = 0;
+  start = now_seconds();
+  elapsed = 0;
+  while (elapsed < MIN_SECONDS) {
+    pool_run(0, SHARED_JOBS, shared_job, &shared);
+    rounds++;
+    elapsed = now_seconds() - start;
+  }
+  double per_second = rounds * SHARED_JOBS / elapsed;
+  for (int i = 0; i < SHARED_JOBS; i++) {
+    if (shared.mismatch[i]) {
+      fprintf(stderr, "bench: %s: objects differ between threads\n", path);
+      exit(1);
+    }
+  }
+  compiler_destroy(shared.context);
+  free(shared.mismatch);
+
+  compiler_free(context, expected);
+  compiler_destroy(context);
+  if (counts.live != 0) {
+    fprintf(stderr, "bench: %s: %ld block(s) not released\n", path,
+            counts.live);
+    exit(1);
+  }
+
+  printf("%-26s %8zu %9.1f", path, expected_size, call_us);
+  if (cli)
+    printf(" %11.1f %7.1fx", process_us, process_us / call_us);
+  else
+    printf(" %11s %8s", "-", "-");
+  printf(" %8.0f %11.0f\n", allocs, per_second);
+  free(source);
+}
+
+int main(int argc, char *argv[]) {
+  const char *cli = NULL;
+  int first = 1;
+  if (argc > 1 && strncmp(argv[1], "--cli=", 6) == 0) {
+    cli = argv[1] + 6;
+    first = 2;
+  }
+  if (first >= argc) {
+    fprintf(stderr, "Usage: %s [--cli=PATH] file...\n", argv[0]);
+    return 1;
+  }
+  printf("%d thread(s) share one context\n", pool_default_threads());
+  printf("%-26s %8s %9s %11s %8s %8s %11s\n", "program", "object", "call(us)",
+         "process(us)", "speedup", "allocs", "shared(/s)");
+  for (int i = first; i < argc; i++)
+    run(argv[i], cli);
+  return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * liveness_bench.c - 活跃变量分析收敛时间基准测试
+ *
+ * 生成一个有几千个临时变量的函数（循环 + 分支 + 长依赖链），
+ * 编译到 IR 之后反复运行 liveness_analyze，统计每次分析的耗时
+ * 以及工作表处理了多少次块。
+ *
+ * 用法: bench_liveness [语句数...]   默认 250 1000 4000
+ */
+
+#include "../include/ir.h"
+#include "../include/lexer.h"
+#include "../include/liveness.h"
+#include "../include/parser.h"
+#include "../include/semantic.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  char *data;
+  int length;
+  int capacity;
+} Source;
+
+static void append(Source *src, const char *fmt, int a, int b, int c) {
+  char line[256];
+  int n = snprintf(line, sizeof(line), fmt, a, b, c);
+  if (src->length + n + 1 > src->capacity) {
+    src->capacity = (src->length + n + 1) * 2;
+    src->data = (char *)realloc(src->data, src->capacity);
+  }
+  memcpy(src->data + src->length, line, n + 1);
+  src->length += n;
+}
+
+/**
+ * 生成测试函数：
+ *   while 循环里是一长串互相依赖的局部变量，每 8 条插入一个 if，
+ *   让 CFG 有很多块，并且 s 跨越整个循环活跃
+ */
+static char *generate(int statements) {
+  Source src = {NULL, 0, 0};
+  append(&src, "int f(int a) {\n  int s = 0;\n  int i = 0;\n", 0, 0, 0);
+  append(&src, "  while (i < a) {\n    int v0 = a + i;\n", 0, 0, 0);
+  for (int k = 1; k < statements; k++) {
+    append(&src, "    int v%d = v%d * 3 + i - s;\n", k, k - 1, 0);
+    if (k % 8 == 0)
+      append(&src, "    if (v%d > %d) { s = s + v%d; }\n", k, k, k);
+  }
+  append(&src, "    s = s + v%d;\n    i = i + 1;\n  }\n  return s;\n}\n",
+         statements - 1, 0, 0);
+  return src.data;
+}
+
+static void run(int statements) {
+  char *source = generate(statements);
+
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  ASTNode *ast = parser_parse(&parser);
+  if (parser_had_error(&parser)) {
+    fprintf(stderr, "bench: generated program failed to parse\n");
+    exit(1);
+  }
+  SemanticAnalyzer *analyzer = semantic_init();
+  semantic_analyze(analyzer, ast);
+  IRProgram *ir = ir_generate(ast);
+
+  IRFunction *functions = NULL;
+  ir_collect_functions(ir, &functions);
+
+  // 至少重复 0.2 秒，取平均
+  int rounds = 0;
+  double start = now_seconds(), elapsed = 0;
+  Liveness *lv = NULL;
+  while (elapsed < 0.2) {
+    liveness_free(lv);
+    lv = liveness_analyze(ir, &functions[0]);
+    rounds++;
+    elapsed = now_seconds() - start;
+  }
+
+  printf("%8d %8d %8d %8d %8d %12.1f\n", ir->count, lv->cfg->block_count,
+         lv->temp_count, lv->var_count, lv->visits,
+         elapsed / rounds * 1e6);
+
+  liveness_free(lv);
+  free(functions);
+  ir_program_free(ir);
+  semantic_free(analyzer);
+  ast_free(ast);
+  free(source);
+}
+
+int main(int argc, char *argv[]) {
+  printf("%8s %8s %8s %8s %8s %12s\n", "instrs", "blocks", "temps", "vars",
+         "visits", "usec/run");
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++)
+      run(atoi(argv[i]));
+  } else {
+    run(250);
+    run(1000);
+    run(4000);
+  }
+  return 0;
+}
@@ -0,0 +1,414 @@
+/**
+ * lsp_bench.c - 语言服务器的按键到诊断延迟
+ *
+ * 在本进程的一个线程里运行 lsp_run，通过两根管道和它说 JSON-RPC，和编辑器
+ * 一样发消息。用 progen 生成大约 --lines 行（默认 100000）的程序并 didOpen，
+ * 然后在 --sites 个（默认 20）随机函数体的开头一个字符一个字符地敲进
+ * "int zz = 1 + 2;" 和换行，再一个一个退格删掉。每次按键是一条带 range 的
+ * didChange，计时到收到这个 version 的 publishDiagnostics 为止。
+ * 敲完时文档没有错误，删完时和原来的文本相同，否则返回 1。
+ *
+ * 之后在随机的函数调用处各发 --queries 次（默认 200）hover 和 definition，
+ * 检查 definition 指向被调函数的定义，再发几次 documentSymbol。
+ * 输出每种消息的 p50 / p99 / 最大值。
+ *
+ * 用法: bench_lsp [--lines=N] [--sites=N] [--queries=N] [--seed=N]
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "../include/json.h"
+#include "../include/lsp.h"
+#include "../include/writer.h"
+#include "bench_util.h"
+#include "progen.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BYTES_PER_LINE 34 // progen 生成的程序平均每行的字节数
+#define TARGET_MS 5.0
+#define SYMBOL_REQUESTS 10
+#define URI "file:///bench.c"
+
+static const char typed[] = "int zz = 1 + 2;\n";
+
+// ========== 客户端 ==========
+
+static FILE *to_server;
+static FILE *from_server;
+static int next_id = 1;
+
+static void send_message(Writer *body) {
+  fprintf(to_server, "Content-Length: %lu\r\n\r\n",
+          (unsigned long)body->length);
+  fwrite(body->buffer, 1, body->length, to_server);
+  fflush(to_server);
+  writer_close(body);
+}
+
+static JsonValue *read_message(void) {
+  char header[256];
+  long length = -1;
+  for (;;) {
+    if (!fgets(header, sizeof(header), from_server)) {
+      fprintf(stderr, "bench: server closed the connection\n");
+      exit(1);
+    }
+    if (strcmp(header, "\r\n") == 0)
+      break;
+    if (strncmp(header, "Content-Length:", 15) == 0)
+      length = atol(header + 15);
+  }
+  char *body = (char *)malloc(length > 0 ? length : 1);
+  if (length < 0 || fread(body, 1, length, from_server) != (size_t)length) {
+    fprintf(stderr, "bench: bad message from the server\n");
+    exit(1);
+  }
+  JsonValue *message = json_parse(body, length);
+  free(body);
+  if (!message) {
+    fprintf(stderr, "bench: server sent invalid JSON\n");
+    exit(1);
+  }
+  return message;
+}
+
+/**
+ * 发一个请求，params 是 JSON 文本；返回应答的 result（整条消息，调用者
+ * json_free）。中间收到的通知丢掉
+ */
+static JsonValue *request(const char *method, const char *params) {
+  int id = next_id++;
+  Writer *out = writer_memory();
+  writer_printf(out, "{\"jsonrpc\":\"2.0\",\"id\":%d,\"method\":\"%s\"", id,
+                method);
+  if (params)
+    writer_printf(out, ",\"params\":%s", params);
+  writer_putc(out, '}');
+  send_message(out);
+  for (;;) {
+    JsonValue *message = read_message();
+    if (json_number(json_get(message, "id"), -1) == id) {
+      if (json_get(message, "error")) {
+        fprintf(stderr, "bench: %s failed\n", method);
+        exit(1);
+      }
+      return message;
+    }
+    json_free(message);
+  }
+}
+
+static void notify(Writer *out) {
+  writer_putc(out, '}');
+  send_message(out);
+}
+
+/**
+ * 等这个 version 的 publishDiagnostics，返回诊断的个数
+ */
+static int wait_diagnostics(int version) {
+  for (;;) {
+    JsonValue *message = read_message();
+    const JsonValue *params = json_get(message, "params");
+    if (strcmp(json_string(json_get(message, "method"), ""),
+               "textDocument/publishDiagnostics") == 0 &&
+        json_number(json_get(params, "version"), -1) == version) {
+      const JsonValue *diagnostics = json_get(params, "diagnostics");
+      int count = diagnostics ? diagnostics->count : -1;
+      json_free(message);
+      return count;
+    }
+    json_free(message);
+  }
+}
+
+/**
+ * 把 [start, end) 换成 text 的 didChange（行列都从 0 开始）
+ */
+static void change(int version, int line, int start, int end_line, int end,
+                   const char *text) {
+  Writer *out = writer_memory();
+  writer_printf(out,
+                "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\","
+                "\"params\":{\"textDocument\":{\"uri\":\"" URI "\","
+                "\"version\":%d},\"contentChanges\":[{\"range\":{"
+                "\"start\":{\"line\":%d,\"character\":%d},"
+                "\"end\":{\"line\":%d,\"character\":%d}},\"text\":",
+                version, line, start, end_line, end);
+  json_write_string(out, text, strlen(text));
+  writer_puts(out, "}]}");
+  notify(out);
+}
+
+// ========== 会话 ==========
+
+static int line_of(const char *text, int offset) {
+  int line = 0;
+  for (int i = 0; i < offset; i++)
+    if (text[i] == '\n')
+      line++;
+  return line;
+}
+
+/**
+ * 在 line 行开头敲进 typed、再退格删掉，每次按键的延迟放进 samples
+ */
+static int type_and_erase(int line, int *version, double *samples,
+                          int *count) {
+  int n = (int)strlen(typed);
+  for (int i = 0; i < n; i++) {
+    char key[2] = {typed[i], '\0'};
+    double start = now_seconds();
+    change(++*version, line, i, line, i, key);
+    int errors = wait_diagnostics(*version);
+    samples[(*count)++] = now_seconds() - start;
+    if (i == n - 1 && errors != 0) {
+      fprintf(stderr, "bench: %d diagnostic(s) after typing at line %d\n",
+              errors, line + 1);
+      return 0;
+    }
+  }
+  for (int i = n - 1; i >= 0; i--) {
+    double start = now_seconds();
+    if (typed[i] == '\n')
+      change(++*version, line, i, line + 1, 0, "");
+    else
+      change(++*version, line, i, line, i + 1, "");
+    int errors = wait_diagnostics(*version);
+    samples[(*count)++] = now_seconds() - start;
+    if (i == 0 && errors != 0) {
+      fprintf(stderr, "bench: %d diagnostic(s) after erasing at line %d\n",
+              errors, line + 1);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * 随机找一处函数调用（前面是空格或括号、不是 "int " 的 "fn"），返回名字的偏移
+ */
+static int find_call(const char *text, int length) {
+  int from = next_random(length);
+  for (int pass = 0; pass < 2; pass++) {
+    int end = pass == 0 ? length - 2 : from;
+    for (int i = pass == 0 ? from : 4; i < end; i++)
+      if (i >= 4 && text[i] == 'f' && text[i + 1] == 'n' &&
+          (text[i - 1] == ' ' || text[i - 1] == '(') &&
+          strncmp(text + i - 4, "int ", 4) != 0)
+        return i;
+  }
+  return -1;
+}
+
+/**
+ * 被调函数定义所在的行（"int fnN(" 在行首），找不到时返回 -1
+ */
+static int definition_line(const char *text, int call) {
+  char pattern[32] = "\nint ";
+  int n = 5;
+  for (int i = call; text[i] != '(' && n < (int)sizeof(pattern) - 2; i++)
+    pattern[n++] = text[i];
+  pattern[n++] = '(';
+  pattern[n] = '\0';
+  if (strncmp(text, pattern + 1, n - 1) == 0)
+    return 0;
+  const char *found = strstr(text, pattern);
+  return found ? line_of(text, (int)(found - text) + 1) : -1;
+}
+
+static int run_queries(const char *text, int length, int queries) {
+  double *hovers = (double *)malloc(sizeof(double) * queries);
+  double *definitions = (double *)malloc(sizeof(double) * queries);
+  double symbols[SYMBOL_REQUESTS];
+  char params[256];
+  for (int i = 0; i < queries; i++) {
+    int call = find_call(text, length);
+    if (call < 0) {
+      fprintf(stderr, "bench: no function calls in the program\n");
+      return 0;
+    }
+    int line = line_of(text, call);
+    int column = call;
+    while (column > 0 && text[column - 1] != '\n')
+      column--;
+    column = call - column + 1; // 名字中间
+    snprintf(params, sizeof(params),
+             "{\"textDocument\":{\"uri\":\"" URI "\"},"
+             "\"position\":{\"line\":%d,\"character\":%d}}",
+             line, column);
+
+    double start = now_seconds();
+    JsonValue *hover = request("textDocument/hover", params);
+    hovers[i] = now_seconds() - start;
+    const JsonValue *contents =
+        json_get(json_get(hover, "result"), "contents");
+    if (!strstr(json_string(json_get(contents, "value"), ""), "fn")) {
+      fprintf(stderr, "bench: no hover at line %d\n", line + 1);
+      return 0;
+    }
+    json_free(hover);
+
+    start = now_seconds();
+    JsonValue *definition = request("textDocument/definition", params);
+    definitions[i] = now_seconds() - start;
+    const JsonValue *range = json_get(json_get(definition, "result"), "range");
+    int target = (int)json_number(json_get(json_get(range, "start"), "line"),
+                                  -1);
+    if (target != definition_line(text, call)) {
+      fprintf(stderr, "bench: definition at line %d points at line %d\n",
+              line + 1, target + 1);
+      return 0;
+    }
+    json_free(definition);
+  }
+
+  int symbol_count = 0;
+  for (int i = 0; i < SYMBOL_REQUESTS; i++) {
+    double start = now_seconds();
+    JsonValue *reply = request("textDocument/documentSymbol",
+                               "{\"textDocument\":{\"uri\":\"" URI "\"}}");
+    symbols[i] = now_seconds() - start;
+    const JsonValue *result = json_get(reply, "result");
+    symbol_count = result ? result->count : 0;
+    json_free(reply);
+  }
+
+  report_latency("hover", hovers, queries);
+  report_latency("definition", definitions, queries);
+  report_latency("documentSymbol", symbols, SYMBOL_REQUESTS);
+  printf("documentSymbol: %d symbol(s)\n", symbol_count);
+  free(hovers);
+  free(definitions);
+  return 1;
+}
+
+static void *serve(void *files) {
+  FILE **pair = (FILE **)files;
+  static int status;
+  status = lsp_run(pair[0], pair[1]);
+  fclose(pair[1]);
+  return &status;
+}
+
+int main(int argc, char *argv[]) {
+  int lines = 100000;
+  int sites = 20;
+  int queries = 200;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--lines=", 8) == 0) {
+      lines = atoi(argv[i] + 8);
+    } else if (strncmp(argv[i], "--sites=", 8) == 0) {
+      sites = atoi(argv[i] + 8);
+    } else if (strncmp(argv[i], "--queries=", 10) == 0) {
+      queries = atoi(argv[i] + 10);
+    } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+      random_state = strtoull(argv[i] + 7, NULL, 10) | 1;
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--lines=N] [--sites=N] [--queries=N] [--seed=N]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (lines < 1 || sites < 1 || queries < 1) {
+    fprintf(stderr, "bench: --lines, --sites and --queries must be at least "
+                    "1\n");
+    return 1;
+  }
+
+  ProgenOptions options = progen_default_options();
+  options.seed = random_state;
+  options.size = (size_t)lines * BYTES_PER_LINE;
+  size_t length;
+  char *source = progen_generate(&options, &length);
+
+  int requests[2], replies[2];
+  if (pipe(requests) != 0 || pipe(replies) != 0) {
+    perror("bench: pipe");
+    return 1;
+  }
+  FILE *server_files[2] = {fdopen(requests[0], "rb"), fdopen(replies[1], "wb")};
+  to_server = fdopen(requests[1], "wb");
+  from_server = fdopen(replies[0], "rb");
+  pthread_t thread;
+  pthread_create(&thread, NULL, serve, server_files);
+
+  json_free(request("initialize", "{\"processId\":null,\"capabilities\":{}}"));
+  Writer *out = writer_memory();
+  writer_puts(out, "{\"jsonrpc\":\"2.0\",\"method\":\"initialized\","
+                   "\"params\":{}");
+  notify(out);
+
+  double start = now_seconds();
+  out = writer_memory();
+  writer_puts(out, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\","
+                   "\"params\":{\"textDocument\":{\"uri\":\"" URI "\","
+                   "\"languageId\":\"c\",\"version\":1,\"text\":");
+  json_write_string(out, source, length);
+  writer_puts(out, "}}");
+  notify(out);
+  int version = 1;
+  int errors = wait_diagnostics(version);
+  double open_seconds = now_seconds() - start;
+  printf("%d line(s), %lu byte(s)\n", line_of(source, (int)length),
+         (unsigned long)length);
+  if (errors != 0) {
+    fprintf(stderr, "bench: generated program has %d diagnostic(s)\n",
+            errors);
+    return 1;
+  }
+
+  // 敲字的位置：函数头（"int fnN(...) {"）的下一行
+  int *heads = (int *)malloc(sizeof(int) * (length / 8 + 1));
+  int head_count = 0;
+  for (int i = 0, line = 0; i + 6 <= (int)length; i++) {
+    if ((i == 0 || source[i - 1] == '\n') &&
+        strncmp(source + i, "int fn", 6) == 0)
+      heads[head_count++] = line + 1;
+    if (source[i] == '\n')
+      line++;
+  }
+  if (head_count == 0) {
+    fprintf(stderr, "bench: no functions in the program\n");
+    return 1;
+  }
+
+  int keystrokes = sites * (int)strlen(typed) * 2;
+  double *samples = (double *)malloc(sizeof(double) * keystrokes);
+  int count = 0;
+  int ok = 1;
+  printf("%-16s %7s %9s %9s %9s\n", "message", "count", "p50 ms", "p99 ms",
+         "max ms");
+  for (int i = 0; i < sites && ok; i++)
+    ok = type_and_erase(heads[next_random(head_count)], &version, samples,
+                        &count);
+  if (ok) {
+    report_latency("keystroke", samples, count);
+    ok = run_queries(source, (int)length, queries);
+  }
+  double p99 = samples[(count * 99) / 100] * 1e3;
+
+  json_free(request("shutdown", NULL));
+  out = writer_memory();
+  writer_puts(out, "{\"jsonrpc\":\"2.0\",\"method\":\"exit\"");
+  notify(out);
+  void *status;
+  pthread_join(thread, &status);
+  fclose(to_server);
+  fclose(from_server);
+  fclose(server_files[0]);
+
+  printf("didOpen to diagnostics: %.3f ms\n", open_seconds * 1e3);
+  if (ok)
+    printf("keystroke p99 %s the %.0f ms target\n",
+           p99 > TARGET_MS ? "misses" : "meets", TARGET_MS);
+  free(samples);
+  free(heads);
+  free(source);
+  return ok && *(int *)status == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+/**
+ * object_bench.c - 目标文件生成速度：直接写 ELF vs 经过汇编器
+ *
+ * 对每个输入程序先跑一遍前端得到 IR，然后分别重复：
+ *   direct: codegen_generate + object_write（进程内编码）
+ *   as:     codegen_generate + 写 .s + 调用系统的 as
+ * 统计每秒能生成多少个目标文件。计时用墙上时间，因为 as 在子进程里运行。
+ *
+ * 用法: bench_object 文件...
+ */
+
+#include "../include/codegen.h"
+#include "../include/ir.h"
+#include "../include/lexer.h"
+#include "../include/object.h"
+#include "../include/parser.h"
+#include "../include/semantic.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_SECONDS 0.5
+
+static int emit_direct(IRProgram *ir, const char *object_path) {
+  X86Module *module = codegen_generate(ir);
+  if (!module)
+    return 1;
+  int status = object_write(module, object_path);
+  x86_module_free(module);
+  return status;
+}
+
+static int emit_via_as(IRProgram *ir, const char *asm_path,
+                       const char *object_path) {
+  if (codegen_write_assembly(ir, asm_path) != 0)
+    return 1;
+  char command[512];
+  snprintf(command, sizeof(command), "as -o '%s' '%s'", object_path, asm_path);
+  return system(command) != 0;
+}
+
+/**
+ * 重复 route 至少 MIN_SECONDS 秒，返回每秒生成的目标文件数（失败返回 0）
+ */
+static double measure(IRProgram *ir, int use_as) {
+  const char *asm_path = "bench_object.tmp.s";
+  const char *object_path = "bench_object.tmp.o";
+  int rounds = 0;
+  double start = now_seconds(), elapsed = 0;
+  while (elapsed < MIN_SECONDS) {
+    int status = use_as ? emit_via_as(ir, asm_path, object_path)
+                        : emit_direct(ir, object_path);
+    if (status != 0)
+      return 0;
+    rounds++;
+    elapsed = now_seconds() - start;
+  }
+  remove(asm_path);
+  remove(object_path);
+  return rounds / elapsed;
+}
+
+static void run(const char *path) {
+  char *source = read_source(path, NULL);
+  if (!source) {
+    fprintf(stderr, "bench: cannot read %s\n", path);
+    exit(1);
+  }
+
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  ASTNode *ast = parser_parse(&parser);
+  SemanticAnalyzer *analyzer = semantic_init();
+  if (!parser_had_error(&parser))
+    semantic_analyze(analyzer, ast);
+  if (parser_had_error(&parser) || semantic_has_errors(analyzer)) {
+    fprintf(stderr, "bench: %s failed to compile\n", path);
+    exit(1);
+  }
+  IRProgram *ir = ir_generate(ast);
+
+  double direct = measure(ir, 0);
+  double via_as = measure(ir, 1);
+  if (direct == 0 || via_as == 0) {
+    fprintf(stderr, "bench: code generation failed for %s\n", path);
+    exit(1);
+  }
+  printf("%-28s %8d %12.0f %12.0f %8.1fx\n", path, ir->count, direct, via_as,
+         direct / via_as);
+
+  ir_program_free(ir);
+  semantic_free(analyzer);
+  ast_free(ast);
+  free(source);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file...\n", argv[0]);
+    return 1;
+  }
+  printf("%-28s %8s %12s %12s %9s\n", "program", "instrs", "direct/s", "as/s",
+         "speedup");
+  for (int i = 1; i < argc; i++)
+    run(argv[i]);
+  return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * parallel_bench.c - 多文件并行编译在 1/2/4/8/16 个线程上的扩展性
+ *
+ * 把输入程序复制成 JOBS 个编译任务（源码事先读进内存，不计文件 I/O），
+ * 每个任务做一遍 -O 的编译：前端 + 内联/尾调用/窥孔 + 每个函数的寄存器分配。
+ * 用 pool_run 在不同的线程数上执行整批任务，每种线程数至少重复 MIN_SECONDS 秒。
+ *
+ * 输出每种线程数的耗时、相对单线程的加速比、并行效率和窃取次数。
+ * 线程数超过核心数时加速比不会再增长。
+ *
+ * 用法: bench_parallel 文件...
+ */
+
+#include "../include/inline.h"
+#include "../include/ir.h"
+#include "../include/lexer.h"
+#include "../include/parser.h"
+#include "../include/peephole.h"
+#include "../include/pool.h"
+#include "../include/regalloc.h"
+#include "../include/semantic.h"
+#include "../include/tailcall.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JOBS 512
+#define MIN_SECONDS 0.5
+
+typedef struct {
+  char **sources;
+  int source_count;
+  int *failed; // 每个任务一个，避免线程间写同一个变量
+} Batch;
+
+/**
+ * 一个任务：和 `compiler -O -q` 相同的工作量，外加寄存器分配
+ */
+static void compile_job(void *context, int index) {
+  Batch *batch = (Batch *)context;
+  const char *source = batch->sources[index % batch->source_count];
+
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  ASTNode *ast = parser_parse(&parser);
+  SemanticAnalyzer *analyzer = semantic_init();
+  if (!parser_had_error(&parser))
+    semantic_analyze(analyzer, ast);
+  IRProgram *ir = NULL;
+  if (!parser_had_error(&parser) && !semantic_has_errors(analyzer))
+    ir = ir_generate(ast);
+  semantic_free(analyzer);
+  ast_free(ast);
+  if (!ir) {
+    batch->failed[index] = 1;
+    return;
+  }
+
+  ir_inline(ir, inline_default_options());
+  ir_optimize_tail_calls(ir);
+  ir_peephole(ir);
+
+  IRFunction *functions = NULL;
+  int func_count = ir_collect_functions(ir, &functions);
+  for (int i = 0; i < func_count; i++)
+    regalloc_free(regalloc_function(ir, &functions[i]));
+  free(functions);
+  ir_program_free(ir);
+}
+
+/**
+ * 用 threads 个线程把整批任务重复至少 MIN_SECONDS 秒，返回每批的毫秒数
+ */
+static double measure(Batch *batch, int threads, int *steals) {
+  int rounds = 0;
+  *steals = 0;
+  double start = now_seconds(), elapsed = 0;
+  while (elapsed < MIN_SECONDS) {
+    PoolStats stats = pool_run(threads, JOBS, compile_job, batch);
+    *steals += stats.steals;
+    rounds++;
+    elapsed = now_seconds() - start;
+  }
+  *steals /= rounds;
+  return elapsed / rounds * 1e3;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file...\n", argv[0]);
+    return 1;
+  }
+  Batch batch;
+  batch.source_count = argc - 1;
+  batch.sources = (char **)malloc(sizeof(char *) * batch.source_count);
+  batch.failed = (int *)calloc(JOBS, sizeof(int));
+  for (int i = 0; i < batch.source_count; i++) {
+    batch.sources[i] = read_source(argv[i + 1], NULL);
+    if (!batch.sources[i]) {
+      fprintf(stderr, "bench: cannot read %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+
+  printf("%d jobs from %d file(s), %d core(s) online\n", JOBS,
+         batch.source_count, pool_default_threads());
+  printf("%8s %10s %8s %11s %7s\n", "threads", "batch(ms)", "speedup",
+         "efficiency", "steals");
+  static const int thread_counts[] = {1, 2, 4, 8, 16};
+  double base = 0;
+  for (int i = 0; i < 5; i++) {
+    int threads = thread_counts[i], steals;
+    double ms = measure(&batch, threads, &steals);
+    if (i == 0)
+      base = ms;
+    printf("%8d %10.2f %7.2fx %10.0f%% %7d\n", threads, ms, base / ms,
+           100.0 * base / ms / threads, steals);
+  }
+
+  for (int i = 0; i < JOBS; i++) {
+    if (batch.failed[i]) {
+      fprintf(stderr, "bench: %s failed to compile\n",
+              argv[1 + i % batch.source_count]);
+      return 1;
+    }
+  }
+  for (int i = 0; i < batch.source_count; i++)
+    free(batch.sources[i]);
+  free(batch.sources);
+  free(batch.failed);
+  return 0;
+}
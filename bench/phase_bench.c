@@ -0,0 +1,356 @@
+/**
+ * phase_bench.c - 各阶段在 1 KB 到 1 GB 合成程序上的吞吐量
+ *
+ * 用 progen 生成 1 KB、16 KB、256 KB …（每次乘 16，直到 --max-size）的程序，
+ * 每种大小跑完整的 -O 编译（小程序重复到至少 MIN_SECONDS 秒），用 timing.h
+ * 记录 lex、parse、semantic、ir-generate、inline、tail-calls、peephole、codegen，
+ * 输出每个阶段每秒处理的 token / AST 节点 / IR 指令数，以及进程的峰值 RSS
+ * （大小从小到大，所以是到这个大小为止的峰值）。生成源码的时间不算在内。
+ *
+ * --baseline=FILE：和保存的结果比较，某个阶段相对 lex 的吞吐量比值低于基线的
+ *   (100 - TOLERANCE)%，或峰值 RSS 超过基线的 (100 + TOLERANCE)% 时返回 1；
+ *   基线里没有的大小只打印不比较。比较的是同一次运行里阶段之间的比值，
+ *   不是绝对的每秒条数，所以基线在别的机器上也能用；小于 256 KB 的输入
+ *   只比较峰值 RSS
+ * --update-baseline：把这次的结果写到 --baseline 的文件
+ * --stream：前端用 stream.h 逐个声明处理（峰值 RSS 是整个进程的，
+ *   和普通前端比较时分两次运行）
+ *
+ * 用法: bench_phases [--max-size=BYTES] [--baseline=FILE [--update-baseline]]
+ *                    [--tolerance=PCT] [--stream]
+ */
+
+#include "../include/ast.h"
+#include "../include/codegen.h"
+#include "../include/inline.h"
+#include "../include/ir.h"
+#include "../include/lexer.h"
+#include "../include/object.h"
+#include "../include/parser.h"
+#include "../include/peephole.h"
+#include "../include/semantic.h"
+#include "../include/stream.h"
+#include "../include/tailcall.h"
+#include "../include/timing.h"
+#include "progen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_SECONDS 0.3
+#define MAX_SIZES 8
+#define DEFAULT_MAX_SIZE ((size_t)4 << 20)
+#define DEFAULT_TOLERANCE 50
+// 更小的输入每个阶段只有几十微秒，比值的抖动比容差还大，只打印不比较
+#define BASELINE_MIN_SIZE ((size_t)256 << 10)
+
+static const char *const phase_names[] = {
+    "lex",    "parse",      "semantic", "ir-generate",
+    "inline", "tail-calls", "peephole", "codegen"};
+#define PHASES ((int)(sizeof(phase_names) / sizeof(phase_names[0])))
+
+typedef struct {
+  size_t size;
+  double rate[PHASES]; // 每秒处理的对象数
+  const char *unit[PHASES];
+  long rss_kb;
+} Result;
+
+static int stream_mode; // --stream
+
+static size_t parse_size(const char *text) {
+  char *end;
+  double value = strtod(text, &end);
+  if (*end == 'k' || *end == 'K')
+    value *= 1024;
+  else if (*end == 'm' || *end == 'M')
+    value *= 1024 * 1024;
+  else if (*end == 'g' || *end == 'G')
+    value *= 1024.0 * 1024 * 1024;
+  return (size_t)value;
+}
+
+static void format_size(size_t size, char *out, size_t length) {
+  if (size >= ((size_t)1 << 30))
+    snprintf(out, length, "%zuG", size >> 30);
+  else if (size >= ((size_t)1 << 20))
+    snprintf(out, length, "%zuM", size >> 20);
+  else
+    snprintf(out, length, "%zuK", size >> 10);
+}
+
+/**
+ * 一次分析完整个程序的前端
+ */
+static IRProgram *front_end(const char *source, TimeReport *report) {
+  time_report_start(report);
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  ASTNode *ast = parser_parse(&parser);
+  time_report_stop(report, "parse");
+  long nodes = ast_count_nodes(ast);
+  time_report_items(report, nodes, "nodes");
+
+  time_report_start(report);
+  SemanticAnalyzer *analyzer = semantic_init();
+  semantic_analyze(analyzer, ast);
+  time_report_stop(report, "semantic");
+  time_report_items(report, nodes, "nodes");
+  if (parser_had_error(&parser) || semantic_has_errors(analyzer)) {
+    semantic_print_errors(analyzer);
+    fprintf(stderr, "bench: generated program does not compile\n");
+    exit(1);
+  }
+
+  time_report_start(report);
+  IRProgram *ir = ir_generate(ast);
+  time_report_stop(report, "ir-generate");
+  time_report_items(report, ir->count, "instructions");
+  semantic_free(analyzer);
+  ast_free(ast);
+  return ir;
+}
+
+/**
+ * 一遍 -O 编译，各阶段记到 report 里
+ */
+static void compile_once(const char *source, TimeReport *report) {
+  time_report_start(report);
+  Lexer lexer = lexer_init(source);
+  long tokens = 0;
+  Token token;
+  do {
+    token = lexer_next_token(&lexer);
+    tokens++;
+  } while (token.type != TOKEN_EOF);
+  time_report_stop(report, "lex");
+  time_report_items(report, tokens, "tokens");
+
+  IRProgram *ir;
+  if (stream_mode) {
+    SemanticAnalyzer *analyzer = semantic_init();
+    StreamStats stats;
+    ir = stream_front_end(source, analyzer, 0, report, &stats);
+    if (stats.parse_error || semantic_has_errors(analyzer)) {
+      semantic_print_errors(analyzer);
+      fprintf(stderr, "bench: generated program does not compile\n");
+      exit(1);
+    }
+    semantic_free(analyzer);
+  } else {
+    ir = front_end(source, report);
+  }
+
+  time_report_start(report);
+  ir_inline(ir, inline_default_options());
+  time_report_stop(report, "inline");
+  time_report_items(report, ir->count, "instructions");
+
+  time_report_start(report);
+  ir_optimize_tail_calls(ir);
+  time_report_stop(report, "tail-calls");
+  time_report_items(report, ir->count, "instructions");
+
+  time_report_start(report);
+  ir_peephole(ir);
+  time_report_stop(report, "peephole");
+  time_report_items(report, ir->count, "instructions");
+
+  time_report_start(report);
+  X86Module *module = codegen_generate(ir);
+  uint8_t *object = NULL;
+  size_t object_size;
+  if (!module || object_build(module, &object, &object_size) != 0) {
+    fprintf(stderr, "bench: code generation failed\n");
+    exit(1);
+  }
+  time_report_stop(report, "codegen");
+  time_report_items(report, ir->count, "instructions");
+  free(object);
+  x86_module_free(module);
+  ir_program_free(ir);
+}
+
+static Result measure(size_t size) {
+  ProgenOptions options = progen_default_options();
+  options.size = size;
+  size_t length;
+  char *source = progen_generate(&options, &length);
+
+  TimeReport *report = time_report_create();
+  double elapsed = 0;
+  while (elapsed < MIN_SECONDS) {
+    compile_once(source, report);
+    elapsed = 0;
+    for (int i = 0; i < report->count; i++)
+      elapsed += report->phases[i].wall;
+  }
+
+  Result result;
+  memset(&result, 0, sizeof(result));
+  result.size = size;
+  for (int i = 0; i < report->count; i++) {
+    const PhaseTiming *phase = &report->phases[i];
+    for (int p = 0; p < PHASES; p++) {
+      if (strcmp(phase->name, phase_names[p]) == 0) {
+        result.rate[p] = phase->wall > 0 ? phase->items / phase->wall : 0;
+        result.unit[p] = phase->unit;
+      }
+    }
+  }
+  result.rss_kb = time_report_peak_rss();
+  time_report_free(report);
+  free(source);
+  return result;
+}
+
+static void print_results(const Result *results, int count) {
+  char label[16];
+  printf("%-12s %-16s", "phase", "unit");
+  for (int i = 0; i < count; i++) {
+    format_size(results[i].size, label, sizeof(label));
+    printf(" %9s", label);
+  }
+  printf("\n");
+  for (int p = 0; p < PHASES; p++) {
+    char unit[32];
+    snprintf(unit, sizeof(unit), "M %s/s", results[0].unit[p]);
+    printf("%-12s %-16s", phase_names[p], unit);
+    for (int i = 0; i < count; i++)
+      printf(" %9.2f", results[i].rate[p] / 1e6);
+    printf("\n");
+  }
+  printf("%-12s %-16s", "peak RSS", "MB");
+  for (int i = 0; i < count; i++)
+    printf(" %9.1f", results[i].rss_kb / 1024.0);
+  printf("\n");
+}
+
+// ========== 基线 ==========
+
+// 阶段吞吐量除以同一大小下 lex 的吞吐量
+static double relative_rate(const Result *result, int phase) {
+  return result->rate[0] > 0 ? result->rate[phase] / result->rate[0] : 0;
+}
+
+/**
+ * 基线文件每行 "大小 阶段 值"，阶段为 rss 时值是峰值 RSS（KB），
+ * 否则是 relative_rate（lex 自己总是 1，不写）
+ */
+static int write_baseline(const char *path, const Result *results,
+                          int count) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    fprintf(stderr, "bench: cannot create %s\n", path);
+    return 1;
+  }
+  for (int i = 0; i < count; i++) {
+    for (int p = 1; p < PHASES && results[i].size >= BASELINE_MIN_SIZE; p++)
+      fprintf(file, "%zu %s %.4f\n", results[i].size, phase_names[p],
+              relative_rate(&results[i], p));
+    fprintf(file, "%zu rss %ld\n", results[i].size, results[i].rss_kb);
+  }
+  return fclose(file) != 0;
+}
+
+/**
+ * 返回回退的项数；读不到基线时返回 -1
+ */
+static int compare_baseline(const char *path, const Result *results,
+                            int count, int tolerance) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "bench: cannot read baseline %s\n", path);
+    return -1;
+  }
+  int regressions = 0, compared = 0;
+  size_t size;
+  char name[32];
+  double expected;
+  while (fscanf(file, "%zu %31s %lf", &size, name, &expected) == 3) {
+    const Result *result = NULL;
+    for (int i = 0; i < count; i++)
+      if (results[i].size == size)
+        result = &results[i];
+    if (!result)
+      continue;
+    char label[16];
+    format_size(size, label, sizeof(label));
+    if (strcmp(name, "rss") == 0) {
+      compared++;
+      if (result->rss_kb > expected * (100 + tolerance) / 100) {
+        printf("REGRESSION peak RSS at %s: %ld KB, baseline %.0f KB\n", label,
+               result->rss_kb, expected);
+        regressions++;
+      }
+      continue;
+    }
+    for (int p = 1; p < PHASES; p++) {
+      if (strcmp(name, phase_names[p]) != 0)
+        continue;
+      compared++;
+      double relative = relative_rate(result, p);
+      if (relative < expected * (100 - tolerance) / 100) {
+        printf("REGRESSION %s at %s: %.4f x lex, baseline %.4f x lex\n", name,
+               label, relative, expected);
+        regressions++;
+      }
+    }
+  }
+  fclose(file);
+  printf("Compared %d value(s) with %s (tolerance %d%%): %d regression(s)\n",
+         compared, path, tolerance, regressions);
+  return regressions;
+}
+
+int main(int argc, char *argv[]) {
+  size_t max_size = DEFAULT_MAX_SIZE;
+  const char *baseline = NULL;
+  int update = 0;
+  int tolerance = DEFAULT_TOLERANCE;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--max-size=", 11) == 0) {
+      max_size = parse_size(argv[i] + 11);
+    } else if (strncmp(argv[i], "--baseline=", 11) == 0) {
+      baseline = argv[i] + 11;
+    } else if (strcmp(argv[i], "--update-baseline") == 0) {
+      update = 1;
+    } else if (strncmp(argv[i], "--tolerance=", 12) == 0) {
+      tolerance = atoi(argv[i] + 12);
+    } else if (strcmp(argv[i], "--stream") == 0) {
+      stream_mode = 1;
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--max-size=BYTES] [--baseline=FILE "
+              "[--update-baseline]] [--tolerance=PCT] [--stream]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (update && !baseline) {
+    fprintf(stderr, "bench: --update-baseline needs --baseline=FILE\n");
+    return 1;
+  }
+  // 流式前端的 semantic 按符号计数，和基线不可比
+  if (stream_mode && baseline) {
+    fprintf(stderr, "bench: --stream cannot be used with --baseline\n");
+    return 1;
+  }
+
+  Result results[MAX_SIZES];
+  int count = 0;
+  for (size_t size = 1024; size <= max_size && count < MAX_SIZES;
+       size *= 16)
+    results[count++] = measure(size);
+  if (count == 0) {
+    fprintf(stderr, "bench: --max-size is below 1K\n");
+    return 1;
+  }
+  print_results(results, count);
+
+  if (!baseline)
+    return 0;
+  if (update)
+    return write_baseline(baseline, results, count);
+  return compare_baseline(baseline, results, count, tolerance) == 0 ? 0 : 1;
+}
@@ -0,0 +1,403 @@
+/**
+ * progen.c - 合成测试程序生成器实现
+ */
+
+#include "progen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CALL_WINDOW 8 // 只调用最近生成的几个函数
+#define MAX_PARAMS 6
+
+typedef struct {
+  char kind; // 'p' 参数, 'v' int 变量, 'f' float 变量, 'w' 循环计数器（只读）
+  int id;
+} Var;
+
+typedef struct {
+  const ProgenOptions *options;
+  uint64_t state;
+
+  char *text;
+  size_t length;
+  size_t capacity;
+
+  // 当前函数：作用域里的变量（嵌套块结束时弹出）
+  Var *vars;
+  int var_count;
+  int var_capacity;
+  int next_id;
+  int has_call;
+
+  int *param_counts; // 已经生成的函数的参数个数
+  int function_count;
+  int function_capacity;
+} Gen;
+
+ProgenOptions progen_default_options(void) {
+  ProgenOptions options;
+  options.seed = 1;
+  options.functions = 10;
+  options.size = 0;
+  options.statements = 8;
+  options.depth = 3;
+  options.width = 4;
+  options.loop_percent = 15;
+  return options;
+}
+
+// xorshift64*
+static uint64_t next_random(Gen *gen) {
+  gen->state ^= gen->state >> 12;
+  gen->state ^= gen->state << 25;
+  gen->state ^= gen->state >> 27;
+  return gen->state * 0x2545F4914F6CDD1DULL;
+}
+
+// [0, n)
+static int pick(Gen *gen, int n) {
+  return n > 0 ? (int)((next_random(gen) >> 33) % (uint64_t)n) : 0;
+}
+
+// ========== 输出 ==========
+
+static void emit(Gen *gen, const char *text) {
+  size_t length = strlen(text);
+  if (gen->length + length + 1 > gen->capacity) {
+    while (gen->length + length + 1 > gen->capacity)
+      gen->capacity *= 2;
+    gen->text = (char *)realloc(gen->text, gen->capacity);
+  }
+  memcpy(gen->text + gen->length, text, length + 1);
+  gen->length += length;
+}
+
+static void emit_int(Gen *gen, long value) {
+  char digits[24];
+  snprintf(digits, sizeof(digits), "%ld", value);
+  emit(gen, digits);
+}
+
+static void emit_name(Gen *gen, char kind, int id) {
+  char name[24];
+  snprintf(name, sizeof(name), "%c%d", kind, id);
+  emit(gen, name);
+}
+
+static void indent(Gen *gen, int level) {
+  for (int i = 0; i < level; i++)
+    emit(gen, "    ");
+}
+
+// ========== 变量 ==========
+
+static void push_var(Gen *gen, char kind, int id) {
+  if (gen->var_count == gen->var_capacity) {
+    gen->var_capacity = gen->var_capacity ? gen->var_capacity * 2 : 16;
+    gen->vars = (Var *)realloc(gen->vars, sizeof(Var) * gen->var_capacity);
+  }
+  gen->vars[gen->var_count].kind = kind;
+  gen->vars[gen->var_count].id = id;
+  gen->var_count++;
+}
+
+/**
+ * 随机选一个 kinds 里的变量，没有时返回 NULL
+ */
+static const Var *pick_var(Gen *gen, const char *kinds) {
+  int count = 0;
+  for (int i = 0; i < gen->var_count; i++)
+    if (strchr(kinds, gen->vars[i].kind))
+      count++;
+  if (count == 0)
+    return NULL;
+  int n = pick(gen, count);
+  for (int i = 0; i < gen->var_count; i++)
+    if (strchr(kinds, gen->vars[i].kind) && n-- == 0)
+      return &gen->vars[i];
+  return NULL;
+}
+
+// ========== 表达式 ==========
+
+static void int_expr(Gen *gen, int nesting) {
+  static const char *ops[] = {" + ",  " - ",  " * ",  " / ",  " % ",
+                              " < ",  " > ",  " <= ", " >= ", " == ",
+                              " != ", " && ", " || "};
+  int operands = 1 + pick(gen, gen->options->width);
+  if (operands > 1)
+    emit(gen, "(");
+  for (int i = 0; i < operands; i++) {
+    int divide = 0;
+    if (i > 0) {
+      int op = pick(gen, 13);
+      emit(gen, ops[op]);
+      divide = op == 3 || op == 4;
+    }
+    const Var *var = divide ? NULL : pick_var(gen, "pvw");
+    if (divide) {
+      emit_int(gen, 1 + pick(gen, 16)); // 非零常数
+    } else if (nesting > 0 && pick(gen, 4) == 0) {
+      int_expr(gen, nesting - 1);
+    } else if (!var || pick(gen, 3) == 0) {
+      emit_int(gen, pick(gen, 100));
+    } else {
+      int negate = pick(gen, 8) == 0;
+      if (negate)
+        emit(gen, "(-");
+      emit_name(gen, var->kind, var->id);
+      if (negate)
+        emit(gen, ")");
+    }
+  }
+  if (operands > 1)
+    emit(gen, ")");
+}
+
+static void float_expr(Gen *gen) {
+  static const char *ops[] = {" + ", " - ", " * ", " / "};
+  int operands = 1 + pick(gen, gen->options->width);
+  if (operands > 1)
+    emit(gen, "(");
+  for (int i = 0; i < operands; i++) {
+    int op = i > 0 ? pick(gen, 4) : -1;
+    if (op >= 0)
+      emit(gen, ops[op]);
+    const Var *var = op == 3 ? NULL : pick_var(gen, "fpv");
+    if (!var || pick(gen, 3) == 0) {
+      emit_int(gen, 1 + pick(gen, 9)); // 除数也不会是 0
+      emit(gen, ".5");
+    } else {
+      emit_name(gen, var->kind, var->id);
+    }
+  }
+  if (operands > 1)
+    emit(gen, ")");
+}
+
+// ========== 语句 ==========
+
+static void block(Gen *gen, int level, int depth);
+
+static void int_decl(Gen *gen, int level) {
+  int id = gen->next_id++;
+  indent(gen, level);
+  emit(gen, "int ");
+  emit_name(gen, 'v', id);
+  emit(gen, " = ");
+  int_expr(gen, 2);
+  emit(gen, ";\n");
+  push_var(gen, 'v', id);
+}
+
+static void float_decl(Gen *gen, int level) {
+  int id = gen->next_id++;
+  indent(gen, level);
+  emit(gen, "float ");
+  emit_name(gen, 'f', id);
+  emit(gen, " = ");
+  float_expr(gen);
+  emit(gen, ";\n");
+  push_var(gen, 'f', id);
+}
+
+// 比较两个 float 表达式得到 int
+static void float_compare(Gen *gen, int level) {
+  static const char *ops[] = {" < ", " > ", " <= ", " >= ", " == ", " != "};
+  int id = gen->next_id++;
+  indent(gen, level);
+  emit(gen, "int ");
+  emit_name(gen, 'v', id);
+  emit(gen, " = ");
+  float_expr(gen);
+  emit(gen, ops[pick(gen, 6)]);
+  float_expr(gen);
+  emit(gen, ";\n");
+  push_var(gen, 'v', id);
+}
+
+static void assign(Gen *gen, int level, const Var *var) {
+  indent(gen, level);
+  emit_name(gen, var->kind, var->id);
+  emit(gen, " = ");
+  if (var->kind == 'f')
+    float_expr(gen);
+  else
+    int_expr(gen, 2);
+  emit(gen, ";\n");
+}
+
+static void call(Gen *gen, int level) {
+  int first = gen->function_count > CALL_WINDOW
+                  ? gen->function_count - CALL_WINDOW
+                  : 0;
+  int callee = first + pick(gen, gen->function_count - first);
+  int id = gen->next_id++;
+  indent(gen, level);
+  emit(gen, "int ");
+  emit_name(gen, 'v', id);
+  emit(gen, " = fn");
+  emit_int(gen, callee);
+  emit(gen, "(");
+  for (int i = 0; i < gen->param_counts[callee]; i++) {
+    if (i > 0)
+      emit(gen, ", ");
+    int_expr(gen, 1);
+  }
+  emit(gen, ") % 1000;\n");
+  push_var(gen, 'v', id);
+  gen->has_call = 1;
+}
+
+/**
+ * while 循环：计数器在循环前声明，只在循环体的最后减一
+ */
+static void loop(Gen *gen, int level, int depth) {
+  int id = gen->next_id++;
+  indent(gen, level);
+  emit(gen, "int ");
+  emit_name(gen, 'w', id);
+  emit(gen, " = ");
+  emit_int(gen, 1 + pick(gen, 4));
+  emit(gen, ";\n");
+  push_var(gen, 'w', id);
+
+  indent(gen, level);
+  emit(gen, "while (");
+  emit_name(gen, 'w', id);
+  emit(gen, " > 0) {\n");
+  block(gen, level + 1, depth + 1);
+  indent(gen, level + 1);
+  emit_name(gen, 'w', id);
+  emit(gen, " = ");
+  emit_name(gen, 'w', id);
+  emit(gen, " - 1;\n");
+  indent(gen, level);
+  emit(gen, "}\n");
+}
+
+static void branch(Gen *gen, int level, int depth) {
+  indent(gen, level);
+  emit(gen, "if (");
+  int_expr(gen, 2);
+  emit(gen, ") {\n");
+  block(gen, level + 1, depth + 1);
+  indent(gen, level);
+  if (pick(gen, 2) == 0) {
+    emit(gen, "} else {\n");
+    block(gen, level + 1, depth + 1);
+    indent(gen, level);
+  }
+  emit(gen, "}\n");
+}
+
+static void statement(Gen *gen, int level, int depth) {
+  const ProgenOptions *options = gen->options;
+  int nested = depth < options->depth;
+  int roll = pick(gen, 100);
+  if (nested && roll < options->loop_percent) {
+    loop(gen, level, depth);
+    return;
+  }
+  roll = pick(gen, 100);
+  const Var *target = pick_var(gen, "vf");
+  if (nested && roll < 15)
+    branch(gen, level, depth);
+  else if (roll < 25 && depth == 0 && !gen->has_call &&
+           gen->function_count > 0)
+    call(gen, level);
+  else if (roll < 35)
+    float_decl(gen, level);
+  else if (roll < 40)
+    float_compare(gen, level);
+  else if (roll < 60 && target)
+    assign(gen, level, target);
+  else
+    int_decl(gen, level);
+}
+
+/**
+ * 一个块：里面声明的变量在块结束时离开作用域
+ */
+static void block(Gen *gen, int level, int depth) {
+  int saved = gen->var_count;
+  int count = 1 + pick(gen, gen->options->statements);
+  for (int i = 0; i < count; i++)
+    statement(gen, level, depth);
+  gen->var_count = saved;
+}
+
+static void function(Gen *gen) {
+  int index = gen->function_count;
+  int params = pick(gen, MAX_PARAMS + 1);
+  emit(gen, "int fn");
+  emit_int(gen, index);
+  emit(gen, "(");
+  gen->var_count = 0;
+  gen->next_id = 0;
+  gen->has_call = 0;
+  for (int i = 0; i < params; i++) {
+    if (i > 0)
+      emit(gen, ", ");
+    emit(gen, "int ");
+    emit_name(gen, 'p', i);
+    push_var(gen, 'p', i);
+  }
+  emit(gen, ") {\n");
+  block(gen, 1, 0);
+  indent(gen, 1);
+  emit(gen, "return ");
+  int_expr(gen, 2);
+  emit(gen, " % 100000;\n}\n\n");
+
+  if (gen->function_count == gen->function_capacity) {
+    gen->function_capacity =
+        gen->function_capacity ? gen->function_capacity * 2 : 64;
+    gen->param_counts = (int *)realloc(
+        gen->param_counts, sizeof(int) * gen->function_capacity);
+  }
+  gen->param_counts[gen->function_count++] = params;
+}
+
+char *progen_generate(const ProgenOptions *options, size_t *length) {
+  Gen gen;
+  memset(&gen, 0, sizeof(gen));
+  gen.options = options;
+  gen.state = options->seed ? options->seed : 1;
+  gen.capacity = options->size > 0 ? options->size + 4096 : 4096;
+  gen.text = (char *)malloc(gen.capacity);
+  gen.text[0] = '\0';
+
+  if (options->size > 0) {
+    while (gen.length < options->size)
+      function(&gen);
+  } else {
+    for (int i = 0; i < options->functions; i++)
+      function(&gen);
+  }
+
+  // main 调用最后一个函数
+  int last = gen.function_count - 1;
+  emit(&gen, "int main() {\n    int r = ");
+  if (last >= 0) {
+    emit(&gen, "fn");
+    emit_int(&gen, last);
+    emit(&gen, "(");
+    for (int i = 0; i < gen.param_counts[last]; i++) {
+      if (i > 0)
+        emit(&gen, ", ");
+      emit_int(&gen, pick(&gen, 100));
+    }
+    emit(&gen, ")");
+  } else {
+    emit(&gen, "0");
+  }
+  emit(&gen, ";\n    if (r < 0) {\n        r = -r;\n    }\n"
+             "    return r % 256;\n}\n");
+
+  free(gen.vars);
+  free(gen.param_counts);
+  *length = gen.length;
+  return gen.text;
+}
@@ -0,0 +1,37 @@
+/**
+ * progen.h - 合成测试程序生成器
+ *
+ * 按参数生成语法和语义都正确的程序（只用编译器支持的语法：int/float 变量、
+ * if/else、while、函数调用、赋值和各种运算），用来测各阶段在大输入上的吞吐量。
+ * 同样的参数和种子总是生成同样的程序（自带随机数生成器，不依赖 rand）。
+ *
+ * 生成的程序也能运行：
+ *   - 循环都有自己的计数器，次数是很小的常数
+ *   - 除数和模数都是非零常数
+ *   - 每个函数最多调用一个前面的函数，不会递归，调用链是线性的
+ */
+
+#ifndef PROGEN_H
+#define PROGEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  uint64_t seed;
+  int functions;    // 函数个数（size > 0 时忽略）
+  size_t size;      // 不断生成函数直到源码至少有这么多字节（0 表示用 functions）
+  int statements;   // 每个函数体（以及每个嵌套块）最多的语句数
+  int depth;        // if/while 最多嵌套的层数
+  int width;        // 一个表达式最多的操作数个数
+  int loop_percent; // 语句是 while 循环的百分比
+} ProgenOptions;
+
+ProgenOptions progen_default_options(void);
+
+/**
+ * 生成程序（以 '\0' 结尾），*length 为字节数；用 free 释放
+ */
+char *progen_generate(const ProgenOptions *options, size_t *length);
+
+#endif // PROGEN_H
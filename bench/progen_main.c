@@ -0,0 +1,88 @@
+/**
+ * progen_main.c - 生成合成测试程序的命令行工具
+ *
+ * 用法: progen [选项] [-o FILE]
+ *   --seed=N        随机种子（默认 1）
+ *   --functions=N   函数个数（默认 10）
+ *   --size=BYTES    生成到至少这么多字节（可以带 K/M/G 后缀），代替 --functions
+ *   --statements=N  每个块最多的语句数（默认 8）
+ *   --depth=N       if/while 最多嵌套的层数（默认 3）
+ *   --width=N       一个表达式最多的操作数个数（默认 4）
+ *   --loops=PCT     语句是 while 循环的百分比（默认 15）
+ */
+
+#include "progen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * "64K"、"16M"、"1G" 这样的字节数
+ */
+static size_t parse_size(const char *text) {
+  char *end;
+  double value = strtod(text, &end);
+  switch (*end) {
+  case 'k':
+  case 'K':
+    value *= 1024;
+    break;
+  case 'm':
+  case 'M':
+    value *= 1024 * 1024;
+    break;
+  case 'g':
+  case 'G':
+    value *= 1024.0 * 1024 * 1024;
+    break;
+  }
+  return (size_t)value;
+}
+
+int main(int argc, char *argv[]) {
+  ProgenOptions options = progen_default_options();
+  const char *output = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--seed=", 7) == 0) {
+      options.seed = strtoull(argv[i] + 7, NULL, 10);
+    } else if (strncmp(argv[i], "--functions=", 12) == 0) {
+      options.functions = atoi(argv[i] + 12);
+    } else if (strncmp(argv[i], "--size=", 7) == 0) {
+      options.size = parse_size(argv[i] + 7);
+    } else if (strncmp(argv[i], "--statements=", 13) == 0) {
+      options.statements = atoi(argv[i] + 13);
+    } else if (strncmp(argv[i], "--depth=", 8) == 0) {
+      options.depth = atoi(argv[i] + 8);
+    } else if (strncmp(argv[i], "--width=", 8) == 0) {
+      options.width = atoi(argv[i] + 8);
+    } else if (strncmp(argv[i], "--loops=", 8) == 0) {
+      options.loop_percent = atoi(argv[i] + 8);
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--seed=N] [--functions=N] [--size=BYTES] "
+              "[--statements=N] [--depth=N] [--width=N] [--loops=PCT] "
+              "[-o FILE]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (options.statements < 1 || options.width < 1 || options.depth < 0) {
+    fprintf(stderr, "progen: --statements and --width must be at least 1\n");
+    return 1;
+  }
+
+  size_t length;
+  char *program = progen_generate(&options, &length);
+  FILE *file = output ? fopen(output, "wb") : stdout;
+  if (!file) {
+    fprintf(stderr, "progen: cannot create %s\n", output);
+    return 1;
+  }
+  int status = fwrite(program, 1, length, file) == length ? 0 : 1;
+  if (output && fclose(file) != 0)
+    status = 1;
+  free(program);
+  return status;
+}
@@ -0,0 +1,28 @@
+// float.c - SSE2 浮点运算
+float f(float x) {
+    return 4.0 / (1.0 + x * x);
+}
+
+// 中点法求 4/(1+x^2) 在 [0,1] 上的积分（= pi）
+float integrate(int n) {
+    float h = 1.0 / n;
+    float sum = 0.0;
+    int i = 0;
+    while (i < n) {
+        float x = h * (i + 0.5);
+        sum = sum + f(x);
+        i = i + 1;
+    }
+    return sum * h;
+}
+
+int main() {
+    int total = 0;
+    int round = 0;
+    while (round < 50000) {
+        int pi = integrate(1000) * 100;
+        total = total + pi;
+        round = round + 1;
+    }
+    return total % 256;
+}
@@ -0,0 +1,23 @@
+// loops.c - 整数循环、除法和比较
+int collatz(int n) {
+    int steps = 0;
+    while (n != 1) {
+        if (n % 2 == 0) {
+            n = n / 2;
+        } else {
+            n = 3 * n + 1;
+        }
+        steps = steps + 1;
+    }
+    return steps;
+}
+
+int main() {
+    int total = 0;
+    int i = 1;
+    while (i < 100000) {
+        total = total + collatz(i);
+        i = i + 1;
+    }
+    return total % 256;
+}
@@ -0,0 +1,15 @@
+// while.c - 测试用例 "While Loop" 的循环放大：求和 + 比较 + 跳转
+int main() {
+    int round = 0;
+    int sum = 0;
+    while (round < 2000) {
+        int i = 0;
+        sum = 0;
+        while (i < 10000) {
+            sum = sum + i;
+            i = i + 1;
+        }
+        round = round + 1;
+    }
+    return sum % 256;
+}
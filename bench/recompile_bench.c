@@ -0,0 +1,256 @@
+/**
+ * recompile_bench.c - 按函数增量重新编译的构建时间
+ *
+ * 用 progen 生成大约 --lines 行（默认 100000）的程序，在临时目录里建一个
+ * 编译缓存，测：
+ *   full        不用缓存，从头做语法分析、语义分析和 IR 生成
+ *   cold        recompile_front_end，缓存是空的（全部分析并写入缓存）
+ *   unchanged   源码没变（整个文件的缓存没查，所有函数都取自缓存）
+ * 然后做两类编辑，每类 --edits 次（默认 10），每次改完重新编译一遍再改回来：
+ *   body        把一个函数体里的整数常量的第一位换成别的数字（只有它要重新分析）
+ *   signature   把一个函数的返回类型 int 改成 float（调用它的函数也要重新分析）
+ * 每次的 IR 转储和诊断都要和从头编译相同，否则打印那次编辑并返回 1。
+ *
+ * 用法: bench_recompile [--lines=N] [--edits=N] [--seed=N]
+ */
+
+#define _DEFAULT_SOURCE // mkdtemp、opendir
+
+#include "../include/diag.h"
+#include "../include/parser.h"
+#include "../include/recompile.h"
+#include "../include/semantic.h"
+#include "bench_util.h"
+#include "progen.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BYTES_PER_LINE 34 // progen 生成的程序平均每行的字节数
+
+/**
+ * 编译的结果：IR 的转储（有错误时为 NULL）和打印的诊断
+ */
+typedef struct {
+  char *ir;
+  char *diagnostics;
+  int reused;
+  int functions;
+  double seconds;
+} Result;
+
+static void result_free(Result *result) {
+  free(result->ir);
+  free(result->diagnostics);
+}
+
+static Result compile_full(const char *source) {
+  Result result = {NULL, NULL, 0, 0, 0};
+  Writer *out = writer_memory();
+  DiagHandler saved = diag_set_handler(diag_to_writer(out));
+  double start = now_seconds();
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  ASTNode *ast = parser_parse(&parser);
+  IRProgram *program = NULL;
+  if (!parser_had_error(&parser)) {
+    SemanticAnalyzer *analyzer = semantic_init();
+    semantic_analyze(analyzer, ast);
+    semantic_print_errors(analyzer);
+    if (!semantic_has_errors(analyzer))
+      program = ir_generate(ast);
+    semantic_free(analyzer);
+  }
+  ast_free(ast);
+  result.seconds = now_seconds() - start;
+  diag_set_handler(saved);
+  result.ir = dump_ir(program);
+  result.diagnostics = writer_take(out);
+  return result;
+}
+
+static Result compile_cached(const char *source, Cache *cache) {
+  Result result = {NULL, NULL, 0, 0, 0};
+  Writer *out = writer_memory();
+  DiagHandler saved = diag_set_handler(diag_to_writer(out));
+  double start = now_seconds();
+  SemanticAnalyzer *analyzer = semantic_init();
+  RecompileStats stats;
+  IRProgram *program =
+      recompile_front_end(source, "bench.c", analyzer, cache, NULL, &stats);
+  if (!program && !stats.parse_error)
+    semantic_print_errors(analyzer);
+  semantic_free(analyzer);
+  result.seconds = now_seconds() - start;
+  diag_set_handler(saved);
+  result.ir = dump_ir(program);
+  result.diagnostics = writer_take(out);
+  result.reused = stats.reused;
+  result.functions = stats.functions;
+  return result;
+}
+
+static int same_result(const Result *a, const Result *b) {
+  return strcmp(a->diagnostics, b->diagnostics) == 0 &&
+         (a->ir == NULL) == (b->ir == NULL) &&
+         (!a->ir || strcmp(a->ir, b->ir) == 0);
+}
+
+// ========== 编辑 ==========
+
+/**
+ * 把 text 的 [at, at + deleted) 换成 insert，返回新的源码（调用者 free）
+ */
+static char *replace(const char *text, int at, int deleted,
+                     const char *insert) {
+  size_t length = strlen(text), inserted = strlen(insert);
+  char *result = (char *)malloc(length - deleted + inserted + 1);
+  memcpy(result, text, at);
+  memcpy(result + at, insert, inserted);
+  strcpy(result + at + inserted, text + at + deleted);
+  return result;
+}
+
+static const char *const kind_names[] = {"body", "signature"};
+#define KINDS 2
+
+/**
+ * 做一次某类编辑，找不到位置时返回 NULL
+ */
+static char *edit_source(const char *source, int kind) {
+  int length = (int)strlen(source);
+  if (kind == 0) {
+    int at = search(source, length, match_literal);
+    if (at < 0)
+      return NULL;
+    char digit[2] = {(char)('1' + (source[at] - '0' + 1) % 9), '\0'};
+    return replace(source, at, 1, digit);
+  }
+  int at = search(source, length, match_signature);
+  return at < 0 ? NULL : replace(source, at, 3, "float");
+}
+
+// ========== 缓存目录 ==========
+
+static void remove_dir(const char *path) {
+  DIR *dir = opendir(path);
+  if (dir) {
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        continue;
+      char file[512];
+      snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+      remove(file);
+    }
+    closedir(dir);
+  }
+  remove(path);
+}
+
+static int run(const char *source, Cache *cache, int edits) {
+  Result full = compile_full(source);
+  if (!full.ir) {
+    fprintf(stderr, "bench: generated program does not compile\n%s",
+            full.diagnostics);
+    return 1;
+  }
+  Result cold = compile_cached(source, cache);
+  Result warm = compile_cached(source, cache);
+  if (!same_result(&full, &cold) || !same_result(&full, &warm)) {
+    fprintf(stderr, "bench: cached build differs from a full compile\n");
+    return 1;
+  }
+  printf("%d function(s)\n", cold.functions);
+  printf("%-10s %10s\n", "build", "ms");
+  printf("%-10s %10.3f\n", "full", full.seconds * 1e3);
+  printf("%-10s %10.3f\n", "cold", cold.seconds * 1e3);
+  printf("%-10s %10.3f  (%d reused)\n", "unchanged", warm.seconds * 1e3,
+         warm.reused);
+  result_free(&full);
+  result_free(&cold);
+  result_free(&warm);
+
+  printf("\n%-10s %9s %9s %9s %12s\n", "edit", "p50 ms", "p99 ms", "max ms",
+         "recompiled");
+  double *samples = (double *)malloc(sizeof(double) * edits);
+  for (int kind = 0; kind < KINDS; kind++) {
+    int count = 0;
+    long recompiled = 0;
+    for (int i = 0; i < edits; i++) {
+      char *edited = edit_source(source, kind);
+      if (!edited)
+        break;
+      Result expected = compile_full(edited);
+      Result actual = compile_cached(edited, cache);
+      int same = same_result(&expected, &actual);
+      if (!same)
+        fprintf(stderr,
+                "bench: %s edit %d differs from a full compile\n"
+                "--- compiler:\n%s--- recompile:\n%s",
+                kind_names[kind], i + 1, expected.diagnostics,
+                actual.diagnostics);
+      samples[count++] = actual.seconds;
+      recompiled += actual.functions - actual.reused;
+      result_free(&expected);
+      result_free(&actual);
+      free(edited);
+      if (!same) {
+        free(samples);
+        return 1;
+      }
+    }
+    if (count == 0)
+      continue;
+    sort_samples(samples, count);
+    printf("%-10s %9.3f %9.3f %9.3f %12.1f\n", kind_names[kind],
+           percentile(samples, count, 50) * 1e3,
+           percentile(samples, count, 99) * 1e3,
+           percentile(samples, count, 100) * 1e3, (double)recompiled / count);
+  }
+  free(samples);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int lines = 100000;
+  int edits = 10;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--lines=", 8) == 0) {
+      lines = atoi(argv[i] + 8);
+    } else if (strncmp(argv[i], "--edits=", 8) == 0) {
+      edits = atoi(argv[i] + 8);
+    } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+      random_state = strtoull(argv[i] + 7, NULL, 10) | 1;
+    } else {
+      fprintf(stderr, "Usage: %s [--lines=N] [--edits=N] [--seed=N]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (lines < 1 || edits < 1) {
+    fprintf(stderr, "bench: --lines and --edits must be at least 1\n");
+    return 1;
+  }
+
+  ProgenOptions options = progen_default_options();
+  options.seed = random_state;
+  options.size = (size_t)lines * BYTES_PER_LINE;
+  size_t length;
+  char *source = progen_generate(&options, &length);
+
+  char dir[] = "/tmp/compiler-recompile-XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("bench: mkdtemp");
+    return 1;
+  }
+  Cache *cache = cache_open(dir, 1LL << 40);
+  if (!cache)
+    return 1;
+  int status = run(source, cache, edits);
+  cache_close(cache);
+  remove_dir(dir);
+  free(source);
+  return status;
+}
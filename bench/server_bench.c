@@ -0,0 +1,142 @@
+/**
+ * server_bench.c - 常驻编译服务和每次启动一个编译器进程的延迟（p50/p99）
+ *
+ * 在本进程的一个线程里启动服务端（server.h），对每个输入程序测三种方式，
+ * 每种 SAMPLES 次，都是 -q -O -c 的工作量：
+ *   cold:       system("compiler -q -O -c ...")，每次一个新进程
+ *   client:     system("compiler --connect=... -q -O -c ...")，
+ *               还是一个新进程，但编译交给服务端
+ *   in-process: server_connect + server_request，和构建系统直接连接服务端一样
+ * 前两种需要 --cli=PATH。
+ *
+ * 用法: bench_server [--cli=PATH] 文件...
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "../include/compiler.h"
+#include "../include/server.h"
+#include "bench_util.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLES 200
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * 打印 samples 的 p50/p99（微秒）
+ */
+static void report(const char *program, const char *mode, double *samples) {
+  qsort(samples, SAMPLES, sizeof(double), compare_double);
+  printf("%-26s %-11s %9.1f %9.1f\n", program, mode,
+         samples[SAMPLES / 2] * 1e6, samples[SAMPLES * 99 / 100] * 1e6);
+}
+
+static void time_command(const char *command, double *samples) {
+  for (int i = 0; i < SAMPLES; i++) {
+    double start = now_seconds();
+    if (system(command) != 0) {
+      fprintf(stderr, "bench: '%s' failed\n", command);
+      exit(1);
+    }
+    samples[i] = now_seconds() - start;
+  }
+}
+
+static void time_requests(const char *socket_path, const char *source,
+                          double *samples) {
+  ServerRequest request = {COMPILER_OPTIMIZE, SERVER_WANT_OBJECT, source,
+                           strlen(source)};
+  for (int i = 0; i < SAMPLES; i++) {
+    double start = now_seconds();
+    ServerConnection *connection = server_connect(socket_path);
+    ServerReply reply;
+    if (!connection || server_request(connection, &request, &reply) != 0 ||
+        reply.status != 0) {
+      fprintf(stderr, "bench: request failed\n");
+      exit(1);
+    }
+    server_reply_free(&reply);
+    server_disconnect(connection);
+    samples[i] = now_seconds() - start;
+  }
+}
+
+static void *serve(void *path) {
+  if (server_run((const char *)path, 0) != 0)
+    exit(1);
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  const char *cli = NULL;
+  int first = 1;
+  if (argc > 1 && strncmp(argv[1], "--cli=", 6) == 0) {
+    cli = argv[1] + 6;
+    first = 2;
+  }
+  if (first >= argc) {
+    fprintf(stderr, "Usage: %s [--cli=PATH] file...\n", argv[0]);
+    return 1;
+  }
+
+  char socket_path[64];
+  snprintf(socket_path, sizeof(socket_path), "/tmp/compiler-bench-%ld.sock",
+           (long)getpid());
+  pthread_t thread;
+  pthread_create(&thread, NULL, serve, socket_path);
+  ServerConnection *probe = NULL;
+  for (int i = 0; i < 500 && !probe; i++) {
+    struct timespec pause = {0, 10000000};
+    nanosleep(&pause, NULL);
+    probe = server_connect(socket_path);
+  }
+  if (!probe) {
+    fprintf(stderr, "bench: server did not start\n");
+    return 1;
+  }
+  server_disconnect(probe);
+
+  printf("%d samples per mode\n", SAMPLES);
+  printf("%-26s %-11s %9s %9s\n", "program", "mode", "p50(us)", "p99(us)");
+  double samples[SAMPLES];
+  for (int i = first; i < argc; i++) {
+    char *source = read_source(argv[i], NULL);
+    if (!source) {
+      fprintf(stderr, "bench: cannot read %s\n", argv[i]);
+      return 1;
+    }
+    if (cli) {
+      char command[1024];
+      snprintf(command, sizeof(command), "%s -q -O -c %s -o /dev/null", cli,
+               argv[i]);
+      time_command(command, samples);
+      report(argv[i], "cold", samples);
+      snprintf(command, sizeof(command),
+               "%s --connect=%s -q -O -c %s -o /dev/null", cli, socket_path,
+               argv[i]);
+      time_command(command, samples);
+      report(argv[i], "client", samples);
+    }
+    time_requests(socket_path, source, samples);
+    report(argv[i], "in-process", samples);
+    free(source);
+  }
+
+  ServerConnection *connection = server_connect(socket_path);
+  if (!connection || server_stop(connection) != 0) {
+    fprintf(stderr, "bench: cannot stop the server\n");
+    return 1;
+  }
+  server_disconnect(connection);
+  pthread_join(thread, NULL);
+  return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * vm_bench.c - 字节码解释器的吞吐量，和 JIT 的本地代码对比
+ *
+ * 对每个输入程序先跑一遍前端得到 IR，然后：
+ *   compile: 反复 bc_compile + bc_free，取平均（IR → 字节码，带超级指令）
+ *   plain:   不用超级指令时解释执行 main 的墙上时间和执行的指令条数
+ *   fused:   用超级指令时的墙上时间、执行的指令条数和每秒条数
+ *   tier:    分层执行（解释器起步，热函数交给 JIT）的墙上时间
+ *   jit:     同一个 IR 经过 jit_compile 后运行 main 的时间
+ * 返回值不一致时报错退出。
+ *
+ * 用法: bench_vm 文件...
+ */
+
+#include "../include/bytecode.h"
+#include "../include/ir.h"
+#include "../include/jit.h"
+#include "../include/lexer.h"
+#include "../include/parser.h"
+#include "../include/semantic.h"
+#include "../include/tier.h"
+#include "../include/vm.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_SECONDS 0.2
+
+typedef struct {
+  int result;
+  double seconds;
+  double executed;
+} VMRun;
+
+// tier_threshold 为 0 时只用解释器；计时包括分层执行时的 JIT 编译
+static VMRun run_vm(IRProgram *ir, int fuse, uint32_t tier_threshold) {
+  BCProgram *bc = bc_compile(ir, fuse);
+  if (!bc)
+    exit(1);
+  VM *vm = vm_create(bc);
+  VMRun run;
+  double start = now_seconds();
+  Tier *tier = tier_threshold ? tier_attach(vm, ir, tier_threshold) : NULL;
+  if (vm_run_main(vm, &run.result) != 0)
+    exit(1);
+  run.seconds = now_seconds() - start;
+  run.executed = (double)vm->executed;
+  tier_free(tier);
+  vm_free(vm);
+  bc_free(bc);
+  return run;
+}
+
+static void run(const char *path) {
+  char *source = read_source(path, NULL);
+  if (!source) {
+    fprintf(stderr, "bench: cannot read %s\n", path);
+    exit(1);
+  }
+
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  ASTNode *ast = parser_parse(&parser);
+  SemanticAnalyzer *analyzer = semantic_init();
+  if (!parser_had_error(&parser))
+    semantic_analyze(analyzer, ast);
+  if (parser_had_error(&parser) || semantic_has_errors(analyzer)) {
+    fprintf(stderr, "bench: %s failed to compile\n", path);
+    exit(1);
+  }
+  IRProgram *ir = ir_generate(ast);
+
+  int rounds = 0;
+  double start = now_seconds(), elapsed = 0;
+  while (elapsed < MIN_SECONDS) {
+    BCProgram *bc = bc_compile(ir, 1);
+    if (!bc)
+      exit(1);
+    bc_free(bc);
+    rounds++;
+    elapsed = now_seconds() - start;
+  }
+  double compile_us = elapsed / rounds * 1e6;
+
+  VMRun plain = run_vm(ir, 0, 0);
+  VMRun fused = run_vm(ir, 1, 0);
+  VMRun tiered = run_vm(ir, 1, TIER_DEFAULT_THRESHOLD);
+  int result = fused.result;
+  if (plain.result != result || tiered.result != result) {
+    fprintf(stderr, "bench: %s: plain %d, fused %d, tiered %d\n", path,
+            plain.result, result, tiered.result);
+    exit(1);
+  }
+
+  JitProgram *jit = jit_compile(ir);
+  double jit_ms = 0;
+  if (jit) {
+    start = now_seconds();
+    int jit_result = jit_run_main(jit);
+    jit_ms = (now_seconds() - start) * 1e3;
+    jit_free(jit);
+    if (jit_result != result) {
+      fprintf(stderr, "bench: %s: vm returned %d, jit returned %d\n", path,
+              result, jit_result);
+      exit(1);
+    }
+  }
+
+  printf("%-26s %8.1f %9.1f %9.1f %9.1f %9.1f %8.1f %8.1f %8.1f\n", path,
+         compile_us, plain.executed / 1e6, plain.seconds * 1e3,
+         fused.executed / 1e6, fused.seconds * 1e3,
+         fused.executed / fused.seconds / 1e6, tiered.seconds * 1e3, jit_ms);
+
+  ir_program_free(ir);
+  semantic_free(analyzer);
+  ast_free(ast);
+  free(source);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file...\n", argv[0]);
+    return 1;
+  }
+  printf("dispatch: %s\n", VM_COMPUTED_GOTO ? "computed goto" : "switch");
+  printf("%-26s %8s %9s %9s %9s %9s %8s %8s %8s\n", "program", "comp(us)",
+         "plain(M)", "plain(ms)", "fused(M)", "fused(ms)", "Minstr/s",
+         "tier(ms)", "jit(ms)");
+  for (int i = 1; i < argc; i++)
+    run(argv[i]);
+  return 0;
+}
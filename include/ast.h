@@ -156,10 +156,11 @@ typedef struct {
 
 /**
  * for 语句节点数据
- * for_stmt → "for" "(" expr? ";" expr? ";" expr? ")" statement
+ * for_stmt → "for" "(" (var_decl | expr_stmt | ";") expr? ";" expr? ")"
+ *            statement
  */
 typedef struct {
-  ASTNode *init;      // 初始化（可为 NULL）
+  ASTNode *init;      // 初始化：变量声明或表达式语句（可为 NULL）
   ASTNode *condition; // 条件（可为 NULL，表示永真）
   ASTNode *update;    // 更新（可为 NULL）
   ASTNode *body;      // 循环体
@@ -328,6 +329,9 @@ void ast_print(ASTNode *node, int indent);
 // 释放 AST 内存
 void ast_free(ASTNode *node);
 
+// 统计子树里的节点数（包括 node 自己）
+int ast_count_nodes(const ASTNode *node);
+
 // 辅助函数
 const char *ast_node_type_to_string(ASTNodeType type);
 const char *ast_binary_op_to_string(BinaryOp op);
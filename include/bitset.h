@@ -0,0 +1,46 @@
+/**
+ * bitset.h - 定长位集合
+ *
+ * 数据流分析用它表示"值的集合"：第 i 位为 1 表示编号为 i 的值在集合里。
+ * 并、差等运算按 64 位的字一次处理一整个字，循环里没有分支，
+ * 编译器可以直接把它们向量化。
+ */
+
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stdint.h>
+
+typedef struct {
+  uint64_t *words;
+  int word_count;
+  int bit_count;
+} Bitset;
+
+// 创建/释放（创建时所有位都是 0）
+void bitset_init(Bitset *set, int bit_count);
+void bitset_free(Bitset *set);
+
+void bitset_set(Bitset *set, int bit);
+void bitset_reset(Bitset *set, int bit);
+int bitset_test(const Bitset *set, int bit);
+void bitset_clear(Bitset *set);
+int bitset_count(const Bitset *set);
+
+// dst = src
+void bitset_copy(Bitset *dst, const Bitset *src);
+
+// dst |= src，返回 dst 是否改变
+int bitset_union(Bitset *dst, const Bitset *src);
+
+// dst &= ~src
+void bitset_subtract(Bitset *dst, const Bitset *src);
+
+// 数据流的传递函数 dst = gen | (src & ~kill)，返回 dst 是否改变
+int bitset_transfer(Bitset *dst, const Bitset *gen, const Bitset *src,
+                    const Bitset *kill);
+
+// 遍历：返回 >= bit 的第一个 1 的位置，没有返回 -1
+int bitset_next(const Bitset *set, int bit);
+
+#endif // BITSET_H
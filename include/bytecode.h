@@ -0,0 +1,168 @@
+/**
+ * bytecode.h - 寄存器式字节码 (IR → 解释器)
+ *
+ * 每个函数有一个固定大小的帧，临时变量、局部变量和形参都映射到帧里的槽位，
+ * 指令的操作数就是槽位下标（寄存器式，不用操作数栈）。
+ * 全程序的指令放在一个 int32 数组里：操作码后面跟着固定个数的操作数，
+ * 标签解析成数组里的绝对下标，调用目标解析成函数编号。
+ *
+ * 类型在翻译时确定：int 和 float 用不同的操作码，混合运算前插入转换，
+ * 解释器里不需要检查类型。常量先用 LOADI/LOADF 放到临时槽位里再参与运算
+ * （常见的组合有带立即数的超级指令）；全局变量通过 GETG/SETG 和帧里的槽位交换。
+ *
+ * 帧的前 param_count 个槽位是形参：PARAM 把实参压到参数栈，
+ * CALL 把它们复制到被调函数的帧里。
+ */
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "hash.h"
+#include "ir.h"
+#include <stdint.h>
+
+/**
+ * 操作码表：X(名字, 操作数格式)
+ * 格式里每个字符是一个操作数：s 槽位，i 立即数，k 浮点常量编号，
+ * g 全局变量编号，t 跳转目标，f 函数编号，n 实参个数
+ */
+#define BC_OPCODES(X)                                                          \
+  X(NOP, "")                                                                   \
+  X(MOV, "ss")   /* a = b */                                                   \
+  X(LOADI, "si") /* a = imm */                                                 \
+  X(LOADF, "sk") /* a = floats[k] */                                           \
+  X(GETG, "sg")  /* a = globals[g] */                                          \
+  X(SETG, "gs")  /* globals[g] = a */                                          \
+  X(I2F, "ss")   /* a = (double)b */                                           \
+  X(F2I, "ss")   /* a = (int)b */                                              \
+  X(ADDI, "sss")                                                               \
+  X(SUBI, "sss")                                                               \
+  X(MULI, "sss")                                                               \
+  X(DIVI, "sss")                                                               \
+  X(MODI, "sss")                                                               \
+  X(SHL, "sss")                                                                \
+  X(SHR, "sss")                                                                \
+  X(USHR, "sss")                                                               \
+  X(BAND, "sss")                                                               \
+  X(NEGI, "ss")                                                                \
+  X(NOTI, "ss")                                                                \
+  X(ADDF, "sss")                                                               \
+  X(SUBF, "sss")                                                               \
+  X(MULF, "sss")                                                               \
+  X(DIVF, "sss")                                                               \
+  X(NEGF, "ss")                                                                \
+  X(NOTF, "ss")                                                                \
+  X(TRUTHF, "ss") /* a = b != 0.0 */                                           \
+  X(EQI, "sss")                                                                \
+  X(NEI, "sss")                                                                \
+  X(LTI, "sss")                                                                \
+  X(GTI, "sss")                                                                \
+  X(LEI, "sss")                                                                \
+  X(GEI, "sss")                                                                \
+  X(EQF, "sss")                                                                \
+  X(NEF, "sss")                                                                \
+  X(LTF, "sss")                                                                \
+  X(GTF, "sss")                                                                \
+  X(LEF, "sss")                                                                \
+  X(GEF, "sss")                                                                \
+  X(ANDL, "sss") /* a = b && c（整数） */                                      \
+  X(ORL, "sss")                                                                \
+  X(JMP, "t")                                                                  \
+  X(JT, "st") /* if a goto target */                                           \
+  X(JF, "st")                                                                  \
+  X(PARAM, "s")                                                                \
+  X(CALL, "sfn") /* a = call f, argc */                                        \
+  X(RET, "s")                                                                  \
+  X(RETZ, "") /* 返回 0（落到函数末尾） */                                     \
+  BC_SUPERINSTRUCTIONS(X)
+
+/**
+ * 超级指令：把动态执行时最常相邻的指令合并成一条，减少分派次数
+ *   常量 + 运算：a = b op imm / a = b op floats[k]，省掉 LOADI/LOADF
+ *   比较 + 分支：if (a cmp b) goto target，省掉比较结果和 JT/JF
+ * 比较 + 分支的顺序和 IR_EQ..IR_GE 一致，翻译时按偏移量选择
+ */
+#define BC_SUPERINSTRUCTIONS(X)                                                \
+  X(ADDIK, "ssi")                                                              \
+  X(MULIK, "ssi")                                                              \
+  X(DIVIK, "ssi") /* imm != 0 */                                               \
+  X(MODIK, "ssi") /* imm != 0 */                                               \
+  X(EQIK, "ssi")                                                               \
+  X(NEIK, "ssi")                                                               \
+  X(LTIK, "ssi")                                                               \
+  X(GTIK, "ssi")                                                               \
+  X(LEIK, "ssi")                                                               \
+  X(GEIK, "ssi")                                                               \
+  X(ADDFK, "ssk")                                                              \
+  X(SUBFK, "ssk")                                                              \
+  X(MULFK, "ssk")                                                              \
+  X(DIVFK, "ssk")                                                              \
+  X(RSUBFK, "ssk") /* a = floats[k] - b */                                     \
+  X(RDIVFK, "ssk") /* a = floats[k] / b */                                     \
+  X(JEQI, "sst")                                                               \
+  X(JNEI, "sst")                                                               \
+  X(JLTI, "sst")                                                               \
+  X(JGTI, "sst")                                                               \
+  X(JLEI, "sst")                                                               \
+  X(JGEI, "sst")                                                               \
+  X(JEQIK, "sit")                                                              \
+  X(JNEIK, "sit")                                                              \
+  X(JLTIK, "sit")                                                              \
+  X(JGTIK, "sit")                                                              \
+  X(JLEIK, "sit")                                                              \
+  X(JGEIK, "sit")
+
+typedef enum {
+#define BC_ENUM(name, format) BC_##name,
+  BC_OPCODES(BC_ENUM)
+#undef BC_ENUM
+      BC_OPCODE_COUNT
+} BCOpcode;
+
+// 每种操作码的操作数个数和格式
+extern const int bc_operand_count[BC_OPCODE_COUNT];
+extern const char *const bc_operand_formats[BC_OPCODE_COUNT];
+extern const char *const bc_opcode_names[BC_OPCODE_COUNT];
+
+typedef struct {
+  char *name;
+  int entry;       // 第一条指令的下标
+  int param_count; // 形参占帧的前几个槽位
+  int frame_size;  // 槽位数
+  IRValueType return_type;
+} BCFunction;
+
+typedef struct {
+  int32_t *code;
+  int count;
+  int capacity;
+
+  double *floats; // 浮点常量池
+  int float_count;
+  int float_capacity;
+
+  BCFunction *functions;
+  int func_count;
+  int func_capacity;
+  NameMap function_index; // 函数名 → 编号（名字借用 functions[].name）
+
+  char **global_names;
+  IRValueType *global_types;
+  int global_count;
+  int global_capacity;
+  NameMap global_index; // 全局变量名 → 编号（名字借用 global_names）
+
+  int init_function; // 全局变量初始化代码（函数之外的指令），没有时为 -1
+} BCProgram;
+
+// 翻译整个程序；fuse 为真时生成超级指令。出错时打印错误并返回 NULL
+BCProgram *bc_compile(IRProgram *program, int fuse);
+
+void bc_free(BCProgram *bc);
+
+// 按名字查找函数，找不到返回 -1
+int bc_find_function(const BCProgram *bc, const char *name);
+
+void bc_print(const BCProgram *bc);
+
+#endif // BYTECODE_H
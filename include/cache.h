@@ -0,0 +1,113 @@
+/**
+ * cache.h - 磁盘上的编译缓存
+ *
+ * 以"源码内容 + 影响 IR 的编译选项"的哈希为键，把优化后的 IR 保存在缓存目录里：
+ *   <dir>/<32 位十六进制键>.irb（二进制 IR，见 irbin.h）
+ * 命中时直接映射读回 IR，跳过词法、语法、语义分析、IR 生成和优化。
+ *
+ *   - 键：两个不同种子的 XXH64（hash.h），条目自带校验和，
+ *     读到损坏或截断的条目时当作未命中并删除
+ *   - 原子写入：先写 <键>.<pid>.tmp，再 rename 成正式文件名，
+ *     并发的编译进程只会看到完整的条目
+ *   - 容量上限：写入新条目后按修改时间淘汰最旧的条目（命中时更新修改时间，
+ *     所以是 LRU）
+ *   - 统计：本次运行的命中/未命中/写入/淘汰次数，退出时累加到 <dir>/stats
+ *
+ * 整个文件未命中时再按函数查（recompile.h）：每个函数的 IR 以"函数的 Token
+ * 流 + 它引用的全局符号的签名"为键，一个模块（源文件）的所有函数放在一个
+ * 文件里：
+ *   <dir>/<模块键>.fns（"CCFP" 条目数 | 每个条目的键、偏移、大小 | 二进制 IR）
+ * 编译开始时整个读入一次，之后在内存里按键查；有新的函数条目时在结束时
+ * 整个原子写回，所以没有变的模块重新构建时只打开一个文件。它和 .irb 条目
+ * 一起按 LRU 淘汰。
+ *
+ * 并行编译时多个线程可以共用一个 Cache（查找和写入内部加锁）。
+ *
+ * 只支持 POSIX 文件系统（opendir、rename 覆盖已有文件）。
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "ir.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_DEFAULT_DIR ".compiler-cache"
+#define CACHE_DEFAULT_LIMIT (64LL << 20) // 64 MB
+
+// 条目格式变化时加一：旧条目的键不同，自然失效
+#define CACHE_FORMAT_VERSION 3
+
+typedef struct {
+  uint64_t high;
+  uint64_t low;
+} CacheKey;
+
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t stores;
+  uint64_t evictions;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  uint64_t function_hits; // 按函数查找（不计入 hits/misses）
+  uint64_t function_misses;
+} CacheStats;
+
+typedef struct {
+  char *dir;
+  long long limit; // 所有条目的总字节数上限
+  CacheStats stats; // 本次运行
+} Cache;
+
+/**
+ * 打开（必要时创建）缓存目录；失败时打印错误并返回 NULL
+ */
+Cache *cache_open(const char *dir, long long limit);
+
+// 把本次的统计累加到 <dir>/stats，然后释放
+void cache_close(Cache *cache);
+
+/**
+ * 计算键：source 是源码，fingerprint 描述影响 IR 的编译选项
+ */
+CacheKey cache_key(const char *source, size_t length, const char *fingerprint);
+
+// 键的文件名形式（32 个十六进制字符 + '\0'）
+void cache_key_string(CacheKey key, char out[33]);
+
+/**
+ * 查找条目：命中时返回读回的 IR（调用者负责释放），未命中返回 NULL
+ */
+IRProgram *cache_load(Cache *cache, CacheKey key);
+
+// 写入条目并按容量上限淘汰旧条目，成功返回 0
+int cache_store(Cache *cache, CacheKey key, const IRProgram *program);
+
+// 一个模块的函数条目（读入内存的 .fns 文件和这次新写入的条目）
+typedef struct CachePack CachePack;
+
+/**
+ * 读入模块的函数条目；module 区分不同的源文件（通常是路径）。
+ * 文件不存在或损坏时得到空的 CachePack，不会失败
+ */
+CachePack *cache_pack_open(Cache *cache, const char *module);
+
+// 查找函数的条目，记在按函数查找的统计里；命中时返回 IR（调用者释放）
+IRProgram *cache_pack_load(CachePack *pack, CacheKey key);
+
+// 加入函数的条目（在 cache_pack_close 时才写到磁盘）
+void cache_pack_store(CachePack *pack, CacheKey key, const IRProgram *program);
+
+/**
+ * 有新条目时写回（这次用到的条目，加上最近没用到的一部分，编辑后改回来时
+ * 还能命中），然后释放；不写淘汰，之后写整个文件的条目时一起淘汰。
+ * 写入失败返回 1
+ */
+int cache_pack_close(CachePack *pack);
+
+// 打印本次和累计的统计，以及目录里的条目数和总大小
+void cache_print_stats(const Cache *cache);
+
+#endif // CACHE_H
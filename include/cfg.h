@@ -0,0 +1,55 @@
+/**
+ * cfg.h - 控制流图 (Control Flow Graph)
+ *
+ * 把一个函数的指令切分成基本块（basic block）：
+ * 块内的指令总是从第一条顺序执行到最后一条，
+ * 只有块的最后一条指令会跳转，只有块的第一条指令会被跳到。
+ *
+ * 块的开头（leader）：
+ * - 函数的第一条指令
+ * - 每个标签
+ * - 跳转、return 之后的那条指令
+ *
+ * 数据流分析（活跃变量等）都在 CFG 上进行。
+ */
+
+#ifndef CFG_H
+#define CFG_H
+
+#include "ir.h"
+
+/**
+ * 基本块
+ */
+typedef struct {
+  int start;       // 第一条指令的下标
+  int end;         // 最后一条指令的下一个下标 [start, end)
+  int succs[2];    // 后继块（最多两个：跳转目标和顺序执行）
+  int succ_count;  //
+  int *preds;      // 前驱块
+  int pred_count;  //
+  int pred_capacity;
+} BasicBlock;
+
+/**
+ * 一个函数的控制流图
+ */
+typedef struct {
+  IRProgram *program;
+  IRFunction func;
+
+  BasicBlock *blocks; // blocks[0] 是入口块
+  int block_count;
+
+  int *rpo;      // 逆后序（reverse postorder），只包含从入口可达的块
+  int rpo_count; //
+} CFG;
+
+// 为函数建立控制流图
+CFG *cfg_build(IRProgram *program, IRFunction *func);
+void cfg_free(CFG *cfg);
+
+// 打印（调试用）
+void cfg_print(CFG *cfg);
+
+#endif // CFG_H
@@ -0,0 +1,37 @@
+/**
+ * codegen.h - x86-64 代码生成 (System V ABI)
+ *
+ * 把 IR 翻译成 x86.h 的机器指令：
+ * - 每个函数先做寄存器分配（regalloc.h），值在寄存器或栈槽里
+ * - 整数按 32 位运算，浮点数是 double，使用 SSE2
+ * - 比较后紧跟条件跳转时合并成 cmp + jcc，不生成 setcc
+ * - 全局变量放在 .data，初始值必须是常量表达式（和 C 一样）
+ *
+ * 栈帧：
+ *   [rbp + 16 ...]  超过 6 个整数/8 个浮点的实参
+ *   [rbp + 8]       返回地址
+ *   [rbp]           调用者的 rbp
+ *   [rbp - 8 ...]   保存的被调用者保存寄存器
+ *   ...             栈槽（溢出的值）
+ *   ...             寄存器传入的实参的保存区
+ *
+ * 调用：param 把实参压栈，call 时再从栈上取到参数寄存器，
+ * 这样嵌套调用 f(a, g(b)) 的实参不会互相覆盖。
+ */
+
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include "ir.h"
+#include "x86.h"
+
+// 生成整个程序的机器代码；出错时打印错误并返回 NULL
+X86Module *codegen_generate(IRProgram *program);
+
+// 生成并写出 GAS 汇编文件，成功返回 0
+int codegen_write_assembly(IRProgram *program, const char *path);
+
+// 生成并直接写出 ELF 目标文件（不经过汇编器），成功返回 0
+int codegen_write_object(IRProgram *program, const char *path);
+
+#endif // CODEGEN_H
@@ -0,0 +1,104 @@
+/**
+ * compiler.h - 嵌入用的编译器接口 (libcompiler)
+ *
+ * 让别的程序在自己的进程里调用编译器，不必每次启动一个 compiler 进程：
+ *
+ *   CompilerConfig config = compiler_default_config();
+ *   config.flags = COMPILER_OPTIMIZE;
+ *   config.diagnostic = on_error;      // 每条错误信息一次回调
+ *   CompilerContext *context = compiler_create(&config);
+ *
+ *   unsigned char *object;
+ *   size_t size;
+ *   if (compiler_compile_object(context, source, length, &object, &size) == 0)
+ *     ...
+ *   compiler_free(context, object);
+ *   compiler_destroy(context);
+ *
+ * 可重入、线程安全：
+ *   - 创建之后 CompilerContext 只读，多个线程可以同时用同一个上下文编译
+ *   - 每次调用的状态（Lexer、Parser、SemanticAnalyzer、IR、机器代码）都在调用内部
+ *   - 调用期间把当前线程的分配器和错误输出换成上下文的（memory.h、diag.h 里
+ *     的线程局部设置），返回前换回去；编译器没有全局可变状态
+ *
+ * 分配器：编译器的所有内存（包括上下文本身和返回给调用者的 IR、缓冲区）都来自
+ * 配置里的分配器，所以返回的东西要用 compiler_free_ir / compiler_free 释放。
+ *
+ * 这个头文件不会把 malloc/free 换成计数版本（不包含 memory.h）。
+ */
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "inline.h"
+#include "ir.h"
+#include <stddef.h>
+
+/**
+ * 分配器（三个函数都要提供）；user 原样传回
+ */
+typedef struct {
+  void *(*allocate)(void *user, size_t size);
+  void *(*reallocate)(void *user, void *ptr, size_t size);
+  void (*release)(void *user, void *ptr);
+  void *user;
+} CompilerAllocator;
+
+// 一条错误信息（不含换行符），例如 "[Line 3] Error at ';': Expect expression."
+typedef void (*CompilerDiagnostic)(void *user, const char *message);
+
+// 优化遍历（和命令行的 --inline/--tail-calls/--peephole 对应）
+#define COMPILER_INLINE 0x1u
+#define COMPILER_TAIL_CALLS 0x2u
+#define COMPILER_PEEPHOLE 0x4u
+#define COMPILER_OPTIMIZE 0x7u // -O
+
+typedef struct {
+  unsigned flags;               // COMPILER_* 的组合
+  InlineOptions inline_options; // COMPILER_INLINE 的代价模型
+  const CompilerAllocator *allocator; // NULL 表示 malloc/realloc/free（会复制）
+  CompilerDiagnostic diagnostic;      // NULL 表示丢掉错误信息
+  void *diagnostic_user;
+} CompilerConfig;
+
+typedef struct CompilerContext CompilerContext;
+
+// 默认配置：不优化，标准库分配器，不报告错误
+CompilerConfig compiler_default_config(void);
+
+/**
+ * 创建上下文（复制配置）；分配失败返回 NULL
+ */
+CompilerContext *compiler_create(const CompilerConfig *config);
+void compiler_destroy(CompilerContext *context);
+
+/**
+ * 源码 -> 优化后的 IR；有错误时通过回调报告并返回 NULL。
+ * source 不需要以 '\0' 结尾，length 是字节数
+ */
+IRProgram *compiler_compile_ir(CompilerContext *context, const char *source,
+                               size_t length);
+void compiler_free_ir(CompilerContext *context, IRProgram *program);
+
+/**
+ * 源码 -> x86-64 ELF 目标文件（和 -c 的输出相同），成功返回 0；
+ * *data 用 compiler_free 释放
+ */
+int compiler_compile_object(CompilerContext *context, const char *source,
+                            size_t length, unsigned char **data, size_t *size);
+
+/**
+ * IR -> 目标文件（已经有 IR 时不必重新编译源码），成功返回 0
+ */
+int compiler_generate_object(CompilerContext *context, IRProgram *program,
+                             unsigned char **data, size_t *size);
+
+/**
+ * IR -> 二进制 IR（irbin.h 的格式），成功返回 0；*data 用 compiler_free 释放
+ */
+int compiler_encode_ir(CompilerContext *context, const IRProgram *program,
+                       unsigned char **data, size_t *size);
+
+void compiler_free(CompilerContext *context, void *data);
+
+#endif // COMPILER_H
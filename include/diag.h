@@ -0,0 +1,31 @@
+/**
+ * diag.h - 错误信息的输出位置
+ *
+ * 编译器各处的错误信息都经过 diag_printf，默认直接写到 stderr。
+ * 可以为当前线程换上一个处理函数，之后的错误信息逐行（不含换行符）交给它：
+ *   - 并行编译多个文件时，每个任务把错误信息收集到自己的 Writer，
+ *     全部完成后按输入顺序打印，不同文件的错误不会交错在一起
+ *   - 嵌入编译器的程序（compiler.h）通过它收到诊断回调
+ */
+
+#ifndef DIAG_H
+#define DIAG_H
+
+#include "writer.h"
+
+typedef struct {
+  void (*function)(void *user, const char *line); // NULL 表示 stderr
+  void *user;
+} DiagHandler;
+
+void diag_printf(const char *format, ...);
+
+/**
+ * 当前线程之后的错误信息交给 handler，返回原来的处理函数
+ */
+DiagHandler diag_set_handler(DiagHandler handler);
+
+// 把每一行追加到 out 的处理函数
+DiagHandler diag_to_writer(Writer *out);
+
+#endif // DIAG_H
@@ -0,0 +1,60 @@
+/**
+ * encode.h - x86-64 机器码编码
+ *
+ * 把 x86.h 的指令直接编码成字节，不经过汇编器。
+ * 只支持代码生成器用到的指令子集；编码选择和 GNU as 一致
+ * （短立即数、累加器短格式、跳转先用 rel8 不够再换 rel32），
+ * 所以同一个模块两条路线得到的 .text 逐字节相同。
+ *
+ * 引用函数、全局变量和常量的位置留空，生成重定位项由目标文件写出器处理：
+ *   call/jmp 函数      R_X86_64_PLT32  函数符号 - 4
+ *   全局变量 (%rip)    R_X86_64_PC32   变量符号 - 4 - 后面立即数的长度
+ *   常量 .LC (%rip)    R_X86_64_PC32   .rodata + 16 * 编号 - 4
+ */
+
+#ifndef ENCODE_H
+#define ENCODE_H
+
+#include "x86.h"
+#include <stdint.h>
+
+typedef enum {
+  X86_RELOC_PC32 = 2, // R_X86_64_PC32
+  X86_RELOC_PLT32 = 4 // R_X86_64_PLT32
+} X86RelocType;
+
+// 常量在 .rodata 里占 16 字节（见 X86Const）
+#define X86_CONST_SIZE 16
+
+/**
+ * 重定位项：name 为 NULL 时引用 .rodata 段
+ */
+typedef struct {
+  int offset; // 在 .text 里的位置
+  X86RelocType type;
+  const char *name;
+  int64_t addend;
+} X86Reloc;
+
+/**
+ * 整个模块的 .text
+ */
+typedef struct {
+  uint8_t *bytes;
+  int size;
+  int capacity;
+
+  X86Reloc *relocs;
+  int reloc_count;
+  int reloc_capacity;
+
+  int *func_offsets; // 每个函数在 .text 里的起始位置
+  int *func_sizes;
+} X86Code;
+
+// 编码模块里所有函数；遇到不支持的指令形式时打印错误并返回非 0
+int x86_encode_module(const X86Module *module, X86Code *code);
+
+void x86_code_free(X86Code *code);
+
+#endif // ENCODE_H
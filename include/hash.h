@@ -0,0 +1,40 @@
+/**
+ * hash.h - 64 位非加密哈希 (XXH64) 和按名字查找的哈希表
+ *
+ * 编译缓存用它算键，二进制 IR 用它做校验和。
+ * 和 xxHash 的 XXH64 结果一致（小端机器上）。
+ *
+ * NameMap 把函数名、全局变量名映射到下标，代替各个后端按名字的线性查找
+ * （每个调用点都扫一遍所有函数时，函数多了就是平方级的）。
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t hash64(const void *data, size_t length, uint64_t seed);
+
+/**
+ * 名字 → 非负整数，开放寻址，容量是 2 的幂。
+ * 名字是借用的，表用完之前不能释放或修改
+ */
+typedef struct {
+  const char **names;
+  int *values;
+  int mask;
+  int count;
+} NameMap;
+
+// expected 是预计的名字个数（只影响初始容量）
+void name_map_init(NameMap *map, int expected);
+void name_map_free(NameMap *map);
+
+// 加入 name；已经有了时保留原来的值（和线性查找找到第一个一致）
+void name_map_put(NameMap *map, const char *name, int value);
+
+// 查找 name，没有返回 -1
+int name_map_get(const NameMap *map, const char *name);
+
+#endif // HASH_H
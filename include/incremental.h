@@ -0,0 +1,120 @@
+/**
+ * incremental.h - 编辑器用的增量分析
+ *
+ * Document 保存一份源码和按顶层声明切开的分析结果。每一块是一次
+ * parser_next_declaration 读过的源码：出错后跳过的部分、声明本身，以及
+ * 到下一个声明第一个 Token 之前的空白和注释。块首尾相接覆盖整个文件，
+ * 最后一块是文件结束（没有声明，只可能有语法错误）。
+ *
+ * 每次编辑（替换一段文本）之后：
+ *   - 从改动所在的块的前一块开始重新词法和语法分析（前一块结束时已经读了
+ *     改动处的第一个 Token），直到越过改动、又停在一个旧的块边界上并且
+ *     语法分析器的状态相同为止；后面的块原样保留，只移动位置和行号
+ *   - 语义分析只重做新解析的块，以及引用了签名有变化的全局名字的块；
+ *     每块用单独的分析器，全局作用域里只放它用到的名字在前面第一次的声明
+ *   - 每块的 IR 单独生成（临时变量和标签从 0 编号），语义分析重做过的块
+ *     才重新生成；document_ir 重新编号后把它们连起来
+ *
+ * 诊断和普通编译打印的相同：有语法错误时只有语法错误，否则是语义错误。
+ * 行号都是当前源码里的行号。
+ *
+ * 语义分析时还记下每个解析过的名字（semantic.h 的 SemanticResolveHandler），
+ * 编辑器查询跳转和悬停提示时直接用这些结果，不重新分析。有语法错误的块
+ * 没有这些信息。位置的行和列都从 1 开始，列按字节计。
+ */
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "ir.h"
+#include <stddef.h>
+
+typedef struct DocumentChunk DocumentChunk;
+
+typedef struct {
+  char *text; // 当前源码（以 '\0' 结尾）
+  int length;
+  int capacity;
+
+  DocumentChunk *chunks; // 按位置排列
+  int chunk_count;
+  int chunk_capacity;
+
+  // 最近一次 document_open / document_edit 做的工作（测试和基准测试用）
+  int reparsed;   // 重新语法分析的块数
+  int reanalyzed; // 重新做完整语义分析的块数
+} Document;
+
+/**
+ * 一条诊断信息
+ */
+typedef struct {
+  int line;            // 行号（从 1 开始）
+  int semantic;        // 1 为语义错误，0 为语法错误
+  const char *message; // 不带 "[Line N] " 前缀；下次编辑或释放前有效
+} Diagnostic;
+
+// 打开和释放（text 不需要以 '\0' 结尾）
+Document *document_open(const char *text, size_t length);
+void document_free(Document *doc);
+
+/**
+ * 把 [offset, offset + deleted) 替换成 inserted 的 inserted_length 个字节，
+ * 然后更新分析结果。范围超出源码时不做任何修改，返回 -1。
+ */
+int document_edit(Document *doc, size_t offset, size_t deleted,
+                  const char *inserted, size_t inserted_length);
+
+// 有没有语法或语义错误
+int document_has_errors(const Document *doc);
+
+// 当前的诊断，数量放在 *count 里；返回的数组由调用者 free
+Diagnostic *document_diagnostics(const Document *doc, int *count);
+
+// 用 diag_printf 打印诊断，格式和普通编译相同
+void document_print_diagnostics(const Document *doc);
+
+/**
+ * 光标处的名字（声明或使用）和它的声明
+ */
+typedef struct {
+  int line;   // 名字的位置
+  int column;
+  int length;
+  int decl_line; // 声明的名字的位置；找不到声明时为 0
+  int decl_column;
+  const char *detail; // 如 "int fn0(int p0, int p1)"、"(local) int v1"
+} DocumentReference;
+
+/**
+ * 声明的概要（编辑器的大纲）
+ */
+typedef struct {
+  const char *name;
+  const char *detail; // 如 "int fn0(int p0, int p1)"、"int g"
+  int function;       // 1 为函数，0 为全局变量
+  int line;           // 名字的位置
+  int column;
+  int start_line; // 整个声明，end 是最后一个 Token 之后的位置
+  int start_column;
+  int end_line;
+  int end_column;
+} DocumentSymbol;
+
+// 第 line 行第一个字节的位置（超出时是源码长度）
+int document_line_start(const Document *doc, int line);
+
+// line/column 处（或紧跟在后面）有解析过的名字时填好 *ref 并返回 1；
+// detail 在下次编辑或释放前有效
+int document_reference_at(const Document *doc, int line, int column,
+                          DocumentReference *ref);
+
+// 所有顶层声明，数量放在 *count 里；返回的数组由调用者 free，
+// 里面的字符串在下次编辑或释放前有效
+DocumentSymbol *document_symbols(const Document *doc, int *count);
+
+// 没有错误时返回整个程序的 IR（和 ir_generate 的结果相同，调用者释放），
+// 否则返回 NULL
+IRProgram *document_ir(Document *doc);
+
+#endif // INCREMENTAL_H
@@ -0,0 +1,43 @@
+/**
+ * inline.h - 函数内联
+ *
+ * 把小函数的函数体直接复制到调用点：
+ *   param x            x.1 = x
+ *   t1 = call square   t2 = x.1 MUL x.1
+ *                      t1 = t2
+ * 省掉 param/call/return 的开销，也让后续优化能跨越函数边界。
+ *
+ * 代价模型：
+ *   代价 = 被调函数的指令数 - 调用本身的开销 (n 个 param + call + return)
+ *   代价 <= budget 的调用点才会被内联。
+ *   递归函数在自身内部最多展开 max_depth 层，max_depth 为 0 时递归函数
+ *   （包括互相递归的）在哪里都不内联。
+ *   内联进来的函数体里的调用也会展开，但每个函数最多长到原来的 4 倍
+ *   （小于 budget 的按 budget 算），整个程序最多长到原来的 2 倍
+ *   （不到 1000 条指令的按 1000 条算）。
+ */
+
+#ifndef INLINE_H
+#define INLINE_H
+
+#include "ir.h"
+
+// 默认的指令预算和递归展开层数
+#define INLINE_DEFAULT_BUDGET 20
+#define INLINE_DEFAULT_DEPTH 1
+
+/**
+ * 内联选项（代价模型参数）
+ */
+typedef struct {
+  int budget;    // 指令预算
+  int max_depth; // 递归函数最多展开的层数（0 = 不内联递归函数）
+} InlineOptions;
+
+// 默认选项
+InlineOptions inline_default_options(void);
+
+// 对整个程序做内联，返回被内联的调用点数量
+int ir_inline(IRProgram *program, InlineOptions options);
+
+#endif // INLINE_H
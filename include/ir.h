@@ -11,6 +11,7 @@
 #define IR_H
 
 #include "ast.h"
+#include "writer.h"
 
 /**
  * IR 操作码
@@ -25,6 +26,12 @@ typedef enum {
   IR_MOD,    // result = arg1 % arg2
   IR_NEG,    // result = -arg1
 
+  // 位运算（由强度削减生成，只用于整数）
+  IR_SHL,  // result = arg1 << arg2
+  IR_SHR,  // result = arg1 >> arg2 (算术右移，保留符号位)
+  IR_USHR, // result = arg1 >>> arg2 (逻辑右移，高位补 0)
+  IR_BAND, // result = arg1 & arg2
+
   // 比较运算
   IR_EQ, // result = (arg1 == arg2)
   IR_NE, // result = (arg1 != arg2)
@@ -45,11 +52,13 @@ typedef enum {
   IR_IFFALSE, // iffalse arg1 goto label
 
   // 函数相关
-  IR_FUNC_BEGIN, // 函数开始
+  IR_FUNC_BEGIN, // 函数开始 (arg_count = 形参数量，result.vtype = 返回类型)
   IR_FUNC_END,   // 函数结束
+  IR_ARG,        // arg result (声明第 arg1 个形参，紧跟在 FUNC_BEGIN 后)
   IR_PARAM,      // param arg1 (传递参数)
   IR_CALL,       // result = call func, n (调用函数)
   IR_RETURN,     // return arg1
+  IR_TAILCALL,   // tailcall func, n (尾调用：被调函数的返回值直接作为返回值)
 
   // 特殊
   IR_NOP // 空操作
@@ -69,11 +78,21 @@ typedef enum {
   OPERAND_FUNC    // 函数名: main, add, ...
 } OperandType;
 
+/**
+ * 值的类型（后端和优化需要区分整数和浮点）
+ */
+typedef enum {
+  IR_TYPE_INT,  // 整数（char 也按整数处理）
+  IR_TYPE_FLOAT // 浮点数
+} IRValueType;
+
 /**
  * 操作数结构
  */
 typedef struct {
   OperandType type;
+  IRValueType vtype; // 值的类型
+  int is_global; // OPERAND_VAR 是否是全局变量（否则是当前函数的局部变量/形参）
   union {
     int temp_id;      // 临时变量编号
     char *name;       // 变量名/函数名
@@ -94,6 +113,18 @@ typedef struct {
   int arg_count;    // 函数调用时的参数数量
 } IRInstruction;
 
+/**
+ * 生成 IR 时使用的符号（变量或函数）
+ */
+typedef struct {
+  char *name;
+  IRValueType type; // 变量类型 / 函数返回类型
+  int is_global;    // 全局变量
+  int is_function;  // 函数
+  int shadow;       // 遮住的外层同名局部变量个数，不为 0 时 IR 里的名字是
+                    // "名字#shadow"，和外层的分开存储
+} IRSymbol;
+
 /**
  * IR 程序（指令列表）
  */
@@ -103,22 +134,53 @@ typedef struct {
   int capacity;                // 数组容量
   int temp_counter;            // 临时变量计数器
   int label_counter;           // 标签计数器
+
+  // 生成时使用：当前可见的符号（按声明顺序入栈，全局的在栈底）
+  IRSymbol *symbols;
+  int symbol_count;
+  int symbol_capacity;
 } IRProgram;
 
+/**
+ * 函数在指令数组中的位置（优化遍历按函数处理时使用）
+ */
+typedef struct {
+  const char *name; // 函数名（指向 FUNC_BEGIN 指令里的字符串）
+  int begin;        // FUNC_BEGIN 的下标
+  int end;          // FUNC_END 的下标
+  int param_count;  // 形参数量
+} IRFunction;
+
 // ========== 函数声明 ==========
 
 // 创建和销毁
 IRProgram *ir_program_create(void);
 void ir_program_free(IRProgram *program);
 
+// 用重新生成的指令替换 program 的指令（优化遍历使用），rebuilt 会被释放
+void ir_program_replace(IRProgram *program, IRProgram *rebuilt);
+
 // 生成 IR
 IRProgram *ir_generate(ASTNode *ast);
+// 把一个顶层声明追加到 program（流式编译：program 来自 ir_program_create，
+// 声明按源码顺序传入，之后就可以释放它的 AST）
+void ir_generate_declaration(IRProgram *program, ASTNode *decl);
+// 只把顶层声明的符号加入 program，不生成指令（之后的声明能看到它的类型）
+void ir_declare_declaration(IRProgram *program, ASTNode *decl);
+// 把一个顶层声明单独生成为一段 IR（临时变量和标签从 0 编号）；scope 提供
+// 前面的全局符号，生成后也声明了 decl 的符号，但不留下指令
+IRProgram *ir_generate_fragment(IRProgram *scope, ASTNode *decl);
+// 把 ir_generate_fragment 的结果追加到 program，编号接在 program 后面
+void ir_append_fragment(IRProgram *program, const IRProgram *fragment);
+// 同上，但不复制操作数：fragment 的指令移到 program 里，然后释放 fragment
+void ir_take_fragment(IRProgram *program, IRProgram *fragment);
 
 // 辅助函数
 IROperand ir_new_temp(IRProgram *program);
 int ir_new_label(IRProgram *program);
 void ir_emit(IRProgram *program, IROpcode op, IROperand result, IROperand arg1,
              IROperand arg2);
+void ir_emit_instruction(IRProgram *program, IRInstruction instr);
 
 // 构造操作数
 IROperand ir_operand_none(void);
@@ -129,8 +191,18 @@ IROperand ir_operand_float(double val);
 IROperand ir_operand_label(int id);
 IROperand ir_operand_func(const char *name);
 
+// 复制/释放操作数（变量名、函数名是独立分配的字符串）
+IROperand ir_operand_copy(IROperand op);
+void ir_operand_free(IROperand *op);
+
+// 找出程序中的所有函数，返回数量；*functions 需要调用者 free
+int ir_collect_functions(IRProgram *program, IRFunction **functions);
+
 // 打印 IR（调试用）
 void ir_print(IRProgram *program);
+
+// 和 ir_print 相同的文本，经过 out 的缓冲区输出（转储大程序时用）
+void ir_dump(const IRProgram *program, Writer *out);
 const char *ir_opcode_to_string(IROpcode op);
 
 #endif // IR_H
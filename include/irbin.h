@@ -0,0 +1,113 @@
+/**
+ * irbin.h - 二进制 IR 格式
+ *
+ * 把 IRProgram 写成一个可以直接 mmap 使用的文件（扩展名 .irb）：
+ *
+ *   +--------------------+  0
+ *   | IRBinHeader        |  64 字节：魔数、版本、字节序、各部分的偏移和大小、校验和
+ *   +--------------------+  const_offset（8 字节对齐）
+ *   | double[const_count]|  浮点常量池（去重）
+ *   +--------------------+  instruction_offset
+ *   | IRBinInstruction[] |  定长指令（32 字节），操作数里只有整数
+ *   +--------------------+  string_offset
+ *   | 字符串池            |  以 '\0' 结尾的变量名/函数名（去重），偏移 0 是空串
+ *   +--------------------+
+ *
+ * 写入时先在内存里拼好整个文件，再一次 fwrite；
+ * 读取时 mmap 文件，只检查头部（魔数、版本、各部分在文件范围内），
+ * 指令数组和常量池直接在映射的内存上使用，不做逐条解析。
+ * 需要交给优化遍历、后端或解释器时再用 irbin_to_program 转换成 IRProgram。
+ *
+ * 文件按写入方的字节序保存，字节序不同时拒绝读取。
+ */
+
+#ifndef IRBIN_H
+#define IRBIN_H
+
+#include "ir.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define IRBIN_MAGIC "IRB\x1a"
+#define IRBIN_VERSION 1
+#define IRBIN_BYTE_ORDER 0x01020304u
+
+typedef struct {
+  char magic[4]; // IRBIN_MAGIC
+  uint32_t version;
+  uint32_t byte_order; // 按写入方字节序保存的 IRBIN_BYTE_ORDER
+  uint32_t header_size;
+  uint32_t instruction_count;
+  uint32_t instruction_offset;
+  uint32_t const_count;
+  uint32_t const_offset;
+  uint32_t string_size;
+  uint32_t string_offset;
+  int32_t temp_counter;
+  int32_t label_counter;
+  uint64_t file_size;
+  uint64_t checksum; // 头部之后所有字节的 XXH64
+} IRBinHeader;
+
+/**
+ * 定长操作数：value 的含义由 type 决定
+ *   TEMP/LABEL: 编号    INT: 整数值
+ *   FLOAT: 常量池下标   VAR/FUNC: 字符串池偏移
+ */
+typedef struct {
+  uint8_t type;  // OperandType
+  uint8_t vtype; // IRValueType
+  uint8_t is_global;
+  uint8_t reserved;
+  int32_t value;
+} IRBinOperand;
+
+typedef struct {
+  uint32_t opcode; // IROpcode
+  int32_t arg_count;
+  IRBinOperand result;
+  IRBinOperand arg1;
+  IRBinOperand arg2;
+} IRBinInstruction;
+
+/**
+ * 打开的二进制 IR（指针都指向映射的内存）
+ */
+typedef struct {
+  const unsigned char *data;
+  size_t size;
+  const IRBinHeader *header;
+  const double *consts;
+  const IRBinInstruction *instructions;
+  const char *strings;
+  int mapped; // data 是 irbin_open 映射/读入的，irbin_close 时释放
+} IRImage;
+
+/**
+ * 把程序编码成二进制 IR，返回 malloc 的缓冲区，*size 是字节数
+ */
+unsigned char *irbin_encode(const IRProgram *program, size_t *size);
+
+// 编码后一次写入 path，成功返回 0
+int irbin_write(const IRProgram *program, const char *path);
+
+/**
+ * mmap 打开文件（不支持 mmap 的平台整个读入）；
+ * 文件不存在或头部不合法时返回 NULL
+ */
+IRImage *irbin_open(const char *path);
+
+// 把调用者的内存当作二进制 IR（不复制，data 必须 8 字节对齐）
+IRImage *irbin_view(const void *data, size_t size);
+
+void irbin_close(IRImage *image);
+
+// 检查校验和（要读一遍整个文件），一致返回 1
+int irbin_verify(const IRImage *image);
+
+/**
+ * 转换成 IRProgram；操作数引用了不存在的常量或字符串时返回 NULL
+ */
+IRProgram *irbin_to_program(const IRImage *image);
+
+#endif // IRBIN_H
@@ -0,0 +1,55 @@
+/**
+ * jit.h - 在内存里编译并直接运行 (x86-64)
+ *
+ * 和 -c 走同一条路线（codegen → encode），但不写文件：
+ *   1. mmap 一块可读写内存，依次放入 .text、.rodata、.data
+ *   2. 在内存里完成重定位：调用指向缓冲区里的函数，
+ *      全局变量和常量指向缓冲区里的 .data / .rodata
+ *   3. 代码和常量所在的页改成只读可执行（W^X），.data 保持可写
+ * 之后就可以把函数地址当作 C 函数指针调用。
+ *
+ * 只支持有 mmap 的 x86-64 系统（生成的代码使用 System V 调用约定）。
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "hash.h"
+#include "ir.h"
+#include <stddef.h>
+
+typedef struct {
+  unsigned char *memory; // mmap 的整块内存
+  size_t size;
+  size_t code_size; // 只读可执行部分（.text + .rodata，按页对齐）
+
+  // 函数入口
+  char **names;
+  void **entries;
+  IRValueType *return_types;
+  int func_count;
+  NameMap func_index; // 函数名 → 下标（名字借用 names）
+
+  // 全局变量在 .data 里的地址（解释器和本地代码交换全局变量时使用）
+  char **global_names;
+  void **global_addresses;
+  IRValueType *global_types;
+  int global_count;
+  NameMap global_index; // 全局变量名 → 下标（名字借用 global_names）
+} JitProgram;
+
+// 编译整个程序；失败时打印错误并返回 NULL
+JitProgram *jit_compile(IRProgram *program);
+
+void jit_free(JitProgram *jit);
+
+// 查找函数入口，找不到返回 NULL
+void *jit_lookup(JitProgram *jit, const char *name);
+
+// 查找全局变量的地址，找不到返回 NULL
+void *jit_lookup_global(JitProgram *jit, const char *name);
+
+// 调用无参数的 main，返回它的返回值（float 截断成 int）；没有 main 时返回 -1
+int jit_run_main(JitProgram *jit);
+
+#endif // JIT_H
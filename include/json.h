@@ -0,0 +1,55 @@
+/**
+ * json.h - 读写 JSON（语言服务器的 JSON-RPC 消息用）
+ *
+ * json_parse 把整段文本解析成一棵树，字符串里的转义（包括 \uXXXX 和代理对）
+ * 解码成 UTF-8。对象按原来的顺序保存键值，json_get 顺序查找，
+ * 语言服务器的消息都很小，足够了。
+ *
+ * 写的时候直接往 Writer 里拼文本，json_write_string 负责加引号和转义。
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include "writer.h"
+#include <stddef.h>
+
+typedef enum {
+  JSON_NULL,
+  JSON_BOOL,
+  JSON_NUMBER,
+  JSON_STRING,
+  JSON_ARRAY,
+  JSON_OBJECT
+} JsonType;
+
+typedef struct JsonValue JsonValue;
+
+struct JsonValue {
+  JsonType type;
+  int boolean;
+  double number;
+  char *string; // 解码后的 UTF-8（以 '\0' 结尾）
+  size_t length;
+
+  // 数组的元素或对象的值；对象的键在 keys 里
+  JsonValue *items;
+  char **keys;
+  int count;
+};
+
+// 解析 text 的 length 个字节；不是合法的 JSON 时返回 NULL
+JsonValue *json_parse(const char *text, size_t length);
+void json_free(JsonValue *value);
+
+// 对象的成员，没有或者 object 不是对象时返回 NULL（object 可以是 NULL）
+const JsonValue *json_get(const JsonValue *object, const char *key);
+
+// 按类型取值，类型不对时返回 fallback
+const char *json_string(const JsonValue *value, const char *fallback);
+double json_number(const JsonValue *value, double fallback);
+
+// 写出带引号的字符串，控制字符、引号和反斜杠转义
+void json_write_string(Writer *out, const char *text, size_t length);
+
+#endif // JSON_H
@@ -0,0 +1,84 @@
+/**
+ * liveness.h - 活跃变量分析 (Liveness Analysis)
+ *
+ * 一个值在程序点 p 活跃：从 p 出发存在一条路径，在重新赋值之前读取了它。
+ * 死代码删除、寄存器分配、冲突图都建立在这个信息之上。
+ *
+ * 值的编号（每个函数单独编号，保证位集合是稠密的）：
+ *   [0, temp_count)                       临时变量（按 temp_id 重新编号）
+ *   [temp_count, temp_count + var_count)  变量（按 名字 + 是否全局 内化）
+ *
+ * 对每个基本块：
+ *   use = 块内先读后写的值      def = 块内写过的值
+ *   out = ∪ in[后继]            in  = use ∪ (out - def)
+ *
+ * 这是一个逆向问题：沿逆后序的反方向（即后序）处理块，
+ * 配合工作表（worklist）只重新计算后继发生变化的块，通常两三轮就收敛。
+ *
+ * 全局变量：调用可能读取任何全局变量，函数返回后调用者也可能读取，
+ * 所以 call / tailcall / return 都视为"使用了所有全局变量"。
+ */
+
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include "bitset.h"
+#include "cfg.h"
+
+/**
+ * 一个函数的活跃信息
+ */
+typedef struct {
+  CFG *cfg;
+
+  int temp_count;   // 函数里出现的临时变量个数
+  int var_count;    // 函数里出现的变量个数
+  int value_count;  // temp_count + var_count
+  int *temp_index;  // temp_id - temp_id_base → 值编号（-1 表示没出现）
+  int temp_id_base; // 函数里出现的 temp_id 范围 [base, limit)
+  int temp_id_limit;
+  int *value_temp;  // 值编号 → temp_id（只对临时变量有效）
+  const char **var_names; // 值编号 - temp_count → 变量名（借用指令里的字符串）
+  char *var_global;       // 值编号 - temp_count → 是否全局变量
+  struct LivenessVar *var_slots; // (名字, 是否全局) → 值编号 的哈希表
+  int var_mask;
+
+  Bitset globals; // 全局变量对应的位
+
+  // 每个基本块一份
+  Bitset *use;
+  Bitset *def;
+  Bitset *live_in;
+  Bitset *live_out;
+
+  int visits; // 收敛前处理了多少次块
+} Liveness;
+
+// 分析一个函数（指令在 liveness_free 之前不能被修改）
+Liveness *liveness_analyze(IRProgram *program, IRFunction *func);
+void liveness_free(Liveness *lv);
+
+// 操作数的值编号，不是临时变量/变量返回 -1
+int liveness_value(const Liveness *lv, IROperand op);
+
+// 指令读取的值（最多 2 个，不含隐式使用的全局变量），返回个数
+int liveness_instr_uses(const Liveness *lv, const IRInstruction *instr,
+                        int *values);
+
+// 指令写入的值，没有返回 -1
+int liveness_instr_def(const Liveness *lv, const IRInstruction *instr);
+
+// 指令是否隐式使用所有全局变量（call / tailcall / return）
+int liveness_instr_uses_globals(const IRInstruction *instr);
+
+/**
+ * 从块的 live_out 出发，逆向走过一条指令：
+ * live 从"指令之后活跃"变为"指令之前活跃"
+ */
+void liveness_step(const Liveness *lv, const IRInstruction *instr,
+                   Bitset *live);
+
+// 打印每个块的 live-in / live-out
+void liveness_print(const Liveness *lv);
+
+#endif // LIVENESS_H
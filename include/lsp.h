@@ -0,0 +1,28 @@
+/**
+ * lsp.h - 语言服务器（--lsp）
+ *
+ * 在标准输入输出上说 Language Server Protocol（JSON-RPC，每条消息前面是
+ * Content-Length 头）。每个打开的文件是一个 incremental.h 的 Document，
+ * 一直留在内存里：
+ *   - didOpen / didChange / didClose 同步文本，改动只重新分析受影响的顶层
+ *     声明，之后立刻发 publishDiagnostics（带上文档的 version）
+ *   - definition / hover 用语义分析时记下的名字解析结果，documentSymbol
+ *     用每个顶层声明的 AST，都不重新分析
+ *
+ * 位置默认按 UTF-16 计列（协议的默认值），客户端在 positionEncodings 里
+ * 提供 "utf-8" 时改用字节。收到全文替换的 didChange 时先去掉前后没变的
+ * 部分，也按增量处理。
+ */
+
+#ifndef LSP_H
+#define LSP_H
+
+#include <stdio.h>
+
+/**
+ * 从 in 读请求、往 out 写应答，直到收到 exit 或者 in 结束。
+ * 先收到 shutdown 再退出时返回 0，否则返回 1（和协议规定的退出码相同）
+ */
+int lsp_run(FILE *in, FILE *out);
+
+#endif // LSP_H
@@ -0,0 +1,57 @@
+/**
+ * memory.h - 计数的内存分配
+ *
+ * 包含这个头文件的源文件里，malloc/calloc/realloc/free 都被宏换成
+ * mem_* 版本：仍然调用标准库，但顺便记录分配次数和申请的字节数，
+ * --time-report 用它统计每个阶段的分配量。
+ * 包含前定义 MEMORY_UNCOUNTED 的文件使用不计数的标准库版本。
+ *
+ * 计数器是线程局部的，多线程编译时每个线程只看到自己的分配。
+ * 释放时不知道块的大小，所以只记录申请过的总字节数，而不是当前占用。
+ *
+ * 嵌入编译器的程序可以为当前线程换上自己的分配器（compiler.h 在每次调用期间
+ * 换上 CompilerContext 的分配器），之后这个线程的 mem_* 都转给它。
+ */
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef struct {
+  uint64_t allocations; // malloc + calloc + realloc 次数
+  uint64_t frees;
+  uint64_t bytes; // 申请的总字节数
+} MemoryStats;
+
+void *mem_malloc(size_t size);
+void *mem_calloc(size_t count, size_t size);
+void *mem_realloc(void *ptr, size_t size);
+void mem_free(void *ptr);
+
+// 当前线程到目前为止的计数
+MemoryStats memory_stats(void);
+
+typedef struct {
+  void *(*allocate)(void *user, size_t size);
+  void *(*reallocate)(void *user, void *ptr, size_t size);
+  void (*release)(void *user, void *ptr);
+  void *user;
+} MemoryAllocator;
+
+/**
+ * 当前线程之后的分配交给 allocator（NULL 表示标准库），返回原来的分配器；
+ * 分配器的生命期由调用者负责，换回去之前不能释放
+ */
+const MemoryAllocator *memory_set_allocator(const MemoryAllocator *allocator);
+
+#ifndef MEMORY_UNCOUNTED
+#define malloc(size) mem_malloc(size)
+#define calloc(count, size) mem_calloc(count, size)
+#define realloc(ptr, size) mem_realloc(ptr, size)
+#define free(ptr) mem_free(ptr)
+#endif
+
+#endif // MEMORY_H
@@ -0,0 +1,27 @@
+/**
+ * object.h - ELF64 可重定位目标文件输出
+ *
+ * 不调用汇编器，直接把 x86.h 的模块写成 .o：
+ *   .text      encode.h 编码出的机器码
+ *   .data      全局变量（int 4 字节，float 8 字节）
+ *   .rodata    浮点常量（每个 16 字节）
+ *   .rela.text 调用、全局变量和常量引用的重定位项
+ *   .symtab    段符号 + 函数/全局变量符号（+ 引用但未定义的函数）
+ *
+ * 文件格式按小端逐字节写出，不依赖宿主机的 <elf.h>。
+ */
+
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "x86.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// 在内存里生成 ELF 目标文件，*data 由调用者 free；失败返回非 0
+int object_build(const X86Module *module, uint8_t **data, size_t *size);
+
+// 生成并写出目标文件，成功返回 0
+int object_write(const X86Module *module, const char *path);
+
+#endif // OBJECT_H
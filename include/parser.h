@@ -24,12 +24,18 @@
  * - 缓存当前 Token（避免重复读取）
  * - 记录错误信息
  */
-typedef struct {
+typedef struct Parser {
   Lexer *lexer;   // 词法分析器
   Token current;  // 当前 Token
   Token previous; // 上一个 Token（用于错误报告）
   int had_error;  // 是否发生错误
   int panic_mode; // 错误恢复模式
+
+  // 不为 NULL 时在函数体的 '{' 处调用，start 是这个函数定义第一个 Token
+  // 的位置。返回非 0 表示不用解析函数体：它已经把 Lexer 移到了配对的
+  // '}' 后面，函数体留成空的代码块（按函数重新编译时跳过缓存里有的函数）
+  int (*skip_body)(void *user, struct Parser *parser, int start);
+  void *skip_user;
 } Parser;
 
 /**
@@ -51,6 +57,17 @@ Parser parser_init(Lexer *lexer);
  */
 ASTNode *parser_parse(Parser *parser);
 
+/**
+ * parser_next_declaration - 解析下一个顶层声明
+ * @parser: 语法分析器指针
+ *
+ * 返回: 声明的 AST 节点（由调用者 ast_free），文件结束时返回 NULL
+ *
+ * 流式编译用它一次只取一个声明，不必等整个程序的 AST 建好。
+ * 有语法错误时同样打印错误并设置 had_error，之后仍可继续取。
+ */
+ASTNode *parser_next_declaration(Parser *parser);
+
 /**
  * parser_had_error - 检查是否有语法错误
  * @parser: 语法分析器指针
@@ -0,0 +1,45 @@
+/**
+ * peephole.h - 窥孔优化和代数化简
+ *
+ * 每次只看相邻的一两条指令（一个"窥孔"窗口），把它们换成更便宜的形式：
+ * - 常量折叠:     t = 2 MUL 3          → t = 6
+ * - 代数化简:     x + 0, x * 1 → x;  x * 0, x - x → 0
+ * - 强度削减:     x * 8 → x SHL 3;  x / 8、x % 8 → 移位/掩码
+ * - 复制合并:     t = a ADD b; x = t   → x = a ADD b
+ *                 t = a; x = t SUB b   → x = a SUB b
+ * - 取反合并:     t = a LT b; u = !t   → u = a GE b
+ * - 跳转穿透:     goto L1 ... L1: goto L2 → goto L2
+ * - 删除无用代码: 跳到下一条的 goto、无人引用的标签、不可达指令、
+ *                 结果没人用的临时变量
+ *
+ * 一轮化简可能制造出新的机会，所以反复运行直到不再变化（不动点）。
+ * 每个函数单独到不动点，不会因为一个函数而重新扫描整个程序。
+ */
+
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "ir.h"
+
+/**
+ * 窥孔优化统计（每条规则命中的次数）
+ */
+typedef struct {
+  int iterations;       // 轮数最多的函数运行了几轮才到不动点
+  int constants_folded; // 常量折叠
+  int algebraic;        // 代数化简
+  int strength_reduced; // 强度削减
+  int copies_collapsed; // 复制合并
+  int nots_folded;      // 取反合并
+  int jumps_threaded;   // 跳转穿透
+  int dead_removed;     // 删除的无用指令
+} PeepholeStats;
+
+// 对程序的每个函数做窥孔优化，直到不再变化
+PeepholeStats ir_peephole(IRProgram *program);
+
+// 打印统计
+void peephole_print_stats(const PeepholeStats *stats);
+void peephole_write_stats(const PeepholeStats *stats, Writer *out);
+
+#endif // PEEPHOLE_H
@@ -0,0 +1,32 @@
+/**
+ * pool.h - 工作窃取线程池
+ *
+ * 用固定数量的线程执行 task(context, 0) ... task(context, count - 1)：
+ *   - 开始时把下标平均分成连续的段，每个线程一段（各自的双端队列）
+ *   - 线程从自己段的前端取任务
+ *   - 自己的段空了就去别的线程那里偷：从后端拿走剩下的一半，
+ *     所以耗时不均的任务（大小差很多的文件）也能分摊到所有线程
+ * 任务不会产生新任务，所有段都空了线程就退出。
+ *
+ * 不支持线程的平台上在调用线程里依次执行。
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+typedef void (*PoolTask)(void *context, int index);
+
+typedef struct {
+  int threads; // 实际使用的线程数
+  int steals;  // 窃取次数
+} PoolStats;
+
+// 在线核心数（至少 1）
+int pool_default_threads(void);
+
+/**
+ * 用 threads 个线程（<= 0 表示核心数）执行 count 个任务，全部完成后返回
+ */
+PoolStats pool_run(int threads, int count, PoolTask task, void *context);
+
+#endif // POOL_H
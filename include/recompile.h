@@ -0,0 +1,47 @@
+/**
+ * recompile.h - 按函数的增量重新编译
+ *
+ * 大模块两次构建之间通常只改了一个函数。整个文件在编译缓存（cache.h）里
+ * 未命中时逐个声明做语法分析和语义分析，在每个函数体的 '{' 处先只读出
+ * Token 算一个指纹：
+ *   - 函数的 Token 流（类型和原文；空白、注释和所在的行不算）
+ *   - 其中每个名字（包括它自己的名字）此时在全局作用域里的符号：
+ *     种类、类型和参数类型，没有声明时记为没有
+ * 语义分析和 IR 生成只看这些，指纹相同的函数结果也相同。指纹在缓存里有
+ * 条目时（只写入没有错误的函数），函数体不解析也不分析，只声明它的符号、
+ * 直接用缓存里它自己那段未优化的 IR；其它函数照常处理并写回缓存。被调
+ * 函数的签名变了时调用者的指纹跟着变，所以也会重新分析。
+ *
+ * 一个模块的函数条目在缓存里是一个文件（cache.h 的 CachePack），
+ * 开始时读入一次，结束时有新条目才写回。
+ *
+ * 拼起来的 IR 和从头生成的相同，之后照常做整个程序的优化（内联要看到
+ * 所有函数）。全局变量的声明很便宜，每次都重新分析。
+ */
+
+#ifndef RECOMPILE_H
+#define RECOMPILE_H
+
+#include "cache.h"
+#include "ir.h"
+#include "semantic.h"
+#include "timing.h"
+
+typedef struct {
+  int parse_error; // 有语法错误（错误已经打印）
+  int functions;   // 函数个数
+  int reused;      // IR 取自缓存的函数个数
+} RecompileStats;
+
+/**
+ * 前端（语法分析到生成 IR），没有变的函数用缓存里的 IR；module 区分
+ * 不同的源文件（通常是路径）。
+ * 有语法错误（stats->parse_error）或语义错误（留在 analyzer 里）时
+ * 返回 NULL。report 不为 NULL 时记 parse、fingerprint、cache-lookup、
+ * semantic、ir-generate（缓存里的函数只声明符号）、cache-store 和 ir-link
+ */
+IRProgram *recompile_front_end(const char *source, const char *module,
+                               SemanticAnalyzer *analyzer, Cache *cache,
+                               TimeReport *report, RecompileStats *stats);
+
+#endif // RECOMPILE_H
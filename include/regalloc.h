@@ -0,0 +1,91 @@
+/**
+ * regalloc.h - 线性扫描寄存器分配 (Linear Scan Register Allocation)
+ *
+ * IR 里的临时变量、形参、局部变量都是无限多的"虚拟寄存器"，
+ * 这里把它们映射到 x86-64 的物理寄存器或栈槽。
+ *
+ * 1. 活跃区间：按指令顺序给每个程序点编号（指令 i 读操作数在 2i，写结果在 2i+1），
+ *    根据活跃变量分析得到每个值活跃的区间。区间由若干段组成，
+ *    段之间的空隙叫生命周期空洞（lifetime hole）。
+ * 2. 线性扫描（Poletto & Sarkar）：按区间起点排序依次分配，
+ *    维护 active（正在占用寄存器）和 inactive（在空洞里）两个集合；
+ *    区间可以填进别的区间的空洞里（binpacking）。
+ * 3. 寄存器不够时，溢出结束得最晚的那个区间到栈槽。
+ * 4. 第二次机会（second chance）：扫描结束后，被溢出的区间再试一次，
+ *    如果某个寄存器上已分配的区间都和它不冲突，就把它放回寄存器。
+ *
+ * 调用约定：跨越 call 的区间只能使用被调用者保存的寄存器，
+ * 浮点寄存器全部是调用者保存的，跨越 call 的浮点值只能放在栈上。
+ *
+ * 全局变量不参与分配，始终在内存里。
+ */
+
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include "liveness.h"
+#include "target.h"
+
+/**
+ * 值的位置
+ */
+typedef enum {
+  LOC_NONE,  // 不在本函数分配（全局变量、常量）
+  LOC_REG,   // 物理寄存器
+  LOC_STACK  // 栈槽（8 字节）
+} LocationKind;
+
+typedef struct {
+  LocationKind kind;
+  X86Reg reg; // LOC_REG
+  int slot;   // LOC_STACK：第几个栈槽
+} Location;
+
+/**
+ * 区间中连续的一段 [start, end)
+ */
+typedef struct {
+  int start;
+  int end;
+} LiveRange;
+
+/**
+ * 一个值的活跃区间
+ */
+typedef struct {
+  int value;          // 值编号（见 liveness.h）
+  IRValueType type;   // 决定使用整数还是浮点寄存器
+  LiveRange *ranges;  // 按 start 排序，互不重叠
+  int range_count;
+  int range_capacity;
+  int crosses_call;   // 区间跨越了 call
+  Location location;
+} LiveInterval;
+
+/**
+ * 一个函数的分配结果
+ */
+typedef struct {
+  Liveness *lv;
+  LiveInterval *intervals; // 按值编号
+  int interval_count;
+
+  int slot_count;           // 使用的栈槽数
+  int callee_saved_used[REG_COUNT]; // 用到的被调用者保存寄存器（需要在序言保存）
+
+  // 统计
+  int spilled;      // 最终留在栈上的区间数
+  int second_chance; // 溢出后又回到寄存器的区间数
+} RegAlloc;
+
+// 为函数分配寄存器（内部会做活跃变量分析）
+RegAlloc *regalloc_function(IRProgram *program, IRFunction *func);
+void regalloc_free(RegAlloc *ra);
+
+// 操作数的位置（全局变量、常量返回 LOC_NONE）
+Location regalloc_location(const RegAlloc *ra, IROperand op);
+
+// 打印分配结果
+void regalloc_print(const RegAlloc *ra);
+
+#endif // REGALLOC_H
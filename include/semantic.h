@@ -121,6 +121,20 @@ typedef struct SemanticError {
   struct SemanticError *next;
 } SemanticError;
 
+/**
+ * 名字解析的回调（编辑器的跳转和悬停提示用）
+ *
+ * 声明了一个符号（node 是 AST_VAR_DECL / AST_FUNC_DECL / AST_PARAM），
+ * 或者把一处使用（AST_IDENTIFIER / AST_CALL_EXPR / AST_ASSIGN_EXPR）解析到
+ * 符号时调用；global 表示符号在全局作用域里。局部符号在作用域结束时就释放，
+ * 要用的信息在回调里复制出来。
+ */
+typedef struct {
+  void (*resolved)(void *user, const ASTNode *node, const Symbol *sym,
+                   int global);
+  void *user;
+} SemanticResolveHandler;
+
 /**
  * 语义分析器结构体
  */
@@ -129,9 +143,13 @@ typedef struct {
   Scope *global_scope;   // 全局作用域
   SemanticError *errors; // 错误链表
   int error_count;       // 错误数量
+  int symbol_count;      // 声明过的符号总数（统计用）
 
   // 当前函数信息（用于检查 return 语句）
   Symbol *current_function;
+
+  // 名字解析的回调，resolved 为 NULL（默认）时不调用
+  SemanticResolveHandler resolve;
 } SemanticAnalyzer;
 
 // ========== 函数声明 ==========
@@ -162,6 +180,10 @@ int semantic_types_compatible(DataType expected, DataType actual);
 
 // 分析 AST
 void semantic_analyze(SemanticAnalyzer *analyzer, ASTNode *ast);
+// 按顺序逐个分析顶层声明（流式编译），符号表里不保留指向 AST 的指针
+void semantic_analyze_declaration(SemanticAnalyzer *analyzer, ASTNode *decl);
+// 只把顶层声明的符号加入全局作用域（增量分析跳过没有变的声明时用）
+void semantic_declare_declaration(SemanticAnalyzer *analyzer, ASTNode *decl);
 
 // 错误处理
 void semantic_error(SemanticAnalyzer *analyzer, SemanticErrorType type,
@@ -0,0 +1,78 @@
+/**
+ * server.h - 常驻编译服务 (--server) 和它的客户端 (--connect)
+ *
+ * 编译大量很小的程序时，时间主要花在进程启动上（加载、libc 初始化、缺页），
+ * 而不是编译本身。服务端常驻在一个 Unix 域套接字上，每个请求是一份源码和
+ * 编译选项，应答是错误信息和要求的输出（目标文件、二进制 IR、IR 文本）。
+ *
+ * 服务端：
+ *   - 固定数量的工作线程（pool.h），每个线程依次 accept 并处理一个连接，
+ *     连接上可以连续发任意多个请求；多出来的客户端在 listen 队列里等。
+ *     连接空闲几秒（没有新的请求）后服务端断开它，线程去接受下一个连接
+ *   - 每个工作线程有自己的 CompilerContext（compiler.h，每种优化组合一个）
+ *     和收集输出用的缓冲区，在请求之间重复使用
+ *   - 收到 SERVER_STOP 后不再接受新连接，其它连接上正在编译的请求应答后
+ *     断开，然后退出
+ *
+ * 消息（同一台机器上通信，整数用本机字节序）：
+ *   请求: "CCRQ" kind flags wants source_length | 源码
+ *   应答: "CCRP" status 诊断、IR 文本、目标文件、二进制 IR 的长度 | 数据
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stddef.h>
+
+// 请求的输出
+#define SERVER_WANT_OBJECT 0x1u  // ELF 目标文件
+#define SERVER_WANT_IR 0x2u      // 二进制 IR（irbin.h）
+#define SERVER_WANT_LISTING 0x4u // IR 文本（和 -i 相同）
+
+#define SERVER_MAX_SOURCE (64u << 20) // 更大的请求被拒绝
+
+typedef struct {
+  unsigned flags; // compiler.h 的 COMPILER_*
+  unsigned wants; // SERVER_WANT_*
+  const char *source;
+  size_t length;
+} ServerRequest;
+
+/**
+ * 应答；没有请求或编译失败的输出为 NULL，用 server_reply_free 释放
+ */
+typedef struct {
+  int status;        // 0 表示编译成功
+  char *diagnostics; // 错误信息，每行以 '\n' 结尾
+  size_t diagnostics_length;
+  char *listing;
+  size_t listing_length;
+  unsigned char *object;
+  size_t object_size;
+  unsigned char *ir;
+  size_t ir_size;
+} ServerReply;
+
+typedef struct ServerConnection ServerConnection;
+
+/**
+ * 在 path 上监听，用 workers 个工作线程（<= 0 表示核心数）处理请求，
+ * 直到收到 SERVER_STOP；出错返回 1
+ */
+int server_run(const char *path, int workers);
+
+// 连接服务端，失败返回 NULL（不打印错误信息）
+ServerConnection *server_connect(const char *path);
+void server_disconnect(ServerConnection *connection);
+
+/**
+ * 发送一个请求并等待应答；通信失败返回 1（连接之后不能再用）
+ */
+int server_request(ServerConnection *connection, const ServerRequest *request,
+                   ServerReply *reply);
+void server_reply_free(ServerReply *reply);
+
+// 让服务端停止，成功返回 0
+int server_stop(ServerConnection *connection);
+
+#endif // SERVER_H
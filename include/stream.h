@@ -0,0 +1,46 @@
+/**
+ * stream.h - 按顶层声明流式处理的前端
+ *
+ * 普通编译先建好整个程序的 AST，再做语义分析，最后生成 IR，峰值内存里
+ * 同时有整棵 AST 和全部 IR。流式编译每次只取一个顶层声明：
+ *   语法分析 → 语义分析 → 追加到 IR → 释放这个声明的 AST
+ * 然后才读下一个，所以同时存在的 AST 不超过最大的一个声明。
+ *
+ * 流水线模式下语法分析在另一个线程上，通过有界队列把声明交给调用线程做
+ * 语义分析和 IR 生成，两边重叠执行（不支持线程的平台上退回顺序执行）。
+ *
+ * 输出和普通编译相同：
+ *   - 语法错误照常在分析时打印，之后的声明只做语法分析
+ *   - 语义错误留在 analyzer 里，出错后不再生成 IR
+ *
+ * IR 仍然是整个程序的：内联、尾调用和后端都要看到所有函数。
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "ir.h"
+#include "semantic.h"
+#include "timing.h"
+
+typedef struct {
+  int parse_error;  // 有语法错误（错误已经打印）
+  int declarations; // 处理的顶层声明数
+  long nodes;       // AST 节点总数
+  long max_nodes;   // 最大的一个声明的节点数
+} StreamStats;
+
+/**
+ * 流式前端：声明逐个交给 analyzer，返回生成的 IR。
+ * 有语法错误（stats->parse_error）或语义错误（semantic_has_errors）时
+ * IR 不完整，由调用者释放。
+ *
+ * pipeline 为 1 时语法分析放到另一个线程上。report 不为 NULL 时每个声明
+ * 记一次 parse、semantic、ir-generate；流水线模式下 parse 换成 parse-wait，
+ * 即调用线程等下一个声明的时间（语法分析线程上的分配不计入）。
+ */
+IRProgram *stream_front_end(const char *source, SemanticAnalyzer *analyzer,
+                            int pipeline, TimeReport *report,
+                            StreamStats *stats);
+
+#endif // STREAM_H
@@ -0,0 +1,29 @@
+/**
+ * tailcall.h - 尾调用优化
+ *
+ * 尾调用：调用的结果被直接返回
+ *   t = call f, n
+ *   return t
+ *
+ * 自递归的尾调用改写成循环（给形参重新赋值，跳回函数开头），
+ * 不再占用栈空间；调用其他函数的尾调用改写成 IR_TAILCALL，
+ * 后端可以用跳转代替调用。
+ */
+
+#ifndef TAILCALL_H
+#define TAILCALL_H
+
+#include "ir.h"
+
+/**
+ * 尾调用优化统计
+ */
+typedef struct {
+  int self_calls;  // 改写成循环的自递归调用
+  int other_calls; // 标记为 IR_TAILCALL 的调用
+} TailCallStats;
+
+// 对整个程序做尾调用优化
+TailCallStats ir_optimize_tail_calls(IRProgram *program);
+
+#endif // TAILCALL_H
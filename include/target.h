@@ -0,0 +1,52 @@
+/**
+ * target.h - 目标机器描述 (x86-64, System V ABI)
+ *
+ * 寄存器按硬件编码排列：REG_RAX = 0 ... REG_R15 = 15，
+ * REG_XMM0 + n 对应 xmmn，编码时取低 4 位即可。
+ *
+ * System V 调用约定：
+ * - 整数参数: rdi, rsi, rdx, rcx, r8, r9      返回值: rax
+ * - 浮点参数: xmm0 - xmm7                     返回值: xmm0
+ * - 被调用者保存: rbx, rbp, r12 - r15（其余寄存器调用后都可能被改写）
+ */
+
+#ifndef TARGET_H
+#define TARGET_H
+
+typedef enum {
+  REG_NONE = -1,
+  REG_RAX,
+  REG_RCX,
+  REG_RDX,
+  REG_RBX,
+  REG_RSP,
+  REG_RBP,
+  REG_RSI,
+  REG_RDI,
+  REG_R8,
+  REG_R9,
+  REG_R10,
+  REG_R11,
+  REG_R12,
+  REG_R13,
+  REG_R14,
+  REG_R15,
+  REG_XMM0,
+  REG_XMM15 = REG_XMM0 + 15,
+  REG_COUNT
+} X86Reg;
+
+#define INT_ARG_REG_COUNT 6
+#define FLOAT_ARG_REG_COUNT 8
+
+extern const X86Reg INT_ARG_REGS[INT_ARG_REG_COUNT];
+
+// 寄存器名（不带 %），size 是字节数：8/4/1，浮点寄存器忽略 size
+const char *x86_reg_name(X86Reg reg, int size);
+
+int x86_is_float_reg(X86Reg reg);
+
+// 被调用者保存的寄存器（跨调用保持不变）
+int x86_is_callee_saved(X86Reg reg);
+
+#endif // TARGET_H
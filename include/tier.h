@@ -0,0 +1,70 @@
+/**
+ * tier.h - 分层执行：先解释，热函数交给 JIT
+ *
+ * 程序从字节码解释器开始运行（启动只需要 bc_compile，几微秒），
+ * 解释器统计每个函数的调用次数和回边次数；某个函数的热度到达阈值时：
+ *   1. 第一次有函数变热时用 jit_compile 把整个程序编译成本地代码
+ *      （本地代码之间直接互相调用，不再回到解释器）
+ *   2. 把这个函数标记成本地执行，之后解释器里对它的调用都直接跳进本地代码
+ * 正在解释执行的那一次调用不会中途切换（没有栈上替换），所以只在 main
+ * 里循环的程序得不到加速。
+ *
+ * 解释器和本地代码各有一份全局变量：每次进入本地代码前把解释器的全局变量
+ * 写进 JIT 的 .data，返回后再读回来。
+ *
+ * 调用本地函数按 System V 约定：整数实参依次放 rdi..r9，浮点实参依次放
+ * xmm0..xmm7，两类互不影响，所以用一个固定的函数指针类型（6 个 long +
+ * 8 个 double）就能调用任意排列的形参。参数更多的函数留在解释器里。
+ */
+
+#ifndef TIER_H
+#define TIER_H
+
+#include "ir.h"
+#include "jit.h"
+#include "vm.h"
+
+#define TIER_DEFAULT_THRESHOLD 1000
+
+/**
+ * 一次层级变化（按发生顺序记录）
+ */
+typedef struct {
+  int func;
+  VMTier tier;         // 变成了哪一层
+  uint32_t calls;      // 当时的调用次数
+  uint32_t back_edges; // 当时的回边次数
+  const char *reason;  // 留在解释器的原因（VM_TIER_PINNED 时）
+} TierEvent;
+
+typedef struct {
+  IRProgram *ir;
+  VM *vm;
+  JitProgram *jit;
+  int jit_failed;
+  double compile_seconds; // jit_compile 用的时间
+
+  // 每个字节码函数
+  void **entries;
+  IRValueType **param_types;
+  int *param_counts;
+
+  // 每个解释器全局变量在 JIT .data 里的地址
+  void **global_addresses;
+
+  TierEvent *events;
+  int event_count;
+  int event_capacity;
+} Tier;
+
+/**
+ * 给解释器打开分层执行；ir 是 vm 的字节码的来源，运行期间必须保持有效
+ */
+Tier *tier_attach(VM *vm, IRProgram *ir, uint32_t threshold);
+
+void tier_free(Tier *tier);
+
+// 打印每个函数的计数、层级和层级变化的过程
+void tier_print_stats(const Tier *tier);
+
+#endif // TIER_H
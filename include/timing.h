@@ -0,0 +1,72 @@
+/**
+ * timing.h - 各阶段的耗时和内存报告 (--time-report)
+ *
+ * 每个阶段记录：
+ *   - 墙上时间和 CPU 时间（clock_gettime 的 MONOTONIC / PROCESS_CPUTIME）
+ *   - 峰值 RSS 的增长（getrusage 的 ru_maxrss，只有创新高时才会增长）
+ *   - 分配次数和申请的字节数（memory.h 的计数器）
+ *   - 处理的对象数（token、AST 节点、符号、IR 指令）
+ * 同名的阶段累加（--test 编译多个程序时得到总和）。
+ * 结果可以打印成表格，也可以写成 JSON 方便脚本比较。
+ *
+ * 所有函数都接受 NULL 报告（什么也不做），调用处不需要判断是否打开。
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "memory.h"
+
+/**
+ * 某一时刻的计数
+ */
+typedef struct {
+  double wall; // 秒
+  double cpu;  // 秒
+  long rss_kb; // 峰值 RSS
+  MemoryStats memory;
+} TimingSample;
+
+typedef struct {
+  const char *name; // 阶段名（静态字符串）
+  const char *unit; // items 的单位（静态字符串，NULL 表示没有）
+  int runs;
+  double wall;
+  double cpu;
+  long rss_delta_kb;
+  uint64_t allocations;
+  uint64_t bytes;
+  long items;
+} PhaseTiming;
+
+typedef struct {
+  PhaseTiming *phases;
+  int count;
+  int capacity;
+  int last;           // 最近结束的阶段（time_report_items 用）
+  TimingSample start; // 当前阶段开始时
+} TimeReport;
+
+TimeReport *time_report_create(void);
+void time_report_free(TimeReport *report);
+
+// 开始一个阶段
+void time_report_start(TimeReport *report);
+
+// 结束当前阶段，累加到名为 name 的记录
+void time_report_stop(TimeReport *report, const char *name);
+
+// 给刚结束的阶段加上处理的对象数
+void time_report_items(TimeReport *report, long items, const char *unit);
+
+void time_report_print(const TimeReport *report);
+
+// 进程到目前为止的峰值 RSS（KB，不支持的平台返回 0）
+long time_report_peak_rss(void);
+
+/**
+ * 写 JSON（path 为 "-" 时写到 stdout），成功返回 0
+ */
+int time_report_write_json(const TimeReport *report, const char *path);
+
+#endif // TIMING_H
@@ -10,6 +10,8 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include "writer.h"
+
 /**
  * TokenType 枚举
  * 定义了我们的语言支持的所有 Token 类型
@@ -56,6 +58,10 @@ typedef enum {
 typedef struct {
     TokenType type;                 // Token 的类型
     char value[MAX_TOKEN_LENGTH];   // Token 的值（字符串形式）
+    int start;                      // 在源码里的起始位置（字符索引）
+    int length;                     // 在源码里占的字符数（字符串含引号）
+    int line;                       // 起始位置的行号和列号
+    int column;
 } Token;
 
 /**
@@ -67,4 +73,7 @@ const char* token_type_to_string(TokenType type);
 // 打印一个 Token（用于调试）
 void print_token(Token token);
 
+// 同上，写到 out 的缓冲区（转储大文件时用）
+void token_dump(const Token *token, Writer *out);
+
 #endif // TOKEN_H
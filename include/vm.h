@@ -0,0 +1,111 @@
+/**
+ * vm.h - 字节码解释器
+ *
+ * 执行 bytecode.h 的寄存器式字节码，不需要本地代码后端：
+ *   - 所有函数的帧放在一个连续的值栈上，调用时新帧紧跟在调用者的帧后面
+ *   - PARAM 把实参压到参数栈，CALL 把它们复制到新帧的前几个槽位
+ *   - 调用栈记录返回地址、调用者的帧和结果槽位
+ * GCC/Clang 下用 computed goto（每条指令结束时直接跳到下一条的处理代码），
+ * 其他编译器（或定义了 VM_NO_COMPUTED_GOTO）用 switch 分派。
+ *
+ * 分层执行（见 tier.h）：打开后解释器统计每个函数的调用次数和回边
+ * （向后跳转）次数，两者之和到达阈值时通过回调请求把函数编译成本地代码，
+ * 之后对它的调用不再解释，而是交给回调执行。
+ */
+
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include <stdint.h>
+
+#if defined(__GNUC__) && !defined(VM_NO_COMPUTED_GOTO)
+#define VM_COMPUTED_GOTO 1
+#else
+#define VM_COMPUTED_GOTO 0
+#endif
+
+#define VM_STACK_SLOTS (1 << 20) // 值栈的槽位数（所有帧共用）
+#define VM_MAX_FRAMES (1 << 16)  // 最大调用深度
+#define VM_MAX_ARGS (1 << 16)    // 参数栈大小
+
+// 槽位里的值：类型在翻译时已经确定，解释器不做检查
+typedef union {
+  int32_t i;
+  double f;
+} VMValue;
+
+typedef struct {
+  const int32_t *return_pc;
+  VMValue *base; // 调用者的帧
+  int frame_size;
+  int func; // 调用者是哪个函数
+  int dst;  // 返回值写到调用者的哪个槽位
+} VMFrame;
+
+// 函数当前在哪一层执行
+typedef enum {
+  VM_TIER_INTERPRETED,
+  VM_TIER_NATIVE, // 调用交给 call_native
+  VM_TIER_PINNED  // 编译失败或不支持，一直解释执行
+} VMTier;
+
+/**
+ * 分层执行的回调（context 原样传回）
+ */
+typedef struct {
+  uint32_t threshold; // 调用次数 + 回边次数到达它时调用 on_hot
+  // 返回函数的新层级：VM_TIER_NATIVE 或 VM_TIER_PINNED
+  VMTier (*on_hot)(void *context, int func);
+  // 执行一个已经编译的函数，成功返回 0
+  int (*call_native)(void *context, int func, const VMValue *args,
+                     VMValue *result);
+  void *context;
+} VMTierHooks;
+
+typedef struct VM {
+  const BCProgram *program;
+  VMValue *stack;
+  VMValue *globals;
+  VMValue *args;
+  VMFrame *frames;
+  uint64_t executed; // 累计执行的指令条数
+
+  // 动态执行的相邻指令对：pair_counts[前一条 * BC_OPCODE_COUNT + 后一条]，
+  // 用来挑选值得合并成超级指令的组合。NULL 时不统计
+  uint64_t *pair_counts;
+
+  // 分层执行：每个函数的计数和层级。NULL 时不统计
+  VMTierHooks hooks;
+  uint32_t *calls;
+  uint32_t *back_edges;
+  uint64_t *native_calls; // 从解释器转到本地代码的次数
+  unsigned char *tiers;   // VMTier
+} VM;
+
+VM *vm_create(const BCProgram *program);
+void vm_free(VM *vm);
+
+// 打开指令对统计（之后的 vm_call 都会统计）
+void vm_enable_profile(VM *vm);
+
+// 打印最常见的 limit 个指令对
+void vm_print_profile(const VM *vm, int limit);
+
+// 打开分层执行（之后的 vm_call 都会计数）
+void vm_enable_tiering(VM *vm, VMTierHooks hooks);
+
+/**
+ * 调用第 func 个函数，args 是实参（已按形参类型转换）。
+ * 成功返回 0，运行时错误（除零、栈溢出）时打印错误并返回 1
+ */
+int vm_call(VM *vm, int func, const VMValue *args, int arg_count,
+            VMValue *result);
+
+/**
+ * 先执行全局变量初始化，再调用无参数的 main；
+ * *exit_code 是 main 的返回值（float 截断成 int）。成功返回 0
+ */
+int vm_run_main(VM *vm, int *exit_code);
+
+#endif // VM_H
@@ -0,0 +1,74 @@
+/**
+ * writer.h - 带大缓冲区的文本输出
+ *
+ * 转储 IR 和 Token 时每个操作数都调用一次 printf 太慢：
+ * 每次都要解析格式串、加锁 FILE。这里先把文本拼进一块 1 MB 的缓冲区，
+ * 满了才 fwrite 一次；整数用手写的转换，不经过 printf。
+ *
+ * 写到 FILE 上（fwrite 会先冲掉 FILE 自己的缓冲区），所以和同一个 FILE 上的
+ * printf 混用时输出顺序不变，只要在 printf 之前 writer_flush。
+ *
+ * writer_memory 创建的 Writer 不写文件，缓冲区按需扩大，
+ * 并行编译时用来收集每个文件的输出。
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define WRITER_BUFFER_SIZE (1 << 20)
+
+typedef struct {
+  FILE *file;    // NULL 表示只写在内存里
+  int owns_file; // writer_close 时 fclose
+  char *buffer;
+  size_t capacity;
+  size_t length; // 缓冲区里还没写出的字节数
+  size_t bytes;  // 总共写了多少字节
+  int error;     // fwrite 失败过
+} Writer;
+
+/**
+ * 打开文件（"-" 表示标准输出）；失败时打印错误并返回 NULL
+ */
+Writer *writer_open(const char *path);
+
+// 写到已经打开的 FILE（不会关闭它）
+Writer *writer_from_file(FILE *file);
+
+// 只写在内存里，内容见 buffer/length
+Writer *writer_memory(void);
+
+// 写出缓冲区（内存 Writer 什么也不做），成功返回 0
+int writer_flush(Writer *writer);
+
+// 写出、关闭并释放；之前的写入都成功时返回 0
+int writer_close(Writer *writer);
+
+// 取出内存 Writer 里的文本（以 '\0' 结尾，调用者 free）并释放 Writer
+char *writer_take(Writer *writer);
+
+void writer_write(Writer *writer, const char *data, size_t length);
+void writer_puts(Writer *writer, const char *text);
+void writer_putc(Writer *writer, char c);
+
+// 十进制整数，相当于 "%lld"
+void writer_int(Writer *writer, long long value);
+
+// 右对齐到 width 个字符，相当于 "%*lld"
+void writer_int_width(Writer *writer, long long value, int width);
+
+// 左对齐到 width 个字符，相当于 "%-*s"
+void writer_puts_width(Writer *writer, const char *text, int width);
+
+// 定点小数，相当于 "%.*f"（很少用到，交给 snprintf 保证舍入一致）
+void writer_fixed(Writer *writer, double value, int decimals);
+
+// 格式化输出（错误信息等不在乎速度的地方）
+void writer_printf(Writer *writer, const char *format, ...);
+void writer_vprintf(Writer *writer, const char *format, va_list args);
+
+#endif // WRITER_H
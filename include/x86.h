@@ -0,0 +1,201 @@
+/**
+ * x86.h - x86-64 机器指令表示 (Machine IR)
+ *
+ * 代码生成器不直接输出文本，而是先生成这里的结构化指令：
+ * 每条指令是 操作码 + 最多两个操作数（AT&T 顺序：src, dst）。
+ * 同一份指令可以打印成 GAS 汇编，也可以编码成机器码。
+ *
+ * 整数按 32 位运算（size = 4），栈操作和地址按 64 位（size = 8）；
+ * 浮点数是 64 位 double，使用 SSE2 标量指令。
+ */
+
+#ifndef X86_H
+#define X86_H
+
+#include "hash.h"
+#include "ir.h"
+#include "target.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * 操作码
+ */
+typedef enum {
+  X86_LABEL, // 伪指令：.L<label>:
+
+  // 整数
+  X86_MOV,
+  X86_MOVZB, // movzbl %r8, %r32（setcc 之后清零高位）
+  X86_ADD,
+  X86_SUB,
+  X86_IMUL,
+  X86_IDIV,
+  X86_CDQ, // cltd：eax 符号扩展到 edx:eax
+  X86_NEG,
+  X86_SHL,
+  X86_SAR,
+  X86_SHR,
+  X86_AND,
+  X86_OR,
+  X86_XOR,
+  X86_CMP,
+  X86_TEST,
+  X86_SETCC,
+
+  // 控制流和栈
+  X86_JMP,
+  X86_JCC,
+  X86_CALL,
+  X86_RET,
+  X86_PUSH,
+  X86_POP,
+
+  // SSE2 标量浮点
+  X86_MOVSD,
+  X86_MOVAPD, // 寄存器之间复制 double（movsd 只写低 64 位，会依赖目标的旧值）
+  X86_ADDSD,
+  X86_SUBSD,
+  X86_MULSD,
+  X86_DIVSD,
+  X86_UCOMISD,
+  X86_XORPD,
+  X86_CVTSI2SD,  // 32 位整数 → double（同样只写低位，先用 xorpd 清零）
+  X86_CVTTSD2SI, // double → 32 位整数（截断）
+
+  X86_OPCODE_COUNT
+} X86Opcode;
+
+/**
+ * 条件码（setcc / jcc），取值就是硬件编码
+ */
+typedef enum {
+  CC_B = 0x2,  // 无符号 <（浮点 <）
+  CC_AE = 0x3, // 无符号 >=
+  CC_E = 0x4,
+  CC_NE = 0x5,
+  CC_BE = 0x6, // 无符号 <=
+  CC_A = 0x7,  // 无符号 >
+  CC_P = 0xA,  // 奇偶（浮点比较有 NaN）
+  CC_NP = 0xB,
+  CC_L = 0xC,
+  CC_GE = 0xD,
+  CC_LE = 0xE,
+  CC_G = 0xF
+} X86Cond;
+
+/**
+ * 操作数
+ */
+typedef enum {
+  X86_OPND_NONE,
+  X86_OPND_REG,   // 寄存器
+  X86_OPND_IMM,   // 立即数
+  X86_OPND_MEM,   // disp(%base)
+  X86_OPND_GLOBAL, // 全局变量 name(%rip)
+  X86_OPND_CONST, // 只读常量 .LC<index>(%rip)
+  X86_OPND_LABEL, // 跳转目标 .L<index>
+  X86_OPND_FUNC   // 调用目标 name
+} X86OperandKind;
+
+typedef struct {
+  X86OperandKind kind;
+  X86Reg reg;       // REG / MEM 的基址寄存器
+  int64_t imm;      // IMM
+  int disp;         // MEM 的偏移
+  int index;        // CONST / LABEL 的编号
+  const char *name; // GLOBAL / FUNC 的名字（指向模块里的字符串）
+} X86Operand;
+
+/**
+ * 一条机器指令
+ */
+typedef struct {
+  X86Opcode op;
+  X86Cond cond; // SETCC / JCC
+  int size;     // 整数操作的宽度：1/4/8 字节
+  X86Operand src;
+  X86Operand dst; // 单操作数指令只用 dst
+} X86Instr;
+
+/**
+ * 一个函数的机器代码
+ */
+typedef struct {
+  char *name;
+  X86Instr *code;
+  int count;
+  int capacity;
+} X86Function;
+
+/**
+ * 全局变量（.data）
+ */
+typedef struct {
+  char *name;
+  IRValueType type; // int: 4 字节，float: 8 字节
+  int int_value;
+  double float_value;
+} X86Global;
+
+/**
+ * 只读常量（.rodata），16 字节对齐，方便 xorpd 直接引用
+ */
+typedef struct {
+  uint64_t bits;
+} X86Const;
+
+typedef struct {
+  X86Function *functions;
+  int func_count;
+  int func_capacity;
+
+  X86Global *globals;
+  int global_count;
+  int global_capacity;
+  NameMap global_index; // 名字 → globals 的下标
+
+  X86Const *consts;
+  int const_count;
+  int const_capacity;
+} X86Module;
+
+// ========== 操作数构造 ==========
+
+X86Operand x86_reg(X86Reg reg);
+X86Operand x86_imm(int64_t value);
+X86Operand x86_mem(X86Reg base, int disp);
+X86Operand x86_global(const char *name);
+X86Operand x86_const(int index);
+X86Operand x86_label(int label);
+X86Operand x86_func(const char *name);
+
+// ========== 模块 ==========
+
+X86Module *x86_module_create(void);
+void x86_module_free(X86Module *module);
+
+X86Function *x86_add_function(X86Module *module, const char *name);
+X86Global *x86_add_global(X86Module *module, const char *name,
+                          IRValueType type);
+X86Global *x86_find_global(X86Module *module, const char *name);
+
+// 添加（或复用）一个 double 常量，返回编号
+int x86_add_const(X86Module *module, uint64_t bits);
+
+// .data 布局：offsets[i] 是第 i 个全局变量的偏移，返回总大小
+// （int 4 字节对齐，float 8 字节对齐，和 GAS 输出一致）
+int x86_layout_globals(const X86Module *module, int *offsets);
+
+// 追加指令
+void x86_emit(X86Function *func, X86Opcode op, int size, X86Operand src,
+              X86Operand dst);
+void x86_emit_cc(X86Function *func, X86Opcode op, X86Cond cond,
+                 X86Operand dst);
+
+// ========== 输出 ==========
+
+// 打印成 GNU as 可以汇编的 AT&T 语法
+void x86_print_gas(const X86Module *module, FILE *out);
+
+#endif // X86_H
@@ -6,17 +6,65 @@
  * 2. 语法分析 (Parser)
  * 3. 语义分析 (Semantic)
  * 4. 中间代码生成 (IR)
+ *
+ * 后端：-S 输出 x86-64 汇编，-c 直接输出 ELF 目标文件，
+ *       -o 输出目标文件后链接成可执行文件，--jit 在内存里编译并运行 main
+ * 解释执行：--run 翻译成字节码，由解释器运行 main
+ * 缓存：--cache 把优化后的 IR 按源码和选项的哈希保存在磁盘上，命中时跳过前端；
+ *       没命中时按函数查，只重新分析和生成改过的函数（以及签名变了的被调函数
+ *       的调用者）
+ * 二进制 IR：--emit-ir 写出 .irb 文件，输入 .irb 文件时直接从 IR 开始
+ * --time-report：每个阶段的时间、峰值 RSS 增长、分配次数和处理的对象数
+ * 批处理：-q 不回显源码、不打印阶段标题，--dump-ir/--dump-tokens 把转储写到文件
+ * 多个输入文件（或 @文件）时在线程池里并行编译，按输入顺序打印每个文件的输出
+ * 编译服务：--server 常驻在 Unix 套接字上，--connect 把源码交给它编译
+ * 流式前端：--stream 逐个顶层声明分析、生成 IR 并释放 AST，--pipeline 再把
+ *           语法分析放到另一个线程上
+ * 语言服务器：--lsp 在标准输入输出上说 LSP，编辑时增量重新分析
  */
 
+#define _DEFAULT_SOURCE // fork、execvp、waitpid
+
 #include "include/ast.h"
+#include "include/bytecode.h"
+#include "include/cache.h"
+#include "include/codegen.h"
+#include "include/compiler.h"
+#include "include/diag.h"
+#include "include/inline.h"
 #include "include/ir.h"
+#include "include/irbin.h"
+#include "include/jit.h"
 #include "include/lexer.h"
+#include "include/liveness.h"
+#include "include/lsp.h"
+#include "include/memory.h"
 #include "include/parser.h"
+#include "include/peephole.h"
+#include "include/pool.h"
+#include "include/recompile.h"
+#include "include/regalloc.h"
 #include "include/semantic.h"
+#include "include/server.h"
+#include "include/stream.h"
+#include "include/tailcall.h"
+#include "include/tier.h"
+#include "include/timing.h"
+#include "include/vm.h"
+#include "include/writer.h"
+#include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#include <unistd.h>
+#define LINK_SUPPORTED 1
+#else
+#define LINK_SUPPORTED 0
+#endif
 
 /**
  * 读取文件内容
@@ -24,7 +72,7 @@
 char *read_file(const char *filename) {
   FILE *file = fopen(filename, "rb");
   if (!file) {
-    fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+    diag_printf("Error: Cannot open file '%s'\n", filename);
     return NULL;
   }
 
@@ -45,76 +93,945 @@ char *read_file(const char *filename) {
 }
 
 /**
- * 编译流程（所有阶段）
+ * 编译选项
+ */
+typedef struct {
+  int show_tokens;   // 显示 Token 流
+  int show_ast;      // 显示 AST
+  int show_ir;       // 显示 IR
+  int show_liveness; // 显示活跃变量分析结果
+  int show_regalloc; // 显示寄存器分配结果
+  int show_bytecode; // 显示字节码
+
+  // 优化
+  int inline_enabled;          // 函数内联
+  InlineOptions inline_options; // 内联代价模型
+  int tail_calls;              // 尾调用优化
+  int peephole;                // 窥孔优化
+
+  // 后端
+  int emit_assembly;  // -S：只生成汇编
+  int emit_object;    // -c：只生成目标文件
+  int jit;            // --jit：在内存里编译并运行 main
+  int run;            // --run：翻译成字节码并解释执行 main
+  int profile;        // --profile：--run 时统计并打印最常见的指令对
+  int no_fuse;        // --no-fuse：字节码不使用超级指令
+  int tier_threshold; // --tier[=N]：--run 时把热函数交给 JIT（0 表示关闭）
+  const char *output; // -o：输出文件（NULL 时由输入文件名推出）
+  const char *emit_ir; // --emit-ir=FILE：写出二进制 IR
+
+  // 编译缓存
+  Cache *cache;      // --cache[=DIR]：NULL 表示不使用
+  int cache_stats;   // --cache-stats：结束时打印命中统计
+  const char *input; // 正在编译的文件，按函数缓存时区分模块（NULL 时为 "-"）
+
+  TimeReport *report; // --time-report：NULL 表示不统计
+
+  // 批处理
+  int quiet;               // -q：不回显源码，不打印阶段标题和提示信息
+  const char *dump_tokens; // --dump-tokens=FILE：Token 流写到文件
+  const char *dump_ir;     // --dump-ir=FILE：IR 文本写到文件
+
+  // 流式前端（-a 要整棵 AST，这时仍然一次分析完）
+  int stream; // --stream：1 顺序执行，2 --pipeline（语法分析在另一个线程上）
+
+  // 并行编译
+  int jobs;    // -jN：线程数（0 表示核心数）
+  Writer *log; // 本文件的输出先写到这里（NULL 表示直接打印）
+} CompileOptions;
+
+/**
+ * 默认编译选项：只显示 IR，不做优化
+ */
+CompileOptions default_options(void) {
+  CompileOptions options;
+  memset(&options, 0, sizeof(options));
+  options.show_ir = 1;
+  options.inline_options = inline_default_options();
+  return options;
+}
+
+static void vmessage(const CompileOptions *options, const char *format,
+                     va_list args) {
+  if (options->log)
+    writer_vprintf(options->log, format, args);
+  else
+    vprintf(format, args);
+}
+
+/**
+ * 编译结果的输出（并行编译时先收集到 options->log）
+ */
+static void message(const CompileOptions *options, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  vmessage(options, format, args);
+  va_end(args);
+}
+
+/**
+ * 提示信息（阶段标题、成功和统计信息），-q 时不打印；错误不经过这里
+ */
+static void note(const CompileOptions *options, const char *format, ...) {
+  if (options->quiet)
+    return;
+  va_list args;
+  va_start(args, format);
+  vmessage(options, format, args);
+  va_end(args);
+}
+
+/**
+ * 对 IR 运行启用的优化遍历
+ */
+void optimize(IRProgram *ir, const CompileOptions *options) {
+  TimeReport *report = options->report;
+  if (options->inline_enabled) {
+    time_report_start(report);
+    int inlined = ir_inline(ir, options->inline_options);
+    time_report_stop(report, "inline");
+    time_report_items(report, ir->count, "instructions");
+    note(options, "Inlining: %d call site(s) inlined (budget %d, depth %d)\n",
+         inlined, options->inline_options.budget,
+         options->inline_options.max_depth);
+  }
+
+  if (options->tail_calls) {
+    time_report_start(report);
+    TailCallStats stats = ir_optimize_tail_calls(ir);
+    time_report_stop(report, "tail-calls");
+    time_report_items(report, ir->count, "instructions");
+    note(options,
+         "Tail calls: %d self-recursive call(s) turned into loops, "
+         "%d marked as tailcall\n",
+         stats.self_calls, stats.other_calls);
+  }
+
+  if (options->peephole) {
+    time_report_start(report);
+    PeepholeStats stats = ir_peephole(ir);
+    time_report_stop(report, "peephole");
+    time_report_items(report, ir->count, "instructions");
+    if (!options->quiet) {
+      if (options->log)
+        peephole_write_stats(&stats, options->log);
+      else
+        peephole_print_stats(&stats);
+    }
+  }
+}
+
+/**
+ * 影响 IR 的选项（缓存键的一部分）；只影响输出方式的选项不在其中
+ */
+static void options_fingerprint(const CompileOptions *options, char *out,
+                                size_t size) {
+  snprintf(out, size, "inline=%d/%d/%d tail=%d peephole=%d",
+           options->inline_enabled, options->inline_options.budget,
+           options->inline_options.max_depth, options->tail_calls,
+           options->peephole);
+}
+
+/**
+ * 把 path 的扩展名换成 ext（没有扩展名时追加）
+ */
+static char *replace_extension(const char *path, const char *ext) {
+  const char *slash = strrchr(path, '/');
+  const char *dot = strrchr(path, '.');
+  size_t base = (dot && (!slash || dot > slash)) ? (size_t)(dot - path)
+                                                 : strlen(path);
+  char *result = (char *)malloc(base + strlen(ext) + 1);
+  memcpy(result, path, base);
+  strcpy(result + base, ext);
+  return result;
+}
+
+/**
+ * 用系统的 cc 把 object 链接成 output，成功返回 0。
+ * 参数直接交给 execvp，不经过 shell，路径里有引号或空格也没关系
+ */
+static int run_linker(const char *output, const char *object) {
+#if LINK_SUPPORTED
+  char *argv[] = {"cc", "-o", (char *)output, (char *)object, NULL};
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid < 0)
+    return 1;
+  if (pid == 0) {
+    execvp(argv[0], argv);
+    _exit(127);
+  }
+  int status;
+  while (waitpid(pid, &status, 0) < 0)
+    if (errno != EINTR) // 被信号打断时重新等待
+      return 1;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+#else
+  (void)output;
+  (void)object;
+  return 1;
+#endif
+}
+
+/**
+ * 后端：生成汇编或目标文件；需要可执行文件时再交给系统的 cc 链接
+ */
+static int emit_output(IRProgram *ir, const CompileOptions *options) {
+  if (options->emit_assembly) {
+    if (codegen_write_assembly(ir, options->output) != 0)
+      return 1;
+    note(options, "Assembly written to %s\n", options->output);
+    return 0;
+  }
+  if (options->emit_object) {
+    if (codegen_write_object(ir, options->output) != 0)
+      return 1;
+    note(options, "Object written to %s\n", options->output);
+    return 0;
+  }
+
+  char *object_path = replace_extension(options->output, ".tmp.o");
+  int status = codegen_write_object(ir, object_path);
+  if (status == 0) {
+    status = run_linker(options->output, object_path);
+    if (status == 0)
+      note(options, "Executable written to %s\n", options->output);
+    else
+      diag_printf("Error: Linking '%s' failed\n", options->output);
+  }
+  remove(object_path);
+  free(object_path);
+  return status;
+}
+
+/**
+ * --jit：编译到内存并调用 main，返回它的返回值
+ */
+static int run_jit(IRProgram *ir, const CompileOptions *options) {
+  JitProgram *jit = jit_compile(ir);
+  if (!jit)
+    return 1;
+  fflush(stdout);
+  int exit_code = jit_run_main(jit);
+  note(options, "Program exited with %d\n", exit_code);
+  jit_free(jit);
+  return exit_code;
+}
+
+/**
+ * --run：翻译成字节码并解释执行 main，返回它的返回值
+ */
+static int run_bytecode(IRProgram *ir, const CompileOptions *options) {
+  BCProgram *bc = bc_compile(ir, !options->no_fuse);
+  if (!bc)
+    return 1;
+  if (options->show_bytecode) {
+    printf("\n");
+    bc_print(bc);
+  }
+  if (!options->run) {
+    bc_free(bc);
+    return 0;
+  }
+
+  VM *vm = vm_create(bc);
+  if (options->profile)
+    vm_enable_profile(vm);
+  Tier *tier = NULL;
+  if (options->tier_threshold > 0)
+    tier = tier_attach(vm, ir, (uint32_t)options->tier_threshold);
+  fflush(stdout);
+  int exit_code = 0;
+  int status = vm_run_main(vm, &exit_code);
+  if (status == 0)
+    note(options, "Program exited with %d\n", exit_code);
+  if (options->profile)
+    vm_print_profile(vm, 20);
+  if (tier)
+    tier_print_stats(tier);
+  tier_free(tier);
+  vm_free(vm);
+  bc_free(bc);
+  return status == 0 ? exit_code : 1;
+}
+
+/**
+ * 单独计时词法分析：语法分析按需取 Token，两者交织在一起，
+ * 所以这里先单独扫描一遍（parse 的时间里仍然包括词法分析）
+ */
+static void time_lexer(const char *source, TimeReport *report) {
+  time_report_start(report);
+  Lexer lexer = lexer_init(source);
+  long tokens = 0;
+  Token token;
+  do {
+    token = lexer_next_token(&lexer);
+    tokens++;
+  } while (token.type != TOKEN_EOF);
+  time_report_stop(report, "lex");
+  time_report_items(report, tokens, "tokens");
+}
+
+/**
+ * --stream 的阶段 2-4：每个声明分析完就生成 IR 并释放，
+ * 打印的阶段标题和错误与一次分析完整个程序时相同
+ */
+static IRProgram *stream_phases(const char *source,
+                                const CompileOptions *options) {
+  note(options, "========== Phase 2: Syntax Analysis ==========\n");
+  SemanticAnalyzer *analyzer = semantic_init();
+  StreamStats stats;
+  IRProgram *ir = stream_front_end(source, analyzer, options->stream > 1,
+                                   options->report, &stats);
+
+  if (stats.parse_error) {
+    message(options, "Parsing FAILED.\n");
+    ir_program_free(ir);
+    semantic_free(analyzer);
+    return NULL;
+  }
+  note(options, "Parsing successful!\n");
+  note(options, "==============================================\n\n");
+
+  note(options, "========== Phase 3: Semantic Analysis ==========\n");
+  if (semantic_has_errors(analyzer)) {
+    message(options, "Semantic analysis FAILED.\n\n");
+    semantic_print_errors(analyzer);
+    ir_program_free(ir);
+    semantic_free(analyzer);
+    return NULL;
+  }
+  note(options, "Semantic analysis successful!\n");
+  note(options, "================================================\n\n");
+
+  note(options, "========== Phase 4: IR Generation ==========\n");
+  note(options, "IR generation successful! (%d instructions)\n", ir->count);
+  note(options,
+       "Streamed %d declaration(s); largest AST %ld of %ld node(s)\n",
+       stats.declarations, stats.max_nodes, stats.nodes);
+  semantic_free(analyzer);
+
+  optimize(ir, options);
+  return ir;
+}
+
+/**
+ * 有缓存时的前端：没有变的函数用缓存里的 IR，只分析改过的函数。
+ * 打印的阶段标题和错误与一次分析完整个程序时相同
  */
-void compile(const char *source, int show_tokens, int show_ast, int show_ir) {
-  printf("\n========== Source Code ==========\n");
-  printf("%s", source);
-  printf("=================================\n\n");
+static IRProgram *recompile_phases(const char *source,
+                                   const CompileOptions *options) {
+  note(options, "========== Phase 2: Syntax Analysis ==========\n");
+  SemanticAnalyzer *analyzer = semantic_init();
+  RecompileStats stats;
+  IRProgram *ir = recompile_front_end(
+      source, options->input ? options->input : "-", analyzer, options->cache,
+      options->report, &stats);
+
+  if (stats.parse_error) {
+    message(options, "Parsing FAILED.\n");
+    semantic_free(analyzer);
+    return NULL;
+  }
+  note(options, "Parsing successful!\n");
+  note(options, "==============================================\n\n");
+
+  note(options, "========== Phase 3: Semantic Analysis ==========\n");
+  if (!ir) {
+    message(options, "Semantic analysis FAILED.\n\n");
+    semantic_print_errors(analyzer);
+    semantic_free(analyzer);
+    return NULL;
+  }
+  note(options, "Semantic analysis successful!\n");
+  note(options, "================================================\n\n");
+
+  note(options, "========== Phase 4: IR Generation ==========\n");
+  note(options, "IR generation successful! (%d instructions)\n", ir->count);
+  note(options, "Reused IR of %d of %d function(s) from the cache\n",
+       stats.reused, stats.functions);
+  semantic_free(analyzer);
+
+  optimize(ir, options);
+  return ir;
+}
+
+/**
+ * 前端（阶段 1-4）和优化，失败时返回 NULL
+ */
+static IRProgram *front_end(const char *source, const CompileOptions *options) {
+  TimeReport *report = options->report;
+  if (report)
+    time_lexer(source, report);
 
   // 阶段1: 词法分析
-  if (show_tokens) {
-    printf("========== Phase 1: Lexical Analysis ==========\n");
+  if (options->show_tokens) {
+    note(options, "========== Phase 1: Lexical Analysis ==========\n");
     Lexer temp_lexer = lexer_init(source);
     Token token;
     do {
       token = lexer_next_token(&temp_lexer);
       print_token(token);
     } while (token.type != TOKEN_EOF);
-    printf("================================================\n\n");
+    note(options, "================================================\n\n");
   }
 
+  if (options->stream && !options->show_ast)
+    return stream_phases(source, options);
+  if (options->cache && !options->show_ast)
+    return recompile_phases(source, options);
+
   // 阶段2: 语法分析
-  printf("========== Phase 2: Syntax Analysis ==========\n");
+  note(options, "========== Phase 2: Syntax Analysis ==========\n");
+  time_report_start(report);
   Lexer lexer = lexer_init(source);
   Parser parser = parser_init(&lexer);
   ASTNode *ast = parser_parse(&parser);
+  time_report_stop(report, "parse");
+  if (report)
+    time_report_items(report, ast_count_nodes(ast), "nodes");
 
   if (parser_had_error(&parser)) {
-    printf("Parsing FAILED.\n");
+    message(options, "Parsing FAILED.\n");
     ast_free(ast);
-    return;
+    return NULL;
   }
-  printf("Parsing successful!\n");
+  note(options, "Parsing successful!\n");
 
-  if (show_ast) {
+  if (options->show_ast) {
     printf("\nAbstract Syntax Tree:\n");
     ast_print(ast, 0);
   }
-  printf("==============================================\n\n");
+  note(options, "==============================================\n\n");
 
   // 阶段3: 语义分析
-  printf("========== Phase 3: Semantic Analysis ==========\n");
+  note(options, "========== Phase 3: Semantic Analysis ==========\n");
+  time_report_start(report);
   SemanticAnalyzer *analyzer = semantic_init();
   semantic_analyze(analyzer, ast);
+  time_report_stop(report, "semantic");
+  time_report_items(report, analyzer->symbol_count, "symbols");
 
   if (semantic_has_errors(analyzer)) {
-    printf("Semantic analysis FAILED.\n\n");
+    message(options, "Semantic analysis FAILED.\n\n");
     semantic_print_errors(analyzer);
     semantic_free(analyzer);
     ast_free(ast);
-    return;
+    return NULL;
   }
-  printf("Semantic analysis successful!\n");
-  printf("================================================\n\n");
+  note(options, "Semantic analysis successful!\n");
+  note(options, "================================================\n\n");
 
-  // 阶段4: 中间代码生成
-  printf("========== Phase 4: IR Generation ==========\n");
+  // 阶段4: 中间代码生成（IR 里的名字都是复制的，之后不再需要 AST）
+  note(options, "========== Phase 4: IR Generation ==========\n");
+  time_report_start(report);
   IRProgram *ir = ir_generate(ast);
-  printf("IR generation successful! (%d instructions)\n", ir->count);
+  time_report_stop(report, "ir-generate");
+  time_report_items(report, ir->count, "instructions");
+  note(options, "IR generation successful! (%d instructions)\n", ir->count);
+  semantic_free(analyzer);
+  ast_free(ast);
 
-  if (show_ir) {
-    printf("\n");
-    ir_print(ir);
+  optimize(ir, options);
+  return ir;
+}
+
+/**
+ * 关闭转储文件，写入失败时报错
+ */
+static int finish_dump(Writer *out, const char *path, const char *phase,
+                       TimeReport *report) {
+  long bytes = (long)out->bytes;
+  int status = writer_close(out);
+  time_report_stop(report, phase);
+  time_report_items(report, bytes, "bytes");
+  if (status != 0)
+    diag_printf("Error: Writing '%s' failed\n", path);
+  return status;
+}
+
+/**
+ * --dump-tokens：重新扫描一遍源码，把 Token 流写到文件
+ */
+static int dump_tokens(const char *source, const CompileOptions *options) {
+  Writer *out = writer_open(options->dump_tokens);
+  if (!out)
+    return 1;
+  time_report_start(options->report);
+  Lexer lexer = lexer_init(source);
+  Token token;
+  do {
+    token = lexer_next_token(&lexer);
+    token_dump(&token, out);
+  } while (token.type != TOKEN_EOF);
+  return finish_dump(out, options->dump_tokens, "dump-tokens",
+                     options->report);
+}
+
+/**
+ * --dump-ir：把 IR 文本写到文件（格式同 -i）
+ */
+static int dump_ir(const IRProgram *ir, const CompileOptions *options) {
+  Writer *out = writer_open(options->dump_ir);
+  if (!out)
+    return 1;
+  time_report_start(options->report);
+  ir_dump(ir, out);
+  return finish_dump(out, options->dump_ir, "dump-ir", options->report);
+}
+
+/**
+ * 从 IR 开始的部分：打印分析结果，然后生成代码或运行；负责释放 ir
+ */
+static int back_end(IRProgram *ir, const CompileOptions *options) {
+  if (options->show_ir) {
+    message(options, "\n");
+    if (options->log)
+      ir_dump(ir, options->log);
+    else
+      ir_print(ir);
+  }
+
+  if (options->show_liveness || options->show_regalloc) {
+    IRFunction *functions = NULL;
+    int func_count = ir_collect_functions(ir, &functions);
+    for (int i = 0; i < func_count; i++) {
+      if (options->show_liveness) {
+        printf("\n");
+        Liveness *lv = liveness_analyze(ir, &functions[i]);
+        liveness_print(lv);
+        liveness_free(lv);
+      }
+      if (options->show_regalloc) {
+        printf("\n");
+        RegAlloc *ra = regalloc_function(ir, &functions[i]);
+        regalloc_print(ra);
+        regalloc_free(ra);
+      }
+    }
+    free(functions);
+  }
+  note(options, "============================================\n");
+
+  int status = 0;
+  if (options->dump_ir)
+    status = dump_ir(ir, options);
+  if (status == 0 && options->emit_ir) {
+    status = irbin_write(ir, options->emit_ir);
+    if (status == 0)
+      note(options, "IR written to %s\n", options->emit_ir);
+  }
+  if (status == 0) {
+    if (options->output)
+      status = emit_output(ir, options);
+    else if (options->jit)
+      status = run_jit(ir, options);
+    else if (options->run || options->show_bytecode)
+      status = run_bytecode(ir, options);
   }
-  printf("============================================\n");
 
-  // 清理
   ir_program_free(ir);
-  semantic_free(analyzer);
-  ast_free(ast);
+  return status;
+}
+
+/**
+ * 编译流程（所有阶段），成功返回 0；--jit/--run 时返回程序 main 的返回值
+ */
+int compile(const char *source, const CompileOptions *options) {
+  note(options, "\n========== Source Code ==========\n");
+  note(options, "%s", source);
+  note(options, "=================================\n\n");
+
+  if (options->dump_tokens && dump_tokens(source, options) != 0)
+    return 1;
+
+  // 要显示 Token 或 AST 时必须重新分析，不查缓存
+  int use_cache =
+      options->cache && !options->show_tokens && !options->show_ast;
+  CacheKey key;
+  IRProgram *ir = NULL;
+  if (use_cache) {
+    char fingerprint[128];
+    options_fingerprint(options, fingerprint, sizeof(fingerprint));
+    time_report_start(options->report);
+    key = cache_key(source, strlen(source), fingerprint);
+    ir = cache_load(options->cache, key);
+    time_report_stop(options->report, "cache-lookup");
+  }
+
+  if (ir) {
+    char name[33];
+    cache_key_string(key, name);
+    note(options, "========== Phase 4: IR Generation ==========\n");
+    note(options, "Cache hit %s (%d instructions)\n", name, ir->count);
+  } else {
+    ir = front_end(source, options);
+    if (!ir)
+      return 1;
+    if (use_cache) {
+      time_report_start(options->report);
+      cache_store(options->cache, key, ir);
+      time_report_stop(options->report, "cache-store");
+    }
+  }
+
+  return back_end(ir, options);
+}
+
+/**
+ * 从二进制 IR 文件开始：跳过前端和优化（IR 保持写出时的样子）
+ */
+static int compile_ir_file(const char *path, const CompileOptions *options) {
+  time_report_start(options->report);
+  IRImage *image = irbin_open(path);
+  IRProgram *ir = NULL;
+  if (image && irbin_verify(image))
+    ir = irbin_to_program(image);
+  irbin_close(image);
+  time_report_stop(options->report, "load-ir");
+  if (!ir) {
+    diag_printf("Error: '%s' is not a valid IR file\n", path);
+    return 1;
+  }
+
+  note(options, "========== Phase 4: IR Generation ==========\n");
+  note(options, "Loaded %s (%d instructions)\n", path, ir->count);
+  return back_end(ir, options);
+}
+
+/**
+ * 编译一个输入文件（源码或 .irb）；-S/-c 没有 -o 时输出文件名由输入文件名推出
+ */
+static int compile_file(const char *filename, const CompileOptions *options) {
+  CompileOptions file_options = *options;
+  file_options.input = filename;
+  char *output = NULL;
+  if ((options->emit_assembly || options->emit_object) && !options->output) {
+    output = replace_extension(filename, options->emit_assembly ? ".s" : ".o");
+    file_options.output = output;
+  }
+
+  int status;
+  size_t length = strlen(filename);
+  if (length > 4 && strcmp(filename + length - 4, ".irb") == 0) {
+    note(&file_options, "Compiling: %s\n", filename);
+    status = compile_ir_file(filename, &file_options);
+  } else {
+    char *source = read_file(filename);
+    if (source) {
+      note(&file_options, "Compiling: %s\n", filename);
+      status = compile(source, &file_options);
+    } else {
+      status = 1;
+    }
+    free(source);
+  }
+  if (status != 0 && !(options->jit || options->run))
+    status = 1;
+
+  free(output);
+  return status;
+}
+
+/**
+ * 并行编译中的一个文件：输出和错误信息先收集起来，全部完成后按输入顺序打印
+ */
+typedef struct {
+  const char *path;
+  Writer *out; // 提示信息、-i 的 IR
+  Writer *err; // 错误信息（diag_printf）
+  int status;
+} CompileJob;
+
+typedef struct {
+  const CompileOptions *options;
+  CompileJob *jobs;
+} CompileBatch;
+
+static void compile_job(void *context, int index) {
+  CompileBatch *batch = (CompileBatch *)context;
+  CompileJob *job = &batch->jobs[index];
+  CompileOptions options = *batch->options;
+  options.log = job->out = writer_memory();
+  job->err = writer_memory();
+  DiagHandler previous = diag_set_handler(diag_to_writer(job->err));
+  job->status = compile_file(job->path, &options);
+  diag_set_handler(previous);
+}
+
+/**
+ * 把一个任务的错误信息写到 stderr，每行（空行除外）前面加上文件名：
+ * -q 时没有 "Compiling:" 标题，否则分不清是哪个文件的错误
+ */
+static void write_diagnostics(const CompileJob *job) {
+  const char *text = job->err->buffer;
+  size_t length = job->err->length;
+  size_t start = 0;
+  while (start < length) {
+    const char *newline =
+        (const char *)memchr(text + start, '\n', length - start);
+    size_t end = newline ? (size_t)(newline - text) + 1 : length;
+    if (text[start] != '\n')
+      fprintf(stderr, "%s: ", job->path);
+    fwrite(text + start, 1, end - start, stderr);
+    start = end;
+  }
+}
+
+/**
+ * 多个输入文件：每个文件一个任务（各自的 Lexer/Parser/SemanticAnalyzer/IR），
+ * 在工作窃取线程池里执行；有文件失败时返回 1
+ */
+static int compile_files(const char **paths, int count,
+                         const CompileOptions *options) {
+  CompileJob *jobs = (CompileJob *)calloc(count, sizeof(CompileJob));
+  for (int i = 0; i < count; i++)
+    jobs[i].path = paths[i];
+
+  // TimeReport 不是线程安全的，只统计整批的时间
+  CompileOptions job_options = *options;
+  job_options.report = NULL;
+  CompileBatch batch = {&job_options, jobs};
+  time_report_start(options->report);
+  PoolStats stats = pool_run(options->jobs, count, compile_job, &batch);
+  time_report_stop(options->report, "compile-files");
+  time_report_items(options->report, count, "files");
+
+  int failed = 0;
+  for (int i = 0; i < count; i++) {
+    fwrite(jobs[i].out->buffer, 1, jobs[i].out->length, stdout);
+    fflush(stdout);
+    write_diagnostics(&jobs[i]);
+    writer_close(jobs[i].out);
+    writer_close(jobs[i].err);
+    if (jobs[i].status != 0)
+      failed++;
+  }
+  free(jobs);
+
+  note(options, "Compiled %d files on %d thread(s), %d steal(s)\n", count,
+       stats.threads, stats.steals);
+  if (failed)
+    fprintf(stderr, "Error: %d of %d files failed to compile\n", failed,
+            count);
+  return failed ? 1 : 0;
+}
+
+/**
+ * --connect 时服务端能完成的选项：前端、优化、目标文件、二进制 IR 和 IR 文本；
+ * 其它选项（运行、汇编、分析结果、缓存、时间报告……）在本地编译
+ */
+static int remote_supported(const CompileOptions *options) {
+  InlineOptions defaults = inline_default_options();
+  return !(options->show_tokens || options->show_ast ||
+           options->show_liveness || options->show_regalloc ||
+           options->show_bytecode || options->emit_assembly || options->jit ||
+           options->run || options->cache || options->report ||
+           options->dump_tokens || (options->output && !options->emit_object)) &&
+         options->inline_options.budget == defaults.budget &&
+         options->inline_options.max_depth == defaults.max_depth;
+}
+
+static int write_file(const char *path, const void *data, size_t size) {
+  Writer *out = writer_open(path);
+  if (!out)
+    return 1;
+  writer_write(out, (const char *)data, size);
+  if (writer_close(out) != 0) {
+    diag_printf("Error: Writing '%s' failed\n", path);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * 把一个源文件交给服务端编译，按选项写出应答里的输出；
+ * 和服务端的通信失败时返回 -1，由调用者在本地编译
+ */
+static int compile_remote(ServerConnection *connection, const char *filename,
+                          const CompileOptions *options) {
+  size_t length = strlen(filename);
+  if (length > 4 && strcmp(filename + length - 4, ".irb") == 0)
+    return -1;
+  char *source = read_file(filename);
+  if (!source)
+    return 1;
+  note(options, "Compiling: %s\n", filename);
+
+  ServerRequest request;
+  request.flags = (options->inline_enabled ? COMPILER_INLINE : 0) |
+                  (options->tail_calls ? COMPILER_TAIL_CALLS : 0) |
+                  (options->peephole ? COMPILER_PEEPHOLE : 0);
+  request.wants = (options->emit_object ? SERVER_WANT_OBJECT : 0) |
+                  (options->emit_ir ? SERVER_WANT_IR : 0) |
+                  (options->show_ir || options->dump_ir ? SERVER_WANT_LISTING
+                                                        : 0);
+  request.source = source;
+  request.length = strlen(source);
+  ServerReply reply;
+  int failed = server_request(connection, &request, &reply);
+  free(source);
+  if (failed)
+    return -1;
+
+  fwrite(reply.diagnostics, 1, reply.diagnostics_length, stderr);
+  int status = reply.status;
+  if (status == 0 && options->show_ir) {
+    printf("\n");
+    fwrite(reply.listing, 1, reply.listing_length, stdout);
+  }
+  if (status == 0 && options->dump_ir)
+    status = write_file(options->dump_ir, reply.listing, reply.listing_length);
+  if (status == 0 && options->emit_ir) {
+    status = write_file(options->emit_ir, reply.ir, reply.ir_size);
+    if (status == 0)
+      note(options, "IR written to %s\n", options->emit_ir);
+  }
+  if (status == 0 && options->emit_object) {
+    char *output = options->output ? NULL : replace_extension(filename, ".o");
+    const char *path = output ? output : options->output;
+    status = write_file(path, reply.object, reply.object_size);
+    if (status == 0)
+      note(options, "Object written to %s\n", path);
+    free(output);
+  }
+  server_reply_free(&reply);
+  return status ? 1 : 0;
+}
+
+/**
+ * --connect：一个连接上依次编译所有文件；连不上服务端时返回 -1。
+ * 连接中途断开时剩下的文件在本地编译
+ */
+static int compile_remote_files(const char *path, const char **paths,
+                                int count, const CompileOptions *options) {
+  ServerConnection *connection = server_connect(path);
+  if (!connection)
+    return -1;
+  int failed = 0;
+  for (int i = 0; i < count; i++) {
+    int status =
+        connection ? compile_remote(connection, paths[i], options) : -1;
+    if (status < 0) {
+      if (connection) {
+        server_disconnect(connection);
+        connection = NULL;
+        note(options, "Lost connection to %s, compiling locally\n", path);
+      }
+      status = compile_file(paths[i], options);
+    }
+    if (status != 0)
+      failed++;
+  }
+  server_disconnect(connection);
+  if (count == 1)
+    return failed;
+  if (failed)
+    fprintf(stderr, "Error: %d of %d files failed to compile\n", failed,
+            count);
+  return failed ? 1 : 0;
+}
+
+/**
+ * --server：在 path 上常驻，直到 --stop-server
+ */
+static int run_server(const char *path, const CompileOptions *options) {
+  int workers = options->jobs > 0 ? options->jobs : pool_default_threads();
+  note(options, "Serving on %s with %d worker(s)\n", path, workers);
+  fflush(stdout);
+  return server_run(path, workers);
+}
+
+static int stop_server(const char *path) {
+  ServerConnection *connection = server_connect(path);
+  int status = connection ? server_stop(connection) : 1;
+  server_disconnect(connection);
+  if (status != 0)
+    fprintf(stderr, "Error: No server is listening on '%s'\n", path);
+  return status;
 }
 
+/**
+ * 命令行参数（@文件展开之后），字符串都是 malloc 的
+ */
+typedef struct {
+  char **items;
+  int count;
+  int capacity;
+} ArgList;
+
+static void arg_push(ArgList *list, const char *text, size_t length) {
+  if (list->count >= list->capacity) {
+    list->capacity = list->capacity == 0 ? 16 : list->capacity * 2;
+    list->items = (char **)realloc(list->items, sizeof(char *) * list->capacity);
+  }
+  char *arg = (char *)malloc(length + 1);
+  memcpy(arg, text, length);
+  arg[length] = '\0';
+  list->items[list->count++] = arg;
+}
+
+static void arg_list_free(ArgList *list) {
+  for (int i = 0; i < list->count; i++)
+    free(list->items[i]);
+  free(list->items);
+}
+
+#define MAX_RESPONSE_DEPTH 16
+
+static int expand_arg(ArgList *list, const char *arg, int depth);
+
+/**
+ * 读 @文件：参数之间用空白分隔，双引号里的空白不分隔
+ */
+static int expand_response_file(ArgList *list, const char *path, int depth) {
+  if (depth > MAX_RESPONSE_DEPTH) {
+    fprintf(stderr, "Error: Response files nested too deeply at '%s'\n", path);
+    return 1;
+  }
+  char *text = read_file(path);
+  if (!text)
+    return 1;
+
+  int status = 0;
+  ArgList words = {NULL, 0, 0};
+  const char *p = text;
+  for (;;) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+      p++;
+    if (*p == '\0')
+      break;
+    const char *start = p;
+    if (*p == '"') {
+      start = ++p;
+      while (*p && *p != '"')
+        p++;
+      arg_push(&words, start, (size_t)(p - start));
+      if (*p == '"')
+        p++;
+    } else {
+      while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+        p++;
+      arg_push(&words, start, (size_t)(p - start));
+    }
+  }
+  for (int i = 0; i < words.count && status == 0; i++)
+    status = expand_arg(list, words.items[i], depth + 1);
+
+  arg_list_free(&words);
+  free(text);
+  return status;
+}
+
+static int expand_arg(ArgList *list, const char *arg, int depth) {
+  if (arg[0] == '@' && arg[1] != '\0')
+    return expand_response_file(list, arg + 1, depth);
+  arg_push(list, arg, strlen(arg));
+  return 0;
+}
+
+
 /**
  * 演示程序
  */
@@ -138,13 +1055,14 @@ void demo(void) {
                         "    return 0;\n"
                         "}\n";
 
-  compile(program, 0, 0, 1); // 显示 IR
+  CompileOptions options = default_options(); // 显示 IR
+  compile(program, &options);
 }
 
 /**
  * 测试不同的 IR 生成场景
  */
-void test_ir(void) {
+void test_ir(const CompileOptions *options) {
   printf("================================================\n");
   printf("    IR Generation Test Cases\n");
   printf("================================================\n");
@@ -174,6 +1092,20 @@ void test_ir(void) {
                               "    }\n"
                               "    return sum;\n"
                               "}\n"},
+               {"For Loop", "int h(int x) {\n"
+                            "    int i = x * 3;\n"
+                            "    return i;\n"
+                            "}\n"
+                            "int main() {\n"
+                            "    int i = 100;\n"
+                            "    int sum = 0;\n"
+                            "    for (int i = 0; i < 10; i = i + 1) {\n"
+                            "        sum = sum + h(i) + i;\n"
+                            "    }\n"
+                            "    for (;;) {\n"
+                            "        return sum + i;\n"
+                            "    }\n"
+                            "}\n"},
                {"Function Call", "int square(int n) {\n"
                                  "    return n * n;\n"
                                  "}\n"
@@ -181,60 +1113,323 @@ void test_ir(void) {
                                  "    int x = square(5);\n"
                                  "    return x;\n"
                                  "}\n"},
+               {"Short-Circuit", "int check(int n) {\n"
+                                 "    return n * n;\n"
+                                 "}\n"
+                                 "int main() {\n"
+                                 "    int x = 5;\n"
+                                 "    if (x > 0 && check(x) > 10 || !x) {\n"
+                                 "        x = 1;\n"
+                                 "    }\n"
+                                 "    int ok = x < 3 || check(x) == 4;\n"
+                                 "    return ok;\n"
+                                 "}\n"},
+               {"Strength Reduction", "int main() {\n"
+                                      "    int x = 10;\n"
+                                      "    int a = x * 8;\n"
+                                      "    int b = x / 4;\n"
+                                      "    int c = x % 2;\n"
+                                      "    int d = x + 0 - x;\n"
+                                      "    if (!(a < b)) {\n"
+                                      "        d = d * 1;\n"
+                                      "    }\n"
+                                      "    return a + b + c + d;\n"
+                                      "}\n"},
+               {"Tail Call", "int sum_to(int n, int acc) {\n"
+                             "    if (n == 0) {\n"
+                             "        return acc;\n"
+                             "    }\n"
+                             "    return sum_to(n - 1, acc + n);\n"
+                             "}\n"
+                             "int main() {\n"
+                             "    return sum_to(10, 0);\n"
+                             "}\n"},
+               {"Inline Growth", "int a(int x) { return x + 1; }\n"
+                                 "int b(int x) { return a(x) + a(x - 1); }\n"
+                                 "int c(int x) { return b(x) + b(x - 1); }\n"
+                                 "int d(int x) { return c(x) + c(x - 1); }\n"
+                                 "int e(int x) { return d(x) + d(x - 1); }\n"
+                                 "int f(int x) { return e(x) + e(x - 1); }\n"
+                                 "int g(int x) { return f(x) + f(x - 1); }\n"
+                                 "int h(int x) { return g(x) + g(x - 1); }\n"
+                                 "int i(int x) { return h(x) + h(x - 1); }\n"
+                                 "int j(int x) { return i(x) + i(x - 1); }\n"
+                                 "int k(int x) { return j(x) + j(x - 1); }\n"
+                                 "int l(int x) { return k(x) + k(x - 1); }\n"
+                                 "int main() { return l(1); }\n"},
                {NULL, NULL}};
 
   for (int i = 0; tests[i].name != NULL; i++) {
     printf("\n--- Test: %s ---\n", tests[i].name);
-    compile(tests[i].code, 0, 0, 1);
+    compile(tests[i].code, options);
   }
 }
 
 void print_usage(const char *prog) {
-  printf("Usage: %s [options] [file]\n", prog);
+  printf("Usage: %s [options] [file...] [@response-file...]\n", prog);
   printf("\nOptions:\n");
   printf("  -t, --tokens    Show token stream\n");
   printf("  -a, --ast       Show AST\n");
   printf("  -i, --ir        Show IR code\n");
+  printf("  -l, --liveness  Show live variables of each basic block\n");
+  printf("  -r, --regalloc  Show x86-64 register allocation\n");
+  printf("  -b, --bytecode  Show interpreter bytecode\n");
+  printf("  --inline        Inline small functions\n");
+  printf("  --inline-budget=N  Inline cost budget in instructions "
+         "(default %d)\n",
+         INLINE_DEFAULT_BUDGET);
+  printf("  --inline-depth=N   Max expansion depth of recursive calls "
+         "(default %d)\n",
+         INLINE_DEFAULT_DEPTH);
+  printf("  --tail-calls    Turn tail calls into jumps/loops\n");
+  printf("  --peephole      Peephole and algebraic simplification\n");
+  printf("  -O              Enable all optimizations\n");
+  printf("  -S              Write x86-64 assembly (default <file>.s)\n");
+  printf("  -c              Write an ELF object file (default <file>.o)\n");
+  printf("  --jit           Compile in memory and run main (exit code = result)\n");
+  printf("  --run           Run main in the bytecode interpreter\n");
+  printf("  --profile       With --run, show the most frequent opcode pairs\n");
+  printf("  --no-fuse       Do not use bytecode superinstructions\n");
+  printf("  --tier[=N]      With --run, JIT functions after N calls + loop "
+         "back-edges (default %d)\n",
+         TIER_DEFAULT_THRESHOLD);
+  printf("  -o FILE         Write output to FILE (an executable unless -S/-c)\n");
+  printf("  --emit-ir=FILE  Write binary IR to FILE (read back as input "
+         "FILE.irb)\n");
+  printf("  --cache[=DIR]   Reuse IR of unchanged sources and functions "
+         "(default DIR %s)\n",
+         CACHE_DEFAULT_DIR);
+  printf("  --cache-limit=MB   Evict least recently used entries above MB "
+         "(default %lld)\n",
+         CACHE_DEFAULT_LIMIT >> 20);
+  printf("  --cache-stats   Show cache hits and misses\n");
+  printf("  -q, --quiet     Do not echo the source or print phase banners\n");
+  printf("  --dump-tokens=FILE  Write the token stream to FILE (- for stdout)\n");
+  printf("  --dump-ir=FILE  Write the IR listing to FILE (- for stdout)\n");
+  printf("  -jN, --jobs=N   Compile several files on N threads (default: all "
+         "cores)\n");
+  printf("  --stream        Parse, check and lower one top-level declaration "
+         "at a time\n");
+  printf("  --pipeline      Like --stream, parsing on a separate thread\n");
+  printf("  --time-report   Show time, memory and allocations of each phase\n");
+  printf("  --time-report-json=FILE  Also write the report as JSON "
+         "(- for stdout)\n");
+  printf("  --server=SOCKET Serve compile requests on a Unix socket "
+         "(-jN workers)\n");
+  printf("  --connect=SOCKET  Compile through a running server "
+         "(locally if unavailable)\n");
+  printf("  --stop-server=SOCKET  Stop a running server\n");
+  printf("  --lsp           Run a language server on stdin/stdout\n");
   printf("  --test          Run IR test cases\n");
   printf("  -h, --help      Show this help\n");
 }
 
-int main(int argc, char *argv[]) {
-  int show_tokens = 0;
-  int show_ast = 0;
-  int show_ir = 1; // 默认显示 IR
-  const char *filename = NULL;
+int main(int raw_argc, char *raw_argv[]) {
+  // 先展开 @文件
+  ArgList args = {NULL, 0, 0};
+  arg_push(&args, raw_argv[0], strlen(raw_argv[0]));
+  for (int i = 1; i < raw_argc; i++) {
+    if (expand_arg(&args, raw_argv[i], 0) != 0) {
+      arg_list_free(&args);
+      return 1;
+    }
+  }
+  int argc = args.count;
+  char **argv = args.items;
+
+  CompileOptions options = default_options(); // 默认显示 IR
+  const char **inputs = (const char **)malloc(sizeof(char *) * argc);
+  int input_count = 0;
+  int run_tests = 0;
+  int show_ir = 0;
+  const char *cache_dir = NULL;
+  int time_report = 0;
+  const char *time_report_json = NULL;
+  long long cache_limit = CACHE_DEFAULT_LIMIT;
+  const char *server_path = NULL;
+  const char *connect_path = NULL;
+  const char *stop_path = NULL;
+  int lsp = 0;
 
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--tokens") == 0) {
-      show_tokens = 1;
+      options.show_tokens = 1;
     } else if (strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "--ast") == 0) {
-      show_ast = 1;
+      options.show_ast = 1;
     } else if (strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--ir") == 0) {
       show_ir = 1;
+    } else if (strcmp(argv[i], "-l") == 0 ||
+               strcmp(argv[i], "--liveness") == 0) {
+      options.show_liveness = 1;
+    } else if (strcmp(argv[i], "-r") == 0 ||
+               strcmp(argv[i], "--regalloc") == 0) {
+      options.show_regalloc = 1;
+    } else if (strcmp(argv[i], "-b") == 0 ||
+               strcmp(argv[i], "--bytecode") == 0) {
+      options.show_bytecode = 1;
+    } else if (strcmp(argv[i], "--inline") == 0) {
+      options.inline_enabled = 1;
+    } else if (strncmp(argv[i], "--inline-budget=", 16) == 0) {
+      options.inline_enabled = 1;
+      options.inline_options.budget = atoi(argv[i] + 16);
+    } else if (strncmp(argv[i], "--inline-depth=", 15) == 0) {
+      options.inline_enabled = 1;
+      options.inline_options.max_depth = atoi(argv[i] + 15);
+    } else if (strcmp(argv[i], "--tail-calls") == 0) {
+      options.tail_calls = 1;
+    } else if (strcmp(argv[i], "--peephole") == 0) {
+      options.peephole = 1;
+    } else if (strcmp(argv[i], "-O") == 0) {
+      options.inline_enabled = 1;
+      options.tail_calls = 1;
+      options.peephole = 1;
+    } else if (strcmp(argv[i], "-S") == 0) {
+      options.emit_assembly = 1;
+    } else if (strcmp(argv[i], "-c") == 0) {
+      options.emit_object = 1;
+    } else if (strcmp(argv[i], "--jit") == 0) {
+      options.jit = 1;
+    } else if (strcmp(argv[i], "--run") == 0) {
+      options.run = 1;
+    } else if (strcmp(argv[i], "--profile") == 0) {
+      options.run = 1;
+      options.profile = 1;
+    } else if (strcmp(argv[i], "--no-fuse") == 0) {
+      options.no_fuse = 1;
+    } else if (strcmp(argv[i], "--tier") == 0) {
+      options.run = 1;
+      options.tier_threshold = TIER_DEFAULT_THRESHOLD;
+    } else if (strncmp(argv[i], "--tier=", 7) == 0) {
+      options.run = 1;
+      options.tier_threshold = atoi(argv[i] + 7);
+    } else if (strncmp(argv[i], "--emit-ir=", 10) == 0) {
+      options.emit_ir = argv[i] + 10;
+    } else if (strcmp(argv[i], "--cache") == 0) {
+      cache_dir = CACHE_DEFAULT_DIR;
+    } else if (strncmp(argv[i], "--cache=", 8) == 0) {
+      cache_dir = argv[i] + 8;
+    } else if (strncmp(argv[i], "--cache-limit=", 14) == 0) {
+      cache_limit = atoll(argv[i] + 14) << 20;
+    } else if (strcmp(argv[i], "--cache-stats") == 0) {
+      options.cache_stats = 1;
+    } else if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quiet") == 0) {
+      options.quiet = 1;
+    } else if (strncmp(argv[i], "--dump-tokens=", 14) == 0) {
+      options.dump_tokens = argv[i] + 14;
+    } else if (strncmp(argv[i], "--dump-ir=", 10) == 0) {
+      options.dump_ir = argv[i] + 10;
+    } else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2] != '\0') {
+      options.jobs = atoi(argv[i] + 2);
+    } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+      options.jobs = atoi(argv[i] + 7);
+    } else if (strcmp(argv[i], "--stream") == 0) {
+      options.stream = options.stream > 1 ? options.stream : 1;
+    } else if (strcmp(argv[i], "--pipeline") == 0) {
+      options.stream = 2;
+    } else if (strcmp(argv[i], "--time-report") == 0) {
+      time_report = 1;
+    } else if (strncmp(argv[i], "--time-report-json=", 19) == 0) {
+      time_report_json = argv[i] + 19;
+    } else if (strncmp(argv[i], "--server=", 9) == 0) {
+      server_path = argv[i] + 9;
+    } else if (strncmp(argv[i], "--connect=", 10) == 0) {
+      connect_path = argv[i] + 10;
+    } else if (strncmp(argv[i], "--stop-server=", 14) == 0) {
+      stop_path = argv[i] + 14;
+    } else if (strcmp(argv[i], "--lsp") == 0) {
+      lsp = 1;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      options.output = argv[++i];
     } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
       print_usage(argv[0]);
+      free(inputs);
+      arg_list_free(&args);
       return 0;
     } else if (strcmp(argv[i], "--test") == 0) {
-      test_ir();
-      return 0;
+      run_tests = 1;
     } else {
-      filename = argv[i];
+      inputs[input_count++] = argv[i];
     }
   }
 
-  if (filename) {
-    char *source = read_file(filename);
-    if (!source)
+  // 生成代码、运行、转储、-q 或多个输入文件时默认不打印 IR
+  int emit_code =
+      options.emit_assembly || options.emit_object || options.output;
+  options.show_ir =
+      show_ir || !(emit_code || options.emit_ir || options.jit || options.run ||
+                   options.quiet || options.dump_ir || options.dump_tokens ||
+                   input_count > 1);
+  const char *error = NULL;
+  if (emit_code && !options.output && input_count == 0 && !run_tests)
+    error = "-S/-c requires an input file";
+  // 这些选项直接打印到终端或写到同一个文件，只能用于一个输入文件
+  if (input_count > 1 &&
+      (options.output || options.emit_ir || options.dump_ir ||
+       options.dump_tokens || options.jit || options.run ||
+       options.show_tokens || options.show_ast || options.show_liveness ||
+       options.show_regalloc || options.show_bytecode))
+    error = "-o, --emit-ir, --dump-*, --jit, --run and -t/-a/-l/-r/-b take "
+            "a single input file";
+  if ((server_path || stop_path) && input_count > 0)
+    error = "--server and --stop-server take no input files";
+  if (lsp && input_count > 0)
+    error = "--lsp takes no input files";
+  if (error) {
+    fprintf(stderr, "Error: %s\n", error);
+    free(inputs);
+    arg_list_free(&args);
+    return 1;
+  }
+
+  if (options.cache_stats && !cache_dir)
+    cache_dir = CACHE_DEFAULT_DIR;
+  if (cache_dir) {
+    options.cache = cache_open(cache_dir, cache_limit);
+    if (!options.cache) {
+      free(inputs);
+      arg_list_free(&args);
       return 1;
+    }
+  }
 
-    printf("Compiling: %s\n", filename);
-    compile(source, show_tokens, show_ast, show_ir);
+  if (time_report || time_report_json)
+    options.report = time_report_create();
 
-    free(source);
+  int status = 0;
+  if (lsp) {
+    status = lsp_run(stdin, stdout);
+  } else if (server_path) {
+    status = run_server(server_path, &options);
+  } else if (stop_path) {
+    status = stop_server(stop_path);
+  } else if (run_tests) {
+    test_ir(&options);
+  } else if (input_count > 0) {
+    status = -1;
+    if (connect_path && remote_supported(&options)) {
+      status =
+          compile_remote_files(connect_path, inputs, input_count, &options);
+      if (status < 0)
+        note(&options, "No server on %s, compiling locally\n", connect_path);
+    }
+    if (status < 0)
+      status = input_count == 1
+                   ? compile_file(inputs[0], &options)
+                   : compile_files(inputs, input_count, &options);
   } else {
     demo();
   }
 
-  return 0;
+  if (options.cache_stats)
+    cache_print_stats(options.cache);
+  cache_close(options.cache);
+  if (time_report)
+    time_report_print(options.report);
+  if (time_report_json &&
+      time_report_write_json(options.report, time_report_json) != 0)
+    status = 1;
+  time_report_free(options.report);
+  free(inputs);
+  arg_list_free(&args);
+  return status;
 }
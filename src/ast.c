@@ -8,6 +8,7 @@
  */
 
 #include "../include/ast.h"
+#include "../include/memory.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -641,3 +642,66 @@ void ast_free(ASTNode *node) {
 
   free(node);
 }
+
+int ast_count_nodes(const ASTNode *node) {
+  if (!node)
+    return 0;
+
+  int count = 1;
+  switch (node->type) {
+  case AST_PROGRAM:
+    for (int i = 0; i < node->data.program.count; i++)
+      count += ast_count_nodes(node->data.program.declarations[i]);
+    break;
+  case AST_VAR_DECL:
+    count += ast_count_nodes(node->data.var_decl.initializer);
+    break;
+  case AST_FUNC_DECL:
+    for (int i = 0; i < node->data.func_decl.param_count; i++)
+      count += ast_count_nodes(node->data.func_decl.params[i]);
+    count += ast_count_nodes(node->data.func_decl.body);
+    break;
+  case AST_BLOCK:
+    for (int i = 0; i < node->data.block.count; i++)
+      count += ast_count_nodes(node->data.block.statements[i]);
+    break;
+  case AST_IF_STMT:
+    count += ast_count_nodes(node->data.if_stmt.condition);
+    count += ast_count_nodes(node->data.if_stmt.then_branch);
+    count += ast_count_nodes(node->data.if_stmt.else_branch);
+    break;
+  case AST_WHILE_STMT:
+    count += ast_count_nodes(node->data.while_stmt.condition);
+    count += ast_count_nodes(node->data.while_stmt.body);
+    break;
+  case AST_FOR_STMT:
+    count += ast_count_nodes(node->data.for_stmt.init);
+    count += ast_count_nodes(node->data.for_stmt.condition);
+    count += ast_count_nodes(node->data.for_stmt.update);
+    count += ast_count_nodes(node->data.for_stmt.body);
+    break;
+  case AST_RETURN_STMT:
+    count += ast_count_nodes(node->data.return_stmt.value);
+    break;
+  case AST_EXPR_STMT:
+    count += ast_count_nodes(node->data.expr_stmt.expression);
+    break;
+  case AST_BINARY_EXPR:
+    count += ast_count_nodes(node->data.binary_expr.left);
+    count += ast_count_nodes(node->data.binary_expr.right);
+    break;
+  case AST_UNARY_EXPR:
+    count += ast_count_nodes(node->data.unary_expr.operand);
+    break;
+  case AST_CALL_EXPR:
+    for (int i = 0; i < node->data.call_expr.arg_count; i++)
+      count += ast_count_nodes(node->data.call_expr.arguments[i]);
+    break;
+  case AST_ASSIGN_EXPR:
+    count += ast_count_nodes(node->data.assign_expr.value);
+    break;
+  default:
+    break;
+  }
+  return count;
+}
@@ -0,0 +1,99 @@
+/**
+ * bitset.c - 位集合实现
+ */
+
+#include "../include/bitset.h"
+#include "../include/memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WORD_BITS 64
+
+void bitset_init(Bitset *set, int bit_count) {
+  set->bit_count = bit_count;
+  set->word_count = (bit_count + WORD_BITS - 1) / WORD_BITS;
+  set->words = (uint64_t *)calloc(set->word_count ? set->word_count : 1,
+                                  sizeof(uint64_t));
+}
+
+void bitset_free(Bitset *set) {
+  free(set->words);
+  set->words = NULL;
+  set->word_count = 0;
+  set->bit_count = 0;
+}
+
+void bitset_set(Bitset *set, int bit) {
+  set->words[bit / WORD_BITS] |= (uint64_t)1 << (bit % WORD_BITS);
+}
+
+void bitset_reset(Bitset *set, int bit) {
+  set->words[bit / WORD_BITS] &= ~((uint64_t)1 << (bit % WORD_BITS));
+}
+
+int bitset_test(const Bitset *set, int bit) {
+  return (set->words[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1;
+}
+
+void bitset_clear(Bitset *set) {
+  memset(set->words, 0, sizeof(uint64_t) * set->word_count);
+}
+
+int bitset_count(const Bitset *set) {
+  int count = 0;
+  for (int i = 0; i < set->word_count; i++)
+    count += __builtin_popcountll(set->words[i]);
+  return count;
+}
+
+void bitset_copy(Bitset *dst, const Bitset *src) {
+  memcpy(dst->words, src->words, sizeof(uint64_t) * dst->word_count);
+}
+
+int bitset_union(Bitset *dst, const Bitset *src) {
+  uint64_t *restrict d = dst->words;
+  const uint64_t *restrict s = src->words;
+  uint64_t changed = 0;
+  for (int i = 0; i < dst->word_count; i++) {
+    uint64_t merged = d[i] | s[i];
+    changed |= merged ^ d[i];
+    d[i] = merged;
+  }
+  return changed != 0;
+}
+
+void bitset_subtract(Bitset *dst, const Bitset *src) {
+  uint64_t *restrict d = dst->words;
+  const uint64_t *restrict s = src->words;
+  for (int i = 0; i < dst->word_count; i++)
+    d[i] &= ~s[i];
+}
+
+int bitset_transfer(Bitset *dst, const Bitset *gen, const Bitset *src,
+                    const Bitset *kill) {
+  uint64_t *restrict d = dst->words;
+  const uint64_t *restrict g = gen->words;
+  const uint64_t *restrict s = src->words;
+  const uint64_t *restrict k = kill->words;
+  uint64_t changed = 0;
+  for (int i = 0; i < dst->word_count; i++) {
+    uint64_t value = g[i] | (s[i] & ~k[i]);
+    changed |= value ^ d[i];
+    d[i] = value;
+  }
+  return changed != 0;
+}
+
+int bitset_next(const Bitset *set, int bit) {
+  if (bit >= set->bit_count)
+    return -1;
+  int w = bit / WORD_BITS;
+  uint64_t word = set->words[w] & (~(uint64_t)0 << (bit % WORD_BITS));
+  while (1) {
+    if (word)
+      return w * WORD_BITS + __builtin_ctzll(word);
+    if (++w >= set->word_count)
+      return -1;
+    word = set->words[w];
+  }
+}
@@ -0,0 +1,1013 @@
+/**
+ * bytecode.c - IR → 寄存器式字节码
+ */
+
+#include "../include/bytecode.h"
+#include "../include/diag.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BC_NAME(name, format) #name,
+#define BC_FORMAT(name, format) format,
+#define BC_COUNT(name, format) (int)sizeof(format) - 1,
+const char *const bc_opcode_names[BC_OPCODE_COUNT] = {BC_OPCODES(BC_NAME)};
+const char *const bc_operand_formats[BC_OPCODE_COUNT] = {
+    BC_OPCODES(BC_FORMAT)};
+const int bc_operand_count[BC_OPCODE_COUNT] = {BC_OPCODES(BC_COUNT)};
+#undef BC_NAME
+#undef BC_FORMAT
+#undef BC_COUNT
+
+// 每个函数在形参之后保留的临时槽位：两个操作数 + 写全局变量前的结果
+#define SCRATCH_SLOTS 3
+
+/**
+ * 被调用函数的签名（从 FUNC_BEGIN / ARG 收集）
+ */
+typedef struct {
+  IRValueType return_type;
+  IRValueType *param_types;
+  int param_count;
+} Signature;
+
+/**
+ * 局部变量名 → 槽位（开放寻址，每个函数重建）
+ */
+typedef struct {
+  const char *name;
+  int slot;
+} VarEntry;
+
+/**
+ * 还没解析的跳转目标：code[pos] 处填标签 label 的地址
+ */
+typedef struct {
+  int pos;
+  int label;
+} Fixup;
+
+typedef struct {
+  IRProgram *program;
+  BCProgram *bc;
+  Signature *signatures; // 和 bc->functions 一一对应
+  int fuse;              // 生成超级指令
+  int errors;
+
+  int *label_offsets; // 标签编号 → 指令下标，未定义时为 -1
+  Fixup *fixups;
+  int fixup_count;
+  int fixup_capacity;
+
+  // 当前函数
+  BCFunction *func;
+  int slot_count;
+  int scratch; // 第一个临时槽位
+  // 下面四张表按当前函数的临时变量编号范围 [temp_base, temp_base + temps) 索引
+  int *temp_slots;
+  int *temp_owner; // 临时变量的槽位属于哪个函数（避免每个函数清空数组）
+  int *temp_uses;  // 临时变量在当前函数里被读取的次数
+  int *use_owner;
+  int temp_base;
+  int temp_capacity;
+  int owner;
+  VarEntry *vars;
+  int var_capacity;
+  IRValueType *param_types; // 指令下标 - first → PARAM 要传的类型
+  int first;
+  int last;
+} Lowering;
+
+static void error(Lowering *lw, const char *message, const char *name) {
+  diag_printf("Bytecode error: %s%s%s\n", message, name ? ": " : "",
+              name ? name : "");
+  lw->errors++;
+}
+
+static char *str_dup(const char *s) {
+  size_t len = strlen(s) + 1;
+  char *copy = (char *)malloc(len);
+  memcpy(copy, s, len);
+  return copy;
+}
+
+static int is_float(IROperand op) { return op.vtype == IR_TYPE_FLOAT; }
+
+// ==================== 输出 ====================
+
+static void emit_word(Lowering *lw, int32_t word) {
+  BCProgram *bc = lw->bc;
+  if (bc->count >= bc->capacity) {
+    bc->capacity = bc->capacity == 0 ? 256 : bc->capacity * 2;
+    bc->code = (int32_t *)realloc(bc->code, sizeof(int32_t) * bc->capacity);
+  }
+  bc->code[bc->count++] = word;
+}
+
+static void emit(Lowering *lw, BCOpcode op, int a, int b, int c) {
+  emit_word(lw, op);
+  int operands[3] = {a, b, c};
+  for (int i = 0; i < bc_operand_count[op]; i++)
+    emit_word(lw, operands[i]);
+}
+
+/**
+ * 跳转目标先记下来，所有函数翻译完再填
+ */
+static void emit_target(Lowering *lw, int label) {
+  if (lw->fixup_count >= lw->fixup_capacity) {
+    lw->fixup_capacity = lw->fixup_capacity == 0 ? 64 : lw->fixup_capacity * 2;
+    lw->fixups =
+        (Fixup *)realloc(lw->fixups, sizeof(Fixup) * lw->fixup_capacity);
+  }
+  lw->fixups[lw->fixup_count].pos = lw->bc->count;
+  lw->fixups[lw->fixup_count].label = label;
+  lw->fixup_count++;
+  emit_word(lw, -1);
+}
+
+/**
+ * 跳转指令：目标总是最后一个操作数，前面依次是 a、b（按操作码的格式）
+ */
+static void emit_jump(Lowering *lw, BCOpcode op, int a, int b, int label) {
+  emit_word(lw, op);
+  int operands[2] = {a, b};
+  for (int i = 0; i < bc_operand_count[op] - 1; i++)
+    emit_word(lw, operands[i]);
+  emit_target(lw, label);
+}
+
+static int add_float(Lowering *lw, double value) {
+  BCProgram *bc = lw->bc;
+  for (int i = 0; i < bc->float_count; i++) {
+    if (memcmp(&bc->floats[i], &value, sizeof(double)) == 0)
+      return i;
+  }
+  if (bc->float_count >= bc->float_capacity) {
+    bc->float_capacity = bc->float_capacity == 0 ? 16 : bc->float_capacity * 2;
+    bc->floats =
+        (double *)realloc(bc->floats, sizeof(double) * bc->float_capacity);
+  }
+  bc->floats[bc->float_count] = value;
+  return bc->float_count++;
+}
+
+static int global_index(Lowering *lw, IROperand var) {
+  BCProgram *bc = lw->bc;
+  int index = name_map_get(&bc->global_index, var.value.name);
+  if (index >= 0)
+    return index;
+  if (bc->global_count >= bc->global_capacity) {
+    bc->global_capacity =
+        bc->global_capacity == 0 ? 16 : bc->global_capacity * 2;
+    bc->global_names = (char **)realloc(bc->global_names,
+                                        sizeof(char *) * bc->global_capacity);
+    bc->global_types = (IRValueType *)realloc(
+        bc->global_types, sizeof(IRValueType) * bc->global_capacity);
+  }
+  bc->global_names[bc->global_count] = str_dup(var.value.name);
+  bc->global_types[bc->global_count] = var.vtype;
+  name_map_put(&bc->global_index, bc->global_names[bc->global_count],
+               bc->global_count);
+  return bc->global_count++;
+}
+
+int bc_find_function(const BCProgram *bc, const char *name) {
+  return name_map_get(&bc->function_index, name);
+}
+
+static BCFunction *add_function(Lowering *lw, const char *name,
+                                IRValueType return_type, int param_count) {
+  BCProgram *bc = lw->bc;
+  if (bc->func_count >= bc->func_capacity) {
+    bc->func_capacity = bc->func_capacity == 0 ? 8 : bc->func_capacity * 2;
+    bc->functions = (BCFunction *)realloc(
+        bc->functions, sizeof(BCFunction) * bc->func_capacity);
+    lw->signatures = (Signature *)realloc(
+        lw->signatures, sizeof(Signature) * bc->func_capacity);
+  }
+  BCFunction *func = &bc->functions[bc->func_count];
+  func->name = str_dup(name);
+  func->entry = -1;
+  func->param_count = param_count;
+  func->frame_size = param_count;
+  func->return_type = return_type;
+
+  Signature *sig = &lw->signatures[bc->func_count];
+  sig->return_type = return_type;
+  sig->param_count = param_count;
+  sig->param_types = (IRValueType *)calloc(param_count ? param_count : 1,
+                                           sizeof(IRValueType));
+  name_map_put(&bc->function_index, func->name, bc->func_count);
+  bc->func_count++;
+  return func;
+}
+
+// ==================== 槽位 ====================
+
+static unsigned hash_name(const char *name) {
+  unsigned h = 2166136261u;
+  for (; *name; name++)
+    h = (h ^ (unsigned char)*name) * 16777619u;
+  return h;
+}
+
+static int new_slot(Lowering *lw) { return lw->slot_count++; }
+
+static int var_slot(Lowering *lw, const char *name) {
+  unsigned mask = (unsigned)lw->var_capacity - 1;
+  unsigned i = hash_name(name) & mask;
+  while (lw->vars[i].name) {
+    if (strcmp(lw->vars[i].name, name) == 0)
+      return lw->vars[i].slot;
+    i = (i + 1) & mask;
+  }
+  lw->vars[i].name = name;
+  lw->vars[i].slot = new_slot(lw);
+  return lw->vars[i].slot;
+}
+
+/**
+ * 局部变量或临时变量的槽位（第一次出现时分配）
+ */
+static int slot_of(Lowering *lw, IROperand op) {
+  if (op.type == OPERAND_VAR)
+    return var_slot(lw, op.value.name);
+  int id = op.value.temp_id - lw->temp_base;
+  if (lw->temp_owner[id] != lw->owner) {
+    lw->temp_owner[id] = lw->owner;
+    lw->temp_slots[id] = new_slot(lw);
+  }
+  return lw->temp_slots[id];
+}
+
+static int is_global(IROperand op) {
+  return op.type == OPERAND_VAR && op.is_global;
+}
+
+/**
+ * 把操作数按 type 读到一个槽位里，返回槽位下标：
+ * 常量和全局变量先放进第 scratch 个临时槽位，类型不同时插入转换
+ */
+static int read_operand(Lowering *lw, IROperand op, IRValueType type,
+                        int scratch) {
+  int tmp = lw->scratch + scratch;
+  switch (op.type) {
+  case OPERAND_INT:
+    if (type == IR_TYPE_FLOAT)
+      emit(lw, BC_LOADF, tmp, add_float(lw, (double)op.value.int_val), 0);
+    else
+      emit(lw, BC_LOADI, tmp, op.value.int_val, 0);
+    return tmp;
+  case OPERAND_FLOAT:
+    emit(lw, BC_LOADF, tmp, add_float(lw, op.value.float_val), 0);
+    if (type == IR_TYPE_INT)
+      emit(lw, BC_F2I, tmp, tmp, 0);
+    return tmp;
+  case OPERAND_VAR:
+  case OPERAND_TEMP: {
+    int slot;
+    if (is_global(op)) {
+      emit(lw, BC_GETG, tmp, global_index(lw, op), 0);
+      slot = tmp;
+    } else {
+      slot = slot_of(lw, op);
+    }
+    if (op.vtype != type) {
+      emit(lw, type == IR_TYPE_FLOAT ? BC_I2F : BC_F2I, tmp, slot, 0);
+      slot = tmp;
+    }
+    return slot;
+  }
+  default:
+    emit(lw, BC_LOADI, tmp, 0, 0);
+    return tmp;
+  }
+}
+
+/**
+ * 结果写到哪个槽位：全局变量先写临时槽位，再由 write_result 写回
+ */
+static int result_slot(Lowering *lw, IROperand result) {
+  return is_global(result) ? lw->scratch + 2 : slot_of(lw, result);
+}
+
+static void write_result(Lowering *lw, IROperand result, int slot) {
+  if (is_global(result))
+    emit(lw, BC_SETG, global_index(lw, result), slot, 0);
+}
+
+/**
+ * 把 type 类型的槽位 src 转换后存进结果
+ */
+static void store_converted(Lowering *lw, IROperand result, IRValueType type,
+                            int src) {
+  int dst = result_slot(lw, result);
+  if (result.vtype == type) {
+    if (dst != src)
+      emit(lw, BC_MOV, dst, src, 0);
+  } else {
+    emit(lw, result.vtype == IR_TYPE_FLOAT ? BC_I2F : BC_F2I, dst, src, 0);
+  }
+  write_result(lw, result, dst);
+}
+
+// ==================== 指令 ====================
+
+static BCOpcode int_opcode(IROpcode op) {
+  switch (op) {
+  case IR_ADD: return BC_ADDI;
+  case IR_SUB: return BC_SUBI;
+  case IR_MUL: return BC_MULI;
+  case IR_DIV: return BC_DIVI;
+  case IR_MOD: return BC_MODI;
+  case IR_SHL: return BC_SHL;
+  case IR_SHR: return BC_SHR;
+  case IR_USHR: return BC_USHR;
+  case IR_BAND: return BC_BAND;
+  case IR_EQ: return BC_EQI;
+  case IR_NE: return BC_NEI;
+  case IR_LT: return BC_LTI;
+  case IR_GT: return BC_GTI;
+  case IR_LE: return BC_LEI;
+  case IR_GE: return BC_GEI;
+  default: return BC_NOP;
+  }
+}
+
+// 没有浮点版本的运算（取模、移位、按位与）返回 BC_NOP
+static BCOpcode float_opcode(IROpcode op) {
+  switch (op) {
+  case IR_ADD: return BC_ADDF;
+  case IR_SUB: return BC_SUBF;
+  case IR_MUL: return BC_MULF;
+  case IR_DIV: return BC_DIVF;
+  case IR_EQ: return BC_EQF;
+  case IR_NE: return BC_NEF;
+  case IR_LT: return BC_LTF;
+  case IR_GT: return BC_GTF;
+  case IR_LE: return BC_LEF;
+  case IR_GE: return BC_GEF;
+  default: return BC_NOP;
+  }
+}
+
+static int is_compare(IROpcode op) { return op >= IR_EQ && op <= IR_GE; }
+
+static int is_constant(IROperand op) {
+  return op.type == OPERAND_INT || op.type == OPERAND_FLOAT;
+}
+
+static double constant_value(IROperand op) {
+  return op.type == OPERAND_FLOAT ? op.value.float_val
+                                  : (double)op.value.int_val;
+}
+
+// 交换比较的两个操作数：a < b 等价于 b > a
+static IROpcode swap_compare(IROpcode op) {
+  switch (op) {
+  case IR_LT: return IR_GT;
+  case IR_GT: return IR_LT;
+  case IR_LE: return IR_GE;
+  case IR_GE: return IR_LE;
+  default: return op;
+  }
+}
+
+// 整数比较取反：!(a < b) 等价于 a >= b
+static IROpcode negate_compare(IROpcode op) {
+  switch (op) {
+  case IR_EQ: return IR_NE;
+  case IR_NE: return IR_EQ;
+  case IR_LT: return IR_GE;
+  case IR_GE: return IR_LT;
+  case IR_GT: return IR_LE;
+  default: return IR_GT; // IR_LE
+  }
+}
+
+static void swap_operands(IROperand *x, IROperand *y) {
+  IROperand tmp = *x;
+  *x = *y;
+  *y = tmp;
+}
+
+/**
+ * 常量 + 运算的超级指令：常量操作数编码成立即数（浮点是常量编号），
+ * 需要时交换操作数让常量在 *y。不适用时返回 BC_NOP
+ */
+static BCOpcode immediate_form(Lowering *lw, IROpcode op, IRValueType type,
+                               IROperand *x, IROperand *y, int *imm) {
+  if (type == IR_TYPE_INT) {
+    if (!is_constant(*y) && is_constant(*x) &&
+        (op == IR_ADD || op == IR_MUL || is_compare(op))) {
+      swap_operands(x, y);
+      op = swap_compare(op);
+    }
+    if (y->type != OPERAND_INT)
+      return BC_NOP;
+    int value = y->value.int_val;
+    *imm = value;
+    switch (op) {
+    case IR_ADD: return BC_ADDIK;
+    case IR_SUB:
+      *imm = (int)(0u - (unsigned)value); // 回绕：x - c == x + (-c)
+      return BC_ADDIK;
+    case IR_MUL: return BC_MULIK;
+    case IR_DIV: return value != 0 ? BC_DIVIK : BC_NOP;
+    case IR_MOD: return value != 0 ? BC_MODIK : BC_NOP;
+    default:
+      return is_compare(op) ? (BCOpcode)(BC_EQIK + (op - IR_EQ)) : BC_NOP;
+    }
+  }
+
+  if (is_compare(op))
+    return BC_NOP;
+  if (is_constant(*y)) {
+    *imm = add_float(lw, constant_value(*y));
+    switch (op) {
+    case IR_ADD: return BC_ADDFK;
+    case IR_SUB: return BC_SUBFK;
+    case IR_MUL: return BC_MULFK;
+    default: return BC_DIVFK;
+    }
+  }
+  if (is_constant(*x)) {
+    *imm = add_float(lw, constant_value(*x));
+    swap_operands(x, y);
+    switch (op) {
+    case IR_ADD: return BC_ADDFK;
+    case IR_SUB: return BC_RSUBFK;
+    case IR_MUL: return BC_MULFK;
+    default: return BC_RDIVFK;
+    }
+  }
+  return BC_NOP;
+}
+
+/**
+ * 二元运算：有一边是浮点就按浮点算（比较结果总是整数）
+ */
+static void lower_binary(Lowering *lw, IRInstruction *instr) {
+  IRValueType type = IR_TYPE_INT;
+  BCOpcode op = int_opcode(instr->opcode);
+  BCOpcode fop = float_opcode(instr->opcode);
+  if (fop != BC_NOP &&
+      (is_float(instr->arg1) || is_float(instr->arg2) ||
+       (!is_compare(instr->opcode) && is_float(instr->result)))) {
+    type = IR_TYPE_FLOAT;
+    op = fop;
+  }
+
+  IROperand x = instr->arg1, y = instr->arg2;
+  int a, b;
+  BCOpcode kop = BC_NOP;
+  if (lw->fuse)
+    kop = immediate_form(lw, instr->opcode, type, &x, &y, &b);
+  if (kop != BC_NOP) {
+    op = kop;
+    a = read_operand(lw, x, type, 0);
+  } else {
+    a = read_operand(lw, x, type, 0);
+    b = read_operand(lw, y, type, 1);
+  }
+  IRValueType result_type = is_compare(instr->opcode) ? IR_TYPE_INT : type;
+  if (instr->result.vtype == result_type) {
+    int dst = result_slot(lw, instr->result);
+    emit(lw, op, dst, a, b);
+    write_result(lw, instr->result, dst);
+  } else {
+    emit(lw, op, lw->scratch, a, b);
+    store_converted(lw, instr->result, result_type, lw->scratch);
+  }
+}
+
+/**
+ * 逻辑运算的操作数只看真假：浮点先变成 0/1
+ */
+static int read_truth(Lowering *lw, IROperand op, int scratch) {
+  if (!is_float(op))
+    return read_operand(lw, op, IR_TYPE_INT, scratch);
+  int slot = read_operand(lw, op, IR_TYPE_FLOAT, scratch);
+  emit(lw, BC_TRUTHF, lw->scratch + scratch, slot, 0);
+  return lw->scratch + scratch;
+}
+
+static void lower_logical(Lowering *lw, IRInstruction *instr) {
+  int a = read_truth(lw, instr->arg1, 0);
+  int b = read_truth(lw, instr->arg2, 1);
+  BCOpcode op = instr->opcode == IR_AND ? BC_ANDL : BC_ORL;
+  if (instr->result.vtype == IR_TYPE_INT) {
+    int dst = result_slot(lw, instr->result);
+    emit(lw, op, dst, a, b);
+    write_result(lw, instr->result, dst);
+  } else {
+    emit(lw, op, lw->scratch, a, b);
+    store_converted(lw, instr->result, IR_TYPE_INT, lw->scratch);
+  }
+}
+
+static void lower_unary(Lowering *lw, IRInstruction *instr) {
+  IRValueType type = is_float(instr->arg1) ? IR_TYPE_FLOAT : IR_TYPE_INT;
+  IRValueType result_type = type;
+  BCOpcode op;
+  if (instr->opcode == IR_NEG) {
+    if (is_float(instr->result))
+      type = result_type = IR_TYPE_FLOAT;
+    op = type == IR_TYPE_FLOAT ? BC_NEGF : BC_NEGI;
+  } else {
+    result_type = IR_TYPE_INT;
+    op = type == IR_TYPE_FLOAT ? BC_NOTF : BC_NOTI;
+  }
+
+  int a = read_operand(lw, instr->arg1, type, 0);
+  if (instr->result.vtype == result_type) {
+    int dst = result_slot(lw, instr->result);
+    emit(lw, op, dst, a, 0);
+    write_result(lw, instr->result, dst);
+  } else {
+    emit(lw, op, lw->scratch, a, 0);
+    store_converted(lw, instr->result, result_type, lw->scratch);
+  }
+}
+
+static void lower_assign(Lowering *lw, IRInstruction *instr) {
+  IROperand src = instr->arg1;
+  IROperand dst = instr->result;
+
+  // 常量直接装进目标槽位，省掉一次 MOV
+  if (!is_global(dst) && (src.type == OPERAND_INT ||
+                          (src.type == OPERAND_FLOAT && is_float(dst)))) {
+    int slot = slot_of(lw, dst);
+    if (is_float(dst))
+      emit(lw, BC_LOADF, slot,
+           add_float(lw, src.type == OPERAND_INT ? (double)src.value.int_val
+                                                 : src.value.float_val),
+           0);
+    else
+      emit(lw, BC_LOADI, slot, src.value.int_val, 0);
+    return;
+  }
+
+  int slot = read_operand(lw, src, dst.vtype, 0);
+  if (is_global(dst)) {
+    emit(lw, BC_SETG, global_index(lw, dst), slot, 0);
+    return;
+  }
+  int target = slot_of(lw, dst);
+  if (target != slot)
+    emit(lw, BC_MOV, target, slot, 0);
+}
+
+static void lower_branch(Lowering *lw, IRInstruction *instr) {
+  int label = instr->result.value.label_id;
+  if (instr->arg1.type == OPERAND_INT) {
+    // 条件是常量：要么无条件跳转，要么什么都不做
+    int taken = (instr->arg1.value.int_val != 0) == (instr->opcode == IR_IF);
+    if (taken)
+      emit_jump(lw, BC_JMP, 0, 0, label);
+    return;
+  }
+  int cond = read_truth(lw, instr->arg1, 0);
+  emit_jump(lw, instr->opcode == IR_IF ? BC_JT : BC_JF, cond, 0, label);
+}
+
+static void lower_return(Lowering *lw, IRInstruction *instr) {
+  if (instr->arg1.type == OPERAND_NONE) {
+    emit(lw, BC_RETZ, 0, 0, 0);
+    return;
+  }
+  emit(lw, BC_RET, read_operand(lw, instr->arg1, lw->func->return_type, 0), 0,
+       0);
+}
+
+/**
+ * 调用：result = call f。TAILCALL 直接返回被调函数的结果
+ */
+static void lower_call(Lowering *lw, IRInstruction *instr, int is_tail) {
+  int f = bc_find_function(lw->bc, instr->arg1.value.name);
+  if (f < 0) {
+    error(lw, "call to undefined function", instr->arg1.value.name);
+    return;
+  }
+  IRValueType type = lw->signatures[f].return_type;
+
+  if (is_tail) {
+    emit(lw, BC_CALL, lw->scratch, f, instr->arg_count);
+    if (type != lw->func->return_type)
+      emit(lw, type == IR_TYPE_INT ? BC_I2F : BC_F2I, lw->scratch, lw->scratch,
+           0);
+    emit(lw, BC_RET, lw->scratch, 0, 0);
+    return;
+  }
+  if (instr->result.type == OPERAND_NONE) {
+    emit(lw, BC_CALL, lw->scratch, f, instr->arg_count);
+  } else if (instr->result.vtype == type) {
+    int dst = result_slot(lw, instr->result);
+    emit(lw, BC_CALL, dst, f, instr->arg_count);
+    write_result(lw, instr->result, dst);
+  } else {
+    emit(lw, BC_CALL, lw->scratch, f, instr->arg_count);
+    store_converted(lw, instr->result, type, lw->scratch);
+  }
+}
+
+/**
+ * 每个 PARAM 要按被调函数的形参类型传递：先找到它属于哪个 CALL
+ * （嵌套调用的 PARAM 会交错出现，用一个栈匹配）
+ */
+static void match_params(Lowering *lw, int first, int last) {
+  IRInstruction *code = lw->program->instructions;
+  int length = last - first;
+  lw->first = first;
+  lw->param_types =
+      (IRValueType *)malloc(sizeof(IRValueType) * (length ? length : 1));
+  int *pending = (int *)malloc(sizeof(int) * (length ? length : 1));
+  int pending_count = 0;
+
+  for (int i = first; i < last; i++) {
+    IRInstruction *instr = &code[i];
+    if (instr->opcode == IR_PARAM) {
+      lw->param_types[i - first] = instr->arg1.vtype;
+      pending[pending_count++] = i - first;
+    } else if (instr->opcode == IR_CALL || instr->opcode == IR_TAILCALL) {
+      int n = instr->arg_count <= pending_count ? instr->arg_count
+                                                : pending_count;
+      int f = bc_find_function(lw->bc, instr->arg1.value.name);
+      for (int k = 0; k < n; k++) {
+        int rel = pending[pending_count - n + k];
+        if (f >= 0 && k < lw->signatures[f].param_count)
+          lw->param_types[rel] = lw->signatures[f].param_types[k];
+      }
+      pending_count -= n;
+    }
+  }
+  free(pending);
+}
+
+/**
+ * 比较 + 分支的超级指令：if (a cmp b) goto target（只处理整数比较，
+ * 浮点比较遇到 NaN 时不能靠取反条件来翻译 iffalse）
+ */
+static int lower_compare_branch(Lowering *lw, IRInstruction *compare,
+                                IRInstruction *branch) {
+  if (is_float(compare->arg1) || is_float(compare->arg2))
+    return 0;
+  IROpcode op = compare->opcode;
+  IROperand x = compare->arg1, y = compare->arg2;
+  if (!is_constant(y) && is_constant(x)) {
+    swap_operands(&x, &y);
+    op = swap_compare(op);
+  }
+  if (branch->opcode == IR_IFFALSE)
+    op = negate_compare(op);
+
+  int label = branch->result.value.label_id;
+  int a = read_operand(lw, x, IR_TYPE_INT, 0);
+  if (y.type == OPERAND_INT)
+    emit_jump(lw, (BCOpcode)(BC_JEQIK + (op - IR_EQ)), a, y.value.int_val,
+              label);
+  else
+    emit_jump(lw, (BCOpcode)(BC_JEQI + (op - IR_EQ)), a,
+              read_operand(lw, y, IR_TYPE_INT, 1), label);
+  return 1;
+}
+
+static void count_use(Lowering *lw, IROperand op) {
+  if (op.type != OPERAND_TEMP)
+    return;
+  int id = op.value.temp_id - lw->temp_base;
+  if (lw->use_owner[id] != lw->owner) {
+    lw->use_owner[id] = lw->owner;
+    lw->temp_uses[id] = 0;
+  }
+  lw->temp_uses[id]++;
+}
+
+/**
+ * instr 的结果是只读一次的临时变量，并且就是被下一条指令读取时，
+ * 返回下一条指令（可以合并），否则返回 NULL
+ */
+static IRInstruction *single_consumer(Lowering *lw, int index) {
+  IRInstruction *instr = &lw->program->instructions[index];
+  if (!lw->fuse || index + 1 >= lw->last ||
+      instr->result.type != OPERAND_TEMP)
+    return NULL;
+  int id = instr->result.value.temp_id;
+  IRInstruction *next = instr + 1;
+  if (next->arg1.type != OPERAND_TEMP || next->arg1.value.temp_id != id)
+    return NULL;
+  id -= lw->temp_base;
+  if (lw->use_owner[id] != lw->owner || lw->temp_uses[id] != 1)
+    return NULL;
+  return next;
+}
+
+static void lower_one(Lowering *lw, IRInstruction *instr, int index);
+
+/**
+ * 翻译下标为 index 的指令，返回用掉的 IR 指令条数（合并时是 2）
+ */
+static int lower_instruction(Lowering *lw, int index) {
+  IRInstruction *instr = &lw->program->instructions[index];
+  IRInstruction *next = single_consumer(lw, index);
+  if (next && is_compare(instr->opcode) &&
+      (next->opcode == IR_IF || next->opcode == IR_IFFALSE) &&
+      lower_compare_branch(lw, instr, next))
+    return 2;
+
+  // t = ...; x = t：直接写进 x 的槽位，省掉 MOV
+  if (next && next->opcode == IR_ASSIGN &&
+      next->result.type == OPERAND_VAR &&
+      next->result.vtype == instr->result.vtype &&
+      ((instr->opcode >= IR_ASSIGN && instr->opcode <= IR_NOT) ||
+       instr->opcode == IR_CALL)) {
+    IRInstruction forwarded = *instr;
+    forwarded.result = next->result;
+    lower_one(lw, &forwarded, index);
+    return 2;
+  }
+
+  lower_one(lw, instr, index);
+  return 1;
+}
+
+static void lower_one(Lowering *lw, IRInstruction *instr, int index) {
+  switch (instr->opcode) {
+  case IR_ASSIGN:
+    lower_assign(lw, instr);
+    break;
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_DIV:
+  case IR_MOD:
+  case IR_SHL:
+  case IR_SHR:
+  case IR_USHR:
+  case IR_BAND:
+  case IR_EQ:
+  case IR_NE:
+  case IR_LT:
+  case IR_GT:
+  case IR_LE:
+  case IR_GE:
+    lower_binary(lw, instr);
+    break;
+  case IR_AND:
+  case IR_OR:
+    lower_logical(lw, instr);
+    break;
+  case IR_NEG:
+  case IR_NOT:
+    lower_unary(lw, instr);
+    break;
+  case IR_LABEL:
+    lw->label_offsets[instr->result.value.label_id] = lw->bc->count;
+    break;
+  case IR_GOTO:
+    emit_jump(lw, BC_JMP, 0, 0, instr->result.value.label_id);
+    break;
+  case IR_IF:
+  case IR_IFFALSE:
+    lower_branch(lw, instr);
+    break;
+  case IR_PARAM:
+    emit(lw, BC_PARAM,
+         read_operand(lw, instr->arg1, lw->param_types[index - lw->first], 0),
+         0, 0);
+    break;
+  case IR_CALL:
+    lower_call(lw, instr, 0);
+    break;
+  case IR_TAILCALL:
+    lower_call(lw, instr, 1);
+    break;
+  case IR_RETURN:
+    lower_return(lw, instr);
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+ * 翻译 [first, last) 里的指令作为 func 的函数体；形参已经占了前几个槽位
+ */
+/**
+ * 临时变量编号是整个程序的，槽位表只覆盖 [first, last) 里出现的范围；
+ * 表只在更大的函数出现时重新分配，旧内容靠 owner 区分
+ */
+static void reserve_temps(Lowering *lw, int first, int last) {
+  IRInstruction *code = lw->program->instructions;
+  int base = 0, limit = 0;
+  for (int i = first; i < last; i++) {
+    IROperand *ops[3] = {&code[i].result, &code[i].arg1, &code[i].arg2};
+    for (int k = 0; k < 3; k++) {
+      if (ops[k]->type != OPERAND_TEMP)
+        continue;
+      int id = ops[k]->value.temp_id;
+      if (limit == 0 || id < base)
+        base = id;
+      if (id + 1 > limit)
+        limit = id + 1;
+    }
+  }
+  lw->temp_base = base;
+  int temps = limit - base;
+  if (temps <= lw->temp_capacity)
+    return;
+  free(lw->temp_slots);
+  free(lw->temp_owner);
+  free(lw->temp_uses);
+  free(lw->use_owner);
+  lw->temp_capacity = temps;
+  lw->temp_slots = (int *)calloc(temps, sizeof(int));
+  lw->temp_owner = (int *)calloc(temps, sizeof(int));
+  lw->temp_uses = (int *)calloc(temps, sizeof(int));
+  lw->use_owner = (int *)calloc(temps, sizeof(int));
+}
+
+static void lower_body(Lowering *lw, BCFunction *func, int first, int last) {
+  lw->func = func;
+  lw->owner++;
+  lw->slot_count = 0;
+  func->entry = lw->bc->count;
+  reserve_temps(lw, first, last);
+
+  lw->var_capacity = 16;
+  while (lw->var_capacity < 2 * (last - first + func->param_count))
+    lw->var_capacity *= 2;
+  lw->vars = (VarEntry *)calloc(lw->var_capacity, sizeof(VarEntry));
+
+  // 形参：第 i 个 ARG 占第 i 个槽位
+  IRInstruction *code = lw->program->instructions;
+  for (int i = first; i < last && code[i].opcode == IR_ARG; i++)
+    var_slot(lw, code[i].result.value.name);
+  lw->slot_count = func->param_count;
+  lw->scratch = lw->slot_count;
+  lw->slot_count += SCRATCH_SLOTS;
+
+  match_params(lw, first, last);
+  lw->last = last;
+  for (int i = first; i < last; i++) {
+    count_use(lw, code[i].arg1);
+    count_use(lw, code[i].arg2);
+  }
+  for (int i = first; i < last;)
+    i += lower_instruction(lw, i);
+  emit(lw, BC_RETZ, 0, 0, 0);
+
+  func->frame_size = lw->slot_count;
+  free(lw->param_types);
+  free(lw->vars);
+  lw->param_types = NULL;
+  lw->vars = NULL;
+}
+
+/**
+ * 函数之外的指令（全局变量初始化）拼成一个单独的函数，运行 main 之前执行
+ */
+static void lower_init(Lowering *lw) {
+  IRProgram *program = lw->program;
+  IRInstruction *saved = program->instructions;
+  int count = 0;
+  for (int i = 0, in_function = 0; i < program->count; i++) {
+    IROpcode op = program->instructions[i].opcode;
+    if (op == IR_FUNC_BEGIN)
+      in_function = 1;
+    else if (!in_function && op != IR_NOP && op != IR_LABEL)
+      count++;
+    else if (op == IR_FUNC_END)
+      in_function = 0;
+  }
+  if (count == 0)
+    return;
+
+  IRInstruction *init =
+      (IRInstruction *)malloc(sizeof(IRInstruction) * count);
+  count = 0;
+  for (int i = 0, in_function = 0; i < program->count; i++) {
+    IROpcode op = saved[i].opcode;
+    if (op == IR_FUNC_BEGIN)
+      in_function = 1;
+    else if (!in_function && op != IR_NOP && op != IR_LABEL)
+      init[count++] = saved[i];
+    else if (op == IR_FUNC_END)
+      in_function = 0;
+  }
+
+  lw->bc->init_function = lw->bc->func_count;
+  BCFunction *func = add_function(lw, "<init>", IR_TYPE_INT, 0);
+  program->instructions = init;
+  lower_body(lw, func, 0, count);
+  program->instructions = saved;
+  free(init);
+}
+
+BCProgram *bc_compile(IRProgram *program, int fuse) {
+  Lowering lw;
+  memset(&lw, 0, sizeof(lw));
+  lw.program = program;
+  lw.fuse = fuse;
+  lw.bc = (BCProgram *)calloc(1, sizeof(BCProgram));
+  lw.bc->init_function = -1;
+
+  int labels = program->label_counter ? program->label_counter : 1;
+  lw.label_offsets = (int *)malloc(sizeof(int) * labels);
+  for (int i = 0; i < labels; i++)
+    lw.label_offsets[i] = -1;
+  name_map_init(&lw.bc->function_index, 0);
+  name_map_init(&lw.bc->global_index, 0);
+
+  // 先登记所有函数，调用可以指向后面定义的函数
+  IRFunction *functions = NULL;
+  int count = ir_collect_functions(program, &functions);
+  for (int f = 0; f < count; f++) {
+    IRInstruction *begin = &program->instructions[functions[f].begin];
+    add_function(&lw, functions[f].name, begin->result.vtype,
+                 functions[f].param_count);
+    for (int i = 0; i < functions[f].param_count; i++)
+      lw.signatures[f].param_types[i] =
+          program->instructions[functions[f].begin + 1 + i].result.vtype;
+  }
+  for (int f = 0; f < count; f++)
+    lower_body(&lw, &lw.bc->functions[f], functions[f].begin + 1,
+               functions[f].end);
+  lower_init(&lw);
+  free(functions);
+
+  for (int i = 0; i < lw.fixup_count; i++) {
+    int offset = lw.label_offsets[lw.fixups[i].label];
+    if (offset < 0)
+      error(&lw, "jump to undefined label", NULL);
+    lw.bc->code[lw.fixups[i].pos] = offset;
+  }
+
+  for (int f = 0; f < lw.bc->func_count; f++)
+    free(lw.signatures[f].param_types);
+  free(lw.signatures);
+  free(lw.label_offsets);
+  free(lw.fixups);
+  free(lw.temp_slots);
+  free(lw.temp_owner);
+  free(lw.temp_uses);
+  free(lw.use_owner);
+
+  if (lw.errors > 0) {
+    bc_free(lw.bc);
+    return NULL;
+  }
+  return lw.bc;
+}
+
+void bc_free(BCProgram *bc) {
+  if (!bc)
+    return;
+  for (int f = 0; f < bc->func_count; f++)
+    free(bc->functions[f].name);
+  for (int i = 0; i < bc->global_count; i++)
+    free(bc->global_names[i]);
+  free(bc->code);
+  free(bc->floats);
+  free(bc->functions);
+  free(bc->global_names);
+  free(bc->global_types);
+  name_map_free(&bc->function_index);
+  name_map_free(&bc->global_index);
+  free(bc);
+}
+
+// ==================== 打印 ====================
+
+static void print_instruction(const BCProgram *bc, int pc) {
+  BCOpcode op = (BCOpcode)bc->code[pc];
+  const char *format = bc_operand_formats[op];
+  printf("  %04d  %-7s", pc, bc_opcode_names[op]);
+
+  for (int i = 0; format[i]; i++) {
+    int32_t value = bc->code[pc + 1 + i];
+    printf("%s", i ? ", " : "");
+    switch (format[i]) {
+    case 's': printf("s%d", value); break;
+    case 'k': printf("%g", bc->floats[value]); break;
+    case 'g': printf("%s", bc->global_names[value]); break;
+    case 'f': printf("%s", bc->functions[value].name); break;
+    case 't': printf("@%d", value); break;
+    default: printf("%d", value); break;
+    }
+  }
+  printf("\n");
+}
+
+void bc_print(const BCProgram *bc) {
+  for (int f = 0; f < bc->func_count; f++) {
+    const BCFunction *func = &bc->functions[f];
+    int end = f + 1 < bc->func_count ? bc->functions[f + 1].entry : bc->count;
+    printf("%s: (params %d, frame %d)\n", func->name, func->param_count,
+           func->frame_size);
+    for (int pc = func->entry; pc < end; pc += 1 + bc_operand_count[bc->code[pc]])
+      print_instruction(bc, pc);
+  }
+}
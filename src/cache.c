@@ -0,0 +1,636 @@
+/**
+ * cache.c - 磁盘上的编译缓存实现
+ */
+
+#define _DEFAULT_SOURCE // getpid、opendir
+
+#include "../include/cache.h"
+#include "../include/diag.h"
+#include "../include/hash.h"
+#include "../include/irbin.h"
+#include "../include/memory.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CACHE_SUPPORTED 1
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#else
+#define CACHE_SUPPORTED 0
+#endif
+
+CacheKey cache_key(const char *source, size_t length, const char *fingerprint) {
+  // 格式版本和选项决定种子，两个种子得到 128 位的键
+  char salt[256];
+  snprintf(salt, sizeof(salt), "v%d %s", CACHE_FORMAT_VERSION, fingerprint);
+  uint64_t seed = hash64(salt, strlen(salt), 0);
+
+  CacheKey key;
+  key.high = hash64(source, length, seed);
+  key.low = hash64(source, length, ~seed);
+  return key;
+}
+
+void cache_key_string(CacheKey key, char out[33]) {
+  snprintf(out, 33, "%016llx%016llx", (unsigned long long)key.high,
+           (unsigned long long)key.low);
+}
+
+// ========== 文件 ==========
+
+static char *path_join(const char *dir, const char *name) {
+  size_t length = strlen(dir) + strlen(name) + 2;
+  char *path = (char *)malloc(length);
+  snprintf(path, length, "%s/%s", dir, name);
+  return path;
+}
+
+static char *entry_path(const Cache *cache, CacheKey key) {
+  char name[40];
+  cache_key_string(key, name);
+  strcat(name, ".irb");
+  return path_join(cache->dir, name);
+}
+
+#if CACHE_SUPPORTED
+
+// 并行编译时各线程共用一个 Cache：查找和写入（包括统计和淘汰）串行执行
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * 原子写入：写到同目录下的临时文件，完整写完后 rename 到 path
+ */
+static int write_atomic(const char *path, const void *data, size_t size) {
+  size_t length = strlen(path) + 32;
+  char *temp = (char *)malloc(length);
+  snprintf(temp, length, "%s.%ld.tmp", path, (long)getpid());
+
+  FILE *file = fopen(temp, "wb");
+  int status = file ? 0 : 1;
+  if (file) {
+    if (fwrite(data, 1, size, file) != size)
+      status = 1;
+    if (fclose(file) != 0)
+      status = 1;
+  }
+  if (status == 0 && rename(temp, path) != 0)
+    status = 1;
+  if (status != 0)
+    remove(temp);
+  free(temp);
+  return status;
+}
+
+typedef struct {
+  char *name;
+  long long size;
+  time_t mtime;
+} Entry;
+
+// <键>.irb 或 <模块键>.fns
+static int is_entry_name(const char *name) {
+  size_t length = strlen(name);
+  return length == 36 &&
+         (strcmp(name + 32, ".irb") == 0 || strcmp(name + 32, ".fns") == 0);
+}
+
+/**
+ * 列出缓存目录里的条目，返回数量；*total 是总字节数
+ */
+static int scan_entries(const Cache *cache, Entry **entries, long long *total) {
+  *entries = NULL;
+  *total = 0;
+  DIR *dir = opendir(cache->dir);
+  if (!dir)
+    return 0;
+
+  int count = 0, capacity = 0;
+  struct dirent *ent;
+  while ((ent = readdir(dir)) != NULL) {
+    if (!is_entry_name(ent->d_name))
+      continue;
+    char *path = path_join(cache->dir, ent->d_name);
+    struct stat st;
+    int found = stat(path, &st) == 0;
+    free(path);
+    if (!found)
+      continue; // 被别的进程淘汰了
+
+    if (count >= capacity) {
+      capacity = capacity == 0 ? 64 : capacity * 2;
+      *entries = (Entry *)realloc(*entries, sizeof(Entry) * capacity);
+    }
+    Entry *entry = &(*entries)[count++];
+    size_t length = strlen(ent->d_name) + 1;
+    entry->name = (char *)malloc(length);
+    memcpy(entry->name, ent->d_name, length);
+    entry->size = (long long)st.st_size;
+    entry->mtime = st.st_mtime;
+    *total += entry->size;
+  }
+  closedir(dir);
+  return count;
+}
+
+static void free_entries(Entry *entries, int count) {
+  for (int i = 0; i < count; i++)
+    free(entries[i].name);
+  free(entries);
+}
+
+// 最久没用的在前
+static int compare_entries(const void *a, const void *b) {
+  const Entry *x = (const Entry *)a;
+  const Entry *y = (const Entry *)b;
+  if (x->mtime != y->mtime)
+    return x->mtime < y->mtime ? -1 : 1;
+  return strcmp(x->name, y->name);
+}
+
+/**
+ * 总大小超过上限时按 LRU 删除条目
+ */
+static void evict(Cache *cache) {
+  Entry *entries;
+  long long total;
+  int count = scan_entries(cache, &entries, &total);
+  if (total > cache->limit) {
+    qsort(entries, count, sizeof(Entry), compare_entries);
+    for (int i = 0; i < count && total > cache->limit; i++) {
+      char *path = path_join(cache->dir, entries[i].name);
+      if (remove(path) == 0) {
+        total -= entries[i].size;
+        cache->stats.evictions++;
+      }
+      free(path);
+    }
+  }
+  free_entries(entries, count);
+}
+
+#endif // CACHE_SUPPORTED
+
+// ========== 缓存 ==========
+
+Cache *cache_open(const char *dir, long long limit) {
+#if CACHE_SUPPORTED
+  if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+    diag_printf("Error: Cannot create cache directory '%s'\n", dir);
+    return NULL;
+  }
+  struct stat st;
+  if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+    diag_printf("Error: '%s' is not a directory\n", dir);
+    return NULL;
+  }
+
+  Cache *cache = (Cache *)calloc(1, sizeof(Cache));
+  size_t length = strlen(dir) + 1;
+  cache->dir = (char *)malloc(length);
+  memcpy(cache->dir, dir, length);
+  cache->limit = limit;
+  return cache;
+#else
+  (void)dir;
+  (void)limit;
+  diag_printf("Error: The compilation cache is not supported on this "
+              "platform\n");
+  return NULL;
+#endif
+}
+
+static const char *stat_names[] = {
+    "hits",          "misses",        "stores",         "evictions",
+    "bytes_read",    "bytes_written", "function_hits",  "function_misses"};
+
+static uint64_t *stat_field(CacheStats *stats, int index) {
+  uint64_t *fields[] = {&stats->hits,          &stats->misses,
+                        &stats->stores,        &stats->evictions,
+                        &stats->bytes_read,    &stats->bytes_written,
+                        &stats->function_hits, &stats->function_misses};
+  return fields[index];
+}
+
+#define STAT_COUNT (int)(sizeof(stat_names) / sizeof(stat_names[0]))
+
+// 读 <dir>/stats 里累计的统计（没有时全为 0）
+static CacheStats read_totals(const Cache *cache) {
+  CacheStats totals;
+  memset(&totals, 0, sizeof(totals));
+  char *path = path_join(cache->dir, "stats");
+  FILE *file = fopen(path, "r");
+  free(path);
+  if (!file)
+    return totals;
+
+  char name[32];
+  unsigned long long value;
+  while (fscanf(file, "%31s %llu", name, &value) == 2) {
+    for (int i = 0; i < STAT_COUNT; i++) {
+      if (strcmp(name, stat_names[i]) == 0)
+        *stat_field(&totals, i) = value;
+    }
+  }
+  fclose(file);
+  return totals;
+}
+
+static CacheStats add_stats(CacheStats a, CacheStats b) {
+  for (int i = 0; i < STAT_COUNT; i++)
+    *stat_field(&a, i) += *stat_field(&b, i);
+  return a;
+}
+
+void cache_close(Cache *cache) {
+  if (!cache)
+    return;
+#if CACHE_SUPPORTED
+  if (cache->stats.hits || cache->stats.misses ||
+      cache->stats.function_hits || cache->stats.function_misses) {
+    // 并发的进程可能同时更新，丢掉一次累加是可以接受的
+    CacheStats totals = add_stats(read_totals(cache), cache->stats);
+    char text[512];
+    size_t length = 0;
+    for (int i = 0; i < STAT_COUNT; i++)
+      length += snprintf(text + length, sizeof(text) - length, "%s %llu\n",
+                         stat_names[i],
+                         (unsigned long long)*stat_field(&totals, i));
+    char *path = path_join(cache->dir, "stats");
+    write_atomic(path, text, length);
+    free(path);
+  }
+#endif
+  free(cache->dir);
+  free(cache);
+}
+
+IRProgram *cache_load(Cache *cache, CacheKey key) {
+#if CACHE_SUPPORTED
+  pthread_mutex_lock(&cache_lock);
+#endif
+  char *path = entry_path(cache, key);
+  IRImage *image = irbin_open(path);
+  IRProgram *program = NULL;
+  if (image && irbin_verify(image))
+    program = irbin_to_program(image);
+
+  if (program) {
+    cache->stats.hits++;
+    cache->stats.bytes_read += image->size;
+#if CACHE_SUPPORTED
+    utime(path, NULL); // 最近使用，推迟淘汰
+#endif
+  } else {
+    cache->stats.misses++;
+    remove(path); // 损坏的条目（不存在时什么也不做）
+  }
+  irbin_close(image);
+  free(path);
+#if CACHE_SUPPORTED
+  pthread_mutex_unlock(&cache_lock);
+#endif
+  return program;
+}
+
+int cache_store(Cache *cache, CacheKey key, const IRProgram *program) {
+#if CACHE_SUPPORTED
+  size_t size;
+  unsigned char *image = irbin_encode(program, &size);
+  if (!image)
+    return 1;
+  pthread_mutex_lock(&cache_lock);
+  char *path = entry_path(cache, key);
+  int status = write_atomic(path, image, size);
+  free(path);
+  if (status == 0) {
+    cache->stats.stores++;
+    cache->stats.bytes_written += size;
+    evict(cache);
+  }
+  pthread_mutex_unlock(&cache_lock);
+  free(image);
+  return status;
+#else
+  (void)cache;
+  (void)key;
+  (void)program;
+  return 1;
+#endif
+}
+
+// ========== 按模块打包的函数条目 ==========
+
+#define PACK_MAGIC 0x50464343u // "CCFP"
+#define PACK_ALIGN 8           // 二进制 IR 要 8 字节对齐
+#define PACK_MIN_SPARE 16      // 写回时至少保留这么多没用到的条目
+
+typedef struct {
+  uint32_t magic;
+  uint32_t count;
+} PackHeader;
+
+// 文件里的索引：键和二进制 IR 的位置
+typedef struct {
+  uint64_t high;
+  uint64_t low;
+  uint64_t offset;
+  uint64_t size;
+} PackIndex;
+
+typedef struct {
+  CacheKey key;
+  const unsigned char *image; // 在 data 里，或者等于 owned
+  size_t size;
+  unsigned char *owned; // 这次新写入的条目
+  int used;             // 这次编译用到了
+} PackEntry;
+
+struct CachePack {
+  Cache *cache;
+  char *path;
+  unsigned char *data; // 读入的整个文件
+  PackEntry *entries;
+  int count;
+  int capacity;
+  int *order; // 用到的条目按使用的顺序
+  int used;
+  int *slots; // 键 → entries 下标（开放寻址，-1 为空），容量是 2 的幂
+  int mask;
+  int stored; // 新写入的条目数
+};
+
+static int same_key(CacheKey a, CacheKey b) {
+  return a.high == b.high && a.low == b.low;
+}
+
+// 键本身就是哈希，直接取低位
+static int *pack_slot(const CachePack *pack, CacheKey key) {
+  size_t slot = (size_t)key.low & (size_t)pack->mask;
+  while (pack->slots[slot] >= 0 &&
+         !same_key(pack->entries[pack->slots[slot]].key, key))
+    slot = (slot + 1) & (size_t)pack->mask;
+  return &pack->slots[slot];
+}
+
+static void pack_rehash(CachePack *pack, int capacity) {
+  free(pack->slots);
+  pack->mask = capacity - 1;
+  pack->slots = (int *)malloc(sizeof(int) * capacity);
+  for (int i = 0; i < capacity; i++)
+    pack->slots[i] = -1;
+  for (int i = 0; i < pack->count; i++)
+    *pack_slot(pack, pack->entries[i].key) = i;
+}
+
+/**
+ * 加入一个条目（键已经存在时替换它），返回下标
+ */
+static int pack_add(CachePack *pack, CacheKey key, const unsigned char *image,
+                    size_t size, unsigned char *owned) {
+  int *slot = pack_slot(pack, key);
+  if (*slot >= 0) {
+    PackEntry *entry = &pack->entries[*slot];
+    free(entry->owned);
+    entry->image = image;
+    entry->size = size;
+    entry->owned = owned;
+    return *slot;
+  }
+  if (pack->count >= pack->capacity) {
+    pack->capacity = pack->capacity == 0 ? 64 : pack->capacity * 2;
+    pack->entries = (PackEntry *)realloc(pack->entries,
+                                         sizeof(PackEntry) * pack->capacity);
+    pack->order =
+        (int *)realloc(pack->order, sizeof(int) * pack->capacity);
+  }
+  int index = pack->count++;
+  PackEntry *entry = &pack->entries[index];
+  entry->key = key;
+  entry->image = image;
+  entry->size = size;
+  entry->owned = owned;
+  entry->used = 0;
+  if ((pack->count + 1) * 2 > pack->mask + 1)
+    pack_rehash(pack, (pack->mask + 1) * 2);
+  else
+    *slot = index;
+  return index;
+}
+
+static void pack_use(CachePack *pack, int index) {
+  if (!pack->entries[index].used) {
+    pack->entries[index].used = 1;
+    pack->order[pack->used++] = index;
+  }
+}
+
+/**
+ * 读入 .fns 文件并建立索引；格式不对时当作空的（写回时覆盖）
+ */
+static void pack_read(CachePack *pack) {
+  FILE *file = fopen(pack->path, "rb");
+  if (!file)
+    return;
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if (length < (long)sizeof(PackHeader)) {
+    fclose(file);
+    return;
+  }
+  // malloc 的对齐满足 PACK_ALIGN
+  pack->data = (unsigned char *)malloc((size_t)length);
+  size_t size = fread(pack->data, 1, (size_t)length, file);
+  fclose(file);
+
+  PackHeader header;
+  memcpy(&header, pack->data, sizeof(header));
+  uint64_t index_end =
+      sizeof(PackHeader) + (uint64_t)header.count * sizeof(PackIndex);
+  if (size != (size_t)length || header.magic != PACK_MAGIC ||
+      index_end > size)
+    return;
+  for (uint32_t i = 0; i < header.count; i++) {
+    PackIndex index;
+    memcpy(&index, pack->data + sizeof(PackHeader) + i * sizeof(PackIndex),
+           sizeof(index));
+    if (index.offset < index_end || index.offset % PACK_ALIGN != 0 ||
+        index.offset > size || index.size > size - index.offset)
+      continue;
+    CacheKey key = {index.high, index.low};
+    if (*pack_slot(pack, key) < 0)
+      pack_add(pack, key, pack->data + index.offset, (size_t)index.size, NULL);
+  }
+  pack->cache->stats.bytes_read += size;
+#if CACHE_SUPPORTED
+  utime(pack->path, NULL); // 最近使用，推迟淘汰
+#endif
+}
+
+CachePack *cache_pack_open(Cache *cache, const char *module) {
+  CachePack *pack = (CachePack *)calloc(1, sizeof(CachePack));
+  pack->cache = cache;
+  char name[40];
+  cache_key_string(cache_key(module, strlen(module), "module"), name);
+  strcat(name, ".fns");
+  pack->path = path_join(cache->dir, name);
+  pack_rehash(pack, 64);
+#if CACHE_SUPPORTED
+  pthread_mutex_lock(&cache_lock);
+#endif
+  pack_read(pack);
+#if CACHE_SUPPORTED
+  pthread_mutex_unlock(&cache_lock);
+#endif
+  return pack;
+}
+
+IRProgram *cache_pack_load(CachePack *pack, CacheKey key) {
+  int index = *pack_slot(pack, key);
+  IRProgram *program = NULL;
+  if (index >= 0) {
+    PackEntry *entry = &pack->entries[index];
+    IRImage *image = irbin_view(entry->image, entry->size);
+    if (image && irbin_verify(image))
+      program = irbin_to_program(image);
+    irbin_close(image);
+    if (program)
+      pack_use(pack, index);
+  }
+#if CACHE_SUPPORTED
+  pthread_mutex_lock(&cache_lock);
+#endif
+  if (program)
+    pack->cache->stats.function_hits++;
+  else
+    pack->cache->stats.function_misses++;
+#if CACHE_SUPPORTED
+  pthread_mutex_unlock(&cache_lock);
+#endif
+  return program;
+}
+
+void cache_pack_store(CachePack *pack, CacheKey key,
+                      const IRProgram *program) {
+  size_t size;
+  unsigned char *image = irbin_encode(program, &size);
+  if (!image)
+    return;
+  pack_use(pack, pack_add(pack, key, image, size, image));
+  pack->stored++;
+#if CACHE_SUPPORTED
+  pthread_mutex_lock(&cache_lock);
+#endif
+  pack->cache->stats.stores++;
+#if CACHE_SUPPORTED
+  pthread_mutex_unlock(&cache_lock);
+#endif
+}
+
+/**
+ * 要写回的条目：用到的按使用顺序，然后是没用到的（文件里的顺序，
+ * 最近不用的在前），最多和用到的一样多（至少 PACK_MIN_SPARE 个）
+ */
+static int pack_select(const CachePack *pack, int *selected) {
+  int count = 0;
+  for (int i = 0; i < pack->used; i++)
+    selected[count++] = pack->order[i];
+  int spare = pack->used > PACK_MIN_SPARE ? pack->used : PACK_MIN_SPARE;
+  for (int i = 0; i < pack->count && spare > 0; i++) {
+    if (!pack->entries[i].used) {
+      selected[count++] = i;
+      spare--;
+    }
+  }
+  return count;
+}
+
+static int pack_write(CachePack *pack) {
+  int *selected = (int *)malloc(sizeof(int) * (pack->count + 1));
+  int count = pack_select(pack, selected);
+
+  size_t size = sizeof(PackHeader) + (size_t)count * sizeof(PackIndex);
+  for (int i = 0; i < count; i++)
+    size += (pack->entries[selected[i]].size + PACK_ALIGN - 1) /
+            PACK_ALIGN * PACK_ALIGN;
+  unsigned char *data = (unsigned char *)calloc(1, size);
+  PackHeader header = {PACK_MAGIC, (uint32_t)count};
+  memcpy(data, &header, sizeof(header));
+  size_t offset = sizeof(PackHeader) + (size_t)count * sizeof(PackIndex);
+  for (int i = 0; i < count; i++) {
+    const PackEntry *entry = &pack->entries[selected[i]];
+    PackIndex index = {entry->key.high, entry->key.low, offset, entry->size};
+    memcpy(data + sizeof(PackHeader) + i * sizeof(PackIndex), &index,
+           sizeof(index));
+    memcpy(data + offset, entry->image, entry->size);
+    offset += (entry->size + PACK_ALIGN - 1) / PACK_ALIGN * PACK_ALIGN;
+  }
+  free(selected);
+
+  int status = 1;
+#if CACHE_SUPPORTED
+  pthread_mutex_lock(&cache_lock);
+  status = write_atomic(pack->path, data, size);
+  if (status == 0)
+    pack->cache->stats.bytes_written += size;
+  pthread_mutex_unlock(&cache_lock);
+#endif
+  free(data);
+  return status;
+}
+
+int cache_pack_close(CachePack *pack) {
+  if (!pack)
+    return 0;
+  int status = pack->stored > 0 ? pack_write(pack) : 0;
+  for (int i = 0; i < pack->count; i++)
+    free(pack->entries[i].owned);
+  free(pack->entries);
+  free(pack->order);
+  free(pack->slots);
+  free(pack->data);
+  free(pack->path);
+  free(pack);
+  return status;
+}
+
+static void print_counts(const char *label, const CacheStats *stats) {
+  uint64_t lookups = stats->hits + stats->misses;
+  printf("  %-9s %llu hits, %llu misses, %llu stores, %llu evictions", label,
+         (unsigned long long)stats->hits, (unsigned long long)stats->misses,
+         (unsigned long long)stats->stores,
+         (unsigned long long)stats->evictions);
+  if (lookups)
+    printf(" (%.1f%% hit rate)", 100.0 * stats->hits / lookups);
+  printf("\n");
+  if (stats->function_hits || stats->function_misses)
+    printf("  %-9s %llu functions reused, %llu recompiled\n", "",
+           (unsigned long long)stats->function_hits,
+           (unsigned long long)stats->function_misses);
+}
+
+void cache_print_stats(const Cache *cache) {
+  int count = 0;
+  long long total = 0;
+#if CACHE_SUPPORTED
+  Entry *entries;
+  count = scan_entries(cache, &entries, &total);
+  free_entries(entries, count);
+#endif
+
+  printf("Cache %s: %d entries, %.1f KB of %.1f KB\n", cache->dir, count,
+         total / 1024.0, cache->limit / 1024.0);
+  print_counts("this run:", &cache->stats);
+  CacheStats totals = add_stats(read_totals(cache), cache->stats);
+  print_counts("total:", &totals);
+  printf("  read %.1f KB, wrote %.1f KB this run\n",
+         cache->stats.bytes_read / 1024.0,
+         cache->stats.bytes_written / 1024.0);
+}
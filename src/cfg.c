@@ -0,0 +1,188 @@
+/**
+ * cfg.c - 控制流图实现
+ */
+
+#include "../include/cfg.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int ends_block(IROpcode op) {
+  return op == IR_GOTO || op == IR_IF || op == IR_IFFALSE ||
+         op == IR_RETURN || op == IR_TAILCALL;
+}
+
+static void add_edge(CFG *cfg, int from, int to) {
+  BasicBlock *src = &cfg->blocks[from];
+  for (int i = 0; i < src->succ_count; i++) {
+    if (src->succs[i] == to)
+      return; // if x goto L; L: 只算一条边
+  }
+  src->succs[src->succ_count++] = to;
+
+  BasicBlock *dst = &cfg->blocks[to];
+  if (dst->pred_count >= dst->pred_capacity) {
+    dst->pred_capacity = dst->pred_capacity == 0 ? 2 : dst->pred_capacity * 2;
+    dst->preds = (int *)realloc(dst->preds, sizeof(int) * dst->pred_capacity);
+  }
+  dst->preds[dst->pred_count++] = from;
+}
+
+/**
+ * 从入口做深度优先搜索，得到逆后序
+ *
+ * 用显式栈代替递归：生成的大函数可能有上万个块。
+ */
+static void compute_rpo(CFG *cfg) {
+  int n = cfg->block_count;
+  cfg->rpo = (int *)malloc(sizeof(int) * (n + 1));
+  cfg->rpo_count = 0;
+  if (n == 0)
+    return;
+
+  char *visited = (char *)calloc(n, 1);
+  int *stack = (int *)malloc(sizeof(int) * (n + 1));
+  int *next_succ = (int *)calloc(n, sizeof(int));
+  int *postorder = (int *)malloc(sizeof(int) * (n + 1));
+  int post_count = 0;
+  int top = 0;
+
+  stack[top++] = 0;
+  visited[0] = 1;
+  while (top > 0) {
+    int b = stack[top - 1];
+    BasicBlock *block = &cfg->blocks[b];
+    if (next_succ[b] < block->succ_count) {
+      int s = block->succs[next_succ[b]++];
+      if (!visited[s]) {
+        visited[s] = 1;
+        stack[top++] = s;
+      }
+    } else {
+      postorder[post_count++] = b;
+      top--;
+    }
+  }
+
+  for (int i = post_count - 1; i >= 0; i--)
+    cfg->rpo[cfg->rpo_count++] = postorder[i];
+
+  free(visited);
+  free(stack);
+  free(next_succ);
+  free(postorder);
+}
+
+CFG *cfg_build(IRProgram *program, IRFunction *func) {
+  CFG *cfg = (CFG *)calloc(1, sizeof(CFG));
+  cfg->program = program;
+  cfg->func = *func;
+
+  IRInstruction *code = program->instructions;
+  int first = func->begin + 1;
+  int last = func->end; // FUNC_END 不属于任何块
+
+  // 1. 标记 leader
+  int length = last - first;
+  char *leader = (char *)calloc(length + 1, 1);
+  if (length > 0)
+    leader[0] = 1;
+  for (int i = first; i < last; i++) {
+    if (code[i].opcode == IR_LABEL)
+      leader[i - first] = 1;
+    if (ends_block(code[i].opcode) && i + 1 < last)
+      leader[i + 1 - first] = 1;
+  }
+
+  // 2. 切分基本块
+  int block_count = 0;
+  for (int i = 0; i < length; i++)
+    block_count += leader[i];
+  cfg->blocks = (BasicBlock *)calloc(block_count ? block_count : 1,
+                                     sizeof(BasicBlock));
+  cfg->block_count = block_count;
+
+  // 标签 → 所在的块；表只覆盖这个函数里定义的标签编号 [base, limit)
+  int base = -1, limit = 0;
+  for (int i = first; i < last; i++) {
+    if (code[i].opcode != IR_LABEL)
+      continue;
+    int label = code[i].result.value.label_id;
+    if (base < 0 || label < base)
+      base = label;
+    if (label >= limit)
+      limit = label + 1;
+  }
+  if (base < 0)
+    base = 0;
+  int *label_block = (int *)malloc(sizeof(int) * (limit - base + 1));
+  for (int i = 0; i < limit - base; i++)
+    label_block[i] = -1;
+
+  int b = -1;
+  for (int i = first; i < last; i++) {
+    if (leader[i - first]) {
+      b++;
+      cfg->blocks[b].start = i;
+    }
+    cfg->blocks[b].end = i + 1;
+    if (code[i].opcode == IR_LABEL)
+      label_block[code[i].result.value.label_id - base] = b;
+  }
+
+  // 3. 连接边
+  for (b = 0; b < block_count; b++) {
+    IRInstruction *tail = &code[cfg->blocks[b].end - 1];
+    int falls_through = b + 1 < block_count;
+
+    switch (tail->opcode) {
+    case IR_GOTO:
+      falls_through = 0;
+      /* fall through */
+    case IR_IF:
+    case IR_IFFALSE: {
+      int label = tail->result.value.label_id;
+      if (label >= base && label < limit && label_block[label - base] >= 0)
+        add_edge(cfg, b, label_block[label - base]);
+      break;
+    }
+    case IR_RETURN:
+    case IR_TAILCALL:
+      falls_through = 0;
+      break;
+    default:
+      break;
+    }
+
+    if (falls_through)
+      add_edge(cfg, b, b + 1);
+  }
+
+  free(leader);
+  free(label_block);
+
+  compute_rpo(cfg);
+  return cfg;
+}
+
+void cfg_free(CFG *cfg) {
+  if (!cfg)
+    return;
+  for (int i = 0; i < cfg->block_count; i++)
+    free(cfg->blocks[i].preds);
+  free(cfg->blocks);
+  free(cfg->rpo);
+  free(cfg);
+}
+
+void cfg_print(CFG *cfg) {
+  printf("CFG of %s (%d blocks):\n", cfg->func.name, cfg->block_count);
+  for (int b = 0; b < cfg->block_count; b++) {
+    BasicBlock *block = &cfg->blocks[b];
+    printf("  B%d [%d, %d) ->", b, block->start, block->end);
+    for (int i = 0; i < block->succ_count; i++)
+      printf(" B%d", block->succs[i]);
+    printf("\n");
+  }
+}
@@ -0,0 +1,1184 @@
+/**
+ * codegen.c - x86-64 代码生成实现
+ */
+
+#include "../include/codegen.h"
+#include "../include/diag.h"
+#include "../include/memory.h"
+#include "../include/object.h"
+#include "../include/regalloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 代码生成器自己使用的临时寄存器（不参与寄存器分配）
+#define SCRATCH REG_RAX
+#define SCRATCH2 REG_R11
+#define FSCRATCH REG_XMM0
+#define FSCRATCH2 (X86Reg)(REG_XMM0 + 1)
+
+/**
+ * 被调用函数的签名（从 FUNC_BEGIN / ARG 收集）
+ */
+typedef struct {
+  const char *name;
+  IRValueType return_type;
+  IRValueType *param_types;
+  int param_count;
+} Signature;
+
+typedef struct {
+  IRProgram *program;
+  X86Module *module;
+  Signature *signatures;
+  int signature_count;
+  NameMap signature_index; // 函数名 → signatures 的下标
+  int next_label; // 代码生成器自己需要的标签，从 IR 的标签之后编号
+  int errors;
+
+  // 当前函数
+  IRFunction *func;
+  X86Function *out;
+  RegAlloc *ra;
+  IRValueType return_type;
+  X86Reg saved[REG_COUNT];
+  int saved_count;
+  int slot_count;
+  int return_label;
+  int pushed;         // 当前压在栈上的 8 字节数（实参），用于对齐
+  int *use_count;     // 值编号 → 被读取的次数
+  int *param_call;    // 指令下标 - begin → param 属于哪个 call（下标）
+  int *param_index;   // 指令下标 - begin → 第几个实参
+  int *param_start;   // 指令下标 - begin → call 的第一个 param 的下标
+} Codegen;
+
+static void error(Codegen *cg, const char *message, const char *name) {
+  diag_printf("Codegen error: %s%s%s\n", message, name ? ": " : "",
+              name ? name : "");
+  cg->errors++;
+}
+
+static uint64_t double_bits(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static int new_label(Codegen *cg) { return cg->next_label++; }
+
+// ==================== 签名和全局变量 ====================
+
+static void collect_signatures(Codegen *cg) {
+  IRFunction *functions = NULL;
+  int count = ir_collect_functions(cg->program, &functions);
+  cg->signatures = (Signature *)calloc(count ? count : 1, sizeof(Signature));
+  cg->signature_count = count;
+  name_map_init(&cg->signature_index, count);
+
+  for (int f = 0; f < count; f++) {
+    Signature *sig = &cg->signatures[f];
+    IRInstruction *begin = &cg->program->instructions[functions[f].begin];
+    sig->name = begin->result.value.name;
+    name_map_put(&cg->signature_index, sig->name, f);
+    sig->return_type = begin->result.vtype;
+    sig->param_count = functions[f].param_count;
+    sig->param_types = (IRValueType *)calloc(
+        sig->param_count ? sig->param_count : 1, sizeof(IRValueType));
+    for (int i = 0; i < sig->param_count; i++)
+      sig->param_types[i] =
+          cg->program->instructions[functions[f].begin + 1 + i].result.vtype;
+  }
+  free(functions);
+}
+
+static Signature *find_signature(Codegen *cg, const char *name) {
+  int index = name_map_get(&cg->signature_index, name);
+  return index >= 0 ? &cg->signatures[index] : NULL;
+}
+
+/**
+ * 编译期常量（全局变量的初始值）
+ */
+typedef struct {
+  int known;
+  IRValueType type;
+  int int_value;
+  double float_value;
+} ConstValue;
+
+static ConstValue const_of(IROperand op, ConstValue *temps, int temp_base,
+                           int temp_limit) {
+  ConstValue value = {0, IR_TYPE_INT, 0, 0};
+  if (op.type == OPERAND_INT) {
+    value.known = 1;
+    value.int_value = op.value.int_val;
+  } else if (op.type == OPERAND_FLOAT) {
+    value.known = 1;
+    value.type = IR_TYPE_FLOAT;
+    value.float_value = op.value.float_val;
+  } else if (op.type == OPERAND_TEMP && op.value.temp_id >= temp_base &&
+             op.value.temp_id < temp_limit) {
+    value = temps[op.value.temp_id - temp_base];
+  }
+  return value;
+}
+
+static double as_double(ConstValue v) {
+  return v.type == IR_TYPE_FLOAT ? v.float_value : (double)v.int_value;
+}
+
+static int as_int(ConstValue v) {
+  return v.type == IR_TYPE_FLOAT ? (int)v.float_value : v.int_value;
+}
+
+/**
+ * 在编译期求值一条全局初始化指令，成功返回 1
+ */
+static int fold_constant(IRInstruction *instr, ConstValue a, ConstValue b,
+                         ConstValue *result) {
+  result->known = 1;
+  result->type = instr->result.vtype;
+  IROpcode op = instr->opcode;
+
+  if (op == IR_ASSIGN) {
+    result->int_value = as_int(a);
+    result->float_value = as_double(a);
+    return a.known;
+  }
+  if (!a.known || (op != IR_NEG && op != IR_NOT && !b.known))
+    return 0;
+
+  if (a.type == IR_TYPE_FLOAT || b.type == IR_TYPE_FLOAT) {
+    double x = as_double(a), y = as_double(b), r = 0;
+    switch (op) {
+    case IR_ADD: r = x + y; break;
+    case IR_SUB: r = x - y; break;
+    case IR_MUL: r = x * y; break;
+    case IR_DIV: r = x / y; break;
+    case IR_NEG: r = -x; break;
+    case IR_NOT: r = !x; break;
+    case IR_EQ: r = x == y; break;
+    case IR_NE: r = x != y; break;
+    case IR_LT: r = x < y; break;
+    case IR_GT: r = x > y; break;
+    case IR_LE: r = x <= y; break;
+    case IR_GE: r = x >= y; break;
+    default:
+      return 0;
+    }
+    result->float_value = r;
+    result->int_value = (int)r;
+    return 1;
+  }
+
+  // 整数按 32 位补码回绕
+  unsigned x = (unsigned)a.int_value, y = (unsigned)b.int_value, r = 0;
+  switch (op) {
+  case IR_ADD: r = x + y; break;
+  case IR_SUB: r = x - y; break;
+  case IR_MUL: r = x * y; break;
+  case IR_DIV:
+  case IR_MOD:
+    if (b.int_value == 0 || (a.int_value == (-2147483647 - 1) && b.int_value == -1))
+      return 0;
+    r = (unsigned)(op == IR_DIV ? a.int_value / b.int_value
+                                : a.int_value % b.int_value);
+    break;
+  case IR_NEG: r = 0u - x; break;
+  case IR_NOT: r = x == 0; break;
+  case IR_SHL: r = x << (y & 31); break;
+  case IR_SHR: r = (unsigned)(a.int_value >> (y & 31)); break;
+  case IR_USHR: r = x >> (y & 31); break;
+  case IR_BAND: r = x & y; break;
+  case IR_EQ: r = x == y; break;
+  case IR_NE: r = x != y; break;
+  case IR_LT: r = a.int_value < b.int_value; break;
+  case IR_GT: r = a.int_value > b.int_value; break;
+  case IR_LE: r = a.int_value <= b.int_value; break;
+  case IR_GE: r = a.int_value >= b.int_value; break;
+  default:
+    return 0;
+  }
+  result->int_value = (int)r;
+  result->float_value = (double)(int)r;
+  return 1;
+}
+
+static X86Global *declare_global(Codegen *cg, IROperand var) {
+  X86Global *global = x86_find_global(cg->module, var.value.name);
+  if (!global)
+    global = x86_add_global(cg->module, var.value.name, var.vtype);
+  return global;
+}
+
+/**
+ * 收集全局变量：函数之外的指令是全局变量的初始化，在编译期求值
+ */
+static void collect_globals(Codegen *cg) {
+  IRProgram *program = cg->program;
+
+  // 只为函数之外用到的临时变量编号建表
+  int temp_base = -1, temp_limit = 0;
+  int in_function = 0;
+  for (int i = 0; i < program->count; i++) {
+    IRInstruction *instr = &program->instructions[i];
+    if (instr->opcode == IR_FUNC_BEGIN)
+      in_function = 1;
+    if (in_function) {
+      if (instr->opcode == IR_FUNC_END)
+        in_function = 0;
+      continue;
+    }
+    IROperand ops[3] = {instr->result, instr->arg1, instr->arg2};
+    for (int k = 0; k < 3; k++) {
+      if (ops[k].type != OPERAND_TEMP)
+        continue;
+      if (temp_base < 0 || ops[k].value.temp_id < temp_base)
+        temp_base = ops[k].value.temp_id;
+      if (ops[k].value.temp_id >= temp_limit)
+        temp_limit = ops[k].value.temp_id + 1;
+    }
+  }
+  if (temp_base < 0)
+    temp_base = 0;
+  ConstValue *temps = (ConstValue *)calloc(
+      temp_limit > temp_base ? temp_limit - temp_base : 1, sizeof(ConstValue));
+
+  in_function = 0;
+  for (int i = 0; i < program->count; i++) {
+    IRInstruction *instr = &program->instructions[i];
+    IROperand ops[3] = {instr->result, instr->arg1, instr->arg2};
+    for (int k = 0; k < 3; k++) {
+      if (ops[k].type == OPERAND_VAR && ops[k].is_global)
+        declare_global(cg, ops[k]);
+    }
+
+    if (instr->opcode == IR_FUNC_BEGIN)
+      in_function = 1;
+    if (in_function) {
+      if (instr->opcode == IR_FUNC_END)
+        in_function = 0;
+      continue;
+    }
+    if (instr->opcode == IR_NOP || instr->opcode == IR_LABEL)
+      continue;
+
+    ConstValue a = const_of(instr->arg1, temps, temp_base, temp_limit);
+    ConstValue b = const_of(instr->arg2, temps, temp_base, temp_limit);
+    ConstValue value;
+    if (instr->opcode > IR_NOT || !fold_constant(instr, a, b, &value)) {
+      error(cg, "global initializer is not a constant expression",
+            instr->result.type == OPERAND_VAR ? instr->result.value.name
+                                              : NULL);
+      continue;
+    }
+
+    if (instr->result.type == OPERAND_TEMP &&
+        instr->result.value.temp_id >= temp_base &&
+        instr->result.value.temp_id < temp_limit) {
+      temps[instr->result.value.temp_id - temp_base] = value;
+    } else if (instr->result.type == OPERAND_VAR) {
+      X86Global *global = declare_global(cg, instr->result);
+      global->int_value = value.int_value;
+      global->float_value = value.float_value;
+    }
+  }
+
+  free(temps);
+}
+
+// ==================== 操作数 ====================
+
+static int slot_offset(Codegen *cg, int slot) {
+  return -8 * (cg->saved_count + slot + 1);
+}
+
+// 寄存器传入的第 i 个形参的保存位置
+static int arg_save_offset(Codegen *cg, int i) {
+  return slot_offset(cg, cg->slot_count + i);
+}
+
+static int is_float(IROperand op) { return op.vtype == IR_TYPE_FLOAT; }
+
+/**
+ * IR 操作数在机器上的位置
+ */
+static X86Operand operand_of(Codegen *cg, IROperand op) {
+  switch (op.type) {
+  case OPERAND_INT:
+    return x86_imm(op.value.int_val);
+  case OPERAND_FLOAT:
+    return x86_const(x86_add_const(cg->module, double_bits(op.value.float_val)));
+  case OPERAND_VAR:
+  case OPERAND_TEMP: {
+    if (op.is_global) {
+      X86Global *global = x86_find_global(cg->module, op.value.name);
+      return x86_global(global->name);
+    }
+    Location loc = regalloc_location(cg->ra, op);
+    if (loc.kind == LOC_REG)
+      return x86_reg(loc.reg);
+    if (loc.kind == LOC_STACK)
+      return x86_mem(REG_RBP, slot_offset(cg, loc.slot));
+    // 从未活跃的值（结果没人用）：写到临时寄存器里丢掉
+    return x86_reg(is_float(op) ? FSCRATCH2 : SCRATCH2);
+  }
+  default:
+    return x86_imm(0);
+  }
+}
+
+static int is_reg(X86Operand op) { return op.kind == X86_OPND_REG; }
+
+static int is_memory(X86Operand op) {
+  return op.kind == X86_OPND_MEM || op.kind == X86_OPND_GLOBAL ||
+         op.kind == X86_OPND_CONST;
+}
+
+static int same_reg(X86Operand op, X86Reg reg) {
+  return op.kind == X86_OPND_REG && op.reg == reg;
+}
+
+static void emit(Codegen *cg, X86Opcode op, int size, X86Operand src,
+                 X86Operand dst) {
+  x86_emit(cg->out, op, size, src, dst);
+}
+
+static X86Operand none(void) {
+  X86Operand op;
+  memset(&op, 0, sizeof(op));
+  op.kind = X86_OPND_NONE;
+  op.reg = REG_NONE;
+  return op;
+}
+
+// 复制 double：寄存器之间用 movapd，避免依赖目标寄存器的旧值
+static void move_float(Codegen *cg, X86Operand src, X86Operand dst) {
+  X86Opcode op = is_reg(src) && is_reg(dst) ? X86_MOVAPD : X86_MOVSD;
+  emit(cg, op, 8, src, dst);
+}
+
+// 整数转 double：cvtsi2sd 只写低位，先清零目标寄存器断开依赖
+static void convert_to_float(Codegen *cg, X86Operand src, X86Reg reg) {
+  emit(cg, X86_XORPD, 8, x86_reg(reg), x86_reg(reg));
+  emit(cg, X86_CVTSI2SD, 4, src, x86_reg(reg));
+}
+
+/**
+ * 把操作数的整数值放进寄存器（浮点值截断）
+ */
+static void load_int(Codegen *cg, IROperand op, X86Reg reg) {
+  X86Operand src = operand_of(cg, op);
+  if (op.type == OPERAND_NONE) {
+    emit(cg, X86_XOR, 4, x86_reg(reg), x86_reg(reg));
+  } else if (is_float(op)) {
+    emit(cg, X86_CVTTSD2SI, 4, src, x86_reg(reg));
+  } else if (!same_reg(src, reg)) {
+    emit(cg, X86_MOV, 4, src, x86_reg(reg));
+  }
+}
+
+/**
+ * 把操作数的浮点值放进 xmm 寄存器（整数值转换）
+ */
+static void load_float(Codegen *cg, IROperand op, X86Reg reg) {
+  if (op.type == OPERAND_INT) {
+    int index = x86_add_const(cg->module, double_bits((double)op.value.int_val));
+    emit(cg, X86_MOVSD, 8, x86_const(index), x86_reg(reg));
+    return;
+  }
+  X86Operand src = operand_of(cg, op);
+  if (op.type == OPERAND_NONE) {
+    emit(cg, X86_XORPD, 8, x86_reg(reg), x86_reg(reg));
+  } else if (!is_float(op)) {
+    convert_to_float(cg, src, reg);
+  } else if (!same_reg(src, reg)) {
+    move_float(cg, src, x86_reg(reg));
+  }
+}
+
+/**
+ * 整数运算的源操作数：寄存器、立即数或内存可以直接用，浮点值先转换
+ */
+static X86Operand int_source(Codegen *cg, IROperand op) {
+  if (is_float(op) || op.type == OPERAND_NONE) {
+    load_int(cg, op, SCRATCH2);
+    return x86_reg(SCRATCH2);
+  }
+  return operand_of(cg, op);
+}
+
+static X86Operand float_source(Codegen *cg, IROperand op, X86Reg scratch) {
+  if (is_float(op) && op.type != OPERAND_NONE)
+    return operand_of(cg, op);
+  load_float(cg, op, scratch);
+  return x86_reg(scratch);
+}
+
+/**
+ * 把寄存器里的结果写回 result
+ */
+static void store(Codegen *cg, IROperand result, X86Reg reg) {
+  X86Operand dst = operand_of(cg, result);
+  if (same_reg(dst, reg))
+    return;
+  if (is_float(result))
+    move_float(cg, x86_reg(reg), dst);
+  else
+    emit(cg, X86_MOV, 4, x86_reg(reg), dst);
+}
+
+/**
+ * 选择计算 result 的寄存器：result 在寄存器里并且不会覆盖 other 时直接用它
+ */
+static X86Reg work_reg(Codegen *cg, IROperand result, IROperand other,
+                       X86Reg fallback) {
+  X86Operand dst = operand_of(cg, result);
+  if (!is_reg(dst) || dst.reg == SCRATCH2 || dst.reg == FSCRATCH2)
+    return fallback;
+  X86Operand o = operand_of(cg, other);
+  if ((other.type == OPERAND_TEMP || other.type == OPERAND_VAR) &&
+      same_reg(o, dst.reg))
+    return fallback;
+  return dst.reg;
+}
+
+// ==================== 条件 ====================
+
+static IROpcode swap_compare(IROpcode op) {
+  switch (op) {
+  case IR_LT: return IR_GT;
+  case IR_GT: return IR_LT;
+  case IR_LE: return IR_GE;
+  case IR_GE: return IR_LE;
+  default: return op;
+  }
+}
+
+static IROpcode negate_compare(IROpcode op) {
+  switch (op) {
+  case IR_EQ: return IR_NE;
+  case IR_NE: return IR_EQ;
+  case IR_LT: return IR_GE;
+  case IR_GE: return IR_LT;
+  case IR_GT: return IR_LE;
+  default: return IR_GT; // IR_LE
+  }
+}
+
+static X86Cond int_cond(IROpcode op) {
+  switch (op) {
+  case IR_EQ: return CC_E;
+  case IR_NE: return CC_NE;
+  case IR_LT: return CC_L;
+  case IR_GT: return CC_G;
+  case IR_LE: return CC_LE;
+  default: return CC_GE;
+  }
+}
+
+/**
+ * 生成比较指令，返回（可能交换过操作数的）比较操作
+ *
+ * 浮点比较只用 > 和 >=（无符号条件 a/ae），< 和 <= 交换操作数：
+ * 这样 NaN（CF=ZF=PF=1）自然得到 false。
+ */
+static IROpcode emit_compare(Codegen *cg, IROpcode op, IROperand a,
+                             IROperand b, int *is_float_compare) {
+  if (is_float(a) || is_float(b)) {
+    *is_float_compare = 1;
+    if (op == IR_LT || op == IR_LE) {
+      IROperand t = a;
+      a = b;
+      b = t;
+      op = swap_compare(op);
+    }
+    load_float(cg, a, FSCRATCH);
+    X86Operand src = float_source(cg, b, FSCRATCH2);
+    emit(cg, X86_UCOMISD, 8, src, x86_reg(FSCRATCH));
+    return op;
+  }
+
+  *is_float_compare = 0;
+  X86Operand left = operand_of(cg, a);
+  X86Operand right = operand_of(cg, b);
+  if (left.kind == X86_OPND_IMM && right.kind != X86_OPND_IMM) {
+    X86Operand t = left;
+    left = right;
+    right = t;
+    op = swap_compare(op);
+  }
+  if (left.kind == X86_OPND_IMM || (is_memory(left) && is_memory(right))) {
+    emit(cg, X86_MOV, 4, left, x86_reg(SCRATCH));
+    left = x86_reg(SCRATCH);
+  }
+  emit(cg, X86_CMP, 4, right, left);
+  return op;
+}
+
+/**
+ * 比较结果为真（jump_if_true）或为假时跳到 target
+ */
+static void emit_branch(Codegen *cg, IROpcode op, int is_float_compare,
+                        int jump_if_true, int target) {
+  if (!jump_if_true)
+    op = negate_compare(op);
+
+  if (!is_float_compare) {
+    x86_emit_cc(cg->out, X86_JCC, int_cond(op), x86_label(target));
+    return;
+  }
+
+  // 浮点：无序（NaN）时只有 != 为真
+  switch (op) {
+  case IR_GT:
+    x86_emit_cc(cg->out, X86_JCC, jump_if_true ? CC_A : CC_BE,
+                x86_label(target));
+    break;
+  case IR_GE:
+    x86_emit_cc(cg->out, X86_JCC, jump_if_true ? CC_AE : CC_B,
+                x86_label(target));
+    break;
+  case IR_LE: // 只会来自 !(a > b)：无序时为真
+    x86_emit_cc(cg->out, X86_JCC, CC_BE, x86_label(target));
+    break;
+  case IR_LT: // 只会来自 !(a >= b)
+    x86_emit_cc(cg->out, X86_JCC, CC_B, x86_label(target));
+    break;
+  case IR_EQ: {
+    int skip = new_label(cg);
+    x86_emit_cc(cg->out, X86_JCC, CC_P, x86_label(skip));
+    x86_emit_cc(cg->out, X86_JCC, CC_E, x86_label(target));
+    emit(cg, X86_LABEL, 0, none(), x86_label(skip));
+    break;
+  }
+  default: // IR_NE
+    x86_emit_cc(cg->out, X86_JCC, CC_P, x86_label(target));
+    x86_emit_cc(cg->out, X86_JCC, CC_NE, x86_label(target));
+    break;
+  }
+}
+
+/**
+ * 把比较结果（0/1）写到 al
+ */
+static void emit_setcc(Codegen *cg, IROpcode op, int is_float_compare) {
+  X86Operand al = x86_reg(REG_RAX);
+  X86Operand cl = x86_reg(REG_RCX);
+  if (!is_float_compare) {
+    x86_emit_cc(cg->out, X86_SETCC, int_cond(op), al);
+    return;
+  }
+  switch (op) {
+  case IR_GT:
+    x86_emit_cc(cg->out, X86_SETCC, CC_A, al);
+    break;
+  case IR_GE:
+    x86_emit_cc(cg->out, X86_SETCC, CC_AE, al);
+    break;
+  case IR_EQ:
+    x86_emit_cc(cg->out, X86_SETCC, CC_E, al);
+    x86_emit_cc(cg->out, X86_SETCC, CC_NP, cl);
+    emit(cg, X86_AND, 1, cl, al);
+    break;
+  default: // IR_NE
+    x86_emit_cc(cg->out, X86_SETCC, CC_NE, al);
+    x86_emit_cc(cg->out, X86_SETCC, CC_P, cl);
+    emit(cg, X86_OR, 1, cl, al);
+    break;
+  }
+}
+
+/**
+ * 值是否为真（非 0）：设置标志位，返回按 IR_NE 解释的比较
+ */
+static int emit_test(Codegen *cg, IROperand value) {
+  int is_float_compare = 0;
+  emit_compare(cg, IR_NE, value, ir_operand_int(0), &is_float_compare);
+  return is_float_compare;
+}
+
+// ==================== 指令 ====================
+
+static void gen_arith(Codegen *cg, IRInstruction *instr) {
+  IROperand result = instr->result;
+  IROperand a = instr->arg1, b = instr->arg2;
+
+  if (is_float(result)) {
+    X86Reg reg = work_reg(cg, result, b, FSCRATCH);
+    load_float(cg, a, reg);
+    if (instr->opcode == IR_NEG) {
+      int sign = x86_add_const(cg->module, (uint64_t)1 << 63);
+      emit(cg, X86_XORPD, 8, x86_const(sign), x86_reg(reg));
+    } else {
+      static const X86Opcode ops[] = {[IR_ADD] = X86_ADDSD,
+                                      [IR_SUB] = X86_SUBSD,
+                                      [IR_MUL] = X86_MULSD,
+                                      [IR_DIV] = X86_DIVSD};
+      X86Opcode op = instr->opcode <= IR_DIV ? ops[instr->opcode] : X86_ADDSD;
+      emit(cg, op, 8, float_source(cg, b, FSCRATCH2), x86_reg(reg));
+    }
+    store(cg, result, reg);
+    return;
+  }
+
+  switch (instr->opcode) {
+  case IR_DIV:
+  case IR_MOD: {
+    load_int(cg, a, REG_RAX);
+    X86Operand divisor = int_source(cg, b);
+    if (divisor.kind == X86_OPND_IMM) {
+      emit(cg, X86_MOV, 4, divisor, x86_reg(REG_RCX));
+      divisor = x86_reg(REG_RCX);
+    }
+    emit(cg, X86_CDQ, 4, none(), none());
+    emit(cg, X86_IDIV, 4, none(), divisor);
+    store(cg, result, instr->opcode == IR_DIV ? REG_RAX : REG_RDX);
+    return;
+  }
+
+  case IR_NEG: {
+    X86Reg reg = work_reg(cg, result, a, SCRATCH);
+    load_int(cg, a, reg);
+    emit(cg, X86_NEG, 4, none(), x86_reg(reg));
+    store(cg, result, reg);
+    return;
+  }
+
+  case IR_SHL:
+  case IR_SHR:
+  case IR_USHR: {
+    X86Opcode op = instr->opcode == IR_SHL   ? X86_SHL
+                   : instr->opcode == IR_SHR ? X86_SAR
+                                             : X86_SHR;
+    X86Reg reg = work_reg(cg, result, b, SCRATCH);
+    X86Operand count;
+    if (b.type == OPERAND_INT) {
+      count = x86_imm(b.value.int_val & 31);
+    } else {
+      load_int(cg, b, REG_RCX);
+      count = x86_reg(REG_RCX);
+    }
+    load_int(cg, a, reg);
+    emit(cg, op, 4, count, x86_reg(reg));
+    store(cg, result, reg);
+    return;
+  }
+
+  default: {
+    X86Opcode op = instr->opcode == IR_ADD   ? X86_ADD
+                   : instr->opcode == IR_SUB ? X86_SUB
+                   : instr->opcode == IR_MUL ? X86_IMUL
+                                             : X86_AND;
+    X86Reg reg = work_reg(cg, result, b, SCRATCH);
+    load_int(cg, a, reg);
+    X86Operand src = int_source(cg, b);
+    if (op == X86_IMUL && src.kind == X86_OPND_IMM) {
+      emit(cg, X86_MOV, 4, src, x86_reg(SCRATCH2));
+      src = x86_reg(SCRATCH2);
+    }
+    emit(cg, op, 4, src, x86_reg(reg));
+    store(cg, result, reg);
+    return;
+  }
+  }
+}
+
+/**
+ * 比较：后面紧跟着使用它的条件跳转时合并成 cmp + jcc，返回 1 表示跳转已生成
+ */
+static int gen_compare(Codegen *cg, IRInstruction *instr, IRInstruction *next) {
+  int is_float_compare;
+  IROpcode op =
+      emit_compare(cg, instr->opcode, instr->arg1, instr->arg2,
+                   &is_float_compare);
+
+  int v = liveness_value(cg->ra->lv, instr->result);
+  if (next && (next->opcode == IR_IF || next->opcode == IR_IFFALSE) &&
+      next->arg1.type == OPERAND_TEMP && instr->result.type == OPERAND_TEMP &&
+      next->arg1.value.temp_id == instr->result.value.temp_id && v >= 0 &&
+      cg->use_count[v] == 1) {
+    emit_branch(cg, op, is_float_compare, next->opcode == IR_IF,
+                next->result.value.label_id);
+    return 1;
+  }
+
+  emit_setcc(cg, op, is_float_compare);
+  emit(cg, X86_MOVZB, 4, x86_reg(REG_RAX), x86_reg(REG_RAX));
+  store(cg, instr->result, REG_RAX);
+  return 0;
+}
+
+/**
+ * !a、a && b、a || b（值形式）
+ */
+static void gen_logical(Codegen *cg, IRInstruction *instr) {
+  if (instr->opcode == IR_NOT) {
+    int is_float_compare = emit_test(cg, instr->arg1);
+    emit_setcc(cg, IR_EQ, 0);
+    if (is_float_compare) {
+      // NaN 为真，!NaN 为假
+      x86_emit_cc(cg->out, X86_SETCC, CC_NP, x86_reg(REG_RCX));
+      emit(cg, X86_AND, 1, x86_reg(REG_RCX), x86_reg(REG_RAX));
+    }
+  } else {
+    int is_float_compare = emit_test(cg, instr->arg1);
+    emit_setcc(cg, IR_NE, is_float_compare);
+    emit(cg, X86_MOV, 4, x86_reg(REG_RAX), x86_reg(REG_RDX));
+    is_float_compare = emit_test(cg, instr->arg2);
+    emit_setcc(cg, IR_NE, is_float_compare);
+    emit(cg, instr->opcode == IR_AND ? X86_AND : X86_OR, 1, x86_reg(REG_RDX),
+         x86_reg(REG_RAX));
+  }
+  emit(cg, X86_MOVZB, 4, x86_reg(REG_RAX), x86_reg(REG_RAX));
+  store(cg, instr->result, REG_RAX);
+}
+
+static void gen_assign(Codegen *cg, IRInstruction *instr) {
+  IROperand result = instr->result;
+  X86Operand dst = operand_of(cg, result);
+
+  if (is_float(result)) {
+    X86Reg reg = is_reg(dst) ? dst.reg : FSCRATCH;
+    load_float(cg, instr->arg1, reg);
+    store(cg, result, reg);
+    return;
+  }
+
+  X86Operand src = operand_of(cg, instr->arg1);
+  if (!is_float(instr->arg1) && instr->arg1.type != OPERAND_NONE &&
+      (src.kind == X86_OPND_IMM || is_reg(src) || is_reg(dst))) {
+    if (!(is_reg(src) && is_reg(dst) && src.reg == dst.reg))
+      emit(cg, X86_MOV, 4, src, dst);
+    return;
+  }
+  X86Reg reg = is_reg(dst) ? dst.reg : SCRATCH;
+  load_int(cg, instr->arg1, reg);
+  store(cg, result, reg);
+}
+
+static void gen_branch(Codegen *cg, IRInstruction *instr) {
+  int target = instr->result.value.label_id;
+  int jump_if_true = instr->opcode == IR_IF;
+
+  if (instr->arg1.type == OPERAND_INT) {
+    if ((instr->arg1.value.int_val != 0) == jump_if_true)
+      emit(cg, X86_JMP, 8, none(), x86_label(target));
+    return;
+  }
+  int is_float_compare = emit_test(cg, instr->arg1);
+  emit_branch(cg, IR_NE, is_float_compare, jump_if_true, target);
+}
+
+static void gen_param(Codegen *cg, int index) {
+  IRInstruction *instr = &cg->program->instructions[index];
+  int rel = index - cg->func->begin;
+
+  // 转换成被调函数形参的类型
+  IRValueType type = instr->arg1.vtype;
+  if (cg->param_call[rel] >= 0) {
+    IRInstruction *call = &cg->program->instructions[cg->param_call[rel]];
+    Signature *sig = find_signature(cg, call->arg1.value.name);
+    if (sig && cg->param_index[rel] < sig->param_count)
+      type = sig->param_types[cg->param_index[rel]];
+  }
+
+  if (type == IR_TYPE_FLOAT) {
+    load_float(cg, instr->arg1, FSCRATCH);
+    emit(cg, X86_SUB, 8, x86_imm(8), x86_reg(REG_RSP));
+    emit(cg, X86_MOVSD, 8, x86_reg(FSCRATCH), x86_mem(REG_RSP, 0));
+  } else {
+    X86Operand src = operand_of(cg, instr->arg1);
+    if (!is_float(instr->arg1) &&
+        (src.kind == X86_OPND_IMM || src.kind == X86_OPND_REG)) {
+      emit(cg, X86_PUSH, 8, none(), src);
+    } else {
+      load_int(cg, instr->arg1, SCRATCH);
+      emit(cg, X86_PUSH, 8, none(), x86_reg(SCRATCH));
+    }
+  }
+  cg->pushed++;
+}
+
+/**
+ * 把栈上的 n 个实参放到参数寄存器，超出寄存器的实参按顺序重新压栈
+ * 返回调用之后需要从栈上弹出的字节数
+ */
+static int setup_call_args(Codegen *cg, int call_index, int n,
+                           int *stack_args) {
+  IRValueType *types = (IRValueType *)malloc(sizeof(IRValueType) * (n + 1));
+  for (int i = 0; i < n; i++)
+    types[i] = IR_TYPE_INT;
+  int first = cg->param_start[call_index - cg->func->begin];
+  for (int i = first; i < call_index; i++) {
+    int rel = i - cg->func->begin;
+    if (cg->program->instructions[i].opcode == IR_PARAM &&
+        cg->param_call[rel] == call_index) {
+      IRInstruction *call = &cg->program->instructions[call_index];
+      Signature *sig = find_signature(cg, call->arg1.value.name);
+      int k = cg->param_index[rel];
+      types[k] = sig && k < sig->param_count
+                     ? sig->param_types[k]
+                     : cg->program->instructions[i].arg1.vtype;
+    }
+  }
+
+  // 第 i 个实参在 [rsp + 8*(n-1-i)]
+  int int_count = 0, float_count = 0;
+  int *overflow = (int *)malloc(sizeof(int) * (n + 1));
+  int overflow_count = 0;
+  for (int i = 0; i < n; i++) {
+    X86Operand slot = x86_mem(REG_RSP, 8 * (n - 1 - i));
+    if (types[i] == IR_TYPE_FLOAT && float_count < FLOAT_ARG_REG_COUNT) {
+      emit(cg, X86_MOVSD, 8, slot, x86_reg((X86Reg)(REG_XMM0 + float_count++)));
+    } else if (types[i] != IR_TYPE_FLOAT && int_count < INT_ARG_REG_COUNT) {
+      emit(cg, X86_MOV, 8, slot, x86_reg(INT_ARG_REGS[int_count++]));
+    } else {
+      overflow[overflow_count++] = i;
+    }
+  }
+
+  // 调用时 rsp 必须 16 字节对齐
+  int pad = (cg->pushed + overflow_count) % 2;
+  if (pad)
+    emit(cg, X86_SUB, 8, x86_imm(8), x86_reg(REG_RSP));
+  for (int k = overflow_count - 1; k >= 0; k--) {
+    int i = overflow[k];
+    int depth = pad + (overflow_count - 1 - k);
+    emit(cg, X86_PUSH, 8, none(), x86_mem(REG_RSP, 8 * (n - 1 - i + depth)));
+  }
+
+  free(types);
+  free(overflow);
+  *stack_args = overflow_count;
+  return 8 * (n + overflow_count + pad);
+}
+
+static void gen_epilogue(Codegen *cg) {
+  emit(cg, X86_MOV, 8, x86_reg(REG_RBP), x86_reg(REG_RSP));
+  if (cg->saved_count > 0)
+    emit(cg, X86_SUB, 8, x86_imm(8 * cg->saved_count), x86_reg(REG_RSP));
+  for (int i = cg->saved_count - 1; i >= 0; i--)
+    emit(cg, X86_POP, 8, none(), x86_reg(cg->saved[i]));
+  emit(cg, X86_POP, 8, none(), x86_reg(REG_RBP));
+}
+
+static void gen_call(Codegen *cg, int index, int is_tail) {
+  IRInstruction *instr = &cg->program->instructions[index];
+  int n = instr->arg_count;
+  Signature *sig = find_signature(cg, instr->arg1.value.name);
+  IRValueType callee_type = sig ? sig->return_type : instr->result.vtype;
+
+  int stack_args;
+  int cleanup = setup_call_args(cg, index, n, &stack_args);
+
+  // 尾调用：实参都在寄存器里、返回类型一致时，拆掉栈帧直接跳过去
+  if (is_tail && stack_args == 0 && callee_type == cg->return_type) {
+    gen_epilogue(cg);
+    emit(cg, X86_JMP, 8, none(), x86_func(instr->arg1.value.name));
+    cg->pushed -= n;
+    return;
+  }
+
+  emit(cg, X86_CALL, 8, none(), x86_func(instr->arg1.value.name));
+  emit(cg, X86_ADD, 8, x86_imm(cleanup), x86_reg(REG_RSP));
+  cg->pushed -= n;
+
+  if (is_tail) {
+    // 返回值已经在 rax/xmm0，必要时转换成本函数的返回类型
+    if (cg->return_type == IR_TYPE_FLOAT && callee_type != IR_TYPE_FLOAT)
+      convert_to_float(cg, x86_reg(REG_RAX), REG_XMM0);
+    else if (cg->return_type != IR_TYPE_FLOAT && callee_type == IR_TYPE_FLOAT)
+      emit(cg, X86_CVTTSD2SI, 4, x86_reg(REG_XMM0), x86_reg(REG_RAX));
+    emit(cg, X86_JMP, 8, none(), x86_label(cg->return_label));
+    return;
+  }
+
+  if (regalloc_location(cg->ra, instr->result).kind == LOC_NONE)
+    return;
+  if (is_float(instr->result)) {
+    if (callee_type != IR_TYPE_FLOAT)
+      convert_to_float(cg, x86_reg(REG_RAX), REG_XMM0);
+    store(cg, instr->result, REG_XMM0);
+  } else {
+    if (callee_type == IR_TYPE_FLOAT)
+      emit(cg, X86_CVTTSD2SI, 4, x86_reg(REG_XMM0), x86_reg(REG_RAX));
+    store(cg, instr->result, REG_RAX);
+  }
+}
+
+static void gen_return(Codegen *cg, IRInstruction *instr, int is_last) {
+  if (instr->arg1.type != OPERAND_NONE) {
+    if (cg->return_type == IR_TYPE_FLOAT)
+      load_float(cg, instr->arg1, REG_XMM0);
+    else
+      load_int(cg, instr->arg1, REG_RAX);
+  } else if (cg->return_type == IR_TYPE_FLOAT) {
+    emit(cg, X86_XORPD, 8, x86_reg(REG_XMM0), x86_reg(REG_XMM0));
+  } else {
+    emit(cg, X86_XOR, 4, x86_reg(REG_RAX), x86_reg(REG_RAX));
+  }
+  if (!is_last)
+    emit(cg, X86_JMP, 8, none(), x86_label(cg->return_label));
+}
+
+/**
+ * 形参：先把所有参数寄存器存到保存区，再逐个取到分配的位置
+ * （直接在寄存器之间移动可能互相覆盖，例如 a 要放进 b 所在的 rsi）
+ */
+static void gen_args(Codegen *cg) {
+  IRFunction *func = cg->func;
+  int n = func->param_count;
+  int int_count = 0, float_count = 0, stack_count = 0;
+  X86Operand *sources = (X86Operand *)malloc(sizeof(X86Operand) * (n + 1));
+
+  for (int i = 0; i < n; i++) {
+    IRInstruction *arg = &cg->program->instructions[func->begin + 1 + i];
+    X86Operand save = x86_mem(REG_RBP, arg_save_offset(cg, i));
+    if (is_float(arg->result) && float_count < FLOAT_ARG_REG_COUNT) {
+      emit(cg, X86_MOVSD, 8, x86_reg((X86Reg)(REG_XMM0 + float_count++)), save);
+      sources[i] = save;
+    } else if (!is_float(arg->result) && int_count < INT_ARG_REG_COUNT) {
+      emit(cg, X86_MOV, 8, x86_reg(INT_ARG_REGS[int_count++]), save);
+      sources[i] = save;
+    } else {
+      sources[i] = x86_mem(REG_RBP, 16 + 8 * stack_count++);
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    IRInstruction *arg = &cg->program->instructions[func->begin + 1 + i];
+    if (regalloc_location(cg->ra, arg->result).kind == LOC_NONE)
+      continue;
+    X86Operand dst = operand_of(cg, arg->result);
+    if (is_float(arg->result)) {
+      X86Reg reg = is_reg(dst) ? dst.reg : FSCRATCH;
+      move_float(cg, sources[i], x86_reg(reg));
+      store(cg, arg->result, reg);
+    } else {
+      X86Reg reg = is_reg(dst) ? dst.reg : SCRATCH;
+      emit(cg, X86_MOV, 4, sources[i], x86_reg(reg));
+      store(cg, arg->result, reg);
+    }
+  }
+  free(sources);
+}
+
+/**
+ * 把 param 和它所属的 call 对应起来（嵌套调用时 param 是交错的）
+ */
+static void match_params(Codegen *cg) {
+  IRFunction *func = cg->func;
+  int length = func->end - func->begin + 1;
+  cg->param_call = (int *)malloc(sizeof(int) * length);
+  cg->param_index = (int *)malloc(sizeof(int) * length);
+  cg->param_start = (int *)malloc(sizeof(int) * length);
+  int *pending = (int *)malloc(sizeof(int) * length);
+  int pending_count = 0;
+
+  for (int i = 0; i < length; i++) {
+    cg->param_call[i] = -1;
+    cg->param_index[i] = 0;
+    cg->param_start[i] = func->begin + i;
+  }
+  for (int i = func->begin + 1; i < func->end; i++) {
+    IRInstruction *instr = &cg->program->instructions[i];
+    if (instr->opcode == IR_PARAM) {
+      pending[pending_count++] = i - func->begin;
+    } else if (instr->opcode == IR_CALL || instr->opcode == IR_TAILCALL) {
+      int n = instr->arg_count <= pending_count ? instr->arg_count
+                                                : pending_count;
+      for (int k = 0; k < n; k++) {
+        int rel = pending[pending_count - n + k];
+        cg->param_call[rel] = i;
+        cg->param_index[rel] = k;
+      }
+      if (n > 0)
+        cg->param_start[i - func->begin] =
+            func->begin + pending[pending_count - n];
+      pending_count -= n;
+    }
+  }
+  free(pending);
+}
+
+static void count_uses(Codegen *cg) {
+  Liveness *lv = cg->ra->lv;
+  cg->use_count = (int *)calloc(lv->value_count + 1, sizeof(int));
+  for (int i = cg->func->begin + 1; i < cg->func->end; i++) {
+    int uses[2];
+    int n = liveness_instr_uses(lv, &cg->program->instructions[i], uses);
+    for (int k = 0; k < n; k++)
+      cg->use_count[uses[k]]++;
+  }
+}
+
+static void gen_function(Codegen *cg, IRFunction *func) {
+  IRInstruction *code = cg->program->instructions;
+  cg->func = func;
+  cg->out = x86_add_function(cg->module, func->name);
+  cg->ra = regalloc_function(cg->program, func);
+  cg->return_type = code[func->begin].result.vtype;
+  cg->return_label = new_label(cg);
+  cg->pushed = 0;
+  cg->slot_count = cg->ra->slot_count;
+  cg->saved_count = 0;
+  for (int r = 0; r < REG_COUNT; r++) {
+    if (cg->ra->callee_saved_used[r])
+      cg->saved[cg->saved_count++] = (X86Reg)r;
+  }
+  count_uses(cg);
+  match_params(cg);
+
+  // 序言：保存的寄存器 + 栈槽 + 形参保存区，总共保持 16 字节对齐
+  emit(cg, X86_PUSH, 8, none(), x86_reg(REG_RBP));
+  emit(cg, X86_MOV, 8, x86_reg(REG_RSP), x86_reg(REG_RBP));
+  for (int i = 0; i < cg->saved_count; i++)
+    emit(cg, X86_PUSH, 8, none(), x86_reg(cg->saved[i]));
+  int frame = 8 * (cg->slot_count + func->param_count);
+  if ((8 * cg->saved_count + frame) % 16 != 0)
+    frame += 8;
+  if (frame > 0)
+    emit(cg, X86_SUB, 8, x86_imm(frame), x86_reg(REG_RSP));
+  gen_args(cg);
+
+  int body = func->begin + 1 + func->param_count;
+  for (int i = body; i < func->end; i++) {
+    IRInstruction *instr = &code[i];
+    IRInstruction *next = i + 1 < func->end ? &code[i + 1] : NULL;
+
+    switch (instr->opcode) {
+    case IR_ASSIGN:
+      gen_assign(cg, instr);
+      break;
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_MOD:
+    case IR_NEG:
+    case IR_SHL:
+    case IR_SHR:
+    case IR_USHR:
+    case IR_BAND:
+      gen_arith(cg, instr);
+      break;
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_GT:
+    case IR_LE:
+    case IR_GE:
+      if (gen_compare(cg, instr, next))
+        i++; // 条件跳转已经合并
+      break;
+    case IR_AND:
+    case IR_OR:
+    case IR_NOT:
+      gen_logical(cg, instr);
+      break;
+    case IR_LABEL:
+      emit(cg, X86_LABEL, 0, none(), x86_label(instr->result.value.label_id));
+      break;
+    case IR_GOTO:
+      emit(cg, X86_JMP, 8, none(), x86_label(instr->result.value.label_id));
+      break;
+    case IR_IF:
+    case IR_IFFALSE:
+      gen_branch(cg, instr);
+      break;
+    case IR_PARAM:
+      gen_param(cg, i);
+      break;
+    case IR_CALL:
+      gen_call(cg, i, 0);
+      break;
+    case IR_TAILCALL:
+      gen_call(cg, i, 1);
+      break;
+    case IR_RETURN:
+      gen_return(cg, instr, i + 1 == func->end);
+      break;
+    default:
+      break;
+    }
+  }
+
+  // 落到函数末尾：返回 0
+  IROpcode last = func->end - 1 < body ? IR_NOP : code[func->end - 1].opcode;
+  if (last != IR_RETURN && last != IR_TAILCALL && last != IR_GOTO) {
+    if (cg->return_type == IR_TYPE_FLOAT)
+      emit(cg, X86_XORPD, 8, x86_reg(REG_XMM0), x86_reg(REG_XMM0));
+    else
+      emit(cg, X86_XOR, 4, x86_reg(REG_RAX), x86_reg(REG_RAX));
+  }
+  emit(cg, X86_LABEL, 0, none(), x86_label(cg->return_label));
+  gen_epilogue(cg);
+  emit(cg, X86_RET, 8, none(), none());
+
+  free(cg->use_count);
+  free(cg->param_call);
+  free(cg->param_index);
+  free(cg->param_start);
+  regalloc_free(cg->ra);
+  cg->ra = NULL;
+}
+
+// ==================== 接口 ====================
+
+X86Module *codegen_generate(IRProgram *program) {
+  if (!program)
+    return NULL;
+
+  Codegen cg;
+  memset(&cg, 0, sizeof(cg));
+  cg.program = program;
+  cg.module = x86_module_create();
+  cg.next_label = program->label_counter;
+
+  collect_signatures(&cg);
+  collect_globals(&cg);
+
+  IRFunction *functions = NULL;
+  int func_count = ir_collect_functions(program, &functions);
+  for (int f = 0; f < func_count && cg.errors == 0; f++)
+    gen_function(&cg, &functions[f]);
+  free(functions);
+
+  for (int i = 0; i < cg.signature_count; i++)
+    free(cg.signatures[i].param_types);
+  free(cg.signatures);
+  name_map_free(&cg.signature_index);
+
+  if (cg.errors > 0) {
+    x86_module_free(cg.module);
+    return NULL;
+  }
+  return cg.module;
+}
+
+int codegen_write_assembly(IRProgram *program, const char *path) {
+  X86Module *module = codegen_generate(program);
+  if (!module)
+    return 1;
+
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    diag_printf("Error: Cannot write file '%s'\n", path);
+    x86_module_free(module);
+    return 1;
+  }
+  x86_print_gas(module, out);
+  fclose(out);
+  x86_module_free(module);
+  return 0;
+}
+
+int codegen_write_object(IRProgram *program, const char *path) {
+  X86Module *module = codegen_generate(program);
+  if (!module)
+    return 1;
+  int status = object_write(module, path);
+  x86_module_free(module);
+  return status;
+}
@@ -0,0 +1,207 @@
+/**
+ * compiler.c - 嵌入用的编译器接口实现
+ */
+
+#include "../include/compiler.h"
+#include "../include/codegen.h"
+#include "../include/diag.h"
+#include "../include/irbin.h"
+#include "../include/lexer.h"
+#include "../include/memory.h"
+#include "../include/object.h"
+#include "../include/parser.h"
+#include "../include/peephole.h"
+#include "../include/semantic.h"
+#include "../include/tailcall.h"
+#include <string.h>
+
+struct CompilerContext {
+  MemoryAllocator allocator;
+  int has_allocator; // 0 表示标准库
+  CompilerConfig config;
+};
+
+/**
+ * 调用期间换上的线程局部设置，Session 结束时换回去
+ */
+typedef struct {
+  const MemoryAllocator *allocator;
+  DiagHandler diag;
+} Session;
+
+static void ignore_line(void *user, const char *line) {
+  (void)user;
+  (void)line;
+}
+
+static Session session_begin(const CompilerContext *context) {
+  Session previous;
+  previous.allocator = memory_set_allocator(
+      context->has_allocator ? &context->allocator : NULL);
+  DiagHandler handler;
+  handler.function = context->config.diagnostic
+                         ? context->config.diagnostic
+                         : ignore_line;
+  handler.user = context->config.diagnostic_user;
+  previous.diag = diag_set_handler(handler);
+  return previous;
+}
+
+static void session_end(Session previous) {
+  diag_set_handler(previous.diag);
+  memory_set_allocator(previous.allocator);
+}
+
+// ========== 上下文 ==========
+
+CompilerConfig compiler_default_config(void) {
+  CompilerConfig config;
+  memset(&config, 0, sizeof(config));
+  config.inline_options = inline_default_options();
+  return config;
+}
+
+CompilerContext *compiler_create(const CompilerConfig *config) {
+  MemoryAllocator allocator;
+  memset(&allocator, 0, sizeof(allocator));
+  if (config->allocator) {
+    allocator.allocate = config->allocator->allocate;
+    allocator.reallocate = config->allocator->reallocate;
+    allocator.release = config->allocator->release;
+    allocator.user = config->allocator->user;
+  }
+
+  // 上下文本身也从配置的分配器里分配
+  const MemoryAllocator *previous =
+      memory_set_allocator(config->allocator ? &allocator : NULL);
+  CompilerContext *context = (CompilerContext *)malloc(sizeof(*context));
+  memory_set_allocator(previous);
+  if (!context)
+    return NULL;
+  context->allocator = allocator;
+  context->has_allocator = config->allocator != NULL;
+  context->config = *config;
+  context->config.allocator = NULL; // 调用者的结构可能先于上下文释放
+  return context;
+}
+
+void compiler_destroy(CompilerContext *context) {
+  if (!context)
+    return;
+  // 释放时 context->allocator 也会消失，先复制一份
+  MemoryAllocator allocator = context->allocator;
+  const MemoryAllocator *previous =
+      memory_set_allocator(context->has_allocator ? &allocator : NULL);
+  free(context);
+  memory_set_allocator(previous);
+}
+
+// ========== 编译 ==========
+
+/**
+ * 前端和优化（在 Session 里调用），失败返回 NULL
+ */
+static IRProgram *front_end(const CompilerContext *context, const char *source,
+                            size_t length) {
+  // Lexer 需要 '\0' 结尾的源码
+  char *text = (char *)malloc(length + 1);
+  if (!text)
+    return NULL;
+  memcpy(text, source, length);
+  text[length] = '\0';
+
+  Lexer lexer = lexer_init(text);
+  Parser parser = parser_init(&lexer);
+  ASTNode *ast = parser_parse(&parser);
+  IRProgram *ir = NULL;
+  if (!parser_had_error(&parser)) {
+    SemanticAnalyzer *analyzer = semantic_init();
+    semantic_analyze(analyzer, ast);
+    if (semantic_has_errors(analyzer))
+      semantic_print_errors(analyzer);
+    else
+      ir = ir_generate(ast);
+    semantic_free(analyzer);
+  }
+  ast_free(ast);
+  free(text);
+  if (!ir)
+    return NULL;
+
+  unsigned flags = context->config.flags;
+  if (flags & COMPILER_INLINE)
+    ir_inline(ir, context->config.inline_options);
+  if (flags & COMPILER_TAIL_CALLS)
+    ir_optimize_tail_calls(ir);
+  if (flags & COMPILER_PEEPHOLE)
+    ir_peephole(ir);
+  return ir;
+}
+
+IRProgram *compiler_compile_ir(CompilerContext *context, const char *source,
+                               size_t length) {
+  Session previous = session_begin(context);
+  IRProgram *ir = front_end(context, source, length);
+  session_end(previous);
+  return ir;
+}
+
+void compiler_free_ir(CompilerContext *context, IRProgram *program) {
+  Session previous = session_begin(context);
+  ir_program_free(program);
+  session_end(previous);
+}
+
+/**
+ * 后端（在 Session 里调用）
+ */
+static int back_end(IRProgram *ir, unsigned char **data, size_t *size) {
+  *data = NULL;
+  *size = 0;
+  X86Module *module = codegen_generate(ir);
+  if (!module)
+    return 1;
+  uint8_t *object;
+  int status = object_build(module, &object, size);
+  if (status == 0)
+    *data = object;
+  x86_module_free(module);
+  return status;
+}
+
+int compiler_compile_object(CompilerContext *context, const char *source,
+                            size_t length, unsigned char **data, size_t *size) {
+  *data = NULL;
+  *size = 0;
+  Session previous = session_begin(context);
+  int status = 1;
+  IRProgram *ir = front_end(context, source, length);
+  if (ir) {
+    status = back_end(ir, data, size);
+    ir_program_free(ir);
+  }
+  session_end(previous);
+  return status;
+}
+
+int compiler_generate_object(CompilerContext *context, IRProgram *program,
+                             unsigned char **data, size_t *size) {
+  Session previous = session_begin(context);
+  int status = back_end(program, data, size);
+  session_end(previous);
+  return status;
+}
+
+int compiler_encode_ir(CompilerContext *context, const IRProgram *program,
+                       unsigned char **data, size_t *size) {
+  Session previous = session_begin(context);
+  *data = irbin_encode(program, size);
+  session_end(previous);
+  return *data ? 0 : 1;
+}
+
+void compiler_free(CompilerContext *context, void *data) {
+  Session previous = session_begin(context);
+  free(data);
+  session_end(previous);
+}
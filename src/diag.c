@@ -0,0 +1,64 @@
+/**
+ * diag.c - 错误信息的输出位置实现
+ */
+
+#include "../include/diag.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+#if defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+#define MAX_LINE 1024
+
+static THREAD_LOCAL DiagHandler handler;
+
+// 还没遇到换行符的部分（一条错误信息可能分几次 diag_printf 输出）
+static THREAD_LOCAL char line[MAX_LINE];
+static THREAD_LOCAL int line_length;
+
+void diag_printf(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  if (!handler.function) {
+    vfprintf(stderr, format, args);
+    va_end(args);
+    return;
+  }
+
+  char text[MAX_LINE];
+  int length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (length >= (int)sizeof(text))
+    length = (int)sizeof(text) - 1; // 过长的部分丢掉
+  for (int i = 0; i < length; i++) {
+    if (text[i] == '\n') {
+      line[line_length] = '\0';
+      handler.function(handler.user, line);
+      line_length = 0;
+    } else if (line_length < MAX_LINE - 1) {
+      line[line_length++] = text[i];
+    }
+  }
+}
+
+DiagHandler diag_set_handler(DiagHandler new_handler) {
+  DiagHandler previous = handler;
+  handler = new_handler;
+  line_length = 0;
+  return previous;
+}
+
+static void write_line(void *user, const char *text) {
+  Writer *out = (Writer *)user;
+  writer_puts(out, text);
+  writer_putc(out, '\n');
+}
+
+DiagHandler diag_to_writer(Writer *out) {
+  DiagHandler to_writer = {write_line, out};
+  return to_writer;
+}
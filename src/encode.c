@@ -0,0 +1,547 @@
+/**
+ * encode.c - x86-64 机器码编码实现
+ */
+
+#include "../include/encode.h"
+#include "../include/diag.h"
+#include "../include/memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * 跳转到标签的位置，等整个函数编码完再回填
+ */
+typedef struct {
+  int position; // 位移字段的位置
+  int width;    // 1 (rel8) 或 4 (rel32)
+  int label;
+  int instr; // 哪条指令（rel8 放不下时把它改成 rel32）
+} Fixup;
+
+typedef struct {
+  X86Code *code;
+  int errors;
+
+  // 当前函数
+  int *label_offsets; // 标签编号 - label_base → 位置
+  int label_base;
+  int label_limit;
+  char *long_jump; // 指令下标 → 是否用 rel32
+  Fixup *fixups;
+  int fixup_count;
+  int fixup_capacity;
+} Encoder;
+
+// ==================== 字节 ====================
+
+static void emit_byte(Encoder *e, uint8_t value) {
+  X86Code *code = e->code;
+  if (code->size >= code->capacity) {
+    code->capacity = code->capacity == 0 ? 256 : code->capacity * 2;
+    code->bytes = (uint8_t *)realloc(code->bytes, code->capacity);
+  }
+  code->bytes[code->size++] = value;
+}
+
+static void emit_bytes(Encoder *e, uint64_t value, int count) {
+  for (int i = 0; i < count; i++)
+    emit_byte(e, (uint8_t)(value >> (8 * i)));
+}
+
+static void add_reloc(Encoder *e, X86RelocType type, const char *name,
+                      int64_t addend) {
+  X86Code *code = e->code;
+  if (code->reloc_count >= code->reloc_capacity) {
+    code->reloc_capacity =
+        code->reloc_capacity == 0 ? 32 : code->reloc_capacity * 2;
+    code->relocs = (X86Reloc *)realloc(
+        code->relocs, sizeof(X86Reloc) * code->reloc_capacity);
+  }
+  X86Reloc *reloc = &code->relocs[code->reloc_count++];
+  reloc->offset = code->size;
+  reloc->type = type;
+  reloc->name = name;
+  reloc->addend = addend;
+}
+
+static void add_fixup(Encoder *e, int label, int width, int instr) {
+  if (e->fixup_count >= e->fixup_capacity) {
+    e->fixup_capacity = e->fixup_capacity == 0 ? 32 : e->fixup_capacity * 2;
+    e->fixups =
+        (Fixup *)realloc(e->fixups, sizeof(Fixup) * e->fixup_capacity);
+  }
+  Fixup *fixup = &e->fixups[e->fixup_count++];
+  fixup->position = e->code->size;
+  fixup->width = width;
+  fixup->label = label;
+  fixup->instr = instr;
+  emit_bytes(e, 0, width);
+}
+
+static int fits_int8(int64_t value) { return value >= -128 && value <= 127; }
+
+static void unsupported(Encoder *e, const X86Instr *instr) {
+  diag_printf("Encode error: unsupported operands for opcode %d\n",
+              instr->op);
+  e->errors++;
+}
+
+// ==================== ModRM / REX ====================
+
+// 寄存器的硬件编号（xmm 取低 4 位）
+static int hw(X86Reg reg) { return reg & 15; }
+
+static int is_reg(X86Operand op) { return op.kind == X86_OPND_REG; }
+
+static int is_rm(X86Operand op) {
+  return op.kind == X86_OPND_REG || op.kind == X86_OPND_MEM ||
+         op.kind == X86_OPND_GLOBAL || op.kind == X86_OPND_CONST;
+}
+
+// 8 位寄存器操作数（spl/bpl/sil/dil 需要 REX 前缀才能访问）
+#define BYTE_RM 1  // r/m 是 8 位寄存器
+#define BYTE_REG 2 // reg 字段也是 8 位寄存器
+#define BYTE_BOTH (BYTE_RM | BYTE_REG)
+
+/**
+ * REX 前缀：w = 64 位操作；byte_regs 见 BYTE_RM / BYTE_REG
+ */
+static void emit_rex(Encoder *e, int w, int reg, X86Operand rm,
+                     int byte_regs) {
+  int rex = 0;
+  if (w)
+    rex |= 0x08;
+  if (reg >= 8)
+    rex |= 0x04;
+  if ((rm.kind == X86_OPND_REG || rm.kind == X86_OPND_MEM) &&
+      hw(rm.reg) >= 8)
+    rex |= 0x01;
+  if ((byte_regs & BYTE_REG) && reg >= 4 && reg < 8)
+    rex |= 0x40;
+  if ((byte_regs & BYTE_RM) && rm.kind == X86_OPND_REG && hw(rm.reg) >= 4 &&
+      hw(rm.reg) < 8)
+    rex |= 0x40;
+  if (rex)
+    emit_byte(e, (uint8_t)(0x40 | rex));
+}
+
+/**
+ * ModRM（以及 SIB、位移）；trailing 是后面立即数的字节数，
+ * RIP 相对寻址的位移是相对指令末尾算的
+ */
+static void emit_modrm(Encoder *e, int reg, X86Operand rm, int trailing) {
+  reg &= 7;
+  switch (rm.kind) {
+  case X86_OPND_REG:
+    emit_byte(e, (uint8_t)(0xC0 | reg << 3 | (hw(rm.reg) & 7)));
+    break;
+
+  case X86_OPND_MEM: {
+    int base = hw(rm.reg) & 7;
+    int mod = rm.disp == 0 && base != 5 ? 0 : fits_int8(rm.disp) ? 1 : 2;
+    emit_byte(e, (uint8_t)(mod << 6 | reg << 3 | base));
+    if (base == 4)
+      emit_byte(e, 0x24); // rsp/r12 作基址必须带 SIB
+    if (mod == 1)
+      emit_byte(e, (uint8_t)rm.disp);
+    else if (mod == 2)
+      emit_bytes(e, (uint32_t)rm.disp, 4);
+    break;
+  }
+
+  case X86_OPND_GLOBAL:
+    emit_byte(e, (uint8_t)(0x05 | reg << 3));
+    add_reloc(e, X86_RELOC_PC32, rm.name, -4 - trailing);
+    emit_bytes(e, 0, 4);
+    break;
+
+  case X86_OPND_CONST:
+    emit_byte(e, (uint8_t)(0x05 | reg << 3));
+    add_reloc(e, X86_RELOC_PC32, NULL,
+              (int64_t)rm.index * X86_CONST_SIZE - 4 - trailing);
+    emit_bytes(e, 0, 4);
+    break;
+
+  default:
+    break;
+  }
+}
+
+/**
+ * 通用格式：[前缀] [REX] 操作码 ModRM
+ * opcode 可以是 1～2 字节（0x0Fxx 写成 0x0F00 | xx）
+ */
+static void emit_op(Encoder *e, uint8_t prefix, int w, int opcode, int reg,
+                    X86Operand rm, int byte_regs, int trailing) {
+  if (prefix)
+    emit_byte(e, prefix);
+  emit_rex(e, w, reg, rm, byte_regs);
+  if (opcode > 0xFF)
+    emit_byte(e, (uint8_t)(opcode >> 8));
+  emit_byte(e, (uint8_t)opcode);
+  emit_modrm(e, reg, rm, trailing);
+}
+
+// ==================== 指令 ====================
+
+static void encode_mov(Encoder *e, const X86Instr *instr) {
+  X86Operand src = instr->src, dst = instr->dst;
+  int w = instr->size == 8;
+  int byte = instr->size == 1;
+  int byte_regs = byte ? BYTE_BOTH : 0;
+
+  if (is_reg(src) && is_rm(dst)) {
+    emit_op(e, 0, w, byte ? 0x88 : 0x89, hw(src.reg), dst, byte_regs, 0);
+  } else if (is_rm(src) && is_reg(dst)) {
+    emit_op(e, 0, w, byte ? 0x8A : 0x8B, hw(dst.reg), src, byte_regs, 0);
+  } else if (src.kind == X86_OPND_IMM && is_reg(dst) && instr->size == 4) {
+    emit_rex(e, 0, 0, dst, 0);
+    emit_byte(e, (uint8_t)(0xB8 + (hw(dst.reg) & 7)));
+    emit_bytes(e, (uint32_t)src.imm, 4);
+  } else if (src.kind == X86_OPND_IMM && is_rm(dst) && !byte) {
+    emit_op(e, 0, w, 0xC7, 0, dst, 0, 4);
+    emit_bytes(e, (uint32_t)src.imm, 4);
+  } else {
+    unsupported(e, instr);
+  }
+}
+
+/**
+ * add/or/and/sub/xor/cmp：ext 是 0x80/0x81/0x83 组里的编号，
+ * 寄存器形式的操作码是 ext * 8 + 1
+ */
+static void encode_alu(Encoder *e, const X86Instr *instr, int ext) {
+  X86Operand src = instr->src, dst = instr->dst;
+  int w = instr->size == 8;
+  int byte = instr->size == 1;
+  int byte_regs = byte ? BYTE_BOTH : 0;
+  int opcode = ext * 8 + (byte ? 0 : 1);
+
+  if (is_reg(src) && is_rm(dst)) {
+    emit_op(e, 0, w, opcode, hw(src.reg), dst, byte_regs, 0);
+  } else if (is_rm(src) && is_reg(dst)) {
+    emit_op(e, 0, w, opcode + 2, hw(dst.reg), src, byte_regs, 0);
+  } else if (src.kind == X86_OPND_IMM && is_rm(dst)) {
+    if (byte) {
+      emit_op(e, 0, 0, 0x80, ext, dst, BYTE_RM, 1);
+      emit_byte(e, (uint8_t)src.imm);
+    } else if (fits_int8(src.imm)) {
+      emit_op(e, 0, w, 0x83, ext, dst, 0, 1);
+      emit_byte(e, (uint8_t)src.imm);
+    } else if (is_reg(dst) && dst.reg == REG_RAX) {
+      // 累加器短格式：add $imm32, %eax
+      if (w)
+        emit_byte(e, 0x48);
+      emit_byte(e, (uint8_t)(ext * 8 + 5));
+      emit_bytes(e, (uint32_t)src.imm, 4);
+    } else {
+      emit_op(e, 0, w, 0x81, ext, dst, 0, 4);
+      emit_bytes(e, (uint32_t)src.imm, 4);
+    }
+  } else {
+    unsupported(e, instr);
+  }
+}
+
+static void encode_shift(Encoder *e, const X86Instr *instr, int ext) {
+  X86Operand src = instr->src, dst = instr->dst;
+  int w = instr->size == 8;
+  if (src.kind == X86_OPND_IMM && src.imm == 1) {
+    emit_op(e, 0, w, 0xD1, ext, dst, 0, 0);
+  } else if (src.kind == X86_OPND_IMM) {
+    emit_op(e, 0, w, 0xC1, ext, dst, 0, 1);
+    emit_byte(e, (uint8_t)src.imm);
+  } else if (is_reg(src) && src.reg == REG_RCX) {
+    emit_op(e, 0, w, 0xD3, ext, dst, 0, 0);
+  } else {
+    unsupported(e, instr);
+  }
+}
+
+/**
+ * 跳转到标签：先试 rel8，放不下时由 encode_function 标记成 rel32 重来
+ */
+static void encode_jump(Encoder *e, const X86Instr *instr, int index) {
+  int is_long = e->long_jump[index];
+  if (instr->op == X86_JMP) {
+    emit_byte(e, is_long ? 0xE9 : 0xEB);
+  } else if (is_long) {
+    emit_byte(e, 0x0F);
+    emit_byte(e, (uint8_t)(0x80 + instr->cond));
+  } else {
+    emit_byte(e, (uint8_t)(0x70 + instr->cond));
+  }
+  add_fixup(e, instr->dst.index, is_long ? 4 : 1, index);
+}
+
+/**
+ * SSE2 标量指令：prefix 0F opcode，reg 是 xmm（或 cvttsd2si 的整数目标）
+ */
+static void encode_sse(Encoder *e, uint8_t prefix, int opcode, int reg,
+                       X86Operand rm) {
+  emit_op(e, prefix, 0, 0x0F00 | opcode, reg, rm, 0, 0);
+}
+
+static void encode_instr(Encoder *e, const X86Instr *instr, int index) {
+  X86Operand src = instr->src, dst = instr->dst;
+  int w = instr->size == 8;
+
+  switch (instr->op) {
+  case X86_LABEL:
+    if (dst.index >= e->label_base && dst.index < e->label_limit)
+      e->label_offsets[dst.index - e->label_base] = e->code->size;
+    break;
+
+  case X86_MOV:
+    encode_mov(e, instr);
+    break;
+  case X86_MOVZB:
+    emit_op(e, 0, w, 0x0FB6, hw(dst.reg), src, BYTE_RM, 0);
+    break;
+
+  case X86_ADD:
+    encode_alu(e, instr, 0);
+    break;
+  case X86_OR:
+    encode_alu(e, instr, 1);
+    break;
+  case X86_AND:
+    encode_alu(e, instr, 4);
+    break;
+  case X86_SUB:
+    encode_alu(e, instr, 5);
+    break;
+  case X86_XOR:
+    encode_alu(e, instr, 6);
+    break;
+  case X86_CMP:
+    encode_alu(e, instr, 7);
+    break;
+
+  case X86_TEST:
+    if (is_reg(src) && is_rm(dst)) {
+      emit_op(e, 0, w, 0x85, hw(src.reg), dst, 0, 0);
+    } else if (src.kind == X86_OPND_IMM && is_rm(dst)) {
+      emit_op(e, 0, w, 0xF7, 0, dst, 0, 4);
+      emit_bytes(e, (uint32_t)src.imm, 4);
+    } else {
+      unsupported(e, instr);
+    }
+    break;
+
+  case X86_IMUL:
+    if (is_rm(src) && is_reg(dst))
+      emit_op(e, 0, w, 0x0FAF, hw(dst.reg), src, 0, 0);
+    else
+      unsupported(e, instr);
+    break;
+  case X86_IDIV:
+    emit_op(e, 0, w, 0xF7, 7, dst, 0, 0);
+    break;
+  case X86_NEG:
+    emit_op(e, 0, w, 0xF7, 3, dst, 0, 0);
+    break;
+  case X86_CDQ:
+    if (w)
+      emit_byte(e, 0x48);
+    emit_byte(e, 0x99);
+    break;
+
+  case X86_SHL:
+    encode_shift(e, instr, 4);
+    break;
+  case X86_SHR:
+    encode_shift(e, instr, 5);
+    break;
+  case X86_SAR:
+    encode_shift(e, instr, 7);
+    break;
+
+  case X86_SETCC:
+    emit_op(e, 0, 0, 0x0F90 + instr->cond, 0, dst, BYTE_RM, 0);
+    break;
+
+  case X86_JMP:
+  case X86_JCC:
+    if (dst.kind == X86_OPND_LABEL) {
+      encode_jump(e, instr, index);
+    } else if (instr->op == X86_JMP && dst.kind == X86_OPND_FUNC) {
+      emit_byte(e, 0xE9);
+      add_reloc(e, X86_RELOC_PLT32, dst.name, -4);
+      emit_bytes(e, 0, 4);
+    } else {
+      unsupported(e, instr);
+    }
+    break;
+
+  case X86_CALL:
+    if (dst.kind == X86_OPND_FUNC) {
+      emit_byte(e, 0xE8);
+      add_reloc(e, X86_RELOC_PLT32, dst.name, -4);
+      emit_bytes(e, 0, 4);
+    } else if (is_reg(dst)) {
+      emit_op(e, 0, 0, 0xFF, 2, dst, 0, 0);
+    } else {
+      unsupported(e, instr);
+    }
+    break;
+
+  case X86_RET:
+    emit_byte(e, 0xC3);
+    break;
+
+  case X86_PUSH:
+    if (is_reg(dst)) {
+      emit_rex(e, 0, 0, dst, 0);
+      emit_byte(e, (uint8_t)(0x50 + (hw(dst.reg) & 7)));
+    } else if (dst.kind == X86_OPND_IMM && fits_int8(dst.imm)) {
+      emit_byte(e, 0x6A);
+      emit_byte(e, (uint8_t)dst.imm);
+    } else if (dst.kind == X86_OPND_IMM) {
+      emit_byte(e, 0x68);
+      emit_bytes(e, (uint32_t)dst.imm, 4);
+    } else {
+      emit_op(e, 0, 0, 0xFF, 6, dst, 0, 0);
+    }
+    break;
+
+  case X86_POP:
+    if (is_reg(dst)) {
+      emit_rex(e, 0, 0, dst, 0);
+      emit_byte(e, (uint8_t)(0x58 + (hw(dst.reg) & 7)));
+    } else {
+      emit_op(e, 0, 0, 0x8F, 0, dst, 0, 0);
+    }
+    break;
+
+  case X86_MOVSD:
+    if (is_reg(dst))
+      encode_sse(e, 0xF2, 0x10, hw(dst.reg), src);
+    else
+      encode_sse(e, 0xF2, 0x11, hw(src.reg), dst);
+    break;
+  case X86_MOVAPD:
+    encode_sse(e, 0x66, 0x28, hw(dst.reg), src);
+    break;
+  case X86_ADDSD:
+    encode_sse(e, 0xF2, 0x58, hw(dst.reg), src);
+    break;
+  case X86_MULSD:
+    encode_sse(e, 0xF2, 0x59, hw(dst.reg), src);
+    break;
+  case X86_SUBSD:
+    encode_sse(e, 0xF2, 0x5C, hw(dst.reg), src);
+    break;
+  case X86_DIVSD:
+    encode_sse(e, 0xF2, 0x5E, hw(dst.reg), src);
+    break;
+  case X86_UCOMISD:
+    encode_sse(e, 0x66, 0x2E, hw(dst.reg), src);
+    break;
+  case X86_XORPD:
+    encode_sse(e, 0x66, 0x57, hw(dst.reg), src);
+    break;
+  case X86_CVTSI2SD:
+    encode_sse(e, 0xF2, 0x2A, hw(dst.reg), src);
+    break;
+  case X86_CVTTSD2SI:
+    encode_sse(e, 0xF2, 0x2C, hw(dst.reg), src);
+    break;
+
+  default:
+    unsupported(e, instr);
+    break;
+  }
+}
+
+/**
+ * 编码一个函数：跳转先全部用 rel8，有放不下的就改成 rel32 再编码一遍，
+ * 直到所有跳转都放得下（只会变长，所以一定收敛）
+ */
+static void encode_function(Encoder *e, const X86Function *func) {
+  X86Code *code = e->code;
+  int start = code->size;
+  int reloc_start = code->reloc_count;
+
+  // 标签编号是整个模块的，表只覆盖这个函数里定义的 [label_base, label_limit)
+  e->label_base = -1;
+  e->label_limit = 0;
+  for (int i = 0; i < func->count; i++) {
+    if (func->code[i].op != X86_LABEL)
+      continue;
+    int label = func->code[i].dst.index;
+    if (e->label_base < 0 || label < e->label_base)
+      e->label_base = label;
+    if (label >= e->label_limit)
+      e->label_limit = label + 1;
+  }
+  if (e->label_base < 0)
+    e->label_base = 0;
+  int label_count = e->label_limit - e->label_base;
+  e->label_offsets = (int *)malloc(sizeof(int) * (label_count + 1));
+  e->long_jump = (char *)calloc(func->count + 1, 1);
+
+  int changed = 1;
+  while (changed && e->errors == 0) {
+    changed = 0;
+    code->size = start;
+    code->reloc_count = reloc_start;
+    e->fixup_count = 0;
+    for (int i = 0; i < label_count; i++)
+      e->label_offsets[i] = -1;
+
+    for (int i = 0; i < func->count; i++)
+      encode_instr(e, &func->code[i], i);
+
+    for (int i = 0; i < e->fixup_count; i++) {
+      Fixup *fixup = &e->fixups[i];
+      if (fixup->label < e->label_base || fixup->label >= e->label_limit ||
+          e->label_offsets[fixup->label - e->label_base] < 0) {
+        diag_printf("Encode error: undefined label .L%d in %s\n",
+                    fixup->label, func->name);
+        e->errors++;
+        break;
+      }
+      int64_t rel = e->label_offsets[fixup->label - e->label_base] -
+                    (fixup->position + fixup->width);
+      if (fixup->width == 1 && !fits_int8(rel)) {
+        e->long_jump[fixup->instr] = 1;
+        changed = 1;
+      } else {
+        for (int k = 0; k < fixup->width; k++)
+          code->bytes[fixup->position + k] = (uint8_t)(rel >> (8 * k));
+      }
+    }
+  }
+
+  free(e->label_offsets);
+  free(e->long_jump);
+}
+
+// ==================== 接口 ====================
+
+int x86_encode_module(const X86Module *module, X86Code *code) {
+  memset(code, 0, sizeof(*code));
+  int count = module->func_count ? module->func_count : 1;
+  code->func_offsets = (int *)calloc(count, sizeof(int));
+  code->func_sizes = (int *)calloc(count, sizeof(int));
+
+  Encoder e;
+  memset(&e, 0, sizeof(e));
+  e.code = code;
+  for (int f = 0; f < module->func_count && e.errors == 0; f++) {
+    code->func_offsets[f] = code->size;
+    encode_function(&e, &module->functions[f]);
+    code->func_sizes[f] = code->size - code->func_offsets[f];
+  }
+  free(e.fixups);
+  return e.errors;
+}
+
+void x86_code_free(X86Code *code) {
+  free(code->bytes);
+  free(code->relocs);
+  free(code->func_offsets);
+  free(code->func_sizes);
+  memset(code, 0, sizeof(*code));
+}
@@ -0,0 +1,146 @@
+/**
+ * hash.c - XXH64 实现
+ */
+
+#include "../include/hash.h"
+#include "../include/memory.h"
+#include <string.h>
+
+#define PRIME64_1 11400714785074694791ULL
+#define PRIME64_2 14029467366897019727ULL
+#define PRIME64_3 1609587929392839161ULL
+#define PRIME64_4 9650029242287828579ULL
+#define PRIME64_5 2870177450012600261ULL
+
+static uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static uint64_t read64(const unsigned char *p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static uint32_t read32(const unsigned char *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static uint64_t xxh_round(uint64_t acc, uint64_t input) {
+  acc += input * PRIME64_2;
+  acc = rotl64(acc, 31);
+  return acc * PRIME64_1;
+}
+
+static uint64_t xxh_merge(uint64_t acc, uint64_t value) {
+  acc ^= xxh_round(0, value);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t hash64(const void *data, size_t length, uint64_t seed) {
+  const unsigned char *p = (const unsigned char *)data;
+  const unsigned char *end = p + length;
+  uint64_t h;
+
+  // 每次处理 32 字节，四路累加
+  if (length >= 32) {
+    const unsigned char *limit = end - 32;
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+    do {
+      v1 = xxh_round(v1, read64(p));
+      v2 = xxh_round(v2, read64(p + 8));
+      v3 = xxh_round(v3, read64(p + 16));
+      v4 = xxh_round(v4, read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = xxh_merge(h, v1);
+    h = xxh_merge(h, v2);
+    h = xxh_merge(h, v3);
+    h = xxh_merge(h, v4);
+  } else {
+    h = seed + PRIME64_5;
+  }
+  h += (uint64_t)length;
+
+  // 剩下不到 32 字节
+  for (; p + 8 <= end; p += 8) {
+    h ^= xxh_round(0, read64(p));
+    h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (p + 4 <= end) {
+    h ^= (uint64_t)read32(p) * PRIME64_1;
+    h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= *p * PRIME64_5;
+    h = rotl64(h, 11) * PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+// ========== NameMap ==========
+
+static size_t name_slot(const NameMap *map, const char *name) {
+  size_t slot = (size_t)hash64(name, strlen(name), 0) & (size_t)map->mask;
+  while (map->names[slot] && strcmp(map->names[slot], name) != 0)
+    slot = (slot + 1) & (size_t)map->mask;
+  return slot;
+}
+
+static void name_map_alloc(NameMap *map, int capacity) {
+  map->names = (const char **)calloc(capacity, sizeof(const char *));
+  map->values = (int *)malloc(sizeof(int) * capacity);
+  map->mask = capacity - 1;
+  map->count = 0;
+}
+
+void name_map_init(NameMap *map, int expected) {
+  int capacity = 16;
+  while (capacity < expected * 2)
+    capacity *= 2;
+  name_map_alloc(map, capacity);
+}
+
+void name_map_free(NameMap *map) {
+  free(map->names);
+  free(map->values);
+  map->names = NULL;
+  map->values = NULL;
+}
+
+void name_map_put(NameMap *map, const char *name, int value) {
+  // 装填因子超过一半时加倍
+  if ((map->count + 1) * 2 > map->mask + 1) {
+    NameMap old = *map;
+    name_map_alloc(map, (old.mask + 1) * 2);
+    for (int i = 0; i <= old.mask; i++) {
+      if (old.names[i])
+        name_map_put(map, old.names[i], old.values[i]);
+    }
+    name_map_free(&old);
+  }
+  size_t slot = name_slot(map, name);
+  if (map->names[slot])
+    return;
+  map->names[slot] = name;
+  map->values[slot] = value;
+  map->count++;
+}
+
+int name_map_get(const NameMap *map, const char *name) {
+  if (!map->names)
+    return -1;
+  size_t slot = name_slot(map, name);
+  return map->names[slot] ? map->values[slot] : -1;
+}
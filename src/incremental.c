@@ -0,0 +1,939 @@
+/**
+ * incremental.c - 编辑器用的增量分析实现
+ */
+
+#include "../include/incremental.h"
+#include "../include/diag.h"
+#include "../include/parser.h"
+#include "../include/semantic.h"
+#include "../include/writer.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * 一条错误信息；行号相对块在分析时所在的行（块整体移动时不用改）
+ */
+typedef struct {
+  int line;
+  char *message;
+} Note;
+
+typedef struct {
+  Note *items;
+  int count;
+  int capacity;
+} NoteList;
+
+/**
+ * 语义分析解析过的一个名字（声明或使用），位置和 Note 一样相对分析时的行
+ */
+typedef struct {
+  int line;
+  int column;
+  const char *name; // 指向 AST 里的字符串
+  int global;       // 全局符号：声明的位置在查询时按名字找
+  int decl_line;    // 局部符号声明的位置
+  int decl_column;
+  char *detail; // 悬停提示
+} Reference;
+
+typedef struct {
+  Reference *items;
+  int count;
+  int capacity;
+} ReferenceList;
+
+struct DocumentChunk {
+  int start;       // 在源码里的起始位置，块一直到下一块的 start 为止
+  int line;        // start 所在的行
+  int parsed_line; // 语法分析时 start 所在的行，AST 和 Note 的行号相对它
+  TokenType last;  // 块里最后一个 Token 的类型（接着分析下一块时要用）
+  int panic;       // 块结束时语法分析器是否在错误恢复中
+  ASTNode *decl;   // 声明的 AST；NULL 表示文件结束
+  int end_line;    // 声明最后一个 Token 结束的位置（行相对 start 所在的行）
+  int end_column;
+
+  NoteList parse_errors;
+  NoteList semantic_errors;
+
+  char *signature;    // 声明留在全局作用域里的符号，没有声明时为 NULL
+  char *detail;       // 给人看的声明，如 "int fn0(int p0, int p1)"
+  const char **names; // 引用的名字（指向 AST 里的字符串，排序去重）
+  int name_count;
+  int name_capacity;
+
+  IRProgram *ir; // 这个声明的 IR（编号从 0 开始），NULL 表示要重新生成
+
+  ReferenceList references; // 按位置排序，语义分析重做时重新收集
+};
+
+/**
+ * 块数组（重新分析时先放在这里，再拼回 Document）
+ */
+typedef struct {
+  DocumentChunk *items;
+  int count;
+  int capacity;
+} ChunkList;
+
+// ========== 小工具 ==========
+
+static void note_add(NoteList *list, int line, const char *message) {
+  if (list->count >= list->capacity) {
+    list->capacity = list->capacity == 0 ? 4 : list->capacity * 2;
+    list->items =
+        (Note *)realloc(list->items, sizeof(Note) * list->capacity);
+  }
+  Note *note = &list->items[list->count++];
+  note->line = line;
+  size_t length = strlen(message);
+  note->message = (char *)malloc(length + 1);
+  memcpy(note->message, message, length + 1);
+}
+
+static void note_clear(NoteList *list) {
+  for (int i = 0; i < list->count; i++)
+    free(list->items[i].message);
+  free(list->items);
+  list->items = NULL;
+  list->count = 0;
+  list->capacity = 0;
+}
+
+static void chunk_push(ChunkList *list, const DocumentChunk *chunk) {
+  if (list->count >= list->capacity) {
+    list->capacity = list->capacity == 0 ? 16 : list->capacity * 2;
+    list->items = (DocumentChunk *)realloc(
+        list->items, sizeof(DocumentChunk) * list->capacity);
+  }
+  list->items[list->count++] = *chunk;
+}
+
+static void reference_clear(ReferenceList *list) {
+  for (int i = 0; i < list->count; i++)
+    free(list->items[i].detail);
+  free(list->items);
+  list->items = NULL;
+  list->count = 0;
+  list->capacity = 0;
+}
+
+static void chunk_free(DocumentChunk *chunk) {
+  ast_free(chunk->decl);
+  note_clear(&chunk->parse_errors);
+  note_clear(&chunk->semantic_errors);
+  reference_clear(&chunk->references);
+  free(chunk->signature);
+  free(chunk->detail);
+  free(chunk->names);
+  ir_program_free(chunk->ir);
+}
+
+static int count_lines(const char *text, size_t length) {
+  int lines = 0;
+  for (size_t i = 0; i < length; i++)
+    if (text[i] == '\n')
+      lines++;
+  return lines;
+}
+
+/**
+ * 最后一个 start 小于 offset 的块（offset 为 0 时是第 0 块）
+ */
+static int find_chunk(const Document *doc, int offset) {
+  int low = 0, high = doc->chunk_count - 1;
+  while (low < high) {
+    int mid = (low + high + 1) / 2;
+    if (doc->chunks[mid].start < offset)
+      low = mid;
+    else
+      high = mid - 1;
+  }
+  return low;
+}
+
+/**
+ * start 正好是 position 的块，没有时返回 -1
+ */
+static int find_boundary(const DocumentChunk *chunks, int count,
+                         int position) {
+  int low = 0, high = count - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    if (chunks[mid].start == position)
+      return mid;
+    if (chunks[mid].start < position)
+      low = mid + 1;
+    else
+      high = mid - 1;
+  }
+  return -1;
+}
+
+// ========== 声明的签名和引用的名字 ==========
+
+static void add_name(DocumentChunk *chunk, const char *name) {
+  if (chunk->name_count >= chunk->name_capacity) {
+    chunk->name_capacity =
+        chunk->name_capacity == 0 ? 16 : chunk->name_capacity * 2;
+    chunk->names = (const char **)realloc(
+        chunk->names, sizeof(const char *) * chunk->name_capacity);
+  }
+  chunk->names[chunk->name_count++] = name;
+}
+
+static void collect_names(DocumentChunk *chunk, ASTNode *node) {
+  if (!node)
+    return;
+  switch (node->type) {
+  case AST_VAR_DECL:
+    collect_names(chunk, node->data.var_decl.initializer);
+    break;
+  case AST_FUNC_DECL:
+    collect_names(chunk, node->data.func_decl.body);
+    break;
+  case AST_BLOCK:
+    for (int i = 0; i < node->data.block.count; i++)
+      collect_names(chunk, node->data.block.statements[i]);
+    break;
+  case AST_IF_STMT:
+    collect_names(chunk, node->data.if_stmt.condition);
+    collect_names(chunk, node->data.if_stmt.then_branch);
+    collect_names(chunk, node->data.if_stmt.else_branch);
+    break;
+  case AST_WHILE_STMT:
+    collect_names(chunk, node->data.while_stmt.condition);
+    collect_names(chunk, node->data.while_stmt.body);
+    break;
+  case AST_FOR_STMT:
+    collect_names(chunk, node->data.for_stmt.init);
+    collect_names(chunk, node->data.for_stmt.condition);
+    collect_names(chunk, node->data.for_stmt.update);
+    collect_names(chunk, node->data.for_stmt.body);
+    break;
+  case AST_RETURN_STMT:
+    collect_names(chunk, node->data.return_stmt.value);
+    break;
+  case AST_EXPR_STMT:
+    collect_names(chunk, node->data.expr_stmt.expression);
+    break;
+  case AST_BINARY_EXPR:
+    collect_names(chunk, node->data.binary_expr.left);
+    collect_names(chunk, node->data.binary_expr.right);
+    break;
+  case AST_UNARY_EXPR:
+    collect_names(chunk, node->data.unary_expr.operand);
+    break;
+  case AST_CALL_EXPR:
+    add_name(chunk, node->data.call_expr.callee);
+    for (int i = 0; i < node->data.call_expr.arg_count; i++)
+      collect_names(chunk, node->data.call_expr.arguments[i]);
+    break;
+  case AST_ASSIGN_EXPR:
+    add_name(chunk, node->data.assign_expr.name);
+    collect_names(chunk, node->data.assign_expr.value);
+    break;
+  case AST_IDENTIFIER:
+    add_name(chunk, node->data.identifier.name);
+    break;
+  default:
+    break;
+  }
+}
+
+static int compare_names(const void *a, const void *b) {
+  return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static const char *declared_name(const ASTNode *decl) {
+  if (!decl)
+    return NULL;
+  if (decl->type == AST_FUNC_DECL)
+    return decl->data.func_decl.name;
+  if (decl->type == AST_VAR_DECL)
+    return decl->data.var_decl.name;
+  return NULL;
+}
+
+/**
+ * "f 名字 返回类型(参数类型,...)" 或 "v 名字 类型"：其它声明看到的只有这些
+ */
+static char *make_signature(const ASTNode *decl) {
+  const char *name = declared_name(decl);
+  if (!name)
+    return NULL;
+  if (decl->type == AST_VAR_DECL) {
+    const char *type = decl->data.var_decl.type;
+    size_t length = strlen(name) + strlen(type) + 4;
+    char *text = (char *)malloc(length + 1);
+    snprintf(text, length + 1, "v %s %s", name, type);
+    return text;
+  }
+
+  const FuncDeclData *func = &decl->data.func_decl;
+  size_t length = strlen(name) + strlen(func->return_type) + 6;
+  for (int i = 0; i < func->param_count; i++)
+    length += strlen(func->params[i]->data.param.type) + 1;
+  char *text = (char *)malloc(length + 1);
+  int used = snprintf(text, length + 1, "f %s %s(", name, func->return_type);
+  for (int i = 0; i < func->param_count; i++)
+    used += snprintf(text + used, length + 1 - used, "%s%s", i ? "," : "",
+                     func->params[i]->data.param.type);
+  snprintf(text + used, length + 1 - used, ")");
+  return text;
+}
+
+/**
+ * "int fn0(int p0, int p1)" 或 "int g"
+ */
+static char *make_detail(const ASTNode *decl) {
+  if (!declared_name(decl))
+    return NULL;
+  Writer *out = writer_memory();
+  if (decl->type == AST_VAR_DECL) {
+    writer_printf(out, "%s %s", decl->data.var_decl.type,
+                  decl->data.var_decl.name);
+    return writer_take(out);
+  }
+  const FuncDeclData *func = &decl->data.func_decl;
+  writer_printf(out, "%s %s(", func->return_type, func->name);
+  for (int i = 0; i < func->param_count; i++)
+    writer_printf(out, "%s%s %s", i ? ", " : "",
+                  func->params[i]->data.param.type,
+                  func->params[i]->data.param.name);
+  writer_putc(out, ')');
+  return writer_take(out);
+}
+
+static void describe_declaration(DocumentChunk *chunk) {
+  chunk->signature = make_signature(chunk->decl);
+  chunk->detail = make_detail(chunk->decl);
+  collect_names(chunk, chunk->decl);
+  if (chunk->name_count == 0)
+    return;
+  qsort(chunk->names, chunk->name_count, sizeof(const char *), compare_names);
+  int unique = 1;
+  for (int i = 1; i < chunk->name_count; i++)
+    if (strcmp(chunk->names[i], chunk->names[unique - 1]) != 0)
+      chunk->names[unique++] = chunk->names[i];
+  chunk->name_count = unique;
+}
+
+/**
+ * 块的语义分析结果是否可能受 changed 里的名字影响
+ */
+static int depends_on(const DocumentChunk *chunk, const char **changed,
+                      int changed_count) {
+  const char *own = declared_name(chunk->decl);
+  for (int i = 0; i < changed_count; i++) {
+    if (own && strcmp(own, changed[i]) == 0)
+      return 1;
+    if (chunk->name_count > 0 &&
+        bsearch(&changed[i], chunk->names, chunk->name_count,
+                sizeof(const char *), compare_names))
+      return 1;
+  }
+  return 0;
+}
+
+// ========== 语法分析 ==========
+
+/**
+ * 收集语法错误：解析 "[Line N] ..." 的行号，其余部分作为信息。
+ * 出错的 Token 是多行的字符串时信息会跨行，后面几行接在上一条后面。
+ */
+static void collect_error(void *user, const char *text) {
+  NoteList *list = (NoteList *)user;
+  int line = 0, prefix = 0;
+  if (sscanf(text, "[Line %d] %n", &line, &prefix) < 1 || prefix == 0) {
+    if (list->count > 0) {
+      Note *note = &list->items[list->count - 1];
+      size_t length = strlen(note->message), extra = strlen(text);
+      note->message = (char *)realloc(note->message, length + extra + 2);
+      note->message[length] = '\n';
+      memcpy(note->message + length + 1, text, extra + 1);
+      return;
+    }
+    prefix = 0;
+  }
+  note_add(list, line, text + prefix);
+}
+
+static int column_at(const char *text, int position) {
+  int column = 1;
+  while (position > 0 && text[position - 1] != '\n') {
+    position--;
+    column++;
+  }
+  return column;
+}
+
+/**
+ * 从第 first 块开始重新语法分析，新的块放进 fresh。
+ * 分析到 changed_end（新源码里改动结束的位置）之后，遇到旧的块边界
+ * （位置差 delta）并且语法分析器状态相同时停下，返回可以复用的第一个
+ * 旧块；一直分析到文件结束时返回 chunk_count。
+ */
+static int reparse(Document *doc, int first, int changed_end, int delta,
+                   ChunkList *fresh) {
+  DocumentChunk *old = doc->chunks;
+  int old_count = doc->chunk_count;
+  int start = 0, line = 1;
+  if (first < old_count) {
+    start = old[first].start;
+    line = old[first].line;
+  }
+
+  Lexer lexer = lexer_init(doc->text);
+  lexer.pos = start;
+  lexer.line = line;
+  lexer.column = column_at(doc->text, start);
+
+  NoteList pending = {NULL, 0, 0};
+  DiagHandler collect = {collect_error, &pending};
+  DiagHandler saved = diag_set_handler(collect);
+  Parser parser = parser_init(&lexer);
+  if (first > 0) {
+    parser.previous.type = old[first - 1].last;
+    parser.panic_mode = old[first - 1].panic;
+  }
+
+  int resume = old_count;
+  for (;;) {
+    DocumentChunk chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.start = start;
+    chunk.line = line;
+    chunk.parsed_line = line;
+    chunk.decl = parser_next_declaration(&parser);
+    chunk.last = parser.previous.type;
+    chunk.panic = parser.panic_mode;
+    chunk.end_line = parser.previous.line - line;
+    chunk.end_column = parser.previous.column + parser.previous.length;
+    for (int i = 0; i < pending.count; i++)
+      note_add(&chunk.parse_errors, pending.items[i].line - line,
+               pending.items[i].message);
+    note_clear(&pending);
+    describe_declaration(&chunk);
+    chunk_push(fresh, &chunk);
+    doc->reparsed++;
+    if (!chunk.decl)
+      break;
+
+    // 下一块从前瞻的 Token 开始
+    start = parser.current.start;
+    line = parser.current.line;
+    // 块里第一行的列号相对行首，这一行上有改动时列号变了，不能复用：
+    // 要等到改动之后换了行的边界
+    if (start >= changed_end &&
+        memchr(doc->text + changed_end, '\n', start - changed_end)) {
+      int j = find_boundary(old, old_count, start - delta);
+      if (j > first && old[j - 1].last == chunk.last &&
+          old[j - 1].panic == chunk.panic) {
+        resume = j;
+        break;
+      }
+    }
+  }
+  diag_set_handler(saved);
+  return resume;
+}
+
+// ========== 语义分析 ==========
+
+static const char *referenced_name(const ASTNode *node) {
+  switch (node->type) {
+  case AST_IDENTIFIER:
+    return node->data.identifier.name;
+  case AST_CALL_EXPR:
+    return node->data.call_expr.callee;
+  case AST_ASSIGN_EXPR:
+    return node->data.assign_expr.name;
+  case AST_PARAM:
+    return node->data.param.name;
+  default:
+    return declared_name(node);
+  }
+}
+
+/**
+ * 悬停提示："int fn0(int p0, int p1)"、"(parameter) int p0"、"(local) int v1"
+ */
+static char *describe_symbol(const Symbol *sym, int global) {
+  Writer *out = writer_memory();
+  if (sym->kind == SYMBOL_FUNCTION) {
+    writer_printf(out, "%s %s(", datatype_to_string(sym->return_type),
+                  sym->name);
+    for (int i = 0; i < sym->param_count; i++)
+      writer_printf(out, "%s%s %s", i ? ", " : "",
+                    datatype_to_string(sym->params[i].type),
+                    sym->params[i].name);
+    writer_putc(out, ')');
+  } else {
+    const char *kind = sym->kind == SYMBOL_PARAMETER ? "parameter"
+                       : global                      ? "global"
+                                                     : "local";
+    writer_printf(out, "(%s) %s %s", kind, datatype_to_string(sym->data_type),
+                  sym->name);
+  }
+  return writer_take(out);
+}
+
+/**
+ * SemanticResolveHandler：记下解析到的名字
+ */
+static void record_reference(void *user, const ASTNode *node, const Symbol *sym,
+                             int global) {
+  ReferenceList *list = (ReferenceList *)user;
+  if (list->count >= list->capacity) {
+    list->capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+    list->items = (Reference *)realloc(list->items,
+                                       sizeof(Reference) * list->capacity);
+  }
+  Reference *ref = &list->items[list->count++];
+  ref->line = node->line;
+  ref->column = node->column;
+  ref->name = referenced_name(node);
+  ref->global = global;
+  ref->decl_line = sym->line;
+  ref->decl_column = sym->column;
+  ref->detail = describe_symbol(sym, global);
+}
+
+static int compare_references(const void *a, const void *b) {
+  const Reference *x = (const Reference *)a, *y = (const Reference *)b;
+  if (x->line != y->line)
+    return x->line < y->line ? -1 : 1;
+  return x->column < y->column ? -1 : x->column > y->column;
+}
+
+/**
+ * 把 analyzer 里的错误移到块上（行号换成相对的）
+ */
+static void take_errors(SemanticAnalyzer *analyzer, DocumentChunk *chunk) {
+  SemanticError *err = analyzer->errors;
+  while (err) {
+    SemanticError *next = err->next;
+    note_add(&chunk->semantic_errors, err->line - chunk->parsed_line,
+             err->message);
+    free(err);
+    err = next;
+  }
+  analyzer->errors = NULL;
+  analyzer->error_count = 0;
+}
+
+/**
+ * 名字到第一个声明它的块（开放寻址，名字指向块的 AST）
+ */
+typedef struct {
+  const char **names;
+  int *chunks;
+  int capacity; // 2 的幂
+} FirstDeclarations;
+
+static unsigned int name_hash(const char *name) {
+  unsigned int h = 0;
+  while (*name)
+    h = h * 31 + (unsigned char)*name++;
+  return h;
+}
+
+/**
+ * name 所在的槽（没有时是应该放它的空槽）
+ */
+static int first_slot(const FirstDeclarations *table, const char *name) {
+  int mask = table->capacity - 1;
+  int slot = (int)(name_hash(name) & (unsigned int)mask);
+  while (table->names[slot] && strcmp(table->names[slot], name) != 0)
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+/**
+ * 声明了 name 的块中位置最前的一个；已经有时保留原来的，和全局作用域一样
+ */
+static void first_add(FirstDeclarations *table, const char *name, int chunk) {
+  int slot = first_slot(table, name);
+  if (!table->names[slot]) {
+    table->names[slot] = name;
+    table->chunks[slot] = chunk;
+  }
+}
+
+/**
+ * 把 chunk 能看到的全局符号放进 analyzer：它引用的名字和它自己的名字
+ * （检查重复声明用）在前面的块里第一次的声明。语义分析只会查找这些名字，
+ * 所以结果和把前面所有的声明都放进去相同。
+ */
+static void declare_visible(const Document *doc,
+                            const FirstDeclarations *table,
+                            const DocumentChunk *chunk,
+                            SemanticAnalyzer *analyzer) {
+  const char *own = declared_name(chunk->decl);
+  for (int i = -1; i < chunk->name_count; i++) {
+    const char *name = i < 0 ? own : chunk->names[i];
+    if (!name)
+      continue;
+    int slot = first_slot(table, name);
+    if (table->names[slot])
+      semantic_declare_declaration(analyzer,
+                                   doc->chunks[table->chunks[slot]].decl);
+  }
+}
+
+/**
+ * 重新语义分析 marked 为 1 的块。前面的块只记下声明的名字，不用把它们
+ * 全部重新声明一遍（有上千个函数时这比分析一个声明还慢）
+ */
+static void reanalyze(Document *doc, const char *marked) {
+  int last = -1;
+  for (int i = 0; i < doc->chunk_count; i++)
+    if (marked[i])
+      last = i;
+  if (last < 0)
+    return;
+
+  FirstDeclarations table;
+  table.capacity = 16;
+  while (table.capacity < 2 * (last + 1))
+    table.capacity *= 2;
+  table.names = (const char **)calloc(table.capacity, sizeof(const char *));
+  table.chunks = (int *)malloc(sizeof(int) * table.capacity);
+
+  for (int i = 0; i <= last; i++) {
+    DocumentChunk *chunk = &doc->chunks[i];
+    if (!chunk->decl)
+      continue;
+    // 有语法错误的声明可能不完整，和普通编译一样不检查（符号照样声明）
+    if (marked[i]) {
+      note_clear(&chunk->semantic_errors);
+      reference_clear(&chunk->references);
+      ir_program_free(chunk->ir);
+      chunk->ir = NULL;
+      doc->reanalyzed++;
+      if (chunk->parse_errors.count == 0) {
+        SemanticAnalyzer *analyzer = semantic_init();
+        declare_visible(doc, &table, chunk, analyzer);
+        analyzer->resolve.resolved = record_reference;
+        analyzer->resolve.user = &chunk->references;
+        semantic_analyze_declaration(analyzer, chunk->decl);
+        take_errors(analyzer, chunk);
+        semantic_free(analyzer);
+        if (chunk->references.count > 0)
+          qsort(chunk->references.items, chunk->references.count,
+                sizeof(Reference), compare_references);
+      }
+    }
+    const char *name = declared_name(chunk->decl);
+    if (name)
+      first_add(&table, name, i);
+  }
+  free(table.names);
+  free(table.chunks);
+}
+
+/**
+ * 用 fresh 替换 [first, resume) 的块，后面的块移动 delta 个字节、
+ * line_delta 行，然后重新做受影响的语义分析
+ */
+static void splice(Document *doc, int first, int resume, ChunkList *fresh,
+                   int delta, int line_delta) {
+  DocumentChunk *old = doc->chunks;
+  int replaced = resume - first;
+
+  // 全局符号有变化时，引用了这些名字的块也要重新分析
+  const char **changed = NULL;
+  int changed_count = 0;
+  int same = replaced == fresh->count;
+  for (int i = 0; same && i < replaced; i++) {
+    const char *a = old[first + i].signature;
+    const char *b = fresh->items[i].signature;
+    same = (!a && !b) || (a && b && strcmp(a, b) == 0);
+  }
+  if (!same) {
+    changed =
+        (const char **)malloc(sizeof(const char *) * (replaced + fresh->count));
+    for (int i = 0; i < replaced; i++)
+      if (old[first + i].signature)
+        changed[changed_count++] = declared_name(old[first + i].decl);
+    for (int i = 0; i < fresh->count; i++)
+      if (fresh->items[i].signature)
+        changed[changed_count++] = declared_name(fresh->items[i].decl);
+  }
+
+  int count = first + fresh->count + (doc->chunk_count - resume);
+  char *marked = (char *)calloc(count > 0 ? count : 1, 1);
+  for (int i = 0; i < fresh->count; i++)
+    marked[first + i] = 1;
+  for (int i = resume; i < doc->chunk_count; i++) {
+    old[i].start += delta;
+    old[i].line += line_delta;
+    if (changed_count > 0 && depends_on(&old[i], changed, changed_count))
+      marked[first + fresh->count + (i - resume)] = 1;
+  }
+
+  // changed 里的名字属于旧块的 AST，用完才能释放旧块
+  free(changed);
+  for (int i = first; i < resume; i++)
+    chunk_free(&old[i]);
+
+  // 原地替换：大文件有上千块，每次编辑都重新分配整个数组也要花时间
+  if (count > doc->chunk_capacity) {
+    while (count > doc->chunk_capacity)
+      doc->chunk_capacity =
+          doc->chunk_capacity == 0 ? 16 : doc->chunk_capacity * 2;
+    doc->chunks = (DocumentChunk *)realloc(
+        doc->chunks, sizeof(DocumentChunk) * doc->chunk_capacity);
+  }
+  if (resume < doc->chunk_count)
+    memmove(doc->chunks + first + fresh->count, doc->chunks + resume,
+            sizeof(DocumentChunk) * (doc->chunk_count - resume));
+  if (fresh->count > 0)
+    memcpy(doc->chunks + first, fresh->items,
+           sizeof(DocumentChunk) * fresh->count);
+  doc->chunk_count = count;
+
+  reanalyze(doc, marked);
+  free(marked);
+}
+
+// ========== 公开接口 ==========
+
+Document *document_open(const char *text, size_t length) {
+  Document *doc = (Document *)calloc(1, sizeof(Document));
+  doc->length = (int)length;
+  doc->capacity = (int)length + 1;
+  doc->text = (char *)malloc(doc->capacity);
+  memcpy(doc->text, text, length);
+  doc->text[length] = '\0';
+
+  ChunkList fresh = {NULL, 0, 0};
+  reparse(doc, 0, doc->length, 0, &fresh);
+  splice(doc, 0, 0, &fresh, 0, 0);
+  free(fresh.items);
+  return doc;
+}
+
+void document_free(Document *doc) {
+  if (!doc)
+    return;
+  for (int i = 0; i < doc->chunk_count; i++)
+    chunk_free(&doc->chunks[i]);
+  free(doc->chunks);
+  free(doc->text);
+  free(doc);
+}
+
+int document_edit(Document *doc, size_t offset, size_t deleted,
+                  const char *inserted, size_t inserted_length) {
+  if (offset > (size_t)doc->length || deleted > (size_t)doc->length - offset)
+    return -1;
+
+  int line_delta = count_lines(inserted, inserted_length) -
+                   count_lines(doc->text + offset, deleted);
+  int delta = (int)inserted_length - (int)deleted;
+  int length = doc->length + delta;
+  if (length + 1 > doc->capacity) {
+    while (length + 1 > doc->capacity)
+      doc->capacity *= 2;
+    doc->text = (char *)realloc(doc->text, doc->capacity);
+  }
+  memmove(doc->text + offset + inserted_length, doc->text + offset + deleted,
+          doc->length - offset - deleted + 1);
+  memcpy(doc->text + offset, inserted, inserted_length);
+  doc->length = length;
+
+  // 前一块结束时读过的前瞻 Token 可能就在改动的位置
+  int first = find_chunk(doc, (int)offset);
+  if (first > 0)
+    first--;
+
+  doc->reparsed = 0;
+  doc->reanalyzed = 0;
+  ChunkList fresh = {NULL, 0, 0};
+  int resume =
+      reparse(doc, first, (int)(offset + inserted_length), delta, &fresh);
+  splice(doc, first, resume, &fresh, delta, line_delta);
+  free(fresh.items);
+  return 0;
+}
+
+static int has_parse_errors(const Document *doc) {
+  for (int i = 0; i < doc->chunk_count; i++)
+    if (doc->chunks[i].parse_errors.count > 0)
+      return 1;
+  return 0;
+}
+
+int document_has_errors(const Document *doc) {
+  for (int i = 0; i < doc->chunk_count; i++)
+    if (doc->chunks[i].parse_errors.count > 0 ||
+        doc->chunks[i].semantic_errors.count > 0)
+      return 1;
+  return 0;
+}
+
+Diagnostic *document_diagnostics(const Document *doc, int *count) {
+  int semantic = !has_parse_errors(doc);
+  int total = 0;
+  for (int i = 0; i < doc->chunk_count; i++)
+    total += semantic ? doc->chunks[i].semantic_errors.count
+                      : doc->chunks[i].parse_errors.count;
+
+  Diagnostic *diagnostics =
+      (Diagnostic *)malloc(sizeof(Diagnostic) * (total > 0 ? total : 1));
+  *count = 0;
+  for (int i = 0; i < doc->chunk_count; i++) {
+    const DocumentChunk *chunk = &doc->chunks[i];
+    const NoteList *notes =
+        semantic ? &chunk->semantic_errors : &chunk->parse_errors;
+    for (int k = 0; k < notes->count; k++) {
+      Diagnostic *diagnostic = &diagnostics[(*count)++];
+      diagnostic->line = chunk->line + notes->items[k].line;
+      diagnostic->semantic = semantic;
+      diagnostic->message = notes->items[k].message;
+    }
+  }
+  return diagnostics;
+}
+
+void document_print_diagnostics(const Document *doc) {
+  int count;
+  Diagnostic *diagnostics = document_diagnostics(doc, &count);
+  for (int i = 0; i < count; i++) {
+    if (diagnostics[i].semantic)
+      diag_printf("[Line %d] Semantic Error: %s\n", diagnostics[i].line,
+                  diagnostics[i].message);
+    else
+      diag_printf("[Line %d] %s\n", diagnostics[i].line,
+                  diagnostics[i].message);
+  }
+  if (count > 0 && diagnostics[0].semantic)
+    diag_printf("Total: %d semantic error(s)\n", count);
+  free(diagnostics);
+}
+
+IRProgram *document_ir(Document *doc) {
+  if (document_has_errors(doc))
+    return NULL;
+
+  // scope 只用来给要重新生成的声明提供前面的全局符号
+  IRProgram *scope = ir_program_create();
+  IRProgram *program = ir_program_create();
+  for (int i = 0; i < doc->chunk_count; i++) {
+    DocumentChunk *chunk = &doc->chunks[i];
+    if (!chunk->decl)
+      continue;
+    if (chunk->ir)
+      ir_declare_declaration(scope, chunk->decl);
+    else
+      chunk->ir = ir_generate_fragment(scope, chunk->decl);
+    ir_append_fragment(program, chunk->ir);
+  }
+  ir_program_free(scope);
+  return program;
+}
+
+// ========== 编辑器的查询 ==========
+
+int document_line_start(const Document *doc, int line) {
+  // 从最后一个起始行不超过 line 的块所在的行首开始数换行
+  int pos = 0, current = 1;
+  int low = 0, high = doc->chunk_count - 1, found = -1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    if (doc->chunks[mid].line <= line) {
+      found = mid;
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  if (found >= 0) {
+    pos = doc->chunks[found].start;
+    current = doc->chunks[found].line;
+    while (pos > 0 && doc->text[pos - 1] != '\n')
+      pos--;
+  }
+  while (current < line && pos < doc->length) {
+    if (doc->text[pos++] == '\n')
+      current++;
+  }
+  return current < line ? doc->length : pos;
+}
+
+/**
+ * 第一个声明了 name 的块，没有时返回 -1
+ */
+static int find_declaration(const Document *doc, const char *name) {
+  for (int i = 0; i < doc->chunk_count; i++) {
+    const char *own = declared_name(doc->chunks[i].decl);
+    if (own && strcmp(own, name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+int document_reference_at(const Document *doc, int line, int column,
+                          DocumentReference *ref) {
+  int offset = document_line_start(doc, line) + column - 1;
+  const DocumentChunk *chunk = &doc->chunks[find_chunk(doc, offset + 1)];
+  int shift = chunk->line - chunk->parsed_line;
+
+  // 光标在名字上或者紧跟在名字后面
+  for (int i = 0; i < chunk->references.count; i++) {
+    const Reference *r = &chunk->references.items[i];
+    int length = (int)strlen(r->name);
+    if (r->line + shift != line || column < r->column ||
+        column > r->column + length)
+      continue;
+
+    ref->line = line;
+    ref->column = r->column;
+    ref->length = length;
+    ref->detail = r->detail;
+    ref->decl_line = 0;
+    ref->decl_column = 0;
+    if (!r->global) {
+      ref->decl_line = r->decl_line + shift;
+      ref->decl_column = r->decl_column;
+    } else {
+      int k = find_declaration(doc, r->name);
+      if (k >= 0) {
+        const DocumentChunk *owner = &doc->chunks[k];
+        ref->decl_line =
+            owner->decl->line + owner->line - owner->parsed_line;
+        ref->decl_column = owner->decl->column;
+      }
+    }
+    return 1;
+  }
+  return 0;
+}
+
+DocumentSymbol *document_symbols(const Document *doc, int *count) {
+  DocumentSymbol *symbols = (DocumentSymbol *)malloc(
+      sizeof(DocumentSymbol) * (doc->chunk_count > 0 ? doc->chunk_count : 1));
+  *count = 0;
+  for (int i = 0; i < doc->chunk_count; i++) {
+    const DocumentChunk *chunk = &doc->chunks[i];
+    const char *name = declared_name(chunk->decl);
+    if (!name)
+      continue;
+    int shift = chunk->line - chunk->parsed_line;
+    DocumentSymbol *symbol = &symbols[(*count)++];
+    symbol->name = name;
+    symbol->detail = chunk->detail;
+    symbol->function = chunk->decl->type == AST_FUNC_DECL;
+    symbol->line = chunk->decl->line + shift;
+    symbol->column = chunk->decl->column;
+    symbol->start_line = chunk->line;
+    symbol->start_column = column_at(doc->text, chunk->start);
+    symbol->end_line = chunk->line + chunk->end_line;
+    symbol->end_column = chunk->end_column;
+  }
+  return symbols;
+}
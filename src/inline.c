@@ -0,0 +1,459 @@
+/**
+ * inline.c - 函数内联实现
+ *
+ * 算法：
+ * 1. 收集所有函数，统计指令数、用到的临时变量/标签范围
+ * 2. 建立调用图，找出递归函数（能沿调用边回到自己）
+ * 3. 重新生成整个程序：复制每个函数时，遇到满足代价模型的调用
+ *    就把被调函数的函数体复制进来（被复制的函数体里的调用同样处理）
+ *
+ * 被复制进来的函数体里的调用也会被内联，每个调用者能增长的指令数有上限，
+ * 嵌套展开的每一层都算在它头上；整个程序的增长也有上限。
+ * 否则 fK(x) { return f(K-1)(x) + f(K-2)(x-1); } 这样的调用链每个函数都
+ * 在预算以内，展开后却是指数级的。
+ *
+ * 复制被调函数时要重命名：
+ * - 临时变量和标签：整体平移到新的编号范围
+ * - 局部变量和形参：加上内联实例编号后缀，例如 n → n.3
+ * - 全局变量和函数名保持不变
+ */
+
+#include "../include/inline.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 非递归的调用链最多展开的深度（防止调用链太长时代码爆炸）
+#define INLINE_MAX_NESTING 16
+// 一个函数内联后最多是原来的几倍（原来很小的按 budget 算）
+#define INLINE_MAX_GROWTH 4
+// 整个程序内联后最多是原来的几倍（不到 INLINE_SMALL_UNIT 条的按它算）
+#define INLINE_UNIT_GROWTH 2
+#define INLINE_SMALL_UNIT 1000
+
+/**
+ * 函数信息（内联用）
+ */
+typedef struct {
+  IRFunction info;
+  int cost;         // 函数体的指令数（不含标签）
+  int min_temp;     // 用到的临时变量编号范围
+  int max_temp;     //   (max < min 表示没有)
+  int min_label;    // 用到的标签编号范围
+  int max_label;    //
+  int *callees;     // 调用图：调用了哪些函数（下标）
+  int callee_count; //
+  int is_recursive; // 能否沿调用边回到自己
+} InlineFunc;
+
+/**
+ * 内联器状态
+ */
+typedef struct {
+  IRProgram *program; // 原程序（只读）
+  IRProgram *out;     // 重新生成的程序
+  InlineOptions options;
+
+  InlineFunc *funcs;
+  int func_count;
+
+  int stack[INLINE_MAX_NESTING + 1]; // 正在展开的函数（下标）
+  int depth;
+
+  int instance_counter; // 内联实例编号
+  int inlined;          // 内联的调用点数量
+
+  int caller_growth; // 当前调用者已经增加的指令数（包括嵌套展开的）
+  int caller_limit;  //   上限
+  int unit_growth;   // 整个程序已经增加的指令数
+  int unit_limit;    //   上限
+} Inliner;
+
+/**
+ * 复制函数体时的重命名规则
+ */
+typedef struct {
+  int instance;     // 内联实例编号（-1 表示不重命名）
+  int temp_offset;  // 临时变量编号平移量
+  int label_offset; // 标签编号平移量
+  IROperand result; // 内联时：返回值保存到这里
+  int end_label;    // 内联时：return 跳到这里
+} Rename;
+
+// ========== 收集函数信息 ==========
+
+static int find_function(Inliner *in, const char *name) {
+  for (int i = 0; i < in->func_count; i++) {
+    if (strcmp(in->funcs[i].info.name, name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+static void note_operand(InlineFunc *fn, IROperand op) {
+  if (op.type == OPERAND_TEMP) {
+    if (op.value.temp_id < fn->min_temp)
+      fn->min_temp = op.value.temp_id;
+    if (op.value.temp_id > fn->max_temp)
+      fn->max_temp = op.value.temp_id;
+  } else if (op.type == OPERAND_LABEL) {
+    if (op.value.label_id < fn->min_label)
+      fn->min_label = op.value.label_id;
+    if (op.value.label_id > fn->max_label)
+      fn->max_label = op.value.label_id;
+  }
+}
+
+static void add_callee(InlineFunc *fn, int callee, int *capacity) {
+  for (int i = 0; i < fn->callee_count; i++) {
+    if (fn->callees[i] == callee)
+      return;
+  }
+  if (fn->callee_count >= *capacity) {
+    *capacity = *capacity == 0 ? 4 : *capacity * 2;
+    fn->callees = (int *)realloc(fn->callees, sizeof(int) * (*capacity));
+  }
+  fn->callees[fn->callee_count++] = callee;
+}
+
+static void analyze_functions(Inliner *in) {
+  IRFunction *infos = NULL;
+  in->func_count = ir_collect_functions(in->program, &infos);
+  in->funcs = (InlineFunc *)calloc(in->func_count ? in->func_count : 1,
+                                   sizeof(InlineFunc));
+
+  for (int f = 0; f < in->func_count; f++) {
+    InlineFunc *fn = &in->funcs[f];
+    fn->info = infos[f];
+    fn->min_temp = in->program->temp_counter;
+    fn->min_label = in->program->label_counter;
+    fn->max_temp = fn->max_label = -1;
+  }
+  free(infos);
+
+  // 统计指令数、编号范围，建立调用图
+  for (int f = 0; f < in->func_count; f++) {
+    InlineFunc *fn = &in->funcs[f];
+    int capacity = 0;
+
+    for (int i = fn->info.begin + 1; i < fn->info.end; i++) {
+      IRInstruction *instr = &in->program->instructions[i];
+      note_operand(fn, instr->result);
+      note_operand(fn, instr->arg1);
+      note_operand(fn, instr->arg2);
+
+      if (instr->opcode != IR_LABEL && instr->opcode != IR_ARG &&
+          instr->opcode != IR_NOP)
+        fn->cost++;
+
+      if (instr->opcode == IR_CALL) {
+        int callee = find_function(in, instr->arg1.value.name);
+        if (callee >= 0)
+          add_callee(fn, callee, &capacity);
+      }
+    }
+  }
+
+  // 找递归函数：从 f 出发沿调用边能回到 f
+  int *visited = (int *)calloc(in->func_count ? in->func_count : 1, sizeof(int));
+  int *worklist = (int *)malloc(sizeof(int) * (in->func_count + 1));
+
+  for (int f = 0; f < in->func_count; f++) {
+    memset(visited, 0, sizeof(int) * in->func_count);
+    int top = 0;
+    worklist[top++] = f;
+
+    while (top > 0 && !in->funcs[f].is_recursive) {
+      InlineFunc *fn = &in->funcs[worklist[--top]];
+      for (int c = 0; c < fn->callee_count; c++) {
+        int callee = fn->callees[c];
+        if (callee == f) {
+          in->funcs[f].is_recursive = 1;
+          break;
+        }
+        if (!visited[callee]) {
+          visited[callee] = 1;
+          worklist[top++] = callee;
+        }
+      }
+    }
+  }
+
+  free(visited);
+  free(worklist);
+}
+
+// ========== 代价模型 ==========
+
+/**
+ * 判断一个调用点是否应该内联
+ */
+static int should_inline(Inliner *in, int callee, int arg_count) {
+  InlineFunc *fn = &in->funcs[callee];
+
+  if (arg_count != fn->info.param_count)
+    return 0;
+  if (in->depth >= INLINE_MAX_NESTING)
+    return 0;
+
+  // 调用本身的开销：n 个 param + call + return
+  int cost = fn->cost - (arg_count + 2);
+  if (cost > in->options.budget)
+    return 0;
+
+  // 嵌套展开也算在调用者和整个程序的增长里
+  if (in->caller_growth + fn->cost > in->caller_limit ||
+      in->unit_growth + fn->cost > in->unit_limit)
+    return 0;
+
+  // 递归函数：统计它已经在展开栈里出现了几次；
+  // max_depth 为 0 时连不递归的调用者里的调用也不展开
+  if (fn->is_recursive) {
+    if (in->options.max_depth == 0)
+      return 0;
+    int occurrences = 0;
+    for (int i = 0; i < in->depth; i++) {
+      if (in->stack[i] == callee)
+        occurrences++;
+    }
+    if (occurrences > in->options.max_depth)
+      return 0;
+  }
+
+  return 1;
+}
+
+// ========== 复制和重命名 ==========
+
+static IROperand rename_operand(IROperand op, const Rename *r) {
+  switch (op.type) {
+  case OPERAND_TEMP:
+    op.value.temp_id += r->temp_offset;
+    return op;
+
+  case OPERAND_LABEL:
+    op.value.label_id += r->label_offset;
+    return op;
+
+  case OPERAND_VAR:
+    if (r->instance >= 0 && !op.is_global) {
+      // 局部变量/形参：加上实例编号后缀
+      size_t len = strlen(op.value.name) + 16;
+      char *name = (char *)malloc(len);
+      snprintf(name, len, "%s.%d", op.value.name, r->instance);
+      IROperand renamed = ir_operand_var(name);
+      renamed.vtype = op.vtype;
+      free(name);
+      return renamed;
+    }
+    return ir_operand_copy(op);
+
+  default:
+    return ir_operand_copy(op);
+  }
+}
+
+static void emit_renamed(Inliner *in, IRInstruction *instr, const Rename *r) {
+  IRInstruction copy = *instr;
+  copy.result = rename_operand(instr->result, r);
+  copy.arg1 = rename_operand(instr->arg1, r);
+  copy.arg2 = rename_operand(instr->arg2, r);
+  ir_emit_instruction(in->out, copy);
+}
+
+static void copy_body(Inliner *in, int f, const Rename *r);
+
+/**
+ * 把函数 callee 内联到当前位置
+ *
+ * params 是输出程序中为这次调用传参的 param 指令下标，
+ * 它们被改写成对（重命名后的）形参的赋值。
+ */
+static void inline_call(Inliner *in, int callee, const int *params,
+                        IROperand result) {
+  InlineFunc *fn = &in->funcs[callee];
+
+  Rename r;
+  r.instance = in->instance_counter++;
+  r.temp_offset = 0;
+  r.label_offset = 0;
+  r.result = result;
+
+  // 临时变量和标签平移到新的编号范围
+  if (fn->max_temp >= fn->min_temp) {
+    r.temp_offset = in->out->temp_counter - fn->min_temp;
+    in->out->temp_counter += fn->max_temp - fn->min_temp + 1;
+  }
+  if (fn->max_label >= fn->min_label) {
+    r.label_offset = in->out->label_counter - fn->min_label;
+    in->out->label_counter += fn->max_label - fn->min_label + 1;
+  }
+  r.end_label = ir_new_label(in->out);
+
+  // 实参 → 形参
+  for (int k = 0; k < fn->info.param_count; k++) {
+    IRInstruction *arg = &in->program->instructions[fn->info.begin + 1 + k];
+    IRInstruction *param = &in->out->instructions[params[k]];
+    param->opcode = IR_ASSIGN;
+    param->result = rename_operand(arg->result, &r);
+  }
+
+  in->caller_growth += fn->cost;
+  in->unit_growth += fn->cost;
+  in->stack[in->depth++] = callee;
+  copy_body(in, callee, &r);
+  in->depth--;
+
+  ir_emit(in->out, IR_LABEL, ir_operand_label(r.end_label), ir_operand_none(),
+          ir_operand_none());
+  in->inlined++;
+}
+
+/**
+ * 复制函数 f 的函数体（不含 FUNC_BEGIN/ARG/FUNC_END），
+ * 同时内联其中满足条件的调用
+ */
+static void copy_body(Inliner *in, int f, const Rename *r) {
+  InlineFunc *fn = &in->funcs[f];
+  int body_begin = fn->info.begin + 1 + fn->info.param_count;
+
+  // 输出程序中还没有被 call 消耗的 param 指令
+  int *pending = NULL;
+  int pending_count = 0;
+  int pending_capacity = 0;
+
+  for (int i = body_begin; i < fn->info.end; i++) {
+    IRInstruction *instr = &in->program->instructions[i];
+
+    switch (instr->opcode) {
+    case IR_PARAM:
+      emit_renamed(in, instr, r);
+      if (pending_count >= pending_capacity) {
+        pending_capacity = pending_capacity == 0 ? 8 : pending_capacity * 2;
+        pending = (int *)realloc(pending, sizeof(int) * pending_capacity);
+      }
+      pending[pending_count++] = in->out->count - 1;
+      break;
+
+    case IR_CALL: {
+      int n = instr->arg_count;
+      int callee = find_function(in, instr->arg1.value.name);
+
+      if (n <= pending_count && callee >= 0 && should_inline(in, callee, n)) {
+        pending_count -= n;
+        inline_call(in, callee, pending + pending_count,
+                    rename_operand(instr->result, r));
+      } else {
+        pending_count = n <= pending_count ? pending_count - n : 0;
+        emit_renamed(in, instr, r);
+      }
+      break;
+    }
+
+    case IR_TAILCALL: {
+      // 尾调用不内联，只消耗它的 param
+      int n = instr->arg_count;
+      pending_count = n <= pending_count ? pending_count - n : 0;
+      emit_renamed(in, instr, r);
+      break;
+    }
+
+    case IR_RETURN:
+      if (r->instance < 0) {
+        emit_renamed(in, instr, r);
+        break;
+      }
+
+      // 内联时：return v → result = v; goto L_end
+      if (instr->arg1.type != OPERAND_NONE) {
+        ir_emit(in->out, IR_ASSIGN, r->result, rename_operand(instr->arg1, r),
+                ir_operand_none());
+      }
+      if (i != fn->info.end - 1) {
+        ir_emit(in->out, IR_GOTO, ir_operand_label(r->end_label),
+                ir_operand_none(), ir_operand_none());
+      }
+      break;
+
+    default:
+      emit_renamed(in, instr, r);
+      break;
+    }
+  }
+
+  free(pending);
+}
+
+// ========== 主要接口 ==========
+
+InlineOptions inline_default_options(void) {
+  InlineOptions options;
+  options.budget = INLINE_DEFAULT_BUDGET;
+  options.max_depth = INLINE_DEFAULT_DEPTH;
+  return options;
+}
+
+int ir_inline(IRProgram *program, InlineOptions options) {
+  if (!program)
+    return 0;
+
+  Inliner in;
+  memset(&in, 0, sizeof(in));
+  in.program = program;
+  in.options = options;
+  analyze_functions(&in);
+  int total_cost = 0;
+  for (int f = 0; f < in.func_count; f++)
+    total_cost += in.funcs[f].cost;
+  in.unit_limit =
+      (total_cost > INLINE_SMALL_UNIT ? total_cost : INLINE_SMALL_UNIT) *
+      (INLINE_UNIT_GROWTH - 1);
+
+  in.out = ir_program_create();
+  in.out->temp_counter = program->temp_counter;
+  in.out->label_counter = program->label_counter;
+
+  Rename identity;
+  memset(&identity, 0, sizeof(identity));
+  identity.instance = -1;
+
+  int f = 0;
+  for (int i = 0; i < program->count; i++) {
+    IRInstruction *instr = &program->instructions[i];
+
+    if (instr->opcode != IR_FUNC_BEGIN || f >= in.func_count) {
+      // 函数之外的指令（全局变量初始化）原样复制
+      emit_renamed(&in, instr, &identity);
+      continue;
+    }
+
+    InlineFunc *fn = &in.funcs[f];
+
+    // FUNC_BEGIN 和形参声明
+    for (int k = fn->info.begin; k <= fn->info.begin + fn->info.param_count;
+         k++) {
+      emit_renamed(&in, &program->instructions[k], &identity);
+    }
+
+    in.stack[0] = f;
+    in.depth = 1;
+    in.caller_growth = 0;
+    in.caller_limit = (fn->cost > options.budget ? fn->cost : options.budget) *
+                      (INLINE_MAX_GROWTH - 1);
+    copy_body(&in, f, &identity);
+
+    if (fn->info.end < program->count)
+      emit_renamed(&in, &program->instructions[fn->info.end], &identity);
+
+    i = fn->info.end;
+    f++;
+  }
+
+  for (int i = 0; i < in.func_count; i++)
+    free(in.funcs[i].callees);
+  free(in.funcs);
+
+  ir_program_replace(program, in.out);
+  return in.inlined;
+}
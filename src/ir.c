@@ -11,6 +11,7 @@
  */
 
 #include "../include/ir.h"
+#include "../include/memory.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -59,6 +60,7 @@ IROperand ir_operand_int(int val) {
 IROperand ir_operand_float(double val) {
   IROperand op = {0};
   op.type = OPERAND_FLOAT;
+  op.vtype = IR_TYPE_FLOAT;
   op.value.float_val = val;
   return op;
 }
@@ -77,6 +79,22 @@ IROperand ir_operand_func(const char *name) {
   return op;
 }
 
+static int operand_owns_name(IROperand op) {
+  return op.type == OPERAND_VAR || op.type == OPERAND_FUNC;
+}
+
+IROperand ir_operand_copy(IROperand op) {
+  if (operand_owns_name(op))
+    op.value.name = str_dup(op.value.name);
+  return op;
+}
+
+void ir_operand_free(IROperand *op) {
+  if (operand_owns_name(*op))
+    free(op->value.name);
+  *op = ir_operand_none();
+}
+
 // ========== IR 程序操作 ==========
 
 IRProgram *ir_program_create(void) {
@@ -87,6 +105,9 @@ IRProgram *ir_program_create(void) {
     program->capacity = 0;
     program->temp_counter = 0;
     program->label_counter = 0;
+    program->symbols = NULL;
+    program->symbol_count = 0;
+    program->symbol_capacity = 0;
   }
   return program;
 }
@@ -97,18 +118,36 @@ void ir_program_free(IRProgram *program) {
 
   for (int i = 0; i < program->count; i++) {
     IRInstruction *instr = &program->instructions[i];
-    if (instr->result.type == OPERAND_VAR || instr->result.type == OPERAND_FUNC)
-      free(instr->result.value.name);
-    if (instr->arg1.type == OPERAND_VAR || instr->arg1.type == OPERAND_FUNC)
-      free(instr->arg1.value.name);
-    if (instr->arg2.type == OPERAND_VAR || instr->arg2.type == OPERAND_FUNC)
-      free(instr->arg2.value.name);
+    ir_operand_free(&instr->result);
+    ir_operand_free(&instr->arg1);
+    ir_operand_free(&instr->arg2);
   }
 
+  for (int i = 0; i < program->symbol_count; i++)
+    free(program->symbols[i].name);
+  free(program->symbols);
+
   free(program->instructions);
   free(program);
 }
 
+void ir_program_replace(IRProgram *program, IRProgram *rebuilt) {
+  IRInstruction *old = program->instructions;
+  int old_count = program->count;
+  int old_capacity = program->capacity;
+
+  program->instructions = rebuilt->instructions;
+  program->count = rebuilt->count;
+  program->capacity = rebuilt->capacity;
+  program->temp_counter = rebuilt->temp_counter;
+  program->label_counter = rebuilt->label_counter;
+
+  rebuilt->instructions = old;
+  rebuilt->count = old_count;
+  rebuilt->capacity = old_capacity;
+  ir_program_free(rebuilt);
+}
+
 IROperand ir_new_temp(IRProgram *program) {
   return ir_operand_temp(program->temp_counter++);
 }
@@ -133,30 +172,113 @@ void ir_emit(IRProgram *program, IROpcode op, IROperand result, IROperand arg1,
   instr->arg_count = 0;
 }
 
+// 发射一条完整的指令（操作数的所有权转移给 program）
+void ir_emit_instruction(IRProgram *program, IRInstruction instr) {
+  ir_emit(program, instr.opcode, instr.result, instr.arg1, instr.arg2);
+  program->instructions[program->count - 1].arg_count = instr.arg_count;
+}
+
 // 发射带参数数量的指令（用于函数调用）
 static void ir_emit_call(IRProgram *program, IROperand result, IROperand func,
                          int arg_count) {
-  if (program->count >= program->capacity) {
-    int new_cap = program->capacity == 0 ? 64 : program->capacity * 2;
-    program->instructions = (IRInstruction *)realloc(
-        program->instructions, sizeof(IRInstruction) * new_cap);
-    program->capacity = new_cap;
+  ir_emit(program, IR_CALL, result, func, ir_operand_none());
+  program->instructions[program->count - 1].arg_count = arg_count;
+}
+
+// ========== 符号（区分全局/局部变量，记录类型） ==========
+
+static IRValueType type_from_string(const char *type) {
+  return type && strcmp(type, "float") == 0 ? IR_TYPE_FLOAT : IR_TYPE_INT;
+}
+
+/**
+ * 声明符号：全局变量、函数、形参或函数内的变量声明
+ */
+static void declare_symbol(IRProgram *program, const char *name,
+                           const char *type, int is_global, int is_function) {
+  if (program->symbol_count >= program->symbol_capacity) {
+    int new_cap =
+        program->symbol_capacity == 0 ? 16 : program->symbol_capacity * 2;
+    program->symbols =
+        (IRSymbol *)realloc(program->symbols, sizeof(IRSymbol) * new_cap);
+    program->symbol_capacity = new_cap;
+  }
+  // 先找外层的同名局部变量（在加入新符号之前，数组可能刚扩容）
+  int shadow = 0;
+  if (!is_global && !is_function) {
+    for (int i = program->symbol_count - 1; i >= 0; i--) {
+      IRSymbol *outer = &program->symbols[i];
+      if (!outer->is_function && strcmp(outer->name, name) == 0) {
+        shadow = outer->is_global ? 0 : outer->shadow + 1;
+        break;
+      }
+    }
   }
+  IRSymbol *sym = &program->symbols[program->symbol_count++];
+  sym->name = str_dup(name);
+  sym->type = type_from_string(type);
+  sym->is_global = is_global;
+  sym->is_function = is_function;
+  sym->shadow = shadow;
+}
 
-  IRInstruction *instr = &program->instructions[program->count++];
-  instr->opcode = IR_CALL;
-  instr->result = result;
-  instr->arg1 = func;
-  instr->arg2 = ir_operand_none();
-  instr->arg_count = arg_count;
+/**
+ * 离开作用域：弹出该作用域内声明的符号
+ */
+static void pop_symbols(IRProgram *program, int saved_count) {
+  while (program->symbol_count > saved_count)
+    free(program->symbols[--program->symbol_count].name);
+}
+
+static IRSymbol *lookup_symbol(IRProgram *program, const char *name,
+                               int is_function) {
+  for (int i = program->symbol_count - 1; i >= 0; i--) {
+    IRSymbol *sym = &program->symbols[i];
+    if (sym->is_function == is_function && strcmp(sym->name, name) == 0)
+      return sym;
+  }
+  return NULL;
+}
+
+/**
+ * 变量操作数：带上类型和是否是全局变量
+ */
+static IROperand var_operand(IRProgram *program, const char *name) {
+  IRSymbol *sym = lookup_symbol(program, name, 0);
+  IROperand op;
+  if (sym && sym->shadow) {
+    // '#' 不会出现在源码的名字里，也和内联的实例后缀 ".N"（inline.c）不同
+    char renamed[MAX_TOKEN_LENGTH + 16];
+    snprintf(renamed, sizeof(renamed), "%s#%d", name, sym->shadow);
+    op = ir_operand_var(renamed);
+  } else {
+    op = ir_operand_var(name);
+  }
+  op.is_global = sym ? sym->is_global : 1;
+  op.vtype = sym ? sym->type : IR_TYPE_INT;
+  return op;
+}
+
+/**
+ * 指定类型的新临时变量
+ */
+static IROperand typed_temp(IRProgram *program, IRValueType type) {
+  IROperand temp = ir_new_temp(program);
+  temp.vtype = type;
+  return temp;
 }
 
 // ========== AST 到 IR 翻译 ==========
 
 // 前向声明
 static IROperand translate_expression(IRProgram *program, ASTNode *node);
+static void translate_condition(IRProgram *program, ASTNode *node,
+                                int label_true, int label_false);
 static void translate_statement(IRProgram *program, ASTNode *node);
 
+// 表示"不跳转，顺序执行下去"的标签
+#define LABEL_FALLTHROUGH -1
+
 /**
  * 将二元操作符转换为 IR 操作码
  */
@@ -184,15 +306,141 @@ static IROpcode binary_op_to_ir(BinaryOp op) {
     return IR_LE;
   case OP_GE:
     return IR_GE;
-  case OP_AND:
-    return IR_AND;
-  case OP_OR:
-    return IR_OR;
   default:
+    // && 和 || 需要短路求值，不能映射成普通运算，
+    // 由 translate_logical / translate_condition 处理
     return IR_NOP;
   }
 }
 
+/**
+ * 是否是逻辑运算（&&、||、!）
+ */
+static int is_logical_expr(ASTNode *node) {
+  if (!node)
+    return 0;
+  if (node->type == AST_BINARY_EXPR)
+    return node->data.binary_expr.op == OP_AND ||
+           node->data.binary_expr.op == OP_OR;
+  if (node->type == AST_UNARY_EXPR)
+    return node->data.unary_expr.op == OP_NOT;
+  return 0;
+}
+
+static void emit_label(IRProgram *program, int label) {
+  ir_emit(program, IR_LABEL, ir_operand_label(label), ir_operand_none(),
+          ir_operand_none());
+}
+
+static void emit_goto(IRProgram *program, int label) {
+  ir_emit(program, IR_GOTO, ir_operand_label(label), ir_operand_none(),
+          ir_operand_none());
+}
+
+/**
+ * 把条件翻译成跳转链（短路求值）
+ *
+ * 条件为真跳到 label_true，为假跳到 label_false；
+ * 其中一个可以是 LABEL_FALLTHROUGH，表示这种情况下顺序执行。
+ *
+ * 例如 if (a && b) 生成：
+ *   iffalse a goto L_else
+ *   iffalse b goto L_else
+ *   <then 分支>
+ * a 为假时 b 根本不会被求值，也不需要保存布尔结果的临时变量。
+ */
+static void translate_condition(IRProgram *program, ASTNode *node,
+                                int label_true, int label_false) {
+  if (!node)
+    return;
+
+  if (node->type == AST_BINARY_EXPR && node->data.binary_expr.op == OP_AND) {
+    // 左边为假：整个表达式为假；左边为真：继续看右边
+    int label_skip = label_false;
+    if (label_skip == LABEL_FALLTHROUGH)
+      label_skip = ir_new_label(program);
+
+    translate_condition(program, node->data.binary_expr.left,
+                        LABEL_FALLTHROUGH, label_skip);
+    translate_condition(program, node->data.binary_expr.right, label_true,
+                        label_false);
+
+    if (label_false == LABEL_FALLTHROUGH)
+      emit_label(program, label_skip);
+    return;
+  }
+
+  if (node->type == AST_BINARY_EXPR && node->data.binary_expr.op == OP_OR) {
+    // 左边为真：整个表达式为真；左边为假：继续看右边
+    int label_skip = label_true;
+    if (label_skip == LABEL_FALLTHROUGH)
+      label_skip = ir_new_label(program);
+
+    translate_condition(program, node->data.binary_expr.left, label_skip,
+                        LABEL_FALLTHROUGH);
+    translate_condition(program, node->data.binary_expr.right, label_true,
+                        label_false);
+
+    if (label_true == LABEL_FALLTHROUGH)
+      emit_label(program, label_skip);
+    return;
+  }
+
+  if (node->type == AST_UNARY_EXPR && node->data.unary_expr.op == OP_NOT) {
+    // !cond：交换真假出口即可
+    translate_condition(program, node->data.unary_expr.operand, label_false,
+                        label_true);
+    return;
+  }
+
+  if (node->type == AST_INT_LITERAL) {
+    // 常量条件：直接决定跳转方向
+    int target = node->data.int_literal.value ? label_true : label_false;
+    if (target != LABEL_FALLTHROUGH)
+      emit_goto(program, target);
+    return;
+  }
+
+  // 其他表达式：先求值，再根据结果跳转
+  IROperand cond = translate_expression(program, node);
+
+  if (label_true != LABEL_FALLTHROUGH) {
+    ir_emit(program, IR_IF, ir_operand_label(label_true), cond,
+            ir_operand_none());
+    if (label_false != LABEL_FALLTHROUGH)
+      emit_goto(program, label_false);
+  } else if (label_false != LABEL_FALLTHROUGH) {
+    ir_emit(program, IR_IFFALSE, ir_operand_label(label_false), cond,
+            ir_operand_none());
+  }
+}
+
+/**
+ * 在需要值的地方翻译 &&、||
+ *
+ *   <条件跳转链, 为假跳到 L_false>
+ *   t = 1
+ *   goto L_end
+ * L_false:
+ *   t = 0
+ * L_end:
+ */
+static IROperand translate_logical(IRProgram *program, ASTNode *node) {
+  IROperand result = ir_new_temp(program);
+  int label_false = ir_new_label(program);
+  int label_end = ir_new_label(program);
+
+  translate_condition(program, node, LABEL_FALLTHROUGH, label_false);
+  ir_emit(program, IR_ASSIGN, result, ir_operand_int(1), ir_operand_none());
+  emit_goto(program, label_end);
+
+  emit_label(program, label_false);
+  ir_emit(program, IR_ASSIGN, result, ir_operand_int(0), ir_operand_none());
+  emit_label(program, label_end);
+
+  return result;
+}
+
 /**
  * 翻译表达式，返回保存结果的操作数
  */
@@ -210,19 +458,34 @@ static IROperand translate_expression(IRProgram *program, ASTNode *node) {
     return ir_operand_float(node->data.float_literal.value);
   }
 
+  case AST_CHAR_LITERAL: {
+    // 字符按整数处理
+    return ir_operand_int((unsigned char)node->data.char_literal.value);
+  }
+
   case AST_IDENTIFIER: {
     // 变量：直接返回变量名
-    return ir_operand_var(node->data.identifier.name);
+    return var_operand(program, node->data.identifier.name);
   }
 
   case AST_BINARY_EXPR: {
+    // && 和 ||：短路求值，右操作数可能不执行
+    if (is_logical_expr(node))
+      return translate_logical(program, node);
+
     // 二元表达式：先翻译两个操作数，再生成运算指令
     IROperand left = translate_expression(program, node->data.binary_expr.left);
     IROperand right =
         translate_expression(program, node->data.binary_expr.right);
-    IROperand result = ir_new_temp(program);
 
+    // 算术运算：有一边是浮点结果就是浮点；比较运算的结果是整数
     IROpcode op = binary_op_to_ir(node->data.binary_expr.op);
+    IRValueType type = IR_TYPE_INT;
+    if (op >= IR_ADD && op <= IR_MOD &&
+        (left.vtype == IR_TYPE_FLOAT || right.vtype == IR_TYPE_FLOAT))
+      type = IR_TYPE_FLOAT;
+    IROperand result = typed_temp(program, type);
+
     ir_emit(program, op, result, left, right);
 
     return result;
@@ -231,7 +494,9 @@ static IROperand translate_expression(IRProgram *program, ASTNode *node) {
   case AST_UNARY_EXPR: {
     IROperand operand =
         translate_expression(program, node->data.unary_expr.operand);
-    IROperand result = ir_new_temp(program);
+    IROperand result = typed_temp(
+        program,
+        node->data.unary_expr.op == OP_NEG ? operand.vtype : IR_TYPE_INT);
 
     if (node->data.unary_expr.op == OP_NEG) {
       ir_emit(program, IR_NEG, result, operand, ir_operand_none());
@@ -246,7 +511,7 @@ static IROperand translate_expression(IRProgram *program, ASTNode *node) {
     // 赋值表达式
     IROperand value =
         translate_expression(program, node->data.assign_expr.value);
-    IROperand var = ir_operand_var(node->data.assign_expr.name);
+    IROperand var = var_operand(program, node->data.assign_expr.name);
     ir_emit(program, IR_ASSIGN, var, value, ir_operand_none());
     return var;
   }
@@ -263,7 +528,9 @@ static IROperand translate_expression(IRProgram *program, ASTNode *node) {
     }
 
     // 调用函数
-    IROperand result = ir_new_temp(program);
+    IRSymbol *callee = lookup_symbol(program, node->data.call_expr.callee, 1);
+    IROperand result =
+        typed_temp(program, callee ? callee->type : IR_TYPE_INT);
     IROperand func = ir_operand_func(node->data.call_expr.callee);
     ir_emit_call(program, result, func, arg_count);
 
@@ -284,18 +551,24 @@ static void translate_statement(IRProgram *program, ASTNode *node) {
 
   switch (node->type) {
   case AST_BLOCK: {
+    int saved_symbols = program->symbol_count;
     for (int i = 0; i < node->data.block.count; i++) {
       translate_statement(program, node->data.block.statements[i]);
     }
+    pop_symbols(program, saved_symbols);
     break;
   }
 
   case AST_VAR_DECL: {
+    // 函数内的变量声明是局部变量（顶层的见 translate_global_var）
+    declare_symbol(program, node->data.var_decl.name,
+                   node->data.var_decl.type, 0, 0);
+
     // 变量声明：如果有初始化，生成赋值
     if (node->data.var_decl.initializer) {
       IROperand value =
           translate_expression(program, node->data.var_decl.initializer);
-      IROperand var = ir_operand_var(node->data.var_decl.name);
+      IROperand var = var_operand(program, node->data.var_decl.name);
       ir_emit(program, IR_ASSIGN, var, value, ir_operand_none());
     }
     break;
@@ -310,8 +583,7 @@ static void translate_statement(IRProgram *program, ASTNode *node) {
     // if (cond) then_branch else else_branch
     //
     // 生成代码：
-    //   <翻译 cond>
-    //   iffalse cond goto L_else
+    //   <cond 的跳转链，为假跳到 L_else>
     //   <翻译 then_branch>
     //   goto L_end
     // L_else:
@@ -321,13 +593,9 @@ static void translate_statement(IRProgram *program, ASTNode *node) {
     int label_else = ir_new_label(program);
     int label_end = ir_new_label(program);
 
-    // 翻译条件
-    IROperand cond =
-        translate_expression(program, node->data.if_stmt.condition);
-
-    // 条件为假跳到 else
-    ir_emit(program, IR_IFFALSE, ir_operand_label(label_else), cond,
-            ir_operand_none());
+    // 翻译条件：条件为假跳到 else
+    translate_condition(program, node->data.if_stmt.condition,
+                        LABEL_FALLTHROUGH, label_else);
 
     // then 分支
     translate_statement(program, node->data.if_stmt.then_branch);
@@ -360,8 +628,7 @@ static void translate_statement(IRProgram *program, ASTNode *node) {
     //
     // 生成代码：
     // L_start:
-    //   <翻译 cond>
-    //   iffalse cond goto L_end
+    //   <cond 的跳转链，为假跳到 L_end>
     //   <翻译 body>
     //   goto L_start
     // L_end:
@@ -373,13 +640,9 @@ static void translate_statement(IRProgram *program, ASTNode *node) {
     ir_emit(program, IR_LABEL, ir_operand_label(label_start), ir_operand_none(),
             ir_operand_none());
 
-    // 翻译条件
-    IROperand cond =
-        translate_expression(program, node->data.while_stmt.condition);
-
-    // 条件为假跳出循环
-    ir_emit(program, IR_IFFALSE, ir_operand_label(label_end), cond,
-            ir_operand_none());
+    // 翻译条件：条件为假跳出循环
+    translate_condition(program, node->data.while_stmt.condition,
+                        LABEL_FALLTHROUGH, label_end);
 
     // 循环体
     translate_statement(program, node->data.while_stmt.body);
@@ -394,6 +657,49 @@ static void translate_statement(IRProgram *program, ASTNode *node) {
     break;
   }
 
+  case AST_FOR_STMT: {
+    // for (init; cond; update) body
+    //
+    // 生成翻转后的循环（条件在循环底部），每次迭代只有一个条件跳转：
+    //   <翻译 init>
+    //   <cond 的跳转链，为假跳到 L_end>      进入前的检查
+    // L_preheader:                           唯一进入循环的地方
+    // L_body:                                循环头
+    //   <翻译 body>
+    // L_latch:                               唯一跳回循环头的地方
+    //   <翻译 update>
+    //   <cond 的跳转链，为真跳到 L_body>
+    // L_end:
+    // 没有条件时省略检查，底部是 goto L_body
+
+    int saved_symbols = program->symbol_count; // init 里声明的变量
+    ASTNode *condition = node->data.for_stmt.condition;
+    int label_preheader = ir_new_label(program);
+    int label_body = ir_new_label(program);
+    int label_latch = ir_new_label(program);
+    int label_end = ir_new_label(program);
+
+    translate_statement(program, node->data.for_stmt.init);
+    if (condition)
+      translate_condition(program, condition, LABEL_FALLTHROUGH, label_end);
+    emit_label(program, label_preheader);
+
+    emit_label(program, label_body);
+    translate_statement(program, node->data.for_stmt.body);
+
+    emit_label(program, label_latch);
+    if (node->data.for_stmt.update)
+      translate_expression(program, node->data.for_stmt.update);
+    if (condition)
+      translate_condition(program, condition, label_body, LABEL_FALLTHROUGH);
+    else
+      emit_goto(program, label_body);
+
+    emit_label(program, label_end);
+    pop_symbols(program, saved_symbols);
+    break;
+  }
+
   case AST_RETURN_STMT: {
     if (node->data.return_stmt.value) {
       IROperand value =
@@ -418,20 +724,53 @@ static void translate_function(IRProgram *program, ASTNode *node) {
   if (!node || node->type != AST_FUNC_DECL)
     return;
 
-  // 函数开始
-  ir_emit(program, IR_FUNC_BEGIN, ir_operand_func(node->data.func_decl.name),
-          ir_operand_none(), ir_operand_none());
+  // 先声明函数本身（递归调用时需要知道返回类型）
+  declare_symbol(program, node->data.func_decl.name,
+                 node->data.func_decl.return_type, 1, 1);
+  int saved_symbols = program->symbol_count;
+
+  // 函数开始（函数名操作数的类型是返回类型）
+  IROperand func = ir_operand_func(node->data.func_decl.name);
+  func.vtype = type_from_string(node->data.func_decl.return_type);
+  ir_emit(program, IR_FUNC_BEGIN, func, ir_operand_none(), ir_operand_none());
+  program->instructions[program->count - 1].arg_count =
+      node->data.func_decl.param_count;
+
+  // 形参：arg a, arg b, ...
+  for (int i = 0; i < node->data.func_decl.param_count; i++) {
+    ASTNode *param = node->data.func_decl.params[i];
+    declare_symbol(program, param->data.param.name, param->data.param.type, 0,
+                   0);
+    ir_emit(program, IR_ARG, var_operand(program, param->data.param.name),
+            ir_operand_int(i), ir_operand_none());
+  }
 
   // 翻译函数体
   if (node->data.func_decl.body) {
     translate_statement(program, node->data.func_decl.body);
   }
+  pop_symbols(program, saved_symbols);
 
   // 函数结束
   ir_emit(program, IR_FUNC_END, ir_operand_func(node->data.func_decl.name),
           ir_operand_none(), ir_operand_none());
 }
 
+/**
+ * 翻译全局变量声明：初始化代码放在所有函数之外
+ */
+static void translate_global_var(IRProgram *program, ASTNode *node) {
+  declare_symbol(program, node->data.var_decl.name, node->data.var_decl.type, 1,
+                 0);
+  if (!node->data.var_decl.initializer)
+    return;
+
+  IROperand value =
+      translate_expression(program, node->data.var_decl.initializer);
+  IROperand var = var_operand(program, node->data.var_decl.name);
+  ir_emit(program, IR_ASSIGN, var, value, ir_operand_none());
+}
+
 /**
  * 翻译整个程序
  */
@@ -443,17 +782,133 @@ IRProgram *ir_generate(ASTNode *ast) {
 
   // 翻译每个顶层声明
   for (int i = 0; i < ast->data.program.count; i++) {
-    ASTNode *decl = ast->data.program.declarations[i];
-    if (decl->type == AST_FUNC_DECL) {
-      translate_function(program, decl);
-    } else if (decl->type == AST_VAR_DECL) {
-      translate_statement(program, decl);
-    }
+    ir_generate_declaration(program, ast->data.program.declarations[i]);
   }
 
   return program;
 }
 
+/**
+ * 只声明顶层声明的符号，不生成指令
+ */
+void ir_declare_declaration(IRProgram *program, ASTNode *decl) {
+  if (decl->type == AST_FUNC_DECL) {
+    declare_symbol(program, decl->data.func_decl.name,
+                   decl->data.func_decl.return_type, 1, 1);
+  } else if (decl->type == AST_VAR_DECL) {
+    declare_symbol(program, decl->data.var_decl.name, decl->data.var_decl.type,
+                   1, 0);
+  }
+}
+
+/**
+ * 把一个顶层声明追加到 program
+ */
+void ir_generate_declaration(IRProgram *program, ASTNode *decl) {
+  if (decl->type == AST_FUNC_DECL) {
+    translate_function(program, decl);
+  } else if (decl->type == AST_VAR_DECL) {
+    translate_global_var(program, decl);
+  }
+}
+
+IRProgram *ir_generate_fragment(IRProgram *scope, ASTNode *decl) {
+  scope->temp_counter = 0;
+  scope->label_counter = 0;
+  ir_generate_declaration(scope, decl);
+  IRProgram *fragment = ir_program_create();
+  fragment->instructions = scope->instructions;
+  fragment->count = scope->count;
+  fragment->capacity = scope->capacity;
+  fragment->temp_counter = scope->temp_counter;
+  fragment->label_counter = scope->label_counter;
+  scope->instructions = NULL;
+  scope->count = 0;
+  scope->capacity = 0;
+  return fragment;
+}
+
+/**
+ * 片段的临时变量和标签编号接在 program 已有的后面
+ */
+static void shift_operand(IROperand *op, const IRProgram *program) {
+  if (op->type == OPERAND_TEMP)
+    op->value.temp_id += program->temp_counter;
+  else if (op->type == OPERAND_LABEL)
+    op->value.label_id += program->label_counter;
+}
+
+void ir_append_fragment(IRProgram *program, const IRProgram *fragment) {
+  for (int i = 0; i < fragment->count; i++) {
+    IRInstruction instr = fragment->instructions[i];
+    IROperand *operands[3] = {&instr.result, &instr.arg1, &instr.arg2};
+    for (int k = 0; k < 3; k++) {
+      *operands[k] = ir_operand_copy(*operands[k]);
+      shift_operand(operands[k], program);
+    }
+    ir_emit_instruction(program, instr);
+  }
+  program->temp_counter += fragment->temp_counter;
+  program->label_counter += fragment->label_counter;
+}
+
+void ir_take_fragment(IRProgram *program, IRProgram *fragment) {
+  if (program->count + fragment->count > program->capacity) {
+    int new_cap = program->capacity == 0 ? 64 : program->capacity;
+    while (new_cap < program->count + fragment->count)
+      new_cap *= 2;
+    program->instructions = (IRInstruction *)realloc(
+        program->instructions, sizeof(IRInstruction) * new_cap);
+    program->capacity = new_cap;
+  }
+  for (int i = 0; i < fragment->count; i++) {
+    IRInstruction *instr = &fragment->instructions[i];
+    shift_operand(&instr->result, program);
+    shift_operand(&instr->arg1, program);
+    shift_operand(&instr->arg2, program);
+  }
+  memcpy(program->instructions + program->count, fragment->instructions,
+         sizeof(IRInstruction) * fragment->count);
+  program->count += fragment->count;
+  program->temp_counter += fragment->temp_counter;
+  program->label_counter += fragment->label_counter;
+  fragment->count = 0; // 操作数已经归 program 了
+  ir_program_free(fragment);
+}
+
+// ========== 按函数遍历 ==========
+
+int ir_collect_functions(IRProgram *program, IRFunction **functions) {
+  int count = 0;
+  int capacity = 0;
+  *functions = NULL;
+
+  for (int i = 0; i < program->count; i++) {
+    if (program->instructions[i].opcode != IR_FUNC_BEGIN)
+      continue;
+
+    if (count >= capacity) {
+      capacity = capacity == 0 ? 8 : capacity * 2;
+      *functions =
+          (IRFunction *)realloc(*functions, sizeof(IRFunction) * capacity);
+    }
+
+    IRFunction *func = &(*functions)[count++];
+    func->name = program->instructions[i].result.value.name;
+    func->begin = i;
+    func->param_count = program->instructions[i].arg_count;
+
+    // 找到对应的 FUNC_END（函数不会嵌套）
+    int j = i + 1;
+    while (j < program->count && program->instructions[j].opcode != IR_FUNC_END)
+      j++;
+    func->end = j;
+    i = j;
+  }
+
+  return count;
+}
+
 // ========== 打印 IR ==========
 
 const char *ir_opcode_to_string(IROpcode op) {
@@ -472,6 +927,14 @@ const char *ir_opcode_to_string(IROpcode op) {
     return "MOD";
   case IR_NEG:
     return "NEG";
+  case IR_SHL:
+    return "SHL";
+  case IR_SHR:
+    return "SHR";
+  case IR_USHR:
+    return "USHR";
+  case IR_BAND:
+    return "BAND";
   case IR_EQ:
     return "EQ";
   case IR_NE:
@@ -502,12 +965,16 @@ const char *ir_opcode_to_string(IROpcode op) {
     return "FUNC_BEGIN";
   case IR_FUNC_END:
     return "FUNC_END";
+  case IR_ARG:
+    return "ARG";
   case IR_PARAM:
     return "PARAM";
   case IR_CALL:
     return "CALL";
   case IR_RETURN:
     return "RETURN";
+  case IR_TAILCALL:
+    return "TAILCALL";
   case IR_NOP:
     return "NOP";
   default:
@@ -515,129 +982,158 @@ const char *ir_opcode_to_string(IROpcode op) {
   }
 }
 
-static void print_operand(IROperand op) {
+static void print_operand(Writer *out, IROperand op) {
   switch (op.type) {
   case OPERAND_NONE:
     break;
   case OPERAND_TEMP:
-    printf("t%d", op.value.temp_id);
+    writer_putc(out, 't');
+    writer_int(out, op.value.temp_id);
     break;
   case OPERAND_VAR:
   case OPERAND_FUNC:
-    printf("%s", op.value.name);
+    writer_puts(out, op.value.name);
     break;
   case OPERAND_INT:
-    printf("%d", op.value.int_val);
+    writer_int(out, op.value.int_val);
     break;
   case OPERAND_FLOAT:
-    printf("%.2f", op.value.float_val);
+    writer_fixed(out, op.value.float_val, 2);
     break;
   case OPERAND_LABEL:
-    printf("L%d", op.value.label_id);
+    writer_putc(out, 'L');
+    writer_int(out, op.value.label_id);
     break;
   }
 }
 
-void ir_print(IRProgram *program) {
+void ir_dump(const IRProgram *program, Writer *out) {
   if (!program)
     return;
 
-  printf("IR Instructions (%d total):\n", program->count);
-  printf("========================================\n");
+  writer_puts(out, "IR Instructions (");
+  writer_int(out, program->count);
+  writer_puts(out, " total):\n");
+  writer_puts(out, "========================================\n");
 
   for (int i = 0; i < program->count; i++) {
-    IRInstruction *instr = &program->instructions[i];
+    const IRInstruction *instr = &program->instructions[i];
 
-    printf("%4d: ", i);
+    writer_int_width(out, i, 4);
+    writer_puts(out, ": ");
 
     switch (instr->opcode) {
     case IR_LABEL:
-      print_operand(instr->result);
-      printf(":\n");
+      print_operand(out, instr->result);
+      writer_puts(out, ":\n");
       break;
 
     case IR_GOTO:
-      printf("goto ");
-      print_operand(instr->result);
-      printf("\n");
+      writer_puts(out, "goto ");
+      print_operand(out, instr->result);
+      writer_putc(out, '\n');
       break;
 
     case IR_IF:
-      printf("if ");
-      print_operand(instr->arg1);
-      printf(" goto ");
-      print_operand(instr->result);
-      printf("\n");
+      writer_puts(out, "if ");
+      print_operand(out, instr->arg1);
+      writer_puts(out, " goto ");
+      print_operand(out, instr->result);
+      writer_putc(out, '\n');
       break;
 
     case IR_IFFALSE:
-      printf("iffalse ");
-      print_operand(instr->arg1);
-      printf(" goto ");
-      print_operand(instr->result);
-      printf("\n");
+      writer_puts(out, "iffalse ");
+      print_operand(out, instr->arg1);
+      writer_puts(out, " goto ");
+      print_operand(out, instr->result);
+      writer_putc(out, '\n');
       break;
 
     case IR_FUNC_BEGIN:
-      printf("function ");
-      print_operand(instr->result);
-      printf(":\n");
+      writer_puts(out, "function ");
+      print_operand(out, instr->result);
+      writer_puts(out, ":\n");
       break;
 
     case IR_FUNC_END:
-      printf("end function ");
-      print_operand(instr->result);
-      printf("\n\n");
+      writer_puts(out, "end function ");
+      print_operand(out, instr->result);
+      writer_puts(out, "\n\n");
+      break;
+
+    case IR_ARG:
+      writer_puts(out, "arg ");
+      print_operand(out, instr->result);
+      writer_putc(out, '\n');
       break;
 
     case IR_PARAM:
-      printf("param ");
-      print_operand(instr->arg1);
-      printf("\n");
+      writer_puts(out, "param ");
+      print_operand(out, instr->arg1);
+      writer_putc(out, '\n');
       break;
 
     case IR_CALL:
-      print_operand(instr->result);
-      printf(" = call ");
-      print_operand(instr->arg1);
-      printf(", %d\n", instr->arg_count);
+      print_operand(out, instr->result);
+      writer_puts(out, " = call ");
+      print_operand(out, instr->arg1);
+      writer_puts(out, ", ");
+      writer_int(out, instr->arg_count);
+      writer_putc(out, '\n');
+      break;
+
+    case IR_TAILCALL:
+      writer_puts(out, "tailcall ");
+      print_operand(out, instr->arg1);
+      writer_puts(out, ", ");
+      writer_int(out, instr->arg_count);
+      writer_putc(out, '\n');
       break;
 
     case IR_RETURN:
-      printf("return");
+      writer_puts(out, "return");
       if (instr->arg1.type != OPERAND_NONE) {
-        printf(" ");
-        print_operand(instr->arg1);
+        writer_putc(out, ' ');
+        print_operand(out, instr->arg1);
       }
-      printf("\n");
+      writer_putc(out, '\n');
       break;
 
     case IR_ASSIGN:
-      print_operand(instr->result);
-      printf(" = ");
-      print_operand(instr->arg1);
-      printf("\n");
+      print_operand(out, instr->result);
+      writer_puts(out, " = ");
+      print_operand(out, instr->arg1);
+      writer_putc(out, '\n');
       break;
 
     case IR_NEG:
     case IR_NOT:
-      print_operand(instr->result);
-      printf(" = %s ", instr->opcode == IR_NEG ? "-" : "!");
-      print_operand(instr->arg1);
-      printf("\n");
+      print_operand(out, instr->result);
+      writer_puts(out, instr->opcode == IR_NEG ? " = - " : " = ! ");
+      print_operand(out, instr->arg1);
+      writer_putc(out, '\n');
       break;
 
     default:
       // 二元运算
-      print_operand(instr->result);
-      printf(" = ");
-      print_operand(instr->arg1);
-      printf(" %s ", ir_opcode_to_string(instr->opcode));
-      print_operand(instr->arg2);
-      printf("\n");
+      print_operand(out, instr->result);
+      writer_puts(out, " = ");
+      print_operand(out, instr->arg1);
+      writer_putc(out, ' ');
+      writer_puts(out, ir_opcode_to_string(instr->opcode));
+      writer_putc(out, ' ');
+      print_operand(out, instr->arg2);
+      writer_putc(out, '\n');
       break;
     }
   }
 
-  printf("========================================\n");
+  writer_puts(out, "========================================\n");
+}
+
+void ir_print(IRProgram *program) {
+  Writer *out = writer_from_file(stdout);
+  ir_dump(program, out);
+  writer_close(out);
 }
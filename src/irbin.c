@@ -0,0 +1,435 @@
+/**
+ * irbin.c - 二进制 IR 格式实现
+ */
+
+#define _DEFAULT_SOURCE // mmap
+
+#include "../include/irbin.h"
+#include "../include/diag.h"
+#include "../include/hash.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define IRBIN_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define IRBIN_MMAP 0
+#endif
+
+// ========== 常量池和字符串池（开放寻址去重） ==========
+
+typedef struct {
+  char *data;
+  uint32_t size;
+  uint32_t capacity;
+  uint32_t *slots; // 偏移 + 1，0 表示空
+  uint32_t slot_count;
+  uint32_t used;
+} StringPool;
+
+typedef struct {
+  double *values;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t *slots; // 下标 + 1，0 表示空
+  uint32_t slot_count;
+} ConstPool;
+
+static uint32_t *new_slots(uint32_t count) {
+  return (uint32_t *)calloc(count, sizeof(uint32_t));
+}
+
+static void rehash_strings(StringPool *pool) {
+  uint32_t *old = pool->slots;
+  uint32_t old_count = pool->slot_count;
+  pool->slot_count = old_count ? old_count * 2 : 64;
+  pool->slots = new_slots(pool->slot_count);
+  for (uint32_t i = 0; i < old_count; i++) {
+    if (!old[i])
+      continue;
+    const char *s = pool->data + old[i] - 1;
+    uint32_t mask = pool->slot_count - 1;
+    uint32_t slot = (uint32_t)hash64(s, strlen(s), 0) & mask;
+    while (pool->slots[slot])
+      slot = (slot + 1) & mask;
+    pool->slots[slot] = old[i];
+  }
+  free(old);
+}
+
+static uint32_t intern_string(StringPool *pool, const char *s) {
+  if ((pool->used + 1) * 2 > pool->slot_count)
+    rehash_strings(pool);
+
+  size_t length = strlen(s);
+  uint32_t mask = pool->slot_count - 1;
+  uint32_t slot = (uint32_t)hash64(s, length, 0) & mask;
+  while (pool->slots[slot]) {
+    uint32_t offset = pool->slots[slot] - 1;
+    if (strcmp(pool->data + offset, s) == 0)
+      return offset;
+    slot = (slot + 1) & mask;
+  }
+
+  if (pool->size + length + 1 > pool->capacity) {
+    uint32_t new_cap = pool->capacity ? pool->capacity * 2 : 1024;
+    while (new_cap < pool->size + length + 1)
+      new_cap *= 2;
+    pool->data = (char *)realloc(pool->data, new_cap);
+    pool->capacity = new_cap;
+  }
+  uint32_t offset = pool->size;
+  memcpy(pool->data + offset, s, length + 1);
+  pool->size += (uint32_t)length + 1;
+  pool->slots[slot] = offset + 1;
+  pool->used++;
+  return offset;
+}
+
+static void rehash_consts(ConstPool *pool) {
+  free(pool->slots);
+  pool->slot_count = pool->slot_count ? pool->slot_count * 2 : 64;
+  pool->slots = new_slots(pool->slot_count);
+  uint32_t mask = pool->slot_count - 1;
+  for (uint32_t i = 0; i < pool->count; i++) {
+    uint32_t slot = (uint32_t)hash64(&pool->values[i], sizeof(double), 0) & mask;
+    while (pool->slots[slot])
+      slot = (slot + 1) & mask;
+    pool->slots[slot] = i + 1;
+  }
+}
+
+// 按位比较：0.0 和 -0.0、不同的 NaN 都是不同的常量
+static uint32_t intern_const(ConstPool *pool, double value) {
+  if ((pool->count + 1) * 2 > pool->slot_count)
+    rehash_consts(pool);
+
+  uint32_t mask = pool->slot_count - 1;
+  uint32_t slot = (uint32_t)hash64(&value, sizeof(double), 0) & mask;
+  while (pool->slots[slot]) {
+    uint32_t index = pool->slots[slot] - 1;
+    if (memcmp(&pool->values[index], &value, sizeof(double)) == 0)
+      return index;
+    slot = (slot + 1) & mask;
+  }
+
+  if (pool->count >= pool->capacity) {
+    pool->capacity = pool->capacity ? pool->capacity * 2 : 16;
+    pool->values =
+        (double *)realloc(pool->values, sizeof(double) * pool->capacity);
+  }
+  pool->values[pool->count] = value;
+  pool->slots[slot] = pool->count + 1;
+  return pool->count++;
+}
+
+// ========== 编码 ==========
+
+static void encode_operand(IRBinOperand *out, const IROperand *op,
+                           StringPool *strings, ConstPool *consts) {
+  out->type = (uint8_t)op->type;
+  out->vtype = (uint8_t)op->vtype;
+  out->is_global = op->is_global != 0;
+  switch (op->type) {
+  case OPERAND_TEMP:
+    out->value = op->value.temp_id;
+    break;
+  case OPERAND_INT:
+    out->value = op->value.int_val;
+    break;
+  case OPERAND_LABEL:
+    out->value = op->value.label_id;
+    break;
+  case OPERAND_FLOAT:
+    out->value = (int32_t)intern_const(consts, op->value.float_val);
+    break;
+  case OPERAND_VAR:
+  case OPERAND_FUNC:
+    out->value = (int32_t)intern_string(
+        strings, op->value.name ? op->value.name : "");
+    break;
+  default:
+    break;
+  }
+}
+
+static uint64_t align8(uint64_t value) { return (value + 7) & ~(uint64_t)7; }
+
+unsigned char *irbin_encode(const IRProgram *program, size_t *size) {
+  StringPool strings;
+  ConstPool consts;
+  memset(&strings, 0, sizeof(strings));
+  memset(&consts, 0, sizeof(consts));
+  intern_string(&strings, ""); // 偏移 0
+
+  // calloc：保留字节是 0，同一个程序总是编码成同样的字节
+  int count = program->count;
+  IRBinInstruction *code = (IRBinInstruction *)calloc(
+      count ? count : 1, sizeof(IRBinInstruction));
+  for (int i = 0; i < count; i++) {
+    const IRInstruction *instr = &program->instructions[i];
+    code[i].opcode = (uint32_t)instr->opcode;
+    code[i].arg_count = instr->arg_count;
+    encode_operand(&code[i].result, &instr->result, &strings, &consts);
+    encode_operand(&code[i].arg1, &instr->arg1, &strings, &consts);
+    encode_operand(&code[i].arg2, &instr->arg2, &strings, &consts);
+  }
+
+  IRBinHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, IRBIN_MAGIC, 4);
+  header.version = IRBIN_VERSION;
+  header.byte_order = IRBIN_BYTE_ORDER;
+  header.header_size = sizeof(IRBinHeader);
+  header.const_count = consts.count;
+  header.instruction_count = (uint32_t)count;
+  header.string_size = strings.size;
+  header.temp_counter = program->temp_counter;
+  header.label_counter = program->label_counter;
+
+  uint64_t const_offset = align8(sizeof(IRBinHeader));
+  uint64_t instruction_offset =
+      const_offset + (uint64_t)consts.count * sizeof(double);
+  uint64_t string_offset =
+      instruction_offset + (uint64_t)count * sizeof(IRBinInstruction);
+  uint64_t file_size = string_offset + strings.size;
+
+  unsigned char *image = NULL;
+  if (file_size <= UINT32_MAX) {
+    header.const_offset = (uint32_t)const_offset;
+    header.instruction_offset = (uint32_t)instruction_offset;
+    header.string_offset = (uint32_t)string_offset;
+    header.file_size = file_size;
+
+    image = (unsigned char *)calloc(1, (size_t)file_size);
+    if (consts.count)
+      memcpy(image + const_offset, consts.values,
+             sizeof(double) * consts.count);
+    memcpy(image + instruction_offset, code,
+           sizeof(IRBinInstruction) * count);
+    memcpy(image + string_offset, strings.data, strings.size);
+    header.checksum = hash64(image + sizeof(IRBinHeader),
+                             (size_t)file_size - sizeof(IRBinHeader), 0);
+    memcpy(image, &header, sizeof(header));
+    *size = (size_t)file_size;
+  }
+
+  free(code);
+  free(strings.data);
+  free(strings.slots);
+  free(consts.values);
+  free(consts.slots);
+  return image;
+}
+
+int irbin_write(const IRProgram *program, const char *path) {
+  size_t size;
+  unsigned char *image = irbin_encode(program, &size);
+  if (!image) {
+    diag_printf("Error: IR of %d instructions is too large\n",
+                program->count);
+    return 1;
+  }
+
+  FILE *out = fopen(path, "wb");
+  if (!out) {
+    diag_printf("Error: Cannot write file '%s'\n", path);
+    free(image);
+    return 1;
+  }
+  int status = fwrite(image, 1, size, out) == size ? 0 : 1;
+  if (fclose(out) != 0)
+    status = 1;
+  if (status != 0)
+    diag_printf("Error: Cannot write file '%s'\n", path);
+  free(image);
+  return status;
+}
+
+// ========== 读取 ==========
+
+// 区间 [offset, offset + size) 在文件里
+static int in_file(uint64_t offset, uint64_t size, uint64_t file_size) {
+  return offset <= file_size && size <= file_size - offset;
+}
+
+/**
+ * 检查头部，建立指向各部分的指针
+ */
+static IRImage *make_image(const void *data, size_t size) {
+  if (size < sizeof(IRBinHeader) || ((uintptr_t)data & 7) != 0)
+    return NULL;
+  const IRBinHeader *header = (const IRBinHeader *)data;
+  if (memcmp(header->magic, IRBIN_MAGIC, 4) != 0 ||
+      header->version != IRBIN_VERSION ||
+      header->byte_order != IRBIN_BYTE_ORDER ||
+      header->header_size != sizeof(IRBinHeader) ||
+      header->file_size != size)
+    return NULL;
+  if (header->const_offset % 8 != 0 || header->instruction_offset % 4 != 0 ||
+      !in_file(header->const_offset,
+               (uint64_t)header->const_count * sizeof(double), size) ||
+      !in_file(header->instruction_offset,
+               (uint64_t)header->instruction_count * sizeof(IRBinInstruction),
+               size) ||
+      !in_file(header->string_offset, header->string_size, size))
+    return NULL;
+
+  // 字符串池以 '\0' 结尾，池内的任何偏移都是完整的字符串
+  const unsigned char *bytes = (const unsigned char *)data;
+  if (header->string_size == 0 ||
+      bytes[header->string_offset + header->string_size - 1] != '\0')
+    return NULL;
+
+  IRImage *image = (IRImage *)calloc(1, sizeof(IRImage));
+  image->data = bytes;
+  image->size = size;
+  image->header = header;
+  image->consts = (const double *)(bytes + header->const_offset);
+  image->instructions =
+      (const IRBinInstruction *)(bytes + header->instruction_offset);
+  image->strings = (const char *)(bytes + header->string_offset);
+  return image;
+}
+
+IRImage *irbin_view(const void *data, size_t size) {
+  return make_image(data, size);
+}
+
+IRImage *irbin_open(const char *path) {
+#if IRBIN_MMAP
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(IRBinHeader)) {
+    close(fd);
+    return NULL;
+  }
+  size_t size = (size_t)st.st_size;
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return NULL;
+  IRImage *image = make_image(data, size);
+  if (!image) {
+    munmap(data, size);
+    return NULL;
+  }
+#else
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return NULL;
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  // double 的对齐足够常量池使用
+  double *data = (double *)malloc(length > 0 ? (size_t)length : 1);
+  size_t size = fread(data, 1, length > 0 ? (size_t)length : 0, file);
+  fclose(file);
+  IRImage *image = make_image(data, size);
+  if (!image) {
+    free(data);
+    return NULL;
+  }
+#endif
+  image->mapped = 1;
+  return image;
+}
+
+void irbin_close(IRImage *image) {
+  if (!image)
+    return;
+  if (image->mapped) {
+#if IRBIN_MMAP
+    munmap((void *)image->data, image->size);
+#else
+    free((void *)image->data);
+#endif
+  }
+  free(image);
+}
+
+int irbin_verify(const IRImage *image) {
+  return hash64(image->data + sizeof(IRBinHeader),
+                image->size - sizeof(IRBinHeader),
+                0) == image->header->checksum;
+}
+
+static int decode_operand(const IRImage *image, const IRBinOperand *in,
+                          IROperand *out) {
+  *out = ir_operand_none();
+  if (in->type > OPERAND_FUNC || in->vtype > IR_TYPE_FLOAT)
+    return 0;
+  out->type = (OperandType)in->type;
+  out->vtype = (IRValueType)in->vtype;
+  out->is_global = in->is_global;
+
+  // 编号超出头部计数器的临时变量和标签会让后续阶段按编号索引的表越界
+  switch (out->type) {
+  case OPERAND_TEMP:
+    if (in->value < 0 || in->value >= image->header->temp_counter)
+      return 0;
+    out->value.temp_id = in->value;
+    break;
+  case OPERAND_INT:
+    out->value.int_val = in->value;
+    break;
+  case OPERAND_LABEL:
+    if (in->value < 0 || in->value >= image->header->label_counter)
+      return 0;
+    out->value.label_id = in->value;
+    break;
+  case OPERAND_FLOAT:
+    if (in->value < 0 || (uint32_t)in->value >= image->header->const_count)
+      return 0;
+    out->value.float_val = image->consts[in->value];
+    break;
+  case OPERAND_VAR:
+  case OPERAND_FUNC: {
+    if (in->value < 0 || (uint32_t)in->value >= image->header->string_size)
+      return 0;
+    const char *name = image->strings + in->value;
+    size_t length = strlen(name) + 1;
+    out->value.name = (char *)malloc(length);
+    memcpy(out->value.name, name, length);
+    break;
+  }
+  default:
+    break;
+  }
+  return 1;
+}
+
+IRProgram *irbin_to_program(const IRImage *image) {
+  int count = (int)image->header->instruction_count;
+  IRProgram *program = ir_program_create();
+  program->temp_counter = image->header->temp_counter;
+  program->label_counter = image->header->label_counter;
+  program->instructions =
+      (IRInstruction *)malloc(sizeof(IRInstruction) * (count ? count : 1));
+  program->capacity = count ? count : 1;
+
+  for (int i = 0; i < count; i++) {
+    const IRBinInstruction *in = &image->instructions[i];
+    IRInstruction *instr = &program->instructions[i];
+    instr->opcode = (IROpcode)in->opcode;
+    instr->arg_count = in->arg_count;
+    // 先把三个操作数都置空，失败时 ir_program_free 可以安全释放这一条
+    instr->result = instr->arg1 = instr->arg2 = ir_operand_none();
+    program->count = i + 1;
+    if (in->opcode > IR_NOP || !decode_operand(image, &in->result, &instr->result) ||
+        !decode_operand(image, &in->arg1, &instr->arg1) ||
+        !decode_operand(image, &in->arg2, &instr->arg2)) {
+      ir_program_free(program);
+      return NULL;
+    }
+  }
+  return program;
+}
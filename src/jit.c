@@ -0,0 +1,231 @@
+/**
+ * jit.c - 内存中编译执行实现
+ */
+
+#define _DEFAULT_SOURCE // mmap 的 MAP_ANONYMOUS
+
+#include "../include/jit.h"
+#include "../include/codegen.h"
+#include "../include/encode.h"
+#include "../include/memory.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define JIT_SUPPORTED 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+static char *str_dup(const char *s) {
+  size_t len = strlen(s) + 1;
+  char *copy = (char *)malloc(len);
+  memcpy(copy, s, len);
+  return copy;
+}
+
+static size_t round_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+#if JIT_SUPPORTED
+
+/**
+ * 重定位目标的地址：函数、全局变量，或者 name 为 NULL 时的 .rodata
+ */
+static unsigned char *symbol_address(const JitProgram *jit,
+                                     unsigned char *rodata, const char *name) {
+  if (!name)
+    return rodata;
+  int f = name_map_get(&jit->func_index, name);
+  if (f >= 0)
+    return (unsigned char *)jit->entries[f];
+  int i = name_map_get(&jit->global_index, name);
+  if (i >= 0)
+    return (unsigned char *)jit->global_addresses[i];
+  return NULL;
+}
+
+/**
+ * 把编码好的模块放进可执行内存
+ */
+static JitProgram *load(const X86Module *module, const X86Code *code) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t rodata_offset = round_up(code->size, X86_CONST_SIZE);
+  size_t code_size = round_up(
+      rodata_offset + (size_t)module->const_count * X86_CONST_SIZE, page);
+
+  int *offsets = (int *)malloc(sizeof(int) * (module->global_count + 1));
+  size_t data_size = round_up(x86_layout_globals(module, offsets), page);
+
+  size_t size = code_size + (data_size ? data_size : page);
+  unsigned char *memory = (unsigned char *)mmap(
+      NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    fprintf(stderr, "JIT error: cannot allocate executable memory\n");
+    free(offsets);
+    return NULL;
+  }
+
+  unsigned char *text = memory;
+  unsigned char *rodata = memory + rodata_offset;
+  unsigned char *data = memory + code_size;
+  memcpy(text, code->bytes, code->size);
+  for (int i = 0; i < module->const_count; i++)
+    memcpy(rodata + i * X86_CONST_SIZE, &module->consts[i].bits,
+           sizeof(uint64_t));
+  for (int i = 0; i < module->global_count; i++) {
+    const X86Global *g = &module->globals[i];
+    if (g->type == IR_TYPE_FLOAT)
+      memcpy(data + offsets[i], &g->float_value, sizeof(double));
+    else
+      memcpy(data + offsets[i], &g->int_value, sizeof(int32_t));
+  }
+
+  // 先建好入口和全局变量表，重定位通过它们按名字查找
+  JitProgram *jit = (JitProgram *)calloc(1, sizeof(JitProgram));
+  jit->memory = memory;
+  jit->size = size;
+  jit->code_size = code_size;
+  jit->func_count = module->func_count;
+  jit->names = (char **)malloc(sizeof(char *) * (jit->func_count + 1));
+  jit->entries = (void **)malloc(sizeof(void *) * (jit->func_count + 1));
+  jit->return_types =
+      (IRValueType *)malloc(sizeof(IRValueType) * (jit->func_count + 1));
+  for (int f = 0; f < module->func_count; f++) {
+    jit->names[f] = str_dup(module->functions[f].name);
+    jit->entries[f] = text + code->func_offsets[f];
+    jit->return_types[f] = IR_TYPE_INT;
+  }
+  name_map_init(&jit->func_index, jit->func_count);
+  for (int f = 0; f < jit->func_count; f++)
+    name_map_put(&jit->func_index, jit->names[f], f);
+
+  jit->global_count = module->global_count;
+  int globals = jit->global_count + 1;
+  jit->global_names = (char **)malloc(sizeof(char *) * globals);
+  jit->global_addresses = (void **)malloc(sizeof(void *) * globals);
+  jit->global_types = (IRValueType *)malloc(sizeof(IRValueType) * globals);
+  for (int i = 0; i < module->global_count; i++) {
+    jit->global_names[i] = str_dup(module->globals[i].name);
+    jit->global_addresses[i] = data + offsets[i];
+    jit->global_types[i] = module->globals[i].type;
+  }
+  name_map_init(&jit->global_index, jit->global_count);
+  for (int i = 0; i < jit->global_count; i++)
+    name_map_put(&jit->global_index, jit->global_names[i], i);
+  free(offsets);
+
+  // 重定位：PC32 和 PLT32 都是 S + A - P（函数就在缓冲区里，不需要 PLT）
+  int errors = 0;
+  for (int i = 0; i < code->reloc_count; i++) {
+    const X86Reloc *reloc = &code->relocs[i];
+    unsigned char *target = symbol_address(jit, rodata, reloc->name);
+    if (!target) {
+      fprintf(stderr, "JIT error: undefined symbol '%s'\n", reloc->name);
+      errors++;
+      continue;
+    }
+    int64_t value = (int64_t)(target - (text + reloc->offset)) + reloc->addend;
+    int32_t rel = (int32_t)value;
+    memcpy(text + reloc->offset, &rel, sizeof(rel));
+  }
+
+  if (errors > 0 || mprotect(memory, code_size, PROT_READ | PROT_EXEC) != 0) {
+    if (errors == 0)
+      fprintf(stderr, "JIT error: cannot make code executable\n");
+    jit_free(jit);
+    return NULL;
+  }
+  return jit;
+}
+
+JitProgram *jit_compile(IRProgram *program) {
+  X86Module *module = codegen_generate(program);
+  if (!module)
+    return NULL;
+
+  X86Code code;
+  JitProgram *jit = NULL;
+  if (x86_encode_module(module, &code) == 0)
+    jit = load(module, &code);
+  x86_code_free(&code);
+  x86_module_free(module);
+  if (!jit)
+    return NULL;
+
+  // 返回类型记在 FUNC_BEGIN 上
+  for (int i = 0; i < program->count; i++) {
+    IRInstruction *instr = &program->instructions[i];
+    if (instr->opcode != IR_FUNC_BEGIN)
+      continue;
+    int f = name_map_get(&jit->func_index, instr->result.value.name);
+    if (f >= 0)
+      jit->return_types[f] = instr->result.vtype;
+  }
+  return jit;
+}
+
+void jit_free(JitProgram *jit) {
+  if (!jit)
+    return;
+  munmap(jit->memory, jit->size);
+  for (int f = 0; f < jit->func_count; f++)
+    free(jit->names[f]);
+  free(jit->names);
+  free(jit->entries);
+  free(jit->return_types);
+  for (int i = 0; i < jit->global_count; i++)
+    free(jit->global_names[i]);
+  free(jit->global_names);
+  free(jit->global_addresses);
+  free(jit->global_types);
+  name_map_free(&jit->func_index);
+  name_map_free(&jit->global_index);
+  free(jit);
+}
+
+#else // !JIT_SUPPORTED
+
+JitProgram *jit_compile(IRProgram *program) {
+  (void)program;
+  (void)str_dup;
+  (void)round_up;
+  fprintf(stderr, "JIT error: not supported on this platform\n");
+  return NULL;
+}
+
+void jit_free(JitProgram *jit) { (void)jit; }
+
+#endif
+
+void *jit_lookup(JitProgram *jit, const char *name) {
+  int f = name_map_get(&jit->func_index, name);
+  return f >= 0 ? jit->entries[f] : NULL;
+}
+
+void *jit_lookup_global(JitProgram *jit, const char *name) {
+  int i = name_map_get(&jit->global_index, name);
+  return i >= 0 ? jit->global_addresses[i] : NULL;
+}
+
+int jit_run_main(JitProgram *jit) {
+  int f = name_map_get(&jit->func_index, "main");
+  if (f < 0) {
+    fprintf(stderr, "JIT error: no main function\n");
+    return -1;
+  }
+  // 对象指针和函数指针之间的转换：POSIX 保证可行（dlsym 也这样用）
+  if (jit->return_types[f] == IR_TYPE_FLOAT) {
+    double (*entry)(void);
+    memcpy(&entry, &jit->entries[f], sizeof(entry));
+    return (int)entry();
+  }
+  int (*entry)(void);
+  memcpy(&entry, &jit->entries[f], sizeof(entry));
+  return entry();
+}
@@ -0,0 +1,338 @@
+/**
+ * json.c - JSON 解析和输出
+ */
+
+#include "../include/json.h"
+#include "../include/memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DEPTH 256 // 更深的嵌套当作错误，免得递归把栈用完
+
+typedef struct {
+  const char *text;
+  size_t length;
+  size_t pos;
+  int depth;
+} JsonParser;
+
+// ========== 解析 ==========
+
+static void skip_space(JsonParser *p) {
+  while (p->pos < p->length &&
+         (p->text[p->pos] == ' ' || p->text[p->pos] == '\t' ||
+          p->text[p->pos] == '\n' || p->text[p->pos] == '\r'))
+    p->pos++;
+}
+
+static int literal(JsonParser *p, const char *word) {
+  size_t n = strlen(word);
+  if (p->length - p->pos < n || memcmp(p->text + p->pos, word, n) != 0)
+    return 0;
+  p->pos += n;
+  return 1;
+}
+
+static int hex4(JsonParser *p, unsigned *code) {
+  if (p->length - p->pos < 4)
+    return 0;
+  *code = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = p->text[p->pos++];
+    unsigned digit;
+    if (c >= '0' && c <= '9')
+      digit = (unsigned)(c - '0');
+    else if (c >= 'a' && c <= 'f')
+      digit = (unsigned)(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F')
+      digit = (unsigned)(c - 'A' + 10);
+    else
+      return 0;
+    *code = *code * 16 + digit;
+  }
+  return 1;
+}
+
+static size_t put_utf8(char *out, unsigned code) {
+  if (code < 0x80) {
+    out[0] = (char)code;
+    return 1;
+  }
+  if (code < 0x800) {
+    out[0] = (char)(0xC0 | (code >> 6));
+    out[1] = (char)(0x80 | (code & 0x3F));
+    return 2;
+  }
+  if (code < 0x10000) {
+    out[0] = (char)(0xE0 | (code >> 12));
+    out[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (code & 0x3F));
+    return 3;
+  }
+  out[0] = (char)(0xF0 | (code >> 18));
+  out[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+  out[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+  out[3] = (char)(0x80 | (code & 0x3F));
+  return 4;
+}
+
+/**
+ * 解析字符串（p->pos 在开始的引号上），结果放进 *out（调用者 free）
+ */
+static int parse_string(JsonParser *p, char **out, size_t *out_length) {
+  p->pos++; // 开始的引号
+  // 解码后不会比原文长（\uXXXX 六个字节最多变成四个）
+  size_t end = p->pos;
+  while (end < p->length && p->text[end] != '"')
+    end += p->text[end] == '\\' ? 2 : 1;
+  if (end >= p->length)
+    return 0;
+
+  char *text = (char *)malloc(end - p->pos + 1);
+  size_t n = 0;
+  while (p->text[p->pos] != '"') {
+    char c = p->text[p->pos++];
+    if ((unsigned char)c < 0x20) {
+      free(text);
+      return 0;
+    }
+    if (c != '\\') {
+      text[n++] = c;
+      continue;
+    }
+    c = p->text[p->pos++];
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+      text[n++] = c;
+      break;
+    case 'b':
+      text[n++] = '\b';
+      break;
+    case 'f':
+      text[n++] = '\f';
+      break;
+    case 'n':
+      text[n++] = '\n';
+      break;
+    case 'r':
+      text[n++] = '\r';
+      break;
+    case 't':
+      text[n++] = '\t';
+      break;
+    case 'u': {
+      unsigned code, low;
+      if (!hex4(p, &code)) {
+        free(text);
+        return 0;
+      }
+      // 代理对：后面紧跟着低位的 \uXXXX
+      if (code >= 0xD800 && code < 0xDC00 && p->length - p->pos >= 6 &&
+          p->text[p->pos] == '\\' && p->text[p->pos + 1] == 'u') {
+        size_t saved = p->pos;
+        p->pos += 2;
+        if (hex4(p, &low) && low >= 0xDC00 && low < 0xE000)
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        else
+          p->pos = saved;
+      }
+      n += put_utf8(text + n, code);
+      break;
+    }
+    default:
+      free(text);
+      return 0;
+    }
+  }
+  p->pos++; // 结束的引号
+  text[n] = '\0';
+  *out = text;
+  *out_length = n;
+  return 1;
+}
+
+static int parse_value(JsonParser *p, JsonValue *value);
+
+/**
+ * 解析数组或对象（p->pos 在 '[' 或 '{' 上）
+ */
+static int parse_container(JsonParser *p, JsonValue *value, int object) {
+  char close = object ? '}' : ']';
+  int capacity = 0;
+  value->type = object ? JSON_OBJECT : JSON_ARRAY;
+  p->pos++;
+  skip_space(p);
+  if (p->pos < p->length && p->text[p->pos] == close) {
+    p->pos++;
+    return 1;
+  }
+  for (;;) {
+    if (value->count >= capacity) {
+      capacity = capacity == 0 ? 4 : capacity * 2;
+      value->items =
+          (JsonValue *)realloc(value->items, sizeof(JsonValue) * capacity);
+      if (object)
+        value->keys = (char **)realloc(value->keys, sizeof(char *) * capacity);
+    }
+    JsonValue *item = &value->items[value->count];
+    memset(item, 0, sizeof(*item));
+
+    skip_space(p);
+    if (object) {
+      size_t key_length;
+      if (p->pos >= p->length || p->text[p->pos] != '"' ||
+          !parse_string(p, &value->keys[value->count], &key_length))
+        return 0;
+      skip_space(p);
+      if (p->pos >= p->length || p->text[p->pos] != ':') {
+        free(value->keys[value->count]);
+        return 0;
+      }
+      p->pos++;
+    }
+    value->count++; // 先计数，失败时 json_free 也能释放一半的元素
+    if (!parse_value(p, item))
+      return 0;
+
+    skip_space(p);
+    if (p->pos >= p->length)
+      return 0;
+    char c = p->text[p->pos++];
+    if (c == close)
+      return 1;
+    if (c != ',')
+      return 0;
+  }
+}
+
+static int parse_value(JsonParser *p, JsonValue *value) {
+  skip_space(p);
+  if (p->pos >= p->length)
+    return 0;
+
+  char c = p->text[p->pos];
+  if (c == '{' || c == '[') {
+    if (++p->depth > MAX_DEPTH)
+      return 0;
+    int ok = parse_container(p, value, c == '{');
+    p->depth--;
+    return ok;
+  }
+  if (c == '"') {
+    value->type = JSON_STRING;
+    return parse_string(p, &value->string, &value->length);
+  }
+  if (literal(p, "true") || literal(p, "false")) {
+    value->type = JSON_BOOL;
+    value->boolean = c == 't';
+    return 1;
+  }
+  if (literal(p, "null")) {
+    value->type = JSON_NULL;
+    return 1;
+  }
+  if (c == '-' || (c >= '0' && c <= '9')) {
+    // strtod 需要以 '\0' 结尾的文本，数字不会很长
+    char digits[64];
+    size_t n = 0;
+    while (p->pos < p->length && n < sizeof(digits) - 1 &&
+           strchr("+-0123456789.eE", p->text[p->pos]))
+      digits[n++] = p->text[p->pos++];
+    digits[n] = '\0';
+    char *end;
+    value->type = JSON_NUMBER;
+    value->number = strtod(digits, &end);
+    return end == digits + n;
+  }
+  return 0;
+}
+
+static void free_contents(JsonValue *value) {
+  for (int i = 0; i < value->count; i++) {
+    free_contents(&value->items[i]);
+    if (value->keys)
+      free(value->keys[i]);
+  }
+  free(value->items);
+  free(value->keys);
+  free(value->string);
+}
+
+JsonValue *json_parse(const char *text, size_t length) {
+  JsonParser p = {text, length, 0, 0};
+  JsonValue *value = (JsonValue *)calloc(1, sizeof(JsonValue));
+  int ok = parse_value(&p, value);
+  skip_space(&p);
+  if (!ok || p.pos != length) {
+    json_free(value);
+    return NULL;
+  }
+  return value;
+}
+
+void json_free(JsonValue *value) {
+  if (!value)
+    return;
+  free_contents(value);
+  free(value);
+}
+
+// ========== 取值 ==========
+
+const JsonValue *json_get(const JsonValue *object, const char *key) {
+  if (!object || object->type != JSON_OBJECT)
+    return NULL;
+  for (int i = 0; i < object->count; i++)
+    if (strcmp(object->keys[i], key) == 0)
+      return &object->items[i];
+  return NULL;
+}
+
+const char *json_string(const JsonValue *value, const char *fallback) {
+  return value && value->type == JSON_STRING ? value->string : fallback;
+}
+
+double json_number(const JsonValue *value, double fallback) {
+  return value && value->type == JSON_NUMBER ? value->number : fallback;
+}
+
+// ========== 输出 ==========
+
+void json_write_string(Writer *out, const char *text, size_t length) {
+  static const char hex[] = "0123456789abcdef";
+  writer_putc(out, '"');
+  size_t run = 0; // 不用转义的一段一起写
+  for (size_t i = 0; i < length; i++) {
+    unsigned char c = (unsigned char)text[i];
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+    writer_write(out, text + run, i - run);
+    run = i + 1;
+    switch (c) {
+    case '"':
+      writer_puts(out, "\\\"");
+      break;
+    case '\\':
+      writer_puts(out, "\\\\");
+      break;
+    case '\n':
+      writer_puts(out, "\\n");
+      break;
+    case '\r':
+      writer_puts(out, "\\r");
+      break;
+    case '\t':
+      writer_puts(out, "\\t");
+      break;
+    default: {
+      char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+      writer_write(out, escape, 6);
+      break;
+    }
+    }
+  }
+  writer_write(out, text + run, length - run);
+  writer_putc(out, '"');
+}
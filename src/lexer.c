@@ -199,7 +199,9 @@ static Token read_number(Lexer* lexer) {
     // 检查是否有小数点
     if (current_char(lexer) == '.' && isdigit(lexer->source[lexer->pos + 1])) {
         token.type = TOKEN_FLOAT;  // 改为浮点数
-        token.value[i++] = '.';
+        if (i < MAX_TOKEN_LENGTH - 1) {
+            token.value[i++] = '.';
+        }
         advance(lexer);
         
         // 读取小数部分
@@ -229,18 +231,20 @@ static Token read_string(Lexer* lexer) {
     advance(lexer);  // 跳过开始的双引号
     
     while (current_char(lexer) != '"' && current_char(lexer) != '\0') {
-        if (current_char(lexer) == '\\') {
+        char c = current_char(lexer);
+        if (c == '\\') {
             // 转义字符
             advance(lexer);
             switch (current_char(lexer)) {
-                case 'n':  token.value[i++] = '\n'; break;
-                case 't':  token.value[i++] = '\t'; break;
-                case '"':  token.value[i++] = '"';  break;
-                case '\\': token.value[i++] = '\\'; break;
-                default:   token.value[i++] = current_char(lexer); break;
+                case 'n':  c = '\n'; break;
+                case 't':  c = '\t'; break;
+                case '\0': continue;  // 文件在反斜杠后结束
+                default:   c = current_char(lexer); break;
             }
-        } else {
-            token.value[i++] = current_char(lexer);
+        }
+        // 和标识符一样，过长的部分丢掉（没有结束引号时会一直读到文件末尾）
+        if (i < MAX_TOKEN_LENGTH - 1) {
+            token.value[i++] = c;
         }
         advance(lexer);
     }
@@ -276,7 +280,9 @@ static Token read_char(Lexer* lexer) {
             case '\\': token.value[i++] = '\\'; break;
             default:   token.value[i++] = current_char(lexer); break;
         }
-        advance(lexer);
+        if (current_char(lexer) != '\0') {
+            advance(lexer);  // 文件在反斜杠后结束时不能越过结尾
+        }
     } else if (current_char(lexer) != '\'' && current_char(lexer) != '\0') {
         token.value[i++] = current_char(lexer);
         advance(lexer);
@@ -340,19 +346,16 @@ Lexer lexer_init(const char* source) {
 }
 
 /**
- * lexer_next_token - 获取下一个 Token
+ * scan_token - 从当前位置（已跳过空白和注释）读取一个 Token
  * 
  * 这是词法分析器的核心！
  * 通过首字符判断 Token 类型，然后调用相应的读取函数
  */
-Token lexer_next_token(Lexer* lexer) {
+static Token scan_token(Lexer* lexer) {
     Token token;
     memset(token.value, 0, sizeof(token.value));
     
-    // 1. 跳过空白和注释
-    skip_whitespace_and_comments(lexer);
-    
-    // 2. 检查是否到达文件末尾
+    // 检查是否到达文件末尾
     if (current_char(lexer) == '\0') {
         token.type = TOKEN_EOF;
         token.value[0] = '\0';
@@ -361,7 +364,7 @@ Token lexer_next_token(Lexer* lexer) {
     
     char c = current_char(lexer);
     
-    // 3. 根据首字符判断 Token 类型
+    // 根据首字符判断 Token 类型
     
     // 标识符或关键字: 以字母或下划线开头
     if (isalpha(c) || c == '_') {
@@ -439,6 +442,25 @@ Token lexer_next_token(Lexer* lexer) {
     return token;
 }
 
+/**
+ * lexer_next_token - 获取下一个 Token
+ * 
+ * 先跳过空白和注释，记下 Token 开始的位置，再读取 Token
+ */
+Token lexer_next_token(Lexer* lexer) {
+    skip_whitespace_and_comments(lexer);
+
+    int start = lexer->pos;
+    int line = lexer->line;
+    int column = lexer->column;
+    Token token = scan_token(lexer);
+    token.start = start;
+    token.length = lexer->pos - start;
+    token.line = line;
+    token.column = column;
+    return token;
+}
+
 /**
  * lexer_peek_token - 预览下一个 Token（不消耗）
  * 
@@ -0,0 +1,376 @@
+/**
+ * liveness.c - 活跃变量分析实现
+ */
+
+#include "../include/liveness.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * 产生值的指令（结果写入 result）
+ */
+static int defines_value(IROpcode op) {
+  return (op >= IR_ASSIGN && op <= IR_NOT) || op == IR_CALL || op == IR_ARG;
+}
+
+static int is_value_operand(IROperand op) {
+  return op.type == OPERAND_TEMP || op.type == OPERAND_VAR;
+}
+
+/**
+ * 指令中被读取的操作数（call/tailcall 的 arg1 是函数名，不算）
+ */
+static int read_operands(const IRInstruction *instr, IROperand *ops) {
+  int n = 0;
+  switch (instr->opcode) {
+  case IR_IF:
+  case IR_IFFALSE:
+  case IR_PARAM:
+  case IR_RETURN:
+    ops[n++] = instr->arg1;
+    break;
+  default:
+    if (instr->opcode >= IR_ASSIGN && instr->opcode <= IR_NOT) {
+      ops[n++] = instr->arg1;
+      ops[n++] = instr->arg2;
+    }
+    break;
+  }
+  return n;
+}
+
+// ==================== 变量内化 ====================
+
+struct LivenessVar {
+  const char *name;
+  int is_global;
+  int id;
+};
+
+static unsigned hash_var(const char *name, int is_global) {
+  unsigned h = 2166136261u; // FNV-1a
+  for (const char *p = name; *p; p++) {
+    h ^= (unsigned char)*p;
+    h *= 16777619u;
+  }
+  return h ^ (unsigned)is_global;
+}
+
+static struct LivenessVar *find_var(const Liveness *lv, const char *name,
+                                    int is_global) {
+  unsigned i = hash_var(name, is_global) & lv->var_mask;
+  while (lv->var_slots[i].name) {
+    struct LivenessVar *slot = &lv->var_slots[i];
+    if (slot->is_global == is_global && strcmp(slot->name, name) == 0)
+      return slot;
+    i = (i + 1) & lv->var_mask;
+  }
+  return &lv->var_slots[i];
+}
+
+/**
+ * 给函数里出现的临时变量和变量编号
+ */
+static void number_values(Liveness *lv, IRProgram *program, IRFunction *func) {
+  int length = func->end - func->begin + 1;
+
+  // 只为这个函数用到的编号范围建表，不按整个程序的 temp_counter
+  int base = -1, limit = 0;
+  for (int i = func->begin; i <= func->end; i++) {
+    const IRInstruction *instr = &program->instructions[i];
+    const IROperand *ops[3] = {&instr->result, &instr->arg1, &instr->arg2};
+    for (int k = 0; k < 3; k++) {
+      if (ops[k]->type != OPERAND_TEMP)
+        continue;
+      int id = ops[k]->value.temp_id;
+      if (base < 0 || id < base)
+        base = id;
+      if (id >= limit)
+        limit = id + 1;
+    }
+  }
+  if (base < 0)
+    base = 0;
+  lv->temp_id_base = base;
+  lv->temp_id_limit = limit;
+  lv->temp_index = (int *)malloc(sizeof(int) * (limit - base + 1));
+  for (int i = 0; i < limit - base; i++)
+    lv->temp_index[i] = -1;
+  lv->value_temp = (int *)malloc(sizeof(int) * (3 * length + 1));
+
+  // 每条指令最多引入 3 个变量，表的容量至少是它的两倍
+  int capacity = 16;
+  while (capacity < 6 * length)
+    capacity *= 2;
+  lv->var_slots =
+      (struct LivenessVar *)calloc(capacity, sizeof(struct LivenessVar));
+  lv->var_mask = capacity - 1;
+  lv->var_names = (const char **)malloc(sizeof(char *) * (3 * length + 1));
+  lv->var_global = (char *)malloc(3 * length + 1);
+
+  for (int i = func->begin + 1; i < func->end; i++) {
+    const IRInstruction *instr = &program->instructions[i];
+    IROperand ops[3];
+    int n = read_operands(instr, ops);
+    if (defines_value(instr->opcode))
+      ops[n++] = instr->result;
+
+    for (int k = 0; k < n; k++) {
+      if (ops[k].type == OPERAND_TEMP) {
+        int id = ops[k].value.temp_id;
+        if (lv->temp_index[id - base] < 0) {
+          lv->value_temp[lv->temp_count] = id;
+          lv->temp_index[id - base] = lv->temp_count++;
+        }
+      } else if (ops[k].type == OPERAND_VAR) {
+        struct LivenessVar *slot =
+            find_var(lv, ops[k].value.name, ops[k].is_global);
+        if (!slot->name) {
+          slot->name = ops[k].value.name;
+          slot->is_global = ops[k].is_global;
+          slot->id = lv->var_count;
+          lv->var_names[lv->var_count] = ops[k].value.name;
+          lv->var_global[lv->var_count] = (char)ops[k].is_global;
+          lv->var_count++;
+        }
+      }
+    }
+  }
+
+  lv->value_count = lv->temp_count + lv->var_count;
+
+  // 变量排在临时变量之后
+  for (int i = 0; i <= lv->var_mask; i++) {
+    if (lv->var_slots[i].name)
+      lv->var_slots[i].id += lv->temp_count;
+  }
+}
+
+// ==================== 查询 ====================
+
+int liveness_value(const Liveness *lv, IROperand op) {
+  if (op.type == OPERAND_TEMP) {
+    if (op.value.temp_id < lv->temp_id_base ||
+        op.value.temp_id >= lv->temp_id_limit)
+      return -1;
+    return lv->temp_index[op.value.temp_id - lv->temp_id_base];
+  }
+  if (op.type == OPERAND_VAR) {
+    struct LivenessVar *slot = find_var(lv, op.value.name, op.is_global);
+    return slot->name ? slot->id : -1;
+  }
+  return -1;
+}
+
+int liveness_instr_uses_globals(const IRInstruction *instr) {
+  return instr->opcode == IR_CALL || instr->opcode == IR_TAILCALL ||
+         instr->opcode == IR_RETURN;
+}
+
+int liveness_instr_uses(const Liveness *lv, const IRInstruction *instr,
+                        int *values) {
+  IROperand ops[2];
+  int n = read_operands(instr, ops);
+  int count = 0;
+  for (int k = 0; k < n; k++) {
+    if (!is_value_operand(ops[k]))
+      continue;
+    int v = liveness_value(lv, ops[k]);
+    if (v >= 0)
+      values[count++] = v;
+  }
+  return count;
+}
+
+int liveness_instr_def(const Liveness *lv, const IRInstruction *instr) {
+  if (!defines_value(instr->opcode) || !is_value_operand(instr->result))
+    return -1;
+  return liveness_value(lv, instr->result);
+}
+
+void liveness_step(const Liveness *lv, const IRInstruction *instr,
+                   Bitset *live) {
+  int def = liveness_instr_def(lv, instr);
+  if (def >= 0)
+    bitset_reset(live, def);
+
+  int uses[2];
+  int n = liveness_instr_uses(lv, instr, uses);
+  for (int k = 0; k < n; k++)
+    bitset_set(live, uses[k]);
+
+  if (liveness_instr_uses_globals(instr))
+    bitset_union(live, &lv->globals);
+}
+
+// ==================== 分析 ====================
+
+/**
+ * 计算每个块的 use / def（块内逆序扫描一遍）
+ */
+static void compute_local_sets(Liveness *lv) {
+  CFG *cfg = lv->cfg;
+  IRInstruction *code = cfg->program->instructions;
+
+  for (int b = 0; b < cfg->block_count; b++) {
+    Bitset *use = &lv->use[b];
+    Bitset *def = &lv->def[b];
+
+    for (int i = cfg->blocks[b].end - 1; i >= cfg->blocks[b].start; i--) {
+      int d = liveness_instr_def(lv, &code[i]);
+      if (d >= 0)
+        bitset_set(def, d);
+      liveness_step(lv, &code[i], use);
+    }
+  }
+}
+
+/**
+ * 工作表迭代直到不动点
+ *
+ * 初始顺序是后序（逆后序倒过来）：逆向问题里后继先于前驱算好，
+ * 无环的部分一遍就能得到最终结果，只有循环需要再传播。
+ */
+static void solve(Liveness *lv) {
+  CFG *cfg = lv->cfg;
+  int n = cfg->block_count;
+  if (n == 0)
+    return;
+
+  int *queue = (int *)malloc(sizeof(int) * n);
+  char *queued = (char *)calloc(n, 1);
+  int head = 0, size = 0;
+
+  for (int i = cfg->rpo_count - 1; i >= 0; i--) {
+    queue[size++] = cfg->rpo[i];
+    queued[cfg->rpo[i]] = 1;
+  }
+  // 从入口不可达的块也要有结果（寄存器分配会遍历所有块）
+  for (int b = 0; b < n; b++) {
+    if (!queued[b]) {
+      queue[size++] = b;
+      queued[b] = 1;
+    }
+  }
+
+  while (size > 0) {
+    int b = queue[head];
+    head = (head + 1) % n;
+    size--;
+    queued[b] = 0;
+    lv->visits++;
+
+    BasicBlock *block = &cfg->blocks[b];
+    Bitset *out = &lv->live_out[b];
+    if (block->succ_count == 0) {
+      bitset_copy(out, &lv->globals); // 函数出口：调用者可能读全局变量
+    } else {
+      bitset_copy(out, &lv->live_in[block->succs[0]]);
+      for (int s = 1; s < block->succ_count; s++)
+        bitset_union(out, &lv->live_in[block->succs[s]]);
+    }
+
+    if (!bitset_transfer(&lv->live_in[b], &lv->use[b], out, &lv->def[b]))
+      continue;
+
+    for (int p = 0; p < block->pred_count; p++) {
+      int pred = block->preds[p];
+      if (!queued[pred]) {
+        queued[pred] = 1;
+        queue[(head + size) % n] = pred;
+        size++;
+      }
+    }
+  }
+
+  free(queue);
+  free(queued);
+}
+
+Liveness *liveness_analyze(IRProgram *program, IRFunction *func) {
+  Liveness *lv = (Liveness *)calloc(1, sizeof(Liveness));
+  lv->cfg = cfg_build(program, func);
+
+  number_values(lv, program, func);
+
+  bitset_init(&lv->globals, lv->value_count);
+  for (int i = 0; i < lv->var_count; i++) {
+    if (lv->var_global[i])
+      bitset_set(&lv->globals, lv->temp_count + i);
+  }
+
+  int blocks = lv->cfg->block_count ? lv->cfg->block_count : 1;
+  lv->use = (Bitset *)malloc(sizeof(Bitset) * blocks);
+  lv->def = (Bitset *)malloc(sizeof(Bitset) * blocks);
+  lv->live_in = (Bitset *)malloc(sizeof(Bitset) * blocks);
+  lv->live_out = (Bitset *)malloc(sizeof(Bitset) * blocks);
+  for (int b = 0; b < lv->cfg->block_count; b++) {
+    bitset_init(&lv->use[b], lv->value_count);
+    bitset_init(&lv->def[b], lv->value_count);
+    bitset_init(&lv->live_in[b], lv->value_count);
+    bitset_init(&lv->live_out[b], lv->value_count);
+  }
+
+  compute_local_sets(lv);
+  solve(lv);
+  return lv;
+}
+
+void liveness_free(Liveness *lv) {
+  if (!lv)
+    return;
+  for (int b = 0; b < lv->cfg->block_count; b++) {
+    bitset_free(&lv->use[b]);
+    bitset_free(&lv->def[b]);
+    bitset_free(&lv->live_in[b]);
+    bitset_free(&lv->live_out[b]);
+  }
+  free(lv->use);
+  free(lv->def);
+  free(lv->live_in);
+  free(lv->live_out);
+  bitset_free(&lv->globals);
+  free(lv->temp_index);
+  free(lv->value_temp);
+  free(lv->var_names);
+  free(lv->var_global);
+  free(lv->var_slots);
+  cfg_free(lv->cfg);
+  free(lv);
+}
+
+// ==================== 打印 ====================
+
+static void print_set(const Liveness *lv, const Bitset *set) {
+  printf("{");
+  int first = 1;
+  for (int v = bitset_next(set, 0); v >= 0; v = bitset_next(set, v + 1)) {
+    printf(first ? "" : ", ");
+    if (v < lv->temp_count)
+      printf("t%d", lv->value_temp[v]);
+    else
+      printf("%s", lv->var_names[v - lv->temp_count]);
+    first = 0;
+  }
+  printf("}");
+}
+
+void liveness_print(const Liveness *lv) {
+  CFG *cfg = lv->cfg;
+  printf("Liveness of %s: %d blocks, %d temps, %d vars, %d block visits\n",
+         cfg->func.name, cfg->block_count, lv->temp_count, lv->var_count,
+         lv->visits);
+  for (int b = 0; b < cfg->block_count; b++) {
+    BasicBlock *block = &cfg->blocks[b];
+    printf("  B%d [%d, %d) ->", b, block->start, block->end);
+    for (int s = 0; s < block->succ_count; s++)
+      printf(" B%d", block->succs[s]);
+    printf("\n    in:  ");
+    print_set(lv, &lv->live_in[b]);
+    printf("\n    out: ");
+    print_set(lv, &lv->live_out[b]);
+    printf("\n");
+  }
+}
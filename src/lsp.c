@@ -0,0 +1,548 @@
+/**
+ * lsp.c - 语言服务器实现
+ */
+
+#include "../include/lsp.h"
+#include "../include/incremental.h"
+#include "../include/json.h"
+#include "../include/writer.h"
+#include "../include/memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// JSON-RPC 的错误码
+#define PARSE_ERROR -32700
+#define INVALID_REQUEST -32600
+#define METHOD_NOT_FOUND -32601
+#define SERVER_NOT_INITIALIZED -32002
+
+// DocumentSymbol.kind
+#define SYMBOL_KIND_FUNCTION 12
+#define SYMBOL_KIND_VARIABLE 13
+
+typedef struct {
+  char *uri;
+  Document *doc;
+  int version;
+  int ascii; // 源码里一直没有非 ASCII 字节（UTF-16 的列就是字节数）
+} OpenDocument;
+
+typedef struct {
+  FILE *out;
+  OpenDocument *documents;
+  int count;
+  int capacity;
+  int initialized;
+  int shutdown;
+  int utf8; // 位置按字节计列（客户端同意时）
+} LspServer;
+
+// ========== 消息的读写 ==========
+
+/**
+ * 读一条消息的内容，放进 *buffer（按需扩大）；输入结束或头部不对时返回 1
+ */
+static int read_message(FILE *in, char **buffer, size_t *capacity,
+                        size_t *length) {
+  char header[1024];
+  long content_length = -1;
+  for (;;) {
+    if (!fgets(header, sizeof(header), in))
+      return 1;
+    if (strcmp(header, "\r\n") == 0 || strcmp(header, "\n") == 0)
+      break;
+    if (strncmp(header, "Content-Length:", 15) == 0)
+      content_length = strtol(header + 15, NULL, 10);
+  }
+  if (content_length < 0)
+    return 1;
+
+  if ((size_t)content_length + 1 > *capacity) {
+    *capacity = (size_t)content_length + 1;
+    *buffer = (char *)realloc(*buffer, *capacity);
+  }
+  if (fread(*buffer, 1, (size_t)content_length, in) !=
+      (size_t)content_length)
+    return 1;
+  (*buffer)[content_length] = '\0';
+  *length = (size_t)content_length;
+  return 0;
+}
+
+/**
+ * 加上 Content-Length 头发出 body，并释放它
+ */
+static void send_message(LspServer *server, Writer *body) {
+  fprintf(server->out, "Content-Length: %lu\r\n\r\n",
+          (unsigned long)body->length);
+  fwrite(body->buffer, 1, body->length, server->out);
+  fflush(server->out);
+  writer_close(body);
+}
+
+/**
+ * 请求的 id 原样写回（数字、字符串或 null）
+ */
+static void write_id(Writer *out, const JsonValue *id) {
+  if (id && id->type == JSON_STRING)
+    json_write_string(out, id->string, id->length);
+  else if (id && id->type == JSON_NUMBER)
+    writer_printf(out, "%.17g", id->number);
+  else
+    writer_puts(out, "null");
+}
+
+/**
+ * 开始一个应答，之后写 result 的值，再用 finish_result 结束
+ */
+static Writer *begin_result(const JsonValue *id) {
+  Writer *out = writer_memory();
+  writer_puts(out, "{\"jsonrpc\":\"2.0\",\"id\":");
+  write_id(out, id);
+  writer_puts(out, ",\"result\":");
+  return out;
+}
+
+static void finish_result(LspServer *server, Writer *out) {
+  writer_putc(out, '}');
+  send_message(server, out);
+}
+
+static void send_error(LspServer *server, const JsonValue *id, int code,
+                       const char *message) {
+  Writer *out = writer_memory();
+  writer_puts(out, "{\"jsonrpc\":\"2.0\",\"id\":");
+  write_id(out, id);
+  writer_printf(out, ",\"error\":{\"code\":%d,\"message\":", code);
+  json_write_string(out, message, strlen(message));
+  writer_puts(out, "}}");
+  send_message(server, out);
+}
+
+// ========== 位置换算 ==========
+
+/**
+ * UTF-8 序列的第一个字节对应几个 UTF-16 单元（后续字节为 0）
+ */
+static int utf16_units(unsigned char c) {
+  if ((c & 0xC0) == 0x80)
+    return 0;
+  return c >= 0xF0 ? 2 : 1;
+}
+
+/**
+ * LSP 的位置（行从 0 开始）换成源码里的偏移，超出行尾时停在行尾
+ */
+static int position_offset(const LspServer *server, const OpenDocument *open,
+                           const JsonValue *position) {
+  const Document *doc = open->doc;
+  int line = (int)json_number(json_get(position, "line"), 0);
+  int character = (int)json_number(json_get(position, "character"), 0);
+  if (line < 0)
+    line = 0;
+  int offset = document_line_start(doc, line + 1);
+  int units = 0;
+  while (offset < doc->length && doc->text[offset] != '\n') {
+    if (server->utf8 || open->ascii) {
+      if (units >= character)
+        break;
+      units++;
+    } else {
+      int step = utf16_units((unsigned char)doc->text[offset]);
+      if (step > 0 && units + step > character)
+        break;
+      units += step;
+    }
+    offset++;
+  }
+  return offset;
+}
+
+/**
+ * 源码里的行列（都从 1 开始，列按字节）换成 LSP 的列
+ */
+static int position_character(const LspServer *server,
+                              const OpenDocument *open, int line, int column) {
+  if (server->utf8 || open->ascii)
+    return column - 1;
+  const Document *doc = open->doc;
+  int offset = document_line_start(doc, line);
+  int units = 0;
+  for (int i = 0; i < column - 1 && offset + i < doc->length; i++)
+    units += utf16_units((unsigned char)doc->text[offset + i]);
+  return units;
+}
+
+static void write_position(Writer *out, int line, int character) {
+  writer_puts(out, "{\"line\":");
+  writer_int(out, line);
+  writer_puts(out, ",\"character\":");
+  writer_int(out, character);
+  writer_putc(out, '}');
+}
+
+/**
+ * 写出 [line:column, line:column + length) 的 Range（源码里的行列）
+ */
+static void write_name_range(Writer *out, const LspServer *server,
+                             const OpenDocument *open, int line, int column,
+                             int length) {
+  writer_puts(out, "{\"start\":");
+  write_position(out, line - 1,
+                 position_character(server, open, line, column));
+  writer_puts(out, ",\"end\":");
+  write_position(out, line - 1,
+                 position_character(server, open, line, column + length));
+  writer_putc(out, '}');
+}
+
+static int is_ascii(const char *text, size_t length) {
+  for (size_t i = 0; i < length; i++)
+    if ((unsigned char)text[i] >= 0x80)
+      return 0;
+  return 1;
+}
+
+// ========== 文档 ==========
+
+static OpenDocument *find_document(LspServer *server, const char *uri) {
+  for (int i = 0; i < server->count; i++)
+    if (strcmp(server->documents[i].uri, uri) == 0)
+      return &server->documents[i];
+  return NULL;
+}
+
+static OpenDocument *document_of(LspServer *server, const JsonValue *params) {
+  const char *uri =
+      json_string(json_get(json_get(params, "textDocument"), "uri"), NULL);
+  return uri ? find_document(server, uri) : NULL;
+}
+
+/**
+ * 发出文档当前的诊断（行号都换成从 0 开始，范围是整行）
+ */
+static void publish_diagnostics(LspServer *server, const char *uri,
+                                Document *doc, int version) {
+  Writer *out = writer_memory();
+  writer_puts(out, "{\"jsonrpc\":\"2.0\",\"method\":"
+                   "\"textDocument/publishDiagnostics\",\"params\":{\"uri\":");
+  json_write_string(out, uri, strlen(uri));
+  if (doc)
+    writer_printf(out, ",\"version\":%d", version);
+  writer_puts(out, ",\"diagnostics\":[");
+  if (doc) {
+    int count;
+    Diagnostic *diagnostics = document_diagnostics(doc, &count);
+    for (int i = 0; i < count; i++) {
+      int line = diagnostics[i].line > 0 ? diagnostics[i].line - 1 : 0;
+      writer_puts(out, i ? ",{\"range\":{\"start\":" : "{\"range\":{\"start\":");
+      write_position(out, line, 0);
+      writer_puts(out, ",\"end\":");
+      write_position(out, line + 1, 0);
+      writer_puts(out, "},\"severity\":1,\"source\":\"compiler\",\"message\":");
+      json_write_string(out, diagnostics[i].message,
+                        strlen(diagnostics[i].message));
+      writer_putc(out, '}');
+    }
+    free(diagnostics);
+  }
+  writer_puts(out, "]}}");
+  send_message(server, out);
+}
+
+static void did_open(LspServer *server, const JsonValue *params) {
+  const JsonValue *item = json_get(params, "textDocument");
+  const char *uri = json_string(json_get(item, "uri"), NULL);
+  const JsonValue *text = json_get(item, "text");
+  if (!uri || !text || text->type != JSON_STRING)
+    return;
+
+  OpenDocument *open = find_document(server, uri);
+  if (open) {
+    document_free(open->doc);
+  } else {
+    if (server->count >= server->capacity) {
+      server->capacity = server->capacity == 0 ? 4 : server->capacity * 2;
+      server->documents = (OpenDocument *)realloc(
+          server->documents, sizeof(OpenDocument) * server->capacity);
+    }
+    open = &server->documents[server->count++];
+    size_t length = strlen(uri);
+    open->uri = (char *)malloc(length + 1);
+    memcpy(open->uri, uri, length + 1);
+  }
+  open->doc = document_open(text->string, text->length);
+  open->version = (int)json_number(json_get(item, "version"), 0);
+  open->ascii = is_ascii(text->string, text->length);
+  publish_diagnostics(server, open->uri, open->doc, open->version);
+}
+
+/**
+ * 全文替换：只改前后不同的部分
+ */
+static void replace_text(OpenDocument *open, const char *text, size_t length) {
+  Document *doc = open->doc;
+  size_t old_length = (size_t)doc->length;
+  size_t prefix = 0;
+  while (prefix < old_length && prefix < length &&
+         doc->text[prefix] == text[prefix])
+    prefix++;
+  size_t suffix = 0;
+  while (suffix < old_length - prefix && suffix < length - prefix &&
+         doc->text[old_length - 1 - suffix] == text[length - 1 - suffix])
+    suffix++;
+  document_edit(doc, prefix, old_length - prefix - suffix, text + prefix,
+                length - prefix - suffix);
+  open->ascii = is_ascii(text, length);
+}
+
+static void did_change(LspServer *server, const JsonValue *params) {
+  OpenDocument *open = document_of(server, params);
+  const JsonValue *changes = json_get(params, "contentChanges");
+  if (!open || !changes || changes->type != JSON_ARRAY)
+    return;
+
+  for (int i = 0; i < changes->count; i++) {
+    const JsonValue *change = &changes->items[i];
+    const JsonValue *text = json_get(change, "text");
+    const JsonValue *range = json_get(change, "range");
+    if (!text || text->type != JSON_STRING)
+      continue;
+    if (!range) {
+      replace_text(open, text->string, text->length);
+      continue;
+    }
+    int start = position_offset(server, open, json_get(range, "start"));
+    int end = position_offset(server, open, json_get(range, "end"));
+    if (end < start)
+      end = start;
+    document_edit(open->doc, (size_t)start, (size_t)(end - start),
+                  text->string, text->length);
+    if (!is_ascii(text->string, text->length))
+      open->ascii = 0;
+  }
+  open->version = (int)json_number(
+      json_get(json_get(params, "textDocument"), "version"), open->version);
+  publish_diagnostics(server, open->uri, open->doc, open->version);
+}
+
+static void did_close(LspServer *server, const JsonValue *params) {
+  OpenDocument *open = document_of(server, params);
+  if (!open)
+    return;
+  // 关闭后清掉编辑器里的诊断
+  publish_diagnostics(server, open->uri, NULL, 0);
+  document_free(open->doc);
+  free(open->uri);
+  *open = server->documents[--server->count];
+}
+
+// ========== 查询 ==========
+
+/**
+ * 请求里的位置处的名字；没有时返回 0
+ */
+static int reference_at(LspServer *server, const JsonValue *params,
+                        OpenDocument **open, DocumentReference *ref) {
+  *open = document_of(server, params);
+  if (!*open)
+    return 0;
+  const Document *doc = (*open)->doc;
+  int offset = position_offset(server, *open, json_get(params, "position"));
+  int line = (int)json_number(
+                 json_get(json_get(params, "position"), "line"), 0) + 1;
+  int column = offset - document_line_start(doc, line) + 1;
+  return document_reference_at(doc, line, column, ref);
+}
+
+static void definition(LspServer *server, const JsonValue *id,
+                       const JsonValue *params) {
+  OpenDocument *open;
+  DocumentReference ref;
+  Writer *out = begin_result(id);
+  if (reference_at(server, params, &open, &ref) && ref.decl_line > 0) {
+    writer_puts(out, "{\"uri\":");
+    json_write_string(out, open->uri, strlen(open->uri));
+    writer_puts(out, ",\"range\":");
+    write_name_range(out, server, open, ref.decl_line, ref.decl_column,
+                     ref.length);
+    writer_putc(out, '}');
+  } else {
+    writer_puts(out, "null");
+  }
+  finish_result(server, out);
+}
+
+static void hover(LspServer *server, const JsonValue *id,
+                  const JsonValue *params) {
+  OpenDocument *open;
+  DocumentReference ref;
+  Writer *out = begin_result(id);
+  if (reference_at(server, params, &open, &ref)) {
+    Writer *value = writer_memory();
+    writer_printf(value, "```c\n%s\n```", ref.detail);
+    writer_puts(out, "{\"contents\":{\"kind\":\"markdown\",\"value\":");
+    json_write_string(out, value->buffer, value->length);
+    writer_close(value);
+    writer_puts(out, "},\"range\":");
+    write_name_range(out, server, open, ref.line, ref.column, ref.length);
+    writer_putc(out, '}');
+  } else {
+    writer_puts(out, "null");
+  }
+  finish_result(server, out);
+}
+
+static void document_symbol(LspServer *server, const JsonValue *id,
+                            const JsonValue *params) {
+  OpenDocument *open = document_of(server, params);
+  Writer *out = begin_result(id);
+  if (!open) {
+    writer_puts(out, "null");
+    finish_result(server, out);
+    return;
+  }
+
+  int count;
+  DocumentSymbol *symbols = document_symbols(open->doc, &count);
+  writer_putc(out, '[');
+  for (int i = 0; i < count; i++) {
+    const DocumentSymbol *symbol = &symbols[i];
+    writer_puts(out, i ? ",{\"name\":" : "{\"name\":");
+    json_write_string(out, symbol->name, strlen(symbol->name));
+    writer_puts(out, ",\"detail\":");
+    json_write_string(out, symbol->detail, strlen(symbol->detail));
+    writer_printf(out, ",\"kind\":%d,\"range\":{\"start\":",
+                  symbol->function ? SYMBOL_KIND_FUNCTION
+                                   : SYMBOL_KIND_VARIABLE);
+    write_position(out, symbol->start_line - 1,
+                   position_character(server, open, symbol->start_line,
+                                      symbol->start_column));
+    writer_puts(out, ",\"end\":");
+    write_position(out, symbol->end_line - 1,
+                   position_character(server, open, symbol->end_line,
+                                      symbol->end_column));
+    writer_puts(out, "},\"selectionRange\":");
+    write_name_range(out, server, open, symbol->line, symbol->column,
+                     (int)strlen(symbol->name));
+    writer_putc(out, '}');
+  }
+  writer_putc(out, ']');
+  free(symbols);
+  finish_result(server, out);
+}
+
+// ========== 生命周期 ==========
+
+static void initialize(LspServer *server, const JsonValue *id,
+                       const JsonValue *params) {
+  // 客户端能用 UTF-8 的位置时就不用换算 UTF-16
+  const JsonValue *encodings = json_get(
+      json_get(json_get(params, "capabilities"), "general"),
+      "positionEncodings");
+  server->utf8 = 0;
+  if (encodings && encodings->type == JSON_ARRAY)
+    for (int i = 0; i < encodings->count; i++)
+      if (strcmp(json_string(&encodings->items[i], ""), "utf-8") == 0)
+        server->utf8 = 1;
+  server->initialized = 1;
+
+  Writer *out = begin_result(id);
+  writer_printf(out,
+                "{\"capabilities\":{\"positionEncoding\":\"%s\","
+                "\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+                "\"definitionProvider\":true,\"hoverProvider\":true,"
+                "\"documentSymbolProvider\":true},"
+                "\"serverInfo\":{\"name\":\"compiler\"}}",
+                server->utf8 ? "utf-8" : "utf-16");
+  finish_result(server, out);
+}
+
+/**
+ * 处理一条消息；收到 exit 时返回 1
+ */
+static int dispatch(LspServer *server, const JsonValue *message) {
+  const char *method = json_string(json_get(message, "method"), NULL);
+  const JsonValue *id = json_get(message, "id");
+  const JsonValue *params = json_get(message, "params");
+  if (!method) {
+    // 客户端对我们请求的应答（我们不发请求）或者不合法的消息
+    if (id && !json_get(message, "result") && !json_get(message, "error"))
+      send_error(server, id, INVALID_REQUEST, "Missing method");
+    return 0;
+  }
+
+  if (strcmp(method, "exit") == 0)
+    return 1;
+  if (strcmp(method, "initialize") == 0) {
+    initialize(server, id, params);
+    return 0;
+  }
+  if (!server->initialized) {
+    if (id)
+      send_error(server, id, SERVER_NOT_INITIALIZED, "Server not initialized");
+    return 0;
+  }
+
+  if (strcmp(method, "shutdown") == 0) {
+    server->shutdown = 1;
+    Writer *out = begin_result(id);
+    writer_puts(out, "null");
+    finish_result(server, out);
+    return 0;
+  }
+  if (strcmp(method, "textDocument/didOpen") == 0)
+    did_open(server, params);
+  else if (strcmp(method, "textDocument/didChange") == 0)
+    did_change(server, params);
+  else if (strcmp(method, "textDocument/didClose") == 0)
+    did_close(server, params);
+  else if (strcmp(method, "textDocument/definition") == 0)
+    definition(server, id, params);
+  else if (strcmp(method, "textDocument/hover") == 0)
+    hover(server, id, params);
+  else if (strcmp(method, "textDocument/documentSymbol") == 0)
+    document_symbol(server, id, params);
+  else if (id)
+    send_error(server, id, METHOD_NOT_FOUND, "Method not found");
+  // 其它通知（initialized、$/cancelRequest 等）不用处理
+  return 0;
+}
+
+int lsp_run(FILE *in, FILE *out) {
+#ifdef _WIN32
+  // Content-Length 按字节计，不能让 CRT 改换行
+  _setmode(_fileno(in), _O_BINARY);
+  _setmode(_fileno(out), _O_BINARY);
+#endif
+  LspServer server;
+  memset(&server, 0, sizeof(server));
+  server.out = out;
+
+  char *buffer = NULL;
+  size_t capacity = 0, length;
+  while (read_message(in, &buffer, &capacity, &length) == 0) {
+    JsonValue *message = json_parse(buffer, length);
+    if (!message) {
+      send_error(&server, NULL, PARSE_ERROR, "Parse error");
+      continue;
+    }
+    int done = dispatch(&server, message);
+    json_free(message);
+    if (done)
+      break;
+  }
+
+  for (int i = 0; i < server.count; i++) {
+    document_free(server.documents[i].doc);
+    free(server.documents[i].uri);
+  }
+  free(server.documents);
+  free(buffer);
+  return server.shutdown ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+/**
+ * memory.c - 计数的内存分配实现
+ */
+
+#define MEMORY_UNCOUNTED
+
+#include "../include/memory.h"
+#include <string.h>
+
+#if defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+static THREAD_LOCAL MemoryStats stats;
+static THREAD_LOCAL const MemoryAllocator *allocator;
+
+void *mem_malloc(size_t size) {
+  stats.allocations++;
+  stats.bytes += size;
+  if (allocator)
+    return allocator->allocate(allocator->user, size);
+  return malloc(size);
+}
+
+void *mem_calloc(size_t count, size_t size) {
+  stats.allocations++;
+  stats.bytes += count * size;
+  if (!allocator)
+    return calloc(count, size);
+  if (size != 0 && count > (size_t)-1 / size)
+    return NULL;
+  void *ptr = allocator->allocate(allocator->user, count * size);
+  if (ptr)
+    memset(ptr, 0, count * size);
+  return ptr;
+}
+
+void *mem_realloc(void *ptr, size_t size) {
+  stats.allocations++;
+  stats.bytes += size;
+  if (allocator)
+    return allocator->reallocate(allocator->user, ptr, size);
+  return realloc(ptr, size);
+}
+
+void mem_free(void *ptr) {
+  if (!ptr)
+    return;
+  stats.frees++;
+  if (allocator)
+    allocator->release(allocator->user, ptr);
+  else
+    free(ptr);
+}
+
+MemoryStats memory_stats(void) { return stats; }
+
+const MemoryAllocator *
+memory_set_allocator(const MemoryAllocator *new_allocator) {
+  const MemoryAllocator *previous = allocator;
+  allocator = new_allocator;
+  return previous;
+}
@@ -0,0 +1,371 @@
+/**
+ * object.c - ELF64 目标文件输出实现
+ */
+
+#include "../include/object.h"
+#include "../include/diag.h"
+#include "../include/encode.h"
+#include "../include/hash.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ELF 常量（和 <elf.h> 的取值一致）
+#define ELF_HEADER_SIZE 64
+#define SECTION_HEADER_SIZE 64
+#define SYMBOL_SIZE 24
+#define RELA_SIZE 24
+
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_RELA 4
+
+#define SHF_WRITE 0x1
+#define SHF_ALLOC 0x2
+#define SHF_EXECINSTR 0x4
+#define SHF_INFO_LINK 0x40
+
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_OBJECT 1
+#define STT_FUNC 2
+#define STT_SECTION 3
+
+/**
+ * 段编号（节头表里的下标）
+ */
+enum {
+  SEC_NULL,
+  SEC_TEXT,
+  SEC_DATA,
+  SEC_RODATA,
+  SEC_RELA_TEXT,
+  SEC_SYMTAB,
+  SEC_STRTAB,
+  SEC_SHSTRTAB,
+  SEC_NOTE_STACK, // .note.GNU-stack：声明不需要可执行栈
+  SEC_COUNT
+};
+
+static const char *section_names[SEC_COUNT] = {
+    "", ".text", ".data", ".rodata", ".rela.text", ".symtab", ".strtab",
+    ".shstrtab", ".note.GNU-stack"};
+
+// 段符号（局部）排在最前面：.text、.data、.rodata
+#define SECTION_SYMBOLS 3
+#define SYM_RODATA 3
+
+/**
+ * 可增长的字节缓冲区
+ */
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+} Buffer;
+
+static void buffer_reserve(Buffer *buf, size_t extra) {
+  if (buf->size + extra <= buf->capacity)
+    return;
+  size_t capacity = buf->capacity == 0 ? 1024 : buf->capacity;
+  while (capacity < buf->size + extra)
+    capacity *= 2;
+  buf->data = (uint8_t *)realloc(buf->data, capacity);
+  buf->capacity = capacity;
+}
+
+static void put_bytes(Buffer *buf, const void *data, size_t size) {
+  buffer_reserve(buf, size);
+  memcpy(buf->data + buf->size, data, size);
+  buf->size += size;
+}
+
+// 小端整数
+static void put_uint(Buffer *buf, uint64_t value, int size) {
+  buffer_reserve(buf, size);
+  for (int i = 0; i < size; i++)
+    buf->data[buf->size++] = (uint8_t)(value >> (8 * i));
+}
+
+static void put_zeros(Buffer *buf, size_t count) {
+  if (count == 0)
+    return;
+  buffer_reserve(buf, count);
+  memset(buf->data + buf->size, 0, count);
+  buf->size += count;
+}
+
+static void align(Buffer *buf, size_t alignment) {
+  put_zeros(buf, (alignment - buf->size % alignment) % alignment);
+}
+
+// 追加一个字符串，返回它在字符串表里的偏移
+static uint32_t put_string(Buffer *buf, const char *s) {
+  uint32_t offset = (uint32_t)buf->size;
+  put_bytes(buf, s, strlen(s) + 1);
+  return offset;
+}
+
+/**
+ * 符号
+ */
+typedef struct {
+  const char *name;
+  int bind;
+  int type;
+  int section;
+  uint64_t value;
+  uint64_t size;
+} Symbol;
+
+typedef struct {
+  Symbol *symbols;
+  int count;
+  int capacity;
+  NameMap index; // 名字 → 下标（不含前面的节符号）
+} SymbolTable;
+
+static int add_symbol(SymbolTable *table, const char *name, int bind, int type,
+                      int section, uint64_t value, uint64_t size) {
+  if (table->count >= table->capacity) {
+    table->capacity = table->capacity == 0 ? 32 : table->capacity * 2;
+    table->symbols =
+        (Symbol *)realloc(table->symbols, sizeof(Symbol) * table->capacity);
+  }
+  Symbol *sym = &table->symbols[table->count];
+  sym->name = name;
+  sym->bind = bind;
+  sym->type = type;
+  sym->section = section;
+  sym->value = value;
+  sym->size = size;
+  if (table->count >= SECTION_SYMBOLS)
+    name_map_put(&table->index, name, table->count);
+  return table->count++;
+}
+
+// 符号表下标（下标 0 是空符号，所以 +1）；找不到时添加未定义符号
+static int symbol_index(SymbolTable *table, const char *name) {
+  int index = name_map_get(&table->index, name);
+  if (index >= 0)
+    return index + 1;
+  return add_symbol(table, name, STB_GLOBAL, STT_NOTYPE, SEC_NULL, 0, 0) + 1;
+}
+
+typedef struct {
+  uint32_t name;
+  uint32_t type;
+  uint64_t flags;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t link;
+  uint32_t info;
+  uint64_t align;
+  uint64_t entsize;
+} SectionHeader;
+
+static void put_section_header(Buffer *buf, const SectionHeader *sh) {
+  put_uint(buf, sh->name, 4);
+  put_uint(buf, sh->type, 4);
+  put_uint(buf, sh->flags, 8);
+  put_uint(buf, 0, 8); // sh_addr
+  put_uint(buf, sh->offset, 8);
+  put_uint(buf, sh->size, 8);
+  put_uint(buf, sh->link, 4);
+  put_uint(buf, sh->info, 4);
+  put_uint(buf, sh->align, 8);
+  put_uint(buf, sh->entsize, 8);
+}
+
+static void put_elf_header(Buffer *buf, uint64_t shoff) {
+  static const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 2 /* 64 位 */,
+                                    1 /* 小端 */, 1 /* 版本 */};
+  put_bytes(buf, ident, sizeof(ident));
+  put_uint(buf, 1, 2);  // e_type: ET_REL
+  put_uint(buf, 62, 2); // e_machine: EM_X86_64
+  put_uint(buf, 1, 4);  // e_version
+  put_uint(buf, 0, 8);  // e_entry
+  put_uint(buf, 0, 8);  // e_phoff
+  put_uint(buf, shoff, 8);
+  put_uint(buf, 0, 4); // e_flags
+  put_uint(buf, ELF_HEADER_SIZE, 2);
+  put_uint(buf, 0, 2); // e_phentsize
+  put_uint(buf, 0, 2); // e_phnum
+  put_uint(buf, SECTION_HEADER_SIZE, 2);
+  put_uint(buf, SEC_COUNT, 2);
+  put_uint(buf, SEC_SHSTRTAB, 2);
+}
+
+// ==================== 接口 ====================
+
+int object_build(const X86Module *module, uint8_t **data, size_t *size) {
+  X86Code code;
+  if (x86_encode_module(module, &code) != 0) {
+    x86_code_free(&code);
+    return 1;
+  }
+
+  SymbolTable symbols;
+  memset(&symbols, 0, sizeof(symbols));
+  name_map_init(&symbols.index, module->func_count + module->global_count);
+  add_symbol(&symbols, "", STB_LOCAL, STT_SECTION, SEC_TEXT, 0, 0);
+  add_symbol(&symbols, "", STB_LOCAL, STT_SECTION, SEC_DATA, 0, 0);
+  add_symbol(&symbols, "", STB_LOCAL, STT_SECTION, SEC_RODATA, 0, 0);
+
+  for (int f = 0; f < module->func_count; f++)
+    add_symbol(&symbols, module->functions[f].name, STB_GLOBAL, STT_FUNC,
+               SEC_TEXT, code.func_offsets[f], code.func_sizes[f]);
+
+  // .data：和 x86_print_gas 的布局一致
+  int *offsets = (int *)malloc(sizeof(int) * (module->global_count + 1));
+  Buffer data_section;
+  memset(&data_section, 0, sizeof(data_section));
+  put_zeros(&data_section, x86_layout_globals(module, offsets));
+  for (int i = 0; i < module->global_count; i++) {
+    const X86Global *g = &module->globals[i];
+    uint8_t *slot = data_section.data + offsets[i];
+    int width = g->type == IR_TYPE_FLOAT ? 8 : 4;
+    uint64_t bits = (uint32_t)g->int_value;
+    if (g->type == IR_TYPE_FLOAT)
+      memcpy(&bits, &g->float_value, sizeof(bits));
+    for (int k = 0; k < width; k++)
+      slot[k] = (uint8_t)(bits >> (8 * k));
+    add_symbol(&symbols, g->name, STB_GLOBAL, STT_OBJECT, SEC_DATA, offsets[i],
+               width);
+  }
+  free(offsets);
+
+  // 重定位项（可能添加未定义的函数符号）
+  Buffer rela;
+  memset(&rela, 0, sizeof(rela));
+  for (int i = 0; i < code.reloc_count; i++) {
+    const X86Reloc *reloc = &code.relocs[i];
+    uint64_t sym =
+        reloc->name ? (uint64_t)symbol_index(&symbols, reloc->name) : SYM_RODATA;
+    put_uint(&rela, reloc->offset, 8);
+    put_uint(&rela, sym << 32 | reloc->type, 8);
+    put_uint(&rela, (uint64_t)reloc->addend, 8);
+  }
+
+  Buffer strtab, symtab;
+  memset(&strtab, 0, sizeof(strtab));
+  memset(&symtab, 0, sizeof(symtab));
+  put_string(&strtab, "");
+  put_zeros(&symtab, SYMBOL_SIZE); // 0 号空符号
+  for (int i = 0; i < symbols.count; i++) {
+    const Symbol *sym = &symbols.symbols[i];
+    put_uint(&symtab, sym->name[0] ? put_string(&strtab, sym->name) : 0, 4);
+    put_uint(&symtab, (uint64_t)(sym->bind << 4 | sym->type), 1);
+    put_uint(&symtab, 0, 1); // st_other: STV_DEFAULT
+    put_uint(&symtab, (uint64_t)sym->section, 2);
+    put_uint(&symtab, sym->value, 8);
+    put_uint(&symtab, sym->size, 8);
+  }
+
+  Buffer shstrtab;
+  memset(&shstrtab, 0, sizeof(shstrtab));
+  uint32_t name_offsets[SEC_COUNT];
+  for (int i = 0; i < SEC_COUNT; i++)
+    name_offsets[i] = put_string(&shstrtab, section_names[i]);
+
+  // 依次排列各段内容，最后是节头表
+  SectionHeader headers[SEC_COUNT];
+  memset(headers, 0, sizeof(headers));
+  Buffer out;
+  memset(&out, 0, sizeof(out));
+  put_zeros(&out, ELF_HEADER_SIZE);
+
+  struct {
+    int section;
+    uint32_t type;
+    uint64_t flags;
+    const void *bytes;
+    size_t size;
+    uint64_t align;
+    uint64_t entsize;
+  } layout[] = {
+      {SEC_TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, code.bytes,
+       (size_t)code.size, 1, 0},
+      {SEC_DATA, SHT_PROGBITS, SHF_WRITE | SHF_ALLOC, data_section.data,
+       data_section.size, 8, 0},
+      {SEC_RODATA, SHT_PROGBITS, SHF_ALLOC, NULL,
+       (size_t)module->const_count * X86_CONST_SIZE, 16, 0},
+      {SEC_RELA_TEXT, SHT_RELA, SHF_INFO_LINK, rela.data, rela.size, 8,
+       RELA_SIZE},
+      {SEC_SYMTAB, SHT_SYMTAB, 0, symtab.data, symtab.size, 8, SYMBOL_SIZE},
+      {SEC_STRTAB, SHT_STRTAB, 0, strtab.data, strtab.size, 1, 0},
+      {SEC_SHSTRTAB, SHT_STRTAB, 0, shstrtab.data, shstrtab.size, 1, 0},
+      {SEC_NOTE_STACK, SHT_PROGBITS, 0, NULL, 0, 1, 0},
+  };
+
+  for (size_t i = 0; i < sizeof(layout) / sizeof(layout[0]); i++) {
+    SectionHeader *sh = &headers[layout[i].section];
+    align(&out, layout[i].align);
+    sh->name = name_offsets[layout[i].section];
+    sh->type = layout[i].type;
+    sh->flags = layout[i].flags;
+    sh->offset = out.size;
+    sh->size = layout[i].size;
+    sh->align = layout[i].align;
+    sh->entsize = layout[i].entsize;
+
+    if (layout[i].section == SEC_RODATA) {
+      for (int k = 0; k < module->const_count; k++) {
+        put_uint(&out, module->consts[k].bits, 8);
+        put_uint(&out, 0, 8);
+      }
+    } else if (layout[i].size > 0) {
+      put_bytes(&out, layout[i].bytes, layout[i].size);
+    }
+  }
+  headers[SEC_RELA_TEXT].link = SEC_SYMTAB;
+  headers[SEC_RELA_TEXT].info = SEC_TEXT;
+  headers[SEC_SYMTAB].link = SEC_STRTAB;
+  headers[SEC_SYMTAB].info = SECTION_SYMBOLS + 1; // 第一个全局符号
+
+  align(&out, 8);
+  uint64_t shoff = out.size;
+  for (int i = 0; i < SEC_COUNT; i++)
+    put_section_header(&out, &headers[i]);
+
+  // 回头写 ELF 头
+  Buffer header;
+  memset(&header, 0, sizeof(header));
+  put_elf_header(&header, shoff);
+  memcpy(out.data, header.data, ELF_HEADER_SIZE);
+
+  free(header.data);
+  free(shstrtab.data);
+  free(strtab.data);
+  free(symtab.data);
+  free(rela.data);
+  free(data_section.data);
+  free(symbols.symbols);
+  name_map_free(&symbols.index);
+  x86_code_free(&code);
+
+  *data = out.data;
+  *size = out.size;
+  return 0;
+}
+
+int object_write(const X86Module *module, const char *path) {
+  uint8_t *data;
+  size_t size;
+  if (object_build(module, &data, &size) != 0)
+    return 1;
+
+  FILE *out = fopen(path, "wb");
+  if (!out) {
+    diag_printf("Error: Cannot write file '%s'\n", path);
+    free(data);
+    return 1;
+  }
+  size_t written = fwrite(data, 1, size, out);
+  fclose(out);
+  free(data);
+  return written == size ? 0 : 1;
+}
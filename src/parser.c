@@ -17,9 +17,12 @@
  * params      → param ("," param)*
  * param       → type IDENTIFIER
  * block       → "{" statement* "}"
- * statement   → var_decl | if_stmt | while_stmt | return_stmt | expr_stmt
+ * statement   → var_decl | if_stmt | while_stmt | for_stmt | return_stmt
+ *             | expr_stmt
  * if_stmt     → "if" "(" expression ")" statement ("else" statement)?
  * while_stmt  → "while" "(" expression ")" statement
+ * for_stmt    → "for" "(" (var_decl | expr_stmt | ";") expression? ";"
+ *               expression? ")" statement
  * return_stmt → "return" expression? ";"
  * expr_stmt   → expression ";"
  * expression  → assignment
@@ -38,6 +41,8 @@
  */
 
 #include "../include/parser.h"
+#include "../include/diag.h"
+#include "../include/memory.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -53,15 +58,15 @@ static void error_at(Parser *parser, Token *token, const char *message) {
   parser->panic_mode = 1;
   parser->had_error = 1;
 
-  fprintf(stderr, "[Line %d] Error", parser->lexer->line);
+  diag_printf("[Line %d] Error", parser->lexer->line);
 
   if (token->type == TOKEN_EOF) {
-    fprintf(stderr, " at end");
+    diag_printf(" at end");
   } else if (token->type != TOKEN_UNKNOWN) {
-    fprintf(stderr, " at '%s'", token->value);
+    diag_printf(" at '%s'", token->value);
   }
 
-  fprintf(stderr, ": %s\n", message);
+  diag_printf(": %s\n", message);
 }
 
 /**
@@ -227,6 +232,18 @@ static BinaryOp string_to_binary_op(const char *op) {
 static ASTNode *parse_expression(Parser *parser);
 static ASTNode *parse_statement(Parser *parser);
 static ASTNode *parse_block(Parser *parser);
+static ASTNode *parse_var_declaration(Parser *parser);
+
+/**
+ * 记下节点在源码里的位置（语义错误和编辑器用）
+ */
+static ASTNode *located(ASTNode *node, int line, int column) {
+  if (node) {
+    node->line = line;
+    node->column = column;
+  }
+  return node;
+}
 
 // ========== 表达式解析 ==========
 
@@ -239,39 +256,46 @@ static ASTNode *parse_primary(Parser *parser) {
   // 整数
   if (match(parser, TOKEN_INTEGER)) {
     int value = atoi(parser->previous.value);
-    return ast_create_int_literal(value);
+    return located(ast_create_int_literal(value), parser->previous.line,
+                   parser->previous.column);
   }
 
   // 浮点数
   if (match(parser, TOKEN_FLOAT)) {
     double value = atof(parser->previous.value);
-    return ast_create_float_literal(value);
+    return located(ast_create_float_literal(value), parser->previous.line,
+                   parser->previous.column);
   }
 
   // 字符串
   if (match(parser, TOKEN_STRING)) {
-    return ast_create_string_literal(parser->previous.value);
+    return located(ast_create_string_literal(parser->previous.value),
+                   parser->previous.line, parser->previous.column);
   }
 
   // 字符
   if (match(parser, TOKEN_CHAR)) {
     char value = parser->previous.value[0];
-    return ast_create_char_literal(value);
+    return located(ast_create_char_literal(value), parser->previous.line,
+                   parser->previous.column);
   }
 
   // true/false
   if (check_keyword(parser, "true")) {
     advance(parser);
-    return ast_create_int_literal(1);
+    return located(ast_create_int_literal(1), parser->previous.line,
+                   parser->previous.column);
   }
   if (check_keyword(parser, "false")) {
     advance(parser);
-    return ast_create_int_literal(0);
+    return located(ast_create_int_literal(0), parser->previous.line,
+                   parser->previous.column);
   }
 
   // 标识符
   if (match(parser, TOKEN_IDENTIFIER)) {
-    return ast_create_identifier(parser->previous.value);
+    return located(ast_create_identifier(parser->previous.value),
+                   parser->previous.line, parser->previous.column);
   }
 
   // 括号表达式
@@ -296,7 +320,7 @@ static ASTNode *parse_call(Parser *parser) {
   while (1) {
     if (match(parser, TOKEN_LPAREN)) {
       // 这是一个函数调用
-      if (expr->type != AST_IDENTIFIER) {
+      if (!expr || expr->type != AST_IDENTIFIER) {
         error(parser, "Can only call functions.");
         return expr;
       }
@@ -327,10 +351,12 @@ static ASTNode *parse_call(Parser *parser) {
       char *callee_copy = (char *)malloc(strlen(callee) + 1);
       strcpy(callee_copy, callee);
 
-      // 释放原来的标识符节点
+      // 释放原来的标识符节点（调用的位置就是函数名的位置）
+      int line = expr->line, column = expr->column;
       ast_free(expr);
 
-      expr = ast_create_call_expr(callee_copy, args, arg_count);
+      expr = located(ast_create_call_expr(callee_copy, args, arg_count), line,
+                     column);
       free(callee_copy);
     } else {
       break;
@@ -352,8 +378,9 @@ static ASTNode *parse_unary(Parser *parser) {
        strcmp(parser->current.value, "!") == 0)) {
     advance(parser);
     UnaryOp op = parser->previous.value[0] == '-' ? OP_NEG : OP_NOT;
+    int line = parser->previous.line, column = parser->previous.column;
     ASTNode *operand = parse_unary(parser); // 递归处理右边
-    return ast_create_unary_expr(op, operand);
+    return located(ast_create_unary_expr(op, operand), line, column);
   }
 
   return parse_call(parser);
@@ -373,8 +400,9 @@ static ASTNode *parse_factor(Parser *parser) {
           strcmp(parser->current.value, "%") == 0)) {
     advance(parser);
     BinaryOp op = string_to_binary_op(parser->previous.value);
+    int line = parser->previous.line, column = parser->previous.column;
     ASTNode *right = parse_unary(parser);
-    left = ast_create_binary_expr(op, left, right);
+    left = located(ast_create_binary_expr(op, left, right), line, column);
   }
 
   return left;
@@ -393,8 +421,9 @@ static ASTNode *parse_term(Parser *parser) {
           strcmp(parser->current.value, "-") == 0)) {
     advance(parser);
     BinaryOp op = string_to_binary_op(parser->previous.value);
+    int line = parser->previous.line, column = parser->previous.column;
     ASTNode *right = parse_factor(parser);
-    left = ast_create_binary_expr(op, left, right);
+    left = located(ast_create_binary_expr(op, left, right), line, column);
   }
 
   return left;
@@ -415,8 +444,9 @@ static ASTNode *parse_comparison(Parser *parser) {
           strcmp(parser->current.value, ">=") == 0)) {
     advance(parser);
     BinaryOp op = string_to_binary_op(parser->previous.value);
+    int line = parser->previous.line, column = parser->previous.column;
     ASTNode *right = parse_term(parser);
-    left = ast_create_binary_expr(op, left, right);
+    left = located(ast_create_binary_expr(op, left, right), line, column);
   }
 
   return left;
@@ -435,8 +465,9 @@ static ASTNode *parse_equality(Parser *parser) {
           strcmp(parser->current.value, "!=") == 0)) {
     advance(parser);
     BinaryOp op = string_to_binary_op(parser->previous.value);
+    int line = parser->previous.line, column = parser->previous.column;
     ASTNode *right = parse_comparison(parser);
-    left = ast_create_binary_expr(op, left, right);
+    left = located(ast_create_binary_expr(op, left, right), line, column);
   }
 
   return left;
@@ -451,8 +482,9 @@ static ASTNode *parse_logic_and(Parser *parser) {
   while (check(parser, TOKEN_OPERATOR) &&
          strcmp(parser->current.value, "&&") == 0) {
     advance(parser);
+    int line = parser->previous.line, column = parser->previous.column;
     ASTNode *right = parse_equality(parser);
-    left = ast_create_binary_expr(OP_AND, left, right);
+    left = located(ast_create_binary_expr(OP_AND, left, right), line, column);
   }
 
   return left;
@@ -467,8 +499,9 @@ static ASTNode *parse_logic_or(Parser *parser) {
   while (check(parser, TOKEN_OPERATOR) &&
          strcmp(parser->current.value, "||") == 0) {
     advance(parser);
+    int line = parser->previous.line, column = parser->previous.column;
     ASTNode *right = parse_logic_and(parser);
-    left = ast_create_binary_expr(OP_OR, left, right);
+    left = located(ast_create_binary_expr(OP_OR, left, right), line, column);
   }
 
   return left;
@@ -487,7 +520,7 @@ static ASTNode *parse_assignment(Parser *parser) {
     advance(parser);
 
     // 检查左边是否是标识符
-    if (expr->type != AST_IDENTIFIER) {
+    if (!expr || expr->type != AST_IDENTIFIER) {
       error(parser, "Invalid assignment target.");
       return expr;
     }
@@ -496,7 +529,8 @@ static ASTNode *parse_assignment(Parser *parser) {
     ASTNode *value = parse_assignment(parser); // 右结合，递归
 
     // 创建赋值节点
-    ASTNode *assign = ast_create_assign_expr(name, value);
+    ASTNode *assign =
+        located(ast_create_assign_expr(name, value), expr->line, expr->column);
     ast_free(expr); // 释放原来的标识符节点
     return assign;
   }
@@ -517,15 +551,17 @@ static ASTNode *parse_expression(Parser *parser) {
  * expr_stmt → expression ";"
  */
 static ASTNode *parse_expr_statement(Parser *parser) {
+  int line = parser->current.line, column = parser->current.column;
   ASTNode *expr = parse_expression(parser);
   consume(parser, TOKEN_SEMICOLON, "Expect ';' after expression.");
-  return ast_create_expr_stmt(expr);
+  return located(ast_create_expr_stmt(expr), line, column);
 }
 
 /**
  * return_stmt → "return" expression? ";"
  */
 static ASTNode *parse_return_statement(Parser *parser) {
+  int line = parser->current.line, column = parser->current.column;
   consume_keyword(parser, "return", "Expect 'return'.");
 
   ASTNode *value = NULL;
@@ -534,13 +570,14 @@ static ASTNode *parse_return_statement(Parser *parser) {
   }
 
   consume(parser, TOKEN_SEMICOLON, "Expect ';' after return value.");
-  return ast_create_return_stmt(value);
+  return located(ast_create_return_stmt(value), line, column);
 }
 
 /**
  * while_stmt → "while" "(" expression ")" statement
  */
 static ASTNode *parse_while_statement(Parser *parser) {
+  int line = parser->current.line, column = parser->current.column;
   consume_keyword(parser, "while", "Expect 'while'.");
   consume(parser, TOKEN_LPAREN, "Expect '(' after 'while'.");
 
@@ -550,13 +587,52 @@ static ASTNode *parse_while_statement(Parser *parser) {
 
   ASTNode *body = parse_statement(parser);
 
-  return ast_create_while_stmt(condition, body);
+  return located(ast_create_while_stmt(condition, body), line, column);
+}
+
+/**
+ * for_stmt → "for" "(" (var_decl | expr_stmt | ";") expression? ";"
+ *            expression? ")" statement
+ *
+ * 初始化部分自带分号；条件省略表示永真
+ */
+static ASTNode *parse_for_statement(Parser *parser) {
+  int line = parser->current.line, column = parser->current.column;
+  consume_keyword(parser, "for", "Expect 'for'.");
+  consume(parser, TOKEN_LPAREN, "Expect '(' after 'for'.");
+
+  ASTNode *init = NULL;
+  if (match(parser, TOKEN_SEMICOLON)) {
+    // 没有初始化
+  } else if (is_type_keyword(parser)) {
+    init = parse_var_declaration(parser);
+  } else {
+    init = parse_expr_statement(parser);
+  }
+
+  ASTNode *condition = NULL;
+  if (!check(parser, TOKEN_SEMICOLON)) {
+    condition = parse_expression(parser);
+  }
+  consume(parser, TOKEN_SEMICOLON, "Expect ';' after loop condition.");
+
+  ASTNode *update = NULL;
+  if (!check(parser, TOKEN_RPAREN)) {
+    update = parse_expression(parser);
+  }
+  consume(parser, TOKEN_RPAREN, "Expect ')' after for clauses.");
+
+  ASTNode *body = parse_statement(parser);
+
+  return located(ast_create_for_stmt(init, condition, update, body), line,
+                 column);
 }
 
 /**
  * if_stmt → "if" "(" expression ")" statement ("else" statement)?
  */
 static ASTNode *parse_if_statement(Parser *parser) {
+  int line = parser->current.line, column = parser->current.column;
   consume_keyword(parser, "if", "Expect 'if'.");
   consume(parser, TOKEN_LPAREN, "Expect '(' after 'if'.");
 
@@ -571,24 +647,31 @@ static ASTNode *parse_if_statement(Parser *parser) {
     else_branch = parse_statement(parser);
   }
 
-  return ast_create_if_stmt(condition, then_branch, else_branch);
+  return located(ast_create_if_stmt(condition, then_branch, else_branch), line,
+                 column);
 }
 
 /**
  * block → "{" statement* "}"
  */
 static ASTNode *parse_block(Parser *parser) {
+  int line = parser->current.line, column = parser->current.column;
   consume(parser, TOKEN_LBRACE, "Expect '{'.");
 
-  ASTNode *block = ast_create_block();
+  ASTNode *block = located(ast_create_block(), line, column);
 
   while (!check(parser, TOKEN_RBRACE) && !check(parser, TOKEN_EOF)) {
+    int start = parser->current.start;
     ASTNode *stmt = parse_statement(parser);
     if (stmt) {
       ast_block_add(block, stmt);
     }
 
     if (parser->panic_mode) {
+      // 语句在第一个 Token 就出错（比如分号后面的 ')'）时先跳过它，
+      // 否则错误恢复停在分号后面，同一个错误会一直重复
+      if (parser->current.start == start)
+        advance(parser);
       synchronize(parser);
     }
   }
@@ -607,10 +690,11 @@ static ASTNode *parse_var_declaration(Parser *parser) {
   strcpy(type, parser->current.value);
   advance(parser); // 跳过类型
 
-  // 期望标识符
+  // 期望标识符（声明的位置是名字的位置，编辑器跳转到声明时用）
   consume(parser, TOKEN_IDENTIFIER, "Expect variable name.");
   char name[256];
   strcpy(name, parser->previous.value);
+  int line = parser->previous.line, column = parser->previous.column;
 
   // 可选的初始化
   ASTNode *initializer = NULL;
@@ -622,11 +706,12 @@ static ASTNode *parse_var_declaration(Parser *parser) {
 
   consume(parser, TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
 
-  return ast_create_var_decl(type, name, initializer);
+  return located(ast_create_var_decl(type, name, initializer), line, column);
 }
 
 /**
- * statement → block | if_stmt | while_stmt | return_stmt | var_decl | expr_stmt
+ * statement → block | if_stmt | while_stmt | for_stmt | return_stmt | var_decl
+ *           | expr_stmt
  */
 static ASTNode *parse_statement(Parser *parser) {
   // 代码块
@@ -644,6 +729,11 @@ static ASTNode *parse_statement(Parser *parser) {
     return parse_while_statement(parser);
   }
 
+  // for 语句
+  if (check_keyword(parser, "for")) {
+    return parse_for_statement(parser);
+  }
+
   // return 语句
   if (check_keyword(parser, "return")) {
     return parse_return_statement(parser);
@@ -683,9 +773,10 @@ static void parse_parameters(Parser *parser, ASTNode ***params,
     consume(parser, TOKEN_IDENTIFIER, "Expect parameter name.");
     char name[256];
     strcpy(name, parser->previous.value);
+    int line = parser->previous.line, column = parser->previous.column;
 
     // 创建参数节点
-    ASTNode *param = ast_create_param(type, name);
+    ASTNode *param = located(ast_create_param(type, name), line, column);
 
     // 扩容
     if (*param_count >= capacity) {
@@ -702,15 +793,18 @@ static void parse_parameters(Parser *parser, ASTNode ***params,
  * func_decl → type IDENTIFIER "(" params? ")" block
  */
 static ASTNode *parse_function_declaration(Parser *parser) {
+  int start = parser->current.start;
+
   // 返回类型
   char return_type[64];
   strcpy(return_type, parser->current.value);
   advance(parser);
 
-  // 函数名
+  // 函数名（和变量一样，声明的位置是名字的位置）
   consume(parser, TOKEN_IDENTIFIER, "Expect function name.");
   char name[256];
   strcpy(name, parser->previous.value);
+  int line = parser->previous.line, column = parser->previous.column;
 
   // 参数列表
   consume(parser, TOKEN_LPAREN, "Expect '(' after function name.");
@@ -722,9 +816,19 @@ static ASTNode *parse_function_declaration(Parser *parser) {
   consume(parser, TOKEN_RPAREN, "Expect ')' after parameters.");
 
   // 函数体
-  ASTNode *body = parse_block(parser);
+  ASTNode *body;
+  if (parser->skip_body && check(parser, TOKEN_LBRACE) &&
+      parser->skip_body(parser->skip_user, parser, start)) {
+    body = located(ast_create_block(), parser->current.line,
+                   parser->current.column);
+    advance(parser); // Lexer 已经在 '}' 后面
+  } else {
+    body = parse_block(parser);
+  }
 
-  return ast_create_func_decl(return_type, name, params, param_count, body);
+  return located(
+      ast_create_func_decl(return_type, name, params, param_count, body), line,
+      column);
 }
 
 /**
@@ -737,6 +841,7 @@ static ASTNode *parse_function_declaration(Parser *parser) {
 static ASTNode *parse_declaration(Parser *parser) {
   if (!is_type_keyword(parser)) {
     error(parser, "Expect type.");
+    advance(parser); // 同样跳过，否则分号后面的错误 Token 会让错误恢复原地停下
     return NULL;
   }
 
@@ -763,6 +868,7 @@ static ASTNode *parse_declaration(Parser *parser) {
     parser->previous = saved_previous;
 
     error(parser, "Expect identifier after type.");
+    advance(parser); // 跳过类型，否则错误恢复停在这个类型关键字上，不会前进
     return NULL;
   }
 
@@ -791,6 +897,7 @@ static ASTNode *parse_declaration(Parser *parser) {
  */
 Parser parser_init(Lexer *lexer) {
   Parser parser;
+  memset(&parser, 0, sizeof(parser)); // previous 在读第二个 Token 前也是确定的
   parser.lexer = lexer;
   parser.had_error = 0;
   parser.panic_mode = 0;
@@ -809,19 +916,34 @@ Parser parser_init(Lexer *lexer) {
 ASTNode *parser_parse(Parser *parser) {
   ASTNode *program = ast_create_program();
 
+  ASTNode *decl;
+  while ((decl = parser_next_declaration(parser)) != NULL) {
+    ast_program_add(program, decl);
+  }
+
+  return program;
+}
+
+/**
+ * parser_next_declaration - 解析下一个顶层声明
+ *
+ * 出错的声明（没有得到节点）在错误恢复后跳过，直到读到一个声明或文件结束
+ */
+ASTNode *parser_next_declaration(Parser *parser) {
   while (!check(parser, TOKEN_EOF)) {
     ASTNode *decl = parse_declaration(parser);
-    if (decl) {
-      ast_program_add(program, decl);
-    }
 
     // 错误恢复
     if (parser->panic_mode) {
       synchronize(parser);
     }
+
+    if (decl) {
+      return decl;
+    }
   }
 
-  return program;
+  return NULL;
 }
 
 /**
@@ -0,0 +1,748 @@
+/**
+ * peephole.c - 窥孔优化实现
+ *
+ * 按函数处理：每一轮从头到尾扫描一个函数的指令，把化简后的结果写到新的
+ * 指令数组里；有任何变化就对这个函数再来一轮，直到不动点，然后接到结果
+ * 程序后面。一个函数需要很多轮时不会连带着重建整个程序。
+ * 函数之间的指令（全局变量）单独作为一段处理。
+ *
+ * 整数才做代数化简和强度削减：浮点数有 NaN、-0.0，
+ * x * 0、x - x、!(a < b) → a >= b 这些变换对浮点不成立。
+ *
+ * 有符号除法不能直接右移（-7 >> 1 = -4，但 -7 / 2 = -3），
+ * 负数要先加上 2^k - 1 再移位：
+ *   t1 = x SHR 31          // 负数全 1，正数全 0
+ *   t2 = t1 USHR (32 - k)  // 负数得到 2^k - 1，正数得到 0
+ *   t3 = x ADD t2
+ *   r  = t3 SHR k
+ * 取模同理：r = x - ((x + bias) & -2^k)
+ */
+
+#include "../include/peephole.h"
+#include "../include/memory.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 防止跳转链成环时死循环
+#define MAX_THREAD_STEPS 32
+// 每个函数最多运行的轮数
+#define MAX_ITERATIONS 64
+
+/**
+ * 窥孔优化一轮的状态
+ */
+typedef struct {
+  IRProgram *program; // 本轮的输入，扫描其中 [begin, end) 这一段
+  int begin;
+  int end;
+  IRProgram *out; // 本轮的输出
+
+  // 下面三个数组按整个程序的编号分配，各轮之间复用；
+  // 每轮只清零这一段里出现的编号
+  int *temp_uses; // 每个临时变量被读取的次数
+  int temp_limit;
+  int temp_capacity;
+  int *label_refs; // 每个标签被跳转引用的次数
+  int *label_pos;  // 每个标签所在的指令下标
+  int label_limit;
+  int label_capacity;
+
+  PeepholeStats *stats;
+  int changed; // 本轮是否有变化
+} Peephole;
+
+// ========== 辅助函数 ==========
+
+static int is_int_const(IROperand op, int *value) {
+  if (op.type != OPERAND_INT)
+    return 0;
+  *value = op.value.int_val;
+  return 1;
+}
+
+static int same_operand(IROperand a, IROperand b) {
+  if (a.type != b.type)
+    return 0;
+  switch (a.type) {
+  case OPERAND_TEMP:
+    return a.value.temp_id == b.value.temp_id;
+  case OPERAND_VAR:
+    return a.is_global == b.is_global && strcmp(a.value.name, b.value.name) == 0;
+  case OPERAND_INT:
+    return a.value.int_val == b.value.int_val;
+  case OPERAND_LABEL:
+    return a.value.label_id == b.value.label_id;
+  default:
+    return 0;
+  }
+}
+
+static int is_temp(IROperand op, int temp_id) {
+  return op.type == OPERAND_TEMP && op.value.temp_id == temp_id;
+}
+
+// 指令的所有操作数都是整数
+static int all_int(IRInstruction *instr) {
+  return instr->result.vtype == IR_TYPE_INT &&
+         instr->arg1.vtype == IR_TYPE_INT && instr->arg2.vtype == IR_TYPE_INT;
+}
+
+// v == 2^k (1 <= k <= 30) 时返回 k，否则返回 -1
+static int exact_log2(int v) {
+  if (v < 2 || (v & (v - 1)) != 0)
+    return -1;
+  int k = 0;
+  while ((1 << k) != v)
+    k++;
+  return k;
+}
+
+static int is_comparison(IROpcode op) { return op >= IR_EQ && op <= IR_GE; }
+
+static IROpcode invert_comparison(IROpcode op) {
+  switch (op) {
+  case IR_EQ:
+    return IR_NE;
+  case IR_NE:
+    return IR_EQ;
+  case IR_LT:
+    return IR_GE;
+  case IR_GE:
+    return IR_LT;
+  case IR_GT:
+    return IR_LE;
+  case IR_LE:
+    return IR_GT;
+  default:
+    return op;
+  }
+}
+
+// 没有副作用、只计算一个结果的指令
+static int is_pure(IROpcode op) {
+  return (op >= IR_ASSIGN && op <= IR_NOT);
+}
+
+static int is_jump(IROpcode op) {
+  return op == IR_GOTO || op == IR_IF || op == IR_IFFALSE;
+}
+
+static int uses_of(Peephole *p, IROperand op) {
+  if (op.type != OPERAND_TEMP || op.value.temp_id >= p->temp_limit)
+    return -1;
+  return p->temp_uses[op.value.temp_id];
+}
+
+/**
+ * 整数常量折叠，成功返回 1
+ */
+static int fold_int(IROpcode op, int a, int b, int *result) {
+  unsigned int ua = (unsigned int)a, ub = (unsigned int)b;
+  switch (op) {
+  case IR_ADD:
+    *result = (int)(ua + ub);
+    return 1;
+  case IR_SUB:
+    *result = (int)(ua - ub);
+    return 1;
+  case IR_MUL:
+    *result = (int)(ua * ub);
+    return 1;
+  case IR_DIV:
+  case IR_MOD:
+    if (b == 0 || (a == INT_MIN && b == -1))
+      return 0; // 运行时错误留给运行时
+    *result = op == IR_DIV ? a / b : a % b;
+    return 1;
+  case IR_SHL:
+    if (b < 0 || b > 31)
+      return 0;
+    *result = (int)(ua << b);
+    return 1;
+  case IR_SHR:
+    if (b < 0 || b > 31)
+      return 0;
+    *result = a >> b;
+    return 1;
+  case IR_USHR:
+    if (b < 0 || b > 31)
+      return 0;
+    *result = (int)(ua >> b);
+    return 1;
+  case IR_BAND:
+    *result = a & b;
+    return 1;
+  case IR_EQ:
+    *result = a == b;
+    return 1;
+  case IR_NE:
+    *result = a != b;
+    return 1;
+  case IR_LT:
+    *result = a < b;
+    return 1;
+  case IR_GT:
+    *result = a > b;
+    return 1;
+  case IR_LE:
+    *result = a <= b;
+    return 1;
+  case IR_GE:
+    *result = a >= b;
+    return 1;
+  case IR_NEG:
+    *result = (int)(0u - ua);
+    return 1;
+  case IR_NOT:
+    *result = !a;
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// ========== 输出 ==========
+
+// 发射指令（复制操作数，原程序的操作数保持不变）
+static void emit(Peephole *p, IROpcode op, IROperand result, IROperand arg1,
+                 IROperand arg2) {
+  ir_emit(p->out, op, ir_operand_copy(result), ir_operand_copy(arg1),
+          ir_operand_copy(arg2));
+}
+
+static void emit_copy(Peephole *p, IRInstruction *instr) {
+  IRInstruction copy = *instr;
+  copy.result = ir_operand_copy(instr->result);
+  copy.arg1 = ir_operand_copy(instr->arg1);
+  copy.arg2 = ir_operand_copy(instr->arg2);
+  ir_emit_instruction(p->out, copy);
+}
+
+static void emit_assign(Peephole *p, IROperand result, IROperand value) {
+  emit(p, IR_ASSIGN, result, value, ir_operand_none());
+}
+
+// ========== 统计引用 ==========
+
+/**
+ * 清零 op 对应的计数（op 是这一段里出现的临时变量或标签时）
+ */
+static void reset_counts(Peephole *p, IROperand op) {
+  if (op.type == OPERAND_TEMP && op.value.temp_id < p->temp_limit) {
+    p->temp_uses[op.value.temp_id] = 0;
+  } else if (op.type == OPERAND_LABEL && op.value.label_id < p->label_limit) {
+    p->label_refs[op.value.label_id] = 0;
+    p->label_pos[op.value.label_id] = -1;
+  }
+}
+
+static void count_uses(Peephole *p) {
+  IRProgram *program = p->program;
+  p->temp_limit = program->temp_counter;
+  p->label_limit = program->label_counter;
+  if (p->temp_limit >= p->temp_capacity) {
+    p->temp_capacity = p->temp_limit + 1;
+    p->temp_uses =
+        (int *)realloc(p->temp_uses, sizeof(int) * p->temp_capacity);
+  }
+  if (p->label_limit >= p->label_capacity) {
+    p->label_capacity = p->label_limit + 1;
+    p->label_refs =
+        (int *)realloc(p->label_refs, sizeof(int) * p->label_capacity);
+    p->label_pos =
+        (int *)realloc(p->label_pos, sizeof(int) * p->label_capacity);
+  }
+
+  // 只读这一段里出现过的编号，不用清零整个数组
+  for (int i = p->begin; i < p->end; i++) {
+    IRInstruction *instr = &program->instructions[i];
+    reset_counts(p, instr->result);
+    reset_counts(p, instr->arg1);
+    reset_counts(p, instr->arg2);
+  }
+
+  for (int i = p->begin; i < p->end; i++) {
+    IRInstruction *instr = &program->instructions[i];
+    IROperand reads[2] = {instr->arg1, instr->arg2};
+    for (int k = 0; k < 2; k++) {
+      if (reads[k].type == OPERAND_TEMP && reads[k].value.temp_id < p->temp_limit)
+        p->temp_uses[reads[k].value.temp_id]++;
+    }
+
+    if (instr->result.type != OPERAND_LABEL ||
+        instr->result.value.label_id >= p->label_limit)
+      continue;
+    if (instr->opcode == IR_LABEL)
+      p->label_pos[instr->result.value.label_id] = i;
+    else
+      p->label_refs[instr->result.value.label_id]++;
+  }
+}
+
+// ========== 代数化简和强度削减 ==========
+
+/**
+ * x / 2^k 或 x % 2^k 的移位序列（有符号，负数要修正）
+ */
+static void emit_div_mod_pow2(Peephole *p, IRInstruction *instr, int k) {
+  IROperand x = instr->arg1;
+
+  // bias = x < 0 ? 2^k - 1 : 0
+  IROperand bias = ir_new_temp(p->out);
+  if (k == 1) {
+    emit(p, IR_USHR, bias, x, ir_operand_int(31));
+  } else {
+    IROperand sign = ir_new_temp(p->out);
+    emit(p, IR_SHR, sign, x, ir_operand_int(31));
+    emit(p, IR_USHR, bias, sign, ir_operand_int(32 - k));
+  }
+
+  IROperand biased = ir_new_temp(p->out);
+  emit(p, IR_ADD, biased, x, bias);
+
+  if (instr->opcode == IR_DIV) {
+    emit(p, IR_SHR, instr->result, biased, ir_operand_int(k));
+  } else {
+    IROperand rounded = ir_new_temp(p->out);
+    emit(p, IR_BAND, rounded, biased, ir_operand_int(-(1 << k)));
+    emit(p, IR_SUB, instr->result, x, rounded);
+  }
+}
+
+/**
+ * 化简一条整数运算，发射了替代指令时返回 1
+ */
+static int simplify_arith(Peephole *p, IRInstruction *instr) {
+  if (!all_int(instr))
+    return 0;
+
+  IROpcode op = instr->opcode;
+  int a = 0, b = 0, v;
+  int ca = is_int_const(instr->arg1, &a);
+  int cb = is_int_const(instr->arg2, &b);
+
+  // 常量折叠
+  int unary = op == IR_NEG || op == IR_NOT;
+  if (op != IR_ASSIGN && ca && (cb || unary) && fold_int(op, a, b, &v)) {
+    emit_assign(p, instr->result, ir_operand_int(v));
+    p->stats->constants_folded++;
+    return 1;
+  }
+
+  PeepholeStats *stats = p->stats;
+  switch (op) {
+  case IR_ADD:
+    if (cb && b == 0) { // x + 0
+      emit_assign(p, instr->result, instr->arg1);
+      stats->algebraic++;
+      return 1;
+    }
+    if (ca && a == 0) { // 0 + x
+      emit_assign(p, instr->result, instr->arg2);
+      stats->algebraic++;
+      return 1;
+    }
+    return 0;
+
+  case IR_SUB:
+    if (cb && b == 0) { // x - 0
+      emit_assign(p, instr->result, instr->arg1);
+      stats->algebraic++;
+      return 1;
+    }
+    if (same_operand(instr->arg1, instr->arg2)) { // x - x
+      emit_assign(p, instr->result, ir_operand_int(0));
+      stats->algebraic++;
+      return 1;
+    }
+    return 0;
+
+  case IR_MUL: {
+    // 常量放到右边
+    IROperand x = instr->arg1;
+    if (ca && !cb) {
+      x = instr->arg2;
+      b = a;
+      cb = 1;
+    }
+    if (!cb)
+      return 0;
+    if (b == 0 || b == 1) { // x * 0, x * 1
+      emit_assign(p, instr->result, b == 0 ? ir_operand_int(0) : x);
+      stats->algebraic++;
+      return 1;
+    }
+    int k = exact_log2(b);
+    if (k > 0) { // x * 2^k → x << k
+      emit(p, IR_SHL, instr->result, x, ir_operand_int(k));
+      stats->strength_reduced++;
+      return 1;
+    }
+    return 0;
+  }
+
+  case IR_DIV:
+  case IR_MOD: {
+    if (!cb)
+      return 0;
+    if (b == 1) { // x / 1, x % 1
+      emit_assign(p, instr->result,
+                  op == IR_DIV ? instr->arg1 : ir_operand_int(0));
+      stats->algebraic++;
+      return 1;
+    }
+    int k = exact_log2(b);
+    if (k > 0) {
+      emit_div_mod_pow2(p, instr, k);
+      stats->strength_reduced++;
+      return 1;
+    }
+    return 0;
+  }
+
+  case IR_SHL:
+  case IR_SHR:
+  case IR_USHR:
+    if (cb && b == 0) { // x << 0
+      emit_assign(p, instr->result, instr->arg1);
+      stats->algebraic++;
+      return 1;
+    }
+    return 0;
+
+  default:
+    return 0;
+  }
+}
+
+// ========== 跳转 ==========
+
+/**
+ * 跳转穿透：目标标签后面紧跟着 goto 时，直接跳到最终目标
+ */
+static int thread_target(Peephole *p, int label) {
+  IRProgram *program = p->program;
+  for (int step = 0; step < MAX_THREAD_STEPS; step++) {
+    if (label >= p->label_limit || p->label_pos[label] < 0)
+      break;
+    int j = p->label_pos[label] + 1;
+    while (j < p->end && program->instructions[j].opcode == IR_LABEL)
+      j++;
+    if (j >= p->end || program->instructions[j].opcode != IR_GOTO)
+      break;
+    int next = program->instructions[j].result.value.label_id;
+    if (next == label)
+      break;
+    label = next;
+  }
+  return label;
+}
+
+/**
+ * 从下标 start 开始的一串连续标签里是否有 label
+ */
+static int label_follows(Peephole *p, int start, int label) {
+  IRProgram *program = p->program;
+  for (int j = start; j < p->end; j++) {
+    IRInstruction *instr = &program->instructions[j];
+    if (instr->opcode != IR_LABEL)
+      return 0;
+    if (instr->result.value.label_id == label)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * 化简跳转指令，返回额外消耗的指令数（-1 表示没有处理）
+ */
+static int simplify_jump(Peephole *p, int i) {
+  IRProgram *program = p->program;
+  IRInstruction *instr = &program->instructions[i];
+  IRInstruction jump = *instr;
+  int label = instr->result.value.label_id;
+
+  // 常量条件
+  int c;
+  if (jump.opcode != IR_GOTO && is_int_const(jump.arg1, &c)) {
+    int taken = jump.opcode == IR_IF ? c != 0 : c == 0;
+    p->stats->constants_folded++;
+    if (!taken)
+      return 0; // 永远不跳，删掉
+    jump.opcode = IR_GOTO;
+    jump.arg1 = ir_operand_none();
+  }
+
+  int target = thread_target(p, label);
+  if (target != label)
+    p->stats->jumps_threaded++;
+
+  // 跳到紧跟着的标签：删掉
+  if (label_follows(p, i + 1, target)) {
+    p->stats->dead_removed++;
+    return 0;
+  }
+
+  // iffalse c goto L1; goto L2; L1:  →  if c goto L2; L1:
+  if (jump.opcode != IR_GOTO && i + 1 < p->end &&
+      program->instructions[i + 1].opcode == IR_GOTO &&
+      label_follows(p, i + 2, target)) {
+    int other = thread_target(
+        p, program->instructions[i + 1].result.value.label_id);
+    IROpcode inverted = jump.opcode == IR_IF ? IR_IFFALSE : IR_IF;
+    emit(p, inverted, ir_operand_label(other), jump.arg1, ir_operand_none());
+    p->stats->jumps_threaded++;
+    return 1;
+  }
+
+  if (target == label && jump.opcode == instr->opcode)
+    return -1; // 没有变化
+
+  emit(p, jump.opcode, ir_operand_label(target), jump.arg1, ir_operand_none());
+  return 0;
+}
+
+// ========== 一轮扫描 ==========
+
+static void sweep(Peephole *p) {
+  IRProgram *program = p->program;
+  PeepholeStats *stats = p->stats;
+  int unreachable = 0;
+
+  for (int i = p->begin; i < p->end; i++) {
+    IRInstruction *instr = &program->instructions[i];
+    IRInstruction *next =
+        i + 1 < p->end ? &program->instructions[i + 1] : NULL;
+    int count_before = p->out->count;
+
+    // 不可达代码：直到下一个标签或函数结束
+    if (instr->opcode == IR_LABEL || instr->opcode == IR_FUNC_BEGIN ||
+        instr->opcode == IR_FUNC_END)
+      unreachable = 0;
+    if (unreachable) {
+      stats->dead_removed++;
+      p->changed = 1;
+      continue;
+    }
+
+    // 没人跳转的标签
+    if (instr->opcode == IR_LABEL &&
+        instr->result.value.label_id < p->label_limit &&
+        p->label_refs[instr->result.value.label_id] == 0) {
+      stats->dead_removed++;
+      p->changed = 1;
+      continue;
+    }
+
+    // 结果没人用的临时变量
+    if (is_pure(instr->opcode) && uses_of(p, instr->result) == 0) {
+      stats->dead_removed++;
+      p->changed = 1;
+      continue;
+    }
+
+    // 自己赋值给自己
+    if (instr->opcode == IR_ASSIGN && same_operand(instr->result, instr->arg1)) {
+      stats->algebraic++;
+      p->changed = 1;
+      continue;
+    }
+
+    // t = a LT b; u = !t  →  u = a GE b
+    if (next && is_comparison(instr->opcode) && all_int(instr) &&
+        uses_of(p, instr->result) == 1 && next->opcode == IR_NOT &&
+        is_temp(next->arg1, instr->result.value.temp_id)) {
+      emit(p, invert_comparison(instr->opcode), next->result, instr->arg1,
+           instr->arg2);
+      stats->nots_folded++;
+      p->changed = 1;
+      i++;
+      continue;
+    }
+
+    // t = !x; iffalse t goto L  →  if x goto L
+    if (next && instr->opcode == IR_NOT && uses_of(p, instr->result) == 1 &&
+        (next->opcode == IR_IF || next->opcode == IR_IFFALSE) &&
+        is_temp(next->arg1, instr->result.value.temp_id)) {
+      IROpcode flipped = next->opcode == IR_IF ? IR_IFFALSE : IR_IF;
+      emit(p, flipped, next->result, instr->arg1, ir_operand_none());
+      stats->nots_folded++;
+      p->changed = 1;
+      i++;
+      continue;
+    }
+
+    // t = a; x = t ADD b  →  x = a ADD b（相邻，a 不会在中间被修改）
+    if (next && instr->opcode == IR_ASSIGN && uses_of(p, instr->result) == 1 &&
+        instr->arg1.vtype == instr->result.vtype &&
+        (is_temp(next->arg1, instr->result.value.temp_id) ||
+         is_temp(next->arg2, instr->result.value.temp_id))) {
+      IRInstruction forwarded = *next;
+      int temp_id = instr->result.value.temp_id;
+      forwarded.result = ir_operand_copy(next->result);
+      forwarded.arg1 = ir_operand_copy(
+          is_temp(next->arg1, temp_id) ? instr->arg1 : next->arg1);
+      forwarded.arg2 = ir_operand_copy(
+          is_temp(next->arg2, temp_id) ? instr->arg1 : next->arg2);
+      ir_emit_instruction(p->out, forwarded);
+      stats->copies_collapsed++;
+      p->changed = 1;
+      i++;
+      continue;
+    }
+
+    // t = a ADD b; x = t  →  x = a ADD b
+    if (next && (is_pure(instr->opcode) || instr->opcode == IR_CALL) &&
+        uses_of(p, instr->result) == 1 && next->opcode == IR_ASSIGN &&
+        is_temp(next->arg1, instr->result.value.temp_id) &&
+        next->result.vtype == instr->result.vtype) {
+      IRInstruction merged = *instr;
+      merged.result = ir_operand_copy(next->result);
+      merged.arg1 = ir_operand_copy(instr->arg1);
+      merged.arg2 = ir_operand_copy(instr->arg2);
+      ir_emit_instruction(p->out, merged);
+      stats->copies_collapsed++;
+      p->changed = 1;
+      i++;
+      continue;
+    }
+
+    if (is_pure(instr->opcode) && simplify_arith(p, instr)) {
+      p->changed = 1;
+      continue;
+    }
+
+    if (is_jump(instr->opcode)) {
+      int consumed = simplify_jump(p, i);
+      if (consumed >= 0) {
+        p->changed = 1;
+        i += consumed;
+        if (p->out->count > count_before &&
+            p->out->instructions[p->out->count - 1].opcode == IR_GOTO)
+          unreachable = 1;
+        continue;
+      }
+    }
+
+    emit_copy(p, instr);
+    if (instr->opcode == IR_GOTO || instr->opcode == IR_RETURN ||
+        instr->opcode == IR_TAILCALL)
+      unreachable = 1;
+  }
+}
+
+// ========== 主要接口 ==========
+
+/**
+ * 把 from 的指令（连同操作数）移到 to 的末尾，然后释放 from
+ */
+static void take_instructions(IRProgram *to, IRProgram *from) {
+  if (to->count + from->count > to->capacity) {
+    int new_cap = to->capacity == 0 ? 64 : to->capacity;
+    while (new_cap < to->count + from->count)
+      new_cap *= 2;
+    to->instructions = (IRInstruction *)realloc(
+        to->instructions, sizeof(IRInstruction) * new_cap);
+    to->capacity = new_cap;
+  }
+  memcpy(to->instructions + to->count, from->instructions,
+         sizeof(IRInstruction) * from->count);
+  to->count += from->count;
+  from->count = 0; // 操作数已经归 to 了
+  ir_program_free(from);
+}
+
+/**
+ * 反复扫描 program 的 [begin, end) 这一段直到不动点，结果追加到 result。
+ * 第一轮直接读 program，之后每轮读上一轮的输出（只有这一段那么大）
+ */
+static void optimize_range(Peephole *p, IRProgram *program, int begin,
+                           int end, IRProgram *result) {
+  IRProgram *input = program;
+  int iterations = 0;
+  for (;;) {
+    IRProgram *out = ir_program_create();
+    out->temp_counter = result->temp_counter;
+    out->label_counter = result->label_counter;
+    p->program = input;
+    p->begin = begin;
+    p->end = end;
+    p->out = out;
+    p->changed = 0;
+
+    count_uses(p);
+    sweep(p);
+    iterations++;
+    result->temp_counter = out->temp_counter;
+    result->label_counter = out->label_counter;
+    if (input != program)
+      ir_program_free(input);
+
+    if (!p->changed || iterations >= MAX_ITERATIONS) {
+      take_instructions(result, out);
+      break;
+    }
+    input = out;
+    begin = 0;
+    end = out->count;
+  }
+  if (iterations > p->stats->iterations)
+    p->stats->iterations = iterations;
+}
+
+PeepholeStats ir_peephole(IRProgram *program) {
+  PeepholeStats stats;
+  memset(&stats, 0, sizeof(stats));
+  if (!program)
+    return stats;
+
+  Peephole p;
+  memset(&p, 0, sizeof(p));
+  p.stats = &stats;
+  IRProgram *result = ir_program_create();
+  result->temp_counter = program->temp_counter;
+  result->label_counter = program->label_counter;
+
+  // 每段是一个函数（FUNC_BEGIN 到 FUNC_END），或者函数之间的一串指令
+  int begin = 0;
+  while (begin < program->count) {
+    int end = begin + 1;
+    if (program->instructions[begin].opcode == IR_FUNC_BEGIN) {
+      while (end < program->count &&
+             program->instructions[end - 1].opcode != IR_FUNC_END)
+        end++;
+    } else {
+      while (end < program->count &&
+             program->instructions[end].opcode != IR_FUNC_BEGIN)
+        end++;
+    }
+    optimize_range(&p, program, begin, end, result);
+    begin = end;
+  }
+
+  free(p.temp_uses);
+  free(p.label_refs);
+  free(p.label_pos);
+  ir_program_replace(program, result);
+  return stats;
+}
+
+void peephole_write_stats(const PeepholeStats *stats, Writer *out) {
+  writer_printf(out, "Peephole: %d iteration(s) to fixed point\n",
+                stats->iterations);
+  writer_printf(out, "  constants folded:  %d\n", stats->constants_folded);
+  writer_printf(out, "  algebraic:         %d\n", stats->algebraic);
+  writer_printf(out, "  strength reduced:  %d\n", stats->strength_reduced);
+  writer_printf(out, "  copies collapsed:  %d\n", stats->copies_collapsed);
+  writer_printf(out, "  nots folded:       %d\n", stats->nots_folded);
+  writer_printf(out, "  jumps threaded:    %d\n", stats->jumps_threaded);
+  writer_printf(out, "  dead removed:      %d\n", stats->dead_removed);
+}
+
+void peephole_print_stats(const PeepholeStats *stats) {
+  Writer *out = writer_from_file(stdout);
+  peephole_write_stats(stats, out);
+  writer_close(out);
+}
@@ -0,0 +1,164 @@
+/**
+ * pool.c - 工作窃取线程池实现
+ */
+
+#define _DEFAULT_SOURCE // sysconf(_SC_NPROCESSORS_ONLN)
+
+#include "../include/pool.h"
+#include "../include/memory.h"
+#include <stdlib.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define POOL_THREADS 1
+#include <pthread.h>
+#include <unistd.h>
+#else
+#define POOL_THREADS 0
+#endif
+
+int pool_default_threads(void) {
+#if POOL_THREADS
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? (int)cores : 1;
+#else
+  return 1;
+#endif
+}
+
+#if POOL_THREADS
+
+/**
+ * 一个线程的任务段 [begin, end)
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  int begin;
+  int end;
+} Deque;
+
+typedef struct Pool Pool;
+
+typedef struct {
+  Pool *pool;
+  int id;
+  int steals;
+} Worker;
+
+struct Pool {
+  Deque *deques;
+  Worker *workers;
+  int threads;
+  PoolTask task;
+  void *context;
+};
+
+// 从自己的段前端取一个
+static int pop_front(Deque *deque, int *index) {
+  pthread_mutex_lock(&deque->lock);
+  int found = deque->begin < deque->end;
+  if (found)
+    *index = deque->begin++;
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+/**
+ * 从 victim 的后端拿走一半（至少一个），放进 thief 的段；拿到返回 1
+ */
+static int steal_half(Deque *victim, Deque *thief) {
+  pthread_mutex_lock(&victim->lock);
+  int remaining = victim->end - victim->begin;
+  int taken = (remaining + 1) / 2;
+  int end = victim->end;
+  victim->end -= taken;
+  pthread_mutex_unlock(&victim->lock);
+  if (taken == 0)
+    return 0;
+
+  pthread_mutex_lock(&thief->lock);
+  thief->begin = end - taken;
+  thief->end = end;
+  pthread_mutex_unlock(&thief->lock);
+  return 1;
+}
+
+static int steal(Worker *worker) {
+  Pool *pool = worker->pool;
+  for (int i = 1; i < pool->threads; i++) {
+    int victim = (worker->id + i) % pool->threads;
+    if (steal_half(&pool->deques[victim], &pool->deques[worker->id])) {
+      worker->steals++;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void *worker_main(void *arg) {
+  Worker *worker = (Worker *)arg;
+  Pool *pool = worker->pool;
+  Deque *own = &pool->deques[worker->id];
+  int index;
+  for (;;) {
+    if (!pop_front(own, &index)) {
+      if (!steal(worker))
+        break;
+      continue;
+    }
+    pool->task(pool->context, index);
+  }
+  return NULL;
+}
+
+#endif // POOL_THREADS
+
+PoolStats pool_run(int threads, int count, PoolTask task, void *context) {
+  PoolStats stats = {1, 0};
+  if (threads <= 0)
+    threads = pool_default_threads();
+  if (threads > count)
+    threads = count;
+#if POOL_THREADS
+  if (threads > 1) {
+    Pool pool;
+    pool.threads = threads;
+    pool.task = task;
+    pool.context = context;
+    pool.deques = (Deque *)malloc(sizeof(Deque) * threads);
+    pool.workers = (Worker *)malloc(sizeof(Worker) * threads);
+    for (int i = 0; i < threads; i++) {
+      pthread_mutex_init(&pool.deques[i].lock, NULL);
+      pool.deques[i].begin = (int)((long long)count * i / threads);
+      pool.deques[i].end = (int)((long long)count * (i + 1) / threads);
+      pool.workers[i].pool = &pool;
+      pool.workers[i].id = i;
+      pool.workers[i].steals = 0;
+    }
+
+    // 调用线程自己当 0 号线程
+    pthread_t *ids = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+    int started = 1;
+    for (int i = 1; i < threads; i++) {
+      if (pthread_create(&ids[i], NULL, worker_main, &pool.workers[i]) != 0)
+        break; // 没启动的线程的任务会被其他线程偷走
+      started++;
+    }
+    worker_main(&pool.workers[0]);
+    for (int i = 1; i < started; i++)
+      pthread_join(ids[i], NULL);
+
+    stats.threads = started;
+    for (int i = 0; i < threads; i++) {
+      stats.steals += pool.workers[i].steals;
+      pthread_mutex_destroy(&pool.deques[i].lock);
+    }
+    free(ids);
+    free(pool.workers);
+    free(pool.deques);
+    return stats;
+  }
+#endif
+  for (int i = 0; i < count; i++)
+    task(context, i);
+  return stats;
+}
@@ -0,0 +1,285 @@
+/**
+ * recompile.c - 按函数的增量重新编译实现
+ */
+
+#include "../include/recompile.h"
+#include "../include/hash.h"
+#include "../include/parser.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * 一个顶层声明；函数还有它的指纹和 IR（来自缓存或者刚生成）
+ */
+typedef struct {
+  ASTNode *decl;
+  int fingerprinted; // key 有效（没有语法错误的函数）
+  CacheKey key;
+  IRProgram *ir;
+} Unit;
+
+/**
+ * 语法分析的 skip_body 回调用到的状态
+ */
+typedef struct {
+  SemanticAnalyzer *analyzer; // 已经分析（或声明）了前面的声明
+  CachePack *pack;            // 这个模块的函数条目
+  TimeReport *report;
+
+  Writer *tokens; // 当前函数的 Token 流：每个 Token 是类型、原文和 '\0'
+  size_t *names;  // 其中的标识符（原文在 tokens 里的位置）
+  int name_count;
+  int name_capacity;
+  const char **seen; // 去重用的开放寻址表，容量是 2 的幂
+  int seen_capacity;
+
+  // 最近一个函数的结果
+  int fingerprinted;
+  CacheKey key;
+  IRProgram *ir;
+} Recompiler;
+
+/**
+ * 追加一个 Token，是标识符时记下它的位置
+ */
+static void add_token(Recompiler *rc, const Lexer *lexer, const Token *token) {
+  if (token->type == TOKEN_IDENTIFIER) {
+    if (rc->name_count >= rc->name_capacity) {
+      rc->name_capacity = rc->name_capacity == 0 ? 64 : rc->name_capacity * 2;
+      rc->names =
+          (size_t *)realloc(rc->names, sizeof(size_t) * rc->name_capacity);
+    }
+    rc->names[rc->name_count++] = rc->tokens->length + 1;
+  }
+  writer_putc(rc->tokens, (char)token->type);
+  writer_write(rc->tokens, lexer->source + token->start,
+               (size_t)token->length);
+  writer_putc(rc->tokens, '\0');
+}
+
+/**
+ * 第一次见到 name 时返回 1
+ */
+static int first_sight(Recompiler *rc, const char *name) {
+  size_t mask = (size_t)rc->seen_capacity - 1;
+  size_t slot = (size_t)hash64(name, strlen(name), 0) & mask;
+  while (rc->seen[slot]) {
+    if (strcmp(rc->seen[slot], name) == 0)
+      return 0;
+    slot = (slot + 1) & mask;
+  }
+  rc->seen[slot] = name;
+  return 1;
+}
+
+/**
+ * 函数的指纹：Token 流加上其中每个名字现在对应的全局符号。
+ * 名字按第一次出现的顺序，这个顺序由 Token 流决定，不用排序。
+ * 局部变量和参数的名字也在里面，同名的全局符号变了时多重新分析一次
+ */
+static CacheKey fingerprint(Recompiler *rc) {
+  if (rc->seen_capacity < rc->name_count * 2) {
+    while (rc->seen_capacity < rc->name_count * 2)
+      rc->seen_capacity = rc->seen_capacity == 0 ? 64 : rc->seen_capacity * 2;
+    free(rc->seen);
+    rc->seen = (const char **)malloc(sizeof(const char *) * rc->seen_capacity);
+  }
+  memset(rc->seen, 0, sizeof(const char *) * rc->seen_capacity);
+
+  Writer *symbols = writer_memory();
+  for (int i = 0; i < rc->name_count; i++) {
+    const char *name = rc->tokens->buffer + rc->names[i];
+    if (!first_sight(rc, name))
+      continue;
+    Symbol *sym = semantic_lookup(rc->analyzer, name);
+    if (!sym) {
+      writer_puts(symbols, "-\n");
+      continue;
+    }
+    writer_int(symbols, sym->kind);
+    writer_putc(symbols, ' ');
+    writer_int(symbols, sym->data_type);
+    writer_putc(symbols, ' ');
+    writer_int(symbols, sym->return_type);
+    for (int k = 0; k < sym->param_count; k++) {
+      writer_putc(symbols, ' ');
+      writer_int(symbols, sym->params[k].type);
+    }
+    writer_putc(symbols, '\n');
+  }
+
+  // 符号部分先哈希成选项串，Token 流不用再复制一遍
+  char salt[64];
+  snprintf(salt, sizeof(salt), "function %016llx",
+           (unsigned long long)hash64(symbols->buffer, symbols->length, 0));
+  writer_close(symbols);
+  return cache_key(rc->tokens->buffer, rc->tokens->length, salt);
+}
+
+/**
+ * Parser.skip_body：读出函数的 Token 流算指纹，缓存里有它的 IR 时跳过函数体
+ */
+static int skip_body(void *user, Parser *parser, int start) {
+  Recompiler *rc = (Recompiler *)user;
+  if (parser_had_error(parser))
+    return 0; // 之后不再做语义分析，也就用不到指纹
+
+  time_report_stop(rc->report, "parse");
+  time_report_start(rc->report);
+  rc->tokens->length = 0;
+  rc->name_count = 0;
+
+  // 函数头：从第一个 Token 到 '{'（前面已经分析过，不会出错）
+  Lexer head = *parser->lexer;
+  head.pos = start;
+  for (;;) {
+    Token token = lexer_next_token(&head);
+    if (token.start >= parser->current.start)
+      break;
+    add_token(rc, &head, &token);
+  }
+
+  // 函数体：到配对的 '}'，没有配对时照常解析（报告错误）
+  add_token(rc, parser->lexer, &parser->current);
+  Lexer body = *parser->lexer;
+  int depth = 1;
+  while (depth > 0) {
+    Token token = lexer_next_token(&body);
+    if (token.type == TOKEN_EOF) {
+      time_report_stop(rc->report, "fingerprint");
+      time_report_start(rc->report);
+      return 0;
+    }
+    if (token.type == TOKEN_LBRACE)
+      depth++;
+    else if (token.type == TOKEN_RBRACE)
+      depth--;
+    add_token(rc, &body, &token);
+  }
+  rc->key = fingerprint(rc);
+  rc->fingerprinted = 1;
+  time_report_stop(rc->report, "fingerprint");
+
+  time_report_start(rc->report);
+  rc->ir = cache_pack_load(rc->pack, rc->key);
+  time_report_stop(rc->report, "cache-lookup");
+
+  time_report_start(rc->report);
+  if (!rc->ir)
+    return 0;
+  *parser->lexer = body;
+  return 1;
+}
+
+static void free_units(Unit *units, int count) {
+  for (int i = 0; i < count; i++) {
+    ast_free(units[i].decl);
+    ir_program_free(units[i].ir);
+  }
+  free(units);
+}
+
+IRProgram *recompile_front_end(const char *source, const char *module,
+                               SemanticAnalyzer *analyzer, Cache *cache,
+                               TimeReport *report, RecompileStats *stats) {
+  stats->parse_error = 0;
+  stats->functions = 0;
+  stats->reused = 0;
+
+  // 逐个取声明并马上做语义分析，下一个函数的指纹要用到前面的符号
+  Recompiler rc;
+  memset(&rc, 0, sizeof(rc));
+  rc.analyzer = analyzer;
+  rc.report = report;
+  rc.tokens = writer_memory();
+
+  time_report_start(report);
+  rc.pack = cache_pack_open(cache, module);
+  time_report_stop(report, "cache-lookup");
+
+  time_report_start(report);
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  parser.skip_body = skip_body;
+  parser.skip_user = &rc;
+  Unit *units = NULL;
+  int count = 0, capacity = 0;
+  long nodes = 0;
+  for (;;) {
+    rc.fingerprinted = 0;
+    rc.ir = NULL;
+    ASTNode *decl = parser_next_declaration(&parser);
+    if (!decl)
+      break;
+    if (count >= capacity) {
+      capacity = capacity == 0 ? 64 : capacity * 2;
+      units = (Unit *)realloc(units, sizeof(Unit) * capacity);
+    }
+    Unit *unit = &units[count++];
+    unit->decl = decl;
+    unit->fingerprinted = rc.fingerprinted;
+    unit->key = rc.key;
+    unit->ir = rc.ir;
+    nodes += ast_count_nodes(decl);
+    if (decl->type == AST_FUNC_DECL)
+      stats->functions++;
+    if (parser_had_error(&parser))
+      continue; // 只报告剩下的语法错误
+
+    time_report_stop(report, "parse");
+    time_report_start(report);
+    if (unit->ir) {
+      stats->reused++;
+      semantic_declare_declaration(analyzer, decl);
+    } else {
+      semantic_analyze_declaration(analyzer, decl);
+    }
+    time_report_stop(report, "semantic");
+    time_report_start(report);
+  }
+  time_report_stop(report, "parse");
+  time_report_items(report, nodes, "nodes");
+  writer_close(rc.tokens);
+  free(rc.names);
+  free(rc.seen);
+  if (parser_had_error(&parser) || semantic_has_errors(analyzer)) {
+    stats->parse_error = parser_had_error(&parser);
+    cache_pack_close(rc.pack); // 没有新条目，不会写回
+    free_units(units, count);
+    return NULL;
+  }
+
+  // 拼接 IR：scope 给要重新生成的声明提供前面的全局符号
+  IRProgram *scope = ir_program_create();
+  IRProgram *program = ir_program_create();
+  for (int i = 0; i < count; i++) {
+    Unit *unit = &units[i];
+    int fresh = unit->ir == NULL;
+    time_report_start(report);
+    if (fresh)
+      unit->ir = ir_generate_fragment(scope, unit->decl);
+    else
+      ir_declare_declaration(scope, unit->decl);
+    time_report_stop(report, "ir-generate");
+    time_report_items(report, unit->ir->count, "instructions");
+
+    if (fresh && unit->fingerprinted) {
+      time_report_start(report);
+      cache_pack_store(rc.pack, unit->key, unit->ir);
+      time_report_stop(report, "cache-store");
+    }
+    time_report_start(report);
+    ir_take_fragment(program, unit->ir);
+    unit->ir = NULL;
+    time_report_stop(report, "ir-link");
+  }
+  ir_program_free(scope);
+  free_units(units, count);
+
+  time_report_start(report);
+  cache_pack_close(rc.pack);
+  time_report_stop(report, "cache-store");
+  return program;
+}
@@ -0,0 +1,534 @@
+/**
+ * regalloc.c - 线性扫描寄存器分配实现
+ */
+
+#include "../include/regalloc.h"
+#include "../include/memory.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POS_MAX INT_MAX
+
+/**
+ * 可分配的寄存器（按优先顺序）
+ *
+ * 保留给代码生成器做临时寄存器的：
+ *   rax/rdx（除法、返回值）、rcx（移位次数）、r11、rsp/rbp（栈帧）、
+ *   xmm0/xmm1（浮点返回值和运算）
+ * 调用者保存的排在前面：不跨越 call 的区间优先用它们，省去序言里的保存。
+ */
+static const X86Reg int_regs[] = {REG_RSI, REG_RDI, REG_R8,  REG_R9,
+                                  REG_R10, REG_RBX, REG_R12, REG_R13,
+                                  REG_R14, REG_R15};
+#define INT_REG_COUNT ((int)(sizeof(int_regs) / sizeof(int_regs[0])))
+#define FIRST_FLOAT_REG (REG_XMM0 + 2)
+
+// ==================== 活跃区间 ====================
+
+static void add_range(LiveInterval *it, int start, int end) {
+  if (start >= end)
+    return;
+  if (it->range_count >= it->range_capacity) {
+    it->range_capacity = it->range_capacity == 0 ? 2 : it->range_capacity * 2;
+    it->ranges = (LiveRange *)realloc(it->ranges,
+                                      sizeof(LiveRange) * it->range_capacity);
+  }
+  it->ranges[it->range_count].start = start;
+  it->ranges[it->range_count].end = end;
+  it->range_count++;
+}
+
+static int compare_ranges(const void *a, const void *b) {
+  return ((const LiveRange *)a)->start - ((const LiveRange *)b)->start;
+}
+
+/**
+ * 排序并合并重叠/相邻的段
+ */
+static void normalize(LiveInterval *it) {
+  if (it->range_count <= 1)
+    return;
+  qsort(it->ranges, it->range_count, sizeof(LiveRange), compare_ranges);
+  int n = 0;
+  for (int i = 1; i < it->range_count; i++) {
+    if (it->ranges[i].start <= it->ranges[n].end) {
+      if (it->ranges[i].end > it->ranges[n].end)
+        it->ranges[n].end = it->ranges[i].end;
+    } else {
+      it->ranges[++n] = it->ranges[i];
+    }
+  }
+  it->range_count = n + 1;
+}
+
+static int interval_start(const LiveInterval *it) {
+  return it->ranges[0].start;
+}
+
+static int interval_end(const LiveInterval *it) {
+  return it->ranges[it->range_count - 1].end;
+}
+
+static int covers(const LiveInterval *it, int pos) {
+  for (int i = 0; i < it->range_count; i++) {
+    if (pos < it->ranges[i].start)
+      return 0;
+    if (pos < it->ranges[i].end)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * 两个区间第一次同时活跃的位置，不相交返回 POS_MAX
+ */
+static int next_intersection(const LiveInterval *a, const LiveInterval *b) {
+  int i = 0, j = 0;
+  while (i < a->range_count && j < b->range_count) {
+    const LiveRange *x = &a->ranges[i];
+    const LiveRange *y = &b->ranges[j];
+    if (x->end <= y->start) {
+      i++;
+    } else if (y->end <= x->start) {
+      j++;
+    } else {
+      return x->start > y->start ? x->start : y->start;
+    }
+  }
+  return POS_MAX;
+}
+
+static int intersects(const LiveInterval *a, const LiveInterval *b) {
+  if (interval_end(a) <= interval_start(b) ||
+      interval_end(b) <= interval_start(a))
+    return 0;
+  return next_intersection(a, b) != POS_MAX;
+}
+
+static int is_global_value(const Liveness *lv, int v) {
+  return v >= lv->temp_count && lv->var_global[v - lv->temp_count];
+}
+
+/**
+ * 记录每个值是整数还是浮点
+ */
+static void compute_types(RegAlloc *ra, IRProgram *program) {
+  Liveness *lv = ra->lv;
+  for (int i = lv->cfg->func.begin + 1; i < lv->cfg->func.end; i++) {
+    IRInstruction *instr = &program->instructions[i];
+    IROperand ops[3] = {instr->result, instr->arg1, instr->arg2};
+    for (int k = 0; k < 3; k++) {
+      if (ops[k].vtype != IR_TYPE_FLOAT)
+        continue;
+      int v = liveness_value(lv, ops[k]);
+      if (v >= 0)
+        ra->intervals[v].type = IR_TYPE_FLOAT;
+    }
+  }
+}
+
+/**
+ * 逆序走过每个基本块，构造活跃区间
+ *
+ * live_until[v] 记录 v 当前这一段活跃到哪里为止：
+ * 遇到使用时（v 还不活跃）开始一段，遇到定义时结束这一段，
+ * 走到块开头时仍然活跃的值从块开头算起。
+ */
+static void build_intervals(RegAlloc *ra, IRProgram *program) {
+  Liveness *lv = ra->lv;
+  CFG *cfg = lv->cfg;
+  int *live_until = (int *)malloc(sizeof(int) * (lv->value_count + 1));
+  Bitset live;
+  bitset_init(&live, lv->value_count);
+
+  for (int b = 0; b < cfg->block_count; b++) {
+    int from = 2 * cfg->blocks[b].start;
+    int to = 2 * cfg->blocks[b].end;
+
+    bitset_copy(&live, &lv->live_out[b]);
+    for (int v = bitset_next(&live, 0); v >= 0; v = bitset_next(&live, v + 1))
+      live_until[v] = to;
+
+    for (int i = cfg->blocks[b].end - 1; i >= cfg->blocks[b].start; i--) {
+      IRInstruction *instr = &program->instructions[i];
+
+      int def = liveness_instr_def(lv, instr);
+      if (def >= 0) {
+        if (bitset_test(&live, def)) {
+          add_range(&ra->intervals[def], 2 * i + 1, live_until[def]);
+          bitset_reset(&live, def);
+        } else {
+          // 结果没人用，也要有个地方写
+          add_range(&ra->intervals[def], 2 * i + 1, 2 * i + 2);
+        }
+      }
+
+      int uses[2];
+      int n = liveness_instr_uses(lv, instr, uses);
+      for (int k = 0; k < n; k++) {
+        if (!bitset_test(&live, uses[k])) {
+          bitset_set(&live, uses[k]);
+          live_until[uses[k]] = 2 * i + 1;
+        }
+      }
+    }
+
+    for (int v = bitset_next(&live, 0); v >= 0; v = bitset_next(&live, v + 1))
+      add_range(&ra->intervals[v], from, live_until[v]);
+  }
+
+  for (int v = 0; v < ra->interval_count; v++)
+    normalize(&ra->intervals[v]);
+
+  bitset_free(&live);
+  free(live_until);
+}
+
+/**
+ * 标记跨越 call 的区间：call 之前和之后都活跃
+ */
+static void mark_call_crossings(RegAlloc *ra, IRProgram *program) {
+  CFG *cfg = ra->lv->cfg;
+  int *calls = (int *)malloc(sizeof(int) * (cfg->func.end - cfg->func.begin + 1));
+  int call_count = 0;
+  for (int i = cfg->func.begin + 1; i < cfg->func.end; i++) {
+    if (program->instructions[i].opcode == IR_CALL)
+      calls[call_count++] = 2 * i;
+  }
+
+  for (int v = 0; v < ra->interval_count && call_count > 0; v++) {
+    LiveInterval *it = &ra->intervals[v];
+    int c = 0;
+    for (int r = 0; r < it->range_count && c < call_count; r++) {
+      while (c < call_count && calls[c] < it->ranges[r].start)
+        c++;
+      if (c < call_count && calls[c] + 1 < it->ranges[r].end) {
+        it->crosses_call = 1;
+        break;
+      }
+    }
+  }
+
+  free(calls);
+}
+
+// ==================== 线性扫描 ====================
+
+/**
+ * 区间可以使用的寄存器
+ */
+static int candidate_regs(const LiveInterval *it, X86Reg *regs) {
+  int n = 0;
+  if (it->type == IR_TYPE_FLOAT) {
+    if (it->crosses_call)
+      return 0;
+    for (int r = FIRST_FLOAT_REG; r <= REG_XMM15; r++)
+      regs[n++] = (X86Reg)r;
+    return n;
+  }
+  for (int i = 0; i < INT_REG_COUNT; i++) {
+    if (!it->crosses_call || x86_is_callee_saved(int_regs[i]))
+      regs[n++] = int_regs[i];
+  }
+  return n;
+}
+
+static int compare_by_start(const void *a, const void *b) {
+  const LiveInterval *x = *(LiveInterval *const *)a;
+  const LiveInterval *y = *(LiveInterval *const *)b;
+  int diff = interval_start(x) - interval_start(y);
+  return diff != 0 ? diff : x->value - y->value;
+}
+
+typedef struct {
+  LiveInterval **items;
+  int count;
+} IntervalList;
+
+static void list_remove(IntervalList *list, int index) {
+  list->items[index] = list->items[--list->count];
+}
+
+/**
+ * 尝试找一个在整个区间内都空闲的寄存器
+ */
+static X86Reg find_free_reg(LiveInterval *current, IntervalList *active,
+                            IntervalList *inactive) {
+  X86Reg regs[REG_COUNT];
+  int n = candidate_regs(current, regs);
+
+  int free_until[REG_COUNT];
+  for (int r = 0; r < REG_COUNT; r++)
+    free_until[r] = POS_MAX;
+  for (int i = 0; i < active->count; i++)
+    free_until[active->items[i]->location.reg] = 0;
+  for (int i = 0; i < inactive->count; i++) {
+    LiveInterval *it = inactive->items[i];
+    int pos = next_intersection(it, current);
+    if (pos < free_until[it->location.reg])
+      free_until[it->location.reg] = pos;
+  }
+
+  int end = interval_end(current);
+  for (int i = 0; i < n; i++) {
+    if (free_until[regs[i]] >= end)
+      return regs[i];
+  }
+  return REG_NONE;
+}
+
+/**
+ * 没有空闲寄存器：在 active 里找一个结束得比当前区间晚的，
+ * 把它溢出，让出寄存器（它的寄存器上不能有与当前区间冲突的 inactive 区间）
+ */
+static LiveInterval *choose_victim(LiveInterval *current, IntervalList *active,
+                                   IntervalList *inactive) {
+  X86Reg regs[REG_COUNT];
+  int n = candidate_regs(current, regs);
+  char allowed[REG_COUNT];
+  memset(allowed, 0, sizeof(allowed));
+  for (int i = 0; i < n; i++)
+    allowed[regs[i]] = 1;
+  for (int i = 0; i < inactive->count; i++) {
+    if (intersects(inactive->items[i], current))
+      allowed[inactive->items[i]->location.reg] = 0;
+  }
+
+  LiveInterval *victim = NULL;
+  for (int i = 0; i < active->count; i++) {
+    LiveInterval *it = active->items[i];
+    if (!allowed[it->location.reg])
+      continue;
+    if (!victim || interval_end(it) > interval_end(victim))
+      victim = it;
+  }
+
+  if (victim && interval_end(victim) > interval_end(current))
+    return victim;
+  return NULL;
+}
+
+/**
+ * 被溢出的区间再试一次：寄存器上已分配的区间都与它不相交就放回去
+ */
+static int second_chance(LiveInterval *it, IntervalList *assigned) {
+  X86Reg regs[REG_COUNT];
+  int n = candidate_regs(it, regs);
+  for (int i = 0; i < n; i++) {
+    IntervalList *list = &assigned[regs[i]];
+    int ok = 1;
+    for (int k = 0; k < list->count && ok; k++) {
+      if (intersects(list->items[k], it))
+        ok = 0;
+    }
+    if (ok) {
+      it->location.kind = LOC_REG;
+      it->location.reg = regs[i];
+      list->items[list->count++] = it;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void linear_scan(RegAlloc *ra) {
+  int n = ra->interval_count;
+  LiveInterval **unhandled =
+      (LiveInterval **)malloc(sizeof(LiveInterval *) * (n + 1));
+  int unhandled_count = 0;
+  for (int v = 0; v < n; v++) {
+    if (ra->intervals[v].range_count > 0 && !is_global_value(ra->lv, v))
+      unhandled[unhandled_count++] = &ra->intervals[v];
+  }
+  qsort(unhandled, unhandled_count, sizeof(LiveInterval *), compare_by_start);
+
+  IntervalList active = {(LiveInterval **)malloc(sizeof(void *) * (n + 1)), 0};
+  IntervalList inactive = {(LiveInterval **)malloc(sizeof(void *) * (n + 1)),
+                           0};
+  IntervalList spilled = {(LiveInterval **)malloc(sizeof(void *) * (n + 1)), 0};
+
+  for (int u = 0; u < unhandled_count; u++) {
+    LiveInterval *current = unhandled[u];
+    int pos = interval_start(current);
+
+    // 结束的移出，进入空洞的移到 inactive
+    for (int i = active.count - 1; i >= 0; i--) {
+      LiveInterval *it = active.items[i];
+      if (interval_end(it) <= pos) {
+        list_remove(&active, i);
+      } else if (!covers(it, pos)) {
+        list_remove(&active, i);
+        inactive.items[inactive.count++] = it;
+      }
+    }
+    for (int i = inactive.count - 1; i >= 0; i--) {
+      LiveInterval *it = inactive.items[i];
+      if (interval_end(it) <= pos) {
+        list_remove(&inactive, i);
+      } else if (covers(it, pos)) {
+        list_remove(&inactive, i);
+        active.items[active.count++] = it;
+      }
+    }
+
+    X86Reg reg = find_free_reg(current, &active, &inactive);
+    if (reg != REG_NONE) {
+      current->location.kind = LOC_REG;
+      current->location.reg = reg;
+      active.items[active.count++] = current;
+      continue;
+    }
+
+    LiveInterval *victim = choose_victim(current, &active, &inactive);
+    if (victim) {
+      current->location = victim->location;
+      victim->location.kind = LOC_STACK;
+      for (int i = 0; i < active.count; i++) {
+        if (active.items[i] == victim) {
+          active.items[i] = current;
+          break;
+        }
+      }
+      spilled.items[spilled.count++] = victim;
+    } else {
+      current->location.kind = LOC_STACK;
+      spilled.items[spilled.count++] = current;
+    }
+  }
+
+  // 第二次机会
+  if (spilled.count > 0) {
+    IntervalList assigned[REG_COUNT];
+    for (int r = 0; r < REG_COUNT; r++) {
+      assigned[r].items = NULL;
+      assigned[r].count = 0;
+    }
+    for (int r = 0; r < REG_COUNT; r++)
+      assigned[r].items = (LiveInterval **)malloc(sizeof(void *) * (n + 1));
+    for (int u = 0; u < unhandled_count; u++) {
+      LiveInterval *it = unhandled[u];
+      if (it->location.kind == LOC_REG) {
+        IntervalList *list = &assigned[it->location.reg];
+        list->items[list->count++] = it;
+      }
+    }
+
+    qsort(spilled.items, spilled.count, sizeof(LiveInterval *),
+          compare_by_start);
+    for (int i = 0; i < spilled.count; i++) {
+      if (second_chance(spilled.items[i], assigned))
+        ra->second_chance++;
+    }
+
+    for (int r = 0; r < REG_COUNT; r++)
+      free(assigned[r].items);
+  }
+
+  // 留在栈上的区间分配栈槽：前一个区间结束后栈槽可以复用
+  int *slot_end = (int *)malloc(sizeof(int) * (spilled.count + 1));
+  for (int i = 0; i < spilled.count; i++) {
+    LiveInterval *it = spilled.items[i];
+    if (it->location.kind != LOC_STACK)
+      continue;
+    ra->spilled++;
+    int slot = 0;
+    while (slot < ra->slot_count && slot_end[slot] > interval_start(it))
+      slot++;
+    if (slot == ra->slot_count)
+      ra->slot_count++;
+    slot_end[slot] = interval_end(it);
+    it->location.slot = slot;
+  }
+  free(slot_end);
+
+  for (int u = 0; u < unhandled_count; u++) {
+    Location *loc = &unhandled[u]->location;
+    if (loc->kind == LOC_REG && x86_is_callee_saved(loc->reg))
+      ra->callee_saved_used[loc->reg] = 1;
+  }
+
+  free(unhandled);
+  free(active.items);
+  free(inactive.items);
+  free(spilled.items);
+}
+
+// ==================== 接口 ====================
+
+RegAlloc *regalloc_function(IRProgram *program, IRFunction *func) {
+  RegAlloc *ra = (RegAlloc *)calloc(1, sizeof(RegAlloc));
+  ra->lv = liveness_analyze(program, func);
+
+  ra->interval_count = ra->lv->value_count;
+  ra->intervals = (LiveInterval *)calloc(
+      ra->interval_count ? ra->interval_count : 1, sizeof(LiveInterval));
+  for (int v = 0; v < ra->interval_count; v++) {
+    ra->intervals[v].value = v;
+    ra->intervals[v].type = IR_TYPE_INT;
+    ra->intervals[v].location.kind = LOC_NONE;
+    ra->intervals[v].location.reg = REG_NONE;
+    ra->intervals[v].location.slot = -1;
+  }
+
+  compute_types(ra, program);
+  build_intervals(ra, program);
+  mark_call_crossings(ra, program);
+  linear_scan(ra);
+  return ra;
+}
+
+void regalloc_free(RegAlloc *ra) {
+  if (!ra)
+    return;
+  for (int v = 0; v < ra->interval_count; v++)
+    free(ra->intervals[v].ranges);
+  free(ra->intervals);
+  liveness_free(ra->lv);
+  free(ra);
+}
+
+Location regalloc_location(const RegAlloc *ra, IROperand op) {
+  Location none = {LOC_NONE, REG_NONE, -1};
+  int v = liveness_value(ra->lv, op);
+  if (v < 0)
+    return none;
+  return ra->intervals[v].location;
+}
+
+void regalloc_print(const RegAlloc *ra) {
+  const Liveness *lv = ra->lv;
+  printf("Register allocation of %s: %d values, %d spilled "
+         "(%d second chance), %d stack slots\n",
+         lv->cfg->func.name, ra->interval_count, ra->spilled,
+         ra->second_chance, ra->slot_count);
+
+  printf("  callee-saved:");
+  for (int r = 0; r < REG_COUNT; r++) {
+    if (ra->callee_saved_used[r])
+      printf(" %s", x86_reg_name((X86Reg)r, 8));
+  }
+  printf("\n");
+
+  for (int v = 0; v < ra->interval_count; v++) {
+    const LiveInterval *it = &ra->intervals[v];
+    if (it->location.kind == LOC_NONE)
+      continue;
+    if (v < lv->temp_count)
+      printf("  t%-8d", lv->value_temp[v]);
+    else
+      printf("  %-9s", lv->var_names[v - lv->temp_count]);
+
+    if (it->location.kind == LOC_REG)
+      printf(" %-8s", x86_reg_name(it->location.reg, 8));
+    else
+      printf(" slot %-3d", it->location.slot);
+
+    for (int r = 0; r < it->range_count; r++)
+      printf(" [%d, %d)", it->ranges[r].start, it->ranges[r].end);
+    if (it->crosses_call)
+      printf("  (crosses call)");
+    printf("\n");
+  }
+}
@@ -11,6 +11,8 @@
  */
 
 #include "../include/semantic.h"
+#include "../include/diag.h"
+#include "../include/memory.h"
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -274,6 +276,7 @@ Symbol *semantic_declare(SemanticAnalyzer *analyzer, const char *name,
   if (sym) {
     sym->data_type = type;
     scope_add_symbol(analyzer->current_scope, sym);
+    analyzer->symbol_count++;
   }
   return sym;
 }
@@ -418,11 +421,11 @@ int semantic_has_errors(SemanticAnalyzer *analyzer) {
 void semantic_print_errors(SemanticAnalyzer *analyzer) {
   SemanticError *err = analyzer->errors;
   while (err) {
-    fprintf(stderr, "[Line %d] Semantic Error: %s\n", err->line, err->message);
+    diag_printf("[Line %d] Semantic Error: %s\n", err->line, err->message);
     err = err->next;
   }
   if (analyzer->error_count > 0) {
-    fprintf(stderr, "Total: %d semantic error(s)\n", analyzer->error_count);
+    diag_printf("Total: %d semantic error(s)\n", analyzer->error_count);
   }
 }
 
@@ -433,6 +436,30 @@ static DataType analyze_expression(SemanticAnalyzer *analyzer, ASTNode *node);
 static void analyze_statement(SemanticAnalyzer *analyzer, ASTNode *node);
 static void analyze_declaration(SemanticAnalyzer *analyzer, ASTNode *node);
 
+/**
+ * 记下符号声明的位置，并通知名字解析的回调
+ */
+static void declared_at(SemanticAnalyzer *analyzer, const ASTNode *node,
+                        Symbol *sym) {
+  sym->line = node->line;
+  sym->column = node->column;
+  if (analyzer->resolve.resolved)
+    analyzer->resolve.resolved(analyzer->resolve.user, node, sym,
+                               analyzer->current_scope ==
+                                   analyzer->global_scope);
+}
+
+/**
+ * 通知名字解析的回调：node 用到了 sym
+ */
+static void resolved_to(SemanticAnalyzer *analyzer, const ASTNode *node,
+                        const Symbol *sym) {
+  if (analyzer->resolve.resolved)
+    analyzer->resolve.resolved(
+        analyzer->resolve.user, node, sym,
+        scope_lookup(analyzer->global_scope, sym->name) == sym);
+}
+
 /**
  * 分析表达式，返回表达式的类型
  */
@@ -461,6 +488,7 @@ static DataType analyze_expression(SemanticAnalyzer *analyzer, ASTNode *node) {
                      "Undeclared variable '%s'", node->data.identifier.name);
       return TYPE_ERROR;
     }
+    resolved_to(analyzer, node, sym);
     return sym->data_type;
   }
 
@@ -488,6 +516,7 @@ static DataType analyze_expression(SemanticAnalyzer *analyzer, ASTNode *node) {
                      "Undeclared function '%s'", node->data.call_expr.callee);
       return TYPE_ERROR;
     }
+    resolved_to(analyzer, node, func);
     if (func->kind != SYMBOL_FUNCTION) {
       semantic_error(analyzer, SEM_ERROR_NOT_CALLABLE, node->line,
                      "'%s' is not a function", node->data.call_expr.callee);
@@ -528,6 +557,7 @@ static DataType analyze_expression(SemanticAnalyzer *analyzer, ASTNode *node) {
                      "Undeclared variable '%s'", node->data.assign_expr.name);
       return TYPE_ERROR;
     }
+    resolved_to(analyzer, node, sym);
 
     DataType value_type =
         analyze_expression(analyzer, node->data.assign_expr.value);
@@ -580,8 +610,10 @@ static void analyze_statement(SemanticAnalyzer *analyzer, ASTNode *node) {
                      "Variable '%s' already declared in this scope",
                      node->data.var_decl.name);
     } else {
-      semantic_declare(analyzer, node->data.var_decl.name, SYMBOL_VARIABLE,
-                       type);
+      Symbol *sym = semantic_declare(analyzer, node->data.var_decl.name,
+                                     SYMBOL_VARIABLE, type);
+      if (sym)
+        declared_at(analyzer, node, sym);
     }
 
     // 分析初始化表达式
@@ -610,6 +642,18 @@ static void analyze_statement(SemanticAnalyzer *analyzer, ASTNode *node) {
     analyze_statement(analyzer, node->data.while_stmt.body);
     break;
 
+  case AST_FOR_STMT:
+    // 初始化里声明的变量只在循环里可见
+    semantic_enter_scope(analyzer);
+    analyze_statement(analyzer, node->data.for_stmt.init);
+    if (node->data.for_stmt.condition)
+      analyze_expression(analyzer, node->data.for_stmt.condition);
+    if (node->data.for_stmt.update)
+      analyze_expression(analyzer, node->data.for_stmt.update);
+    analyze_statement(analyzer, node->data.for_stmt.body);
+    semantic_exit_scope(analyzer);
+    break;
+
   case AST_RETURN_STMT: {
     DataType return_type = TYPE_VOID;
     if (node->data.return_stmt.value) {
@@ -640,6 +684,32 @@ static void analyze_statement(SemanticAnalyzer *analyzer, ASTNode *node) {
   }
 }
 
+/**
+ * 在当前作用域声明函数，带上返回类型和参数信息
+ */
+static Symbol *declare_function(SemanticAnalyzer *analyzer, ASTNode *node) {
+  DataType return_type = string_to_datatype(node->data.func_decl.return_type);
+  Symbol *func_sym = semantic_declare(analyzer, node->data.func_decl.name,
+                                      SYMBOL_FUNCTION, return_type);
+  if (!func_sym)
+    return NULL;
+
+  func_sym->return_type = return_type;
+  func_sym->param_count = node->data.func_decl.param_count;
+
+  // 复制参数信息
+  if (func_sym->param_count > 0) {
+    func_sym->params =
+        (ParamInfo *)calloc(func_sym->param_count, sizeof(ParamInfo));
+    for (int i = 0; i < func_sym->param_count; i++) {
+      ASTNode *param = node->data.func_decl.params[i];
+      func_sym->params[i].name = str_dup(param->data.param.name);
+      func_sym->params[i].type = string_to_datatype(param->data.param.type);
+    }
+  }
+  return func_sym;
+}
+
 /**
  * 分析声明（函数/全局变量）
  */
@@ -653,8 +723,6 @@ static void analyze_declaration(SemanticAnalyzer *analyzer, ASTNode *node) {
     break;
 
   case AST_FUNC_DECL: {
-    DataType return_type = string_to_datatype(node->data.func_decl.return_type);
-
     // 检查函数是否已声明
     if (semantic_lookup_current_scope(analyzer, node->data.func_decl.name)) {
       semantic_error(analyzer, SEM_ERROR_REDECLARED, node->line,
@@ -664,24 +732,10 @@ static void analyze_declaration(SemanticAnalyzer *analyzer, ASTNode *node) {
     }
 
     // 声明函数
-    Symbol *func_sym = semantic_declare(analyzer, node->data.func_decl.name,
-                                        SYMBOL_FUNCTION, return_type);
+    Symbol *func_sym = declare_function(analyzer, node);
     if (!func_sym)
       return;
-
-    func_sym->return_type = return_type;
-    func_sym->param_count = node->data.func_decl.param_count;
-
-    // 复制参数信息
-    if (func_sym->param_count > 0) {
-      func_sym->params =
-          (ParamInfo *)calloc(func_sym->param_count, sizeof(ParamInfo));
-      for (int i = 0; i < func_sym->param_count; i++) {
-        ASTNode *param = node->data.func_decl.params[i];
-        func_sym->params[i].name = str_dup(param->data.param.name);
-        func_sym->params[i].type = string_to_datatype(param->data.param.type);
-      }
-    }
+    declared_at(analyzer, node, func_sym);
 
     // 进入函数作用域
     semantic_enter_scope(analyzer);
@@ -691,8 +745,10 @@ static void analyze_declaration(SemanticAnalyzer *analyzer, ASTNode *node) {
     for (int i = 0; i < node->data.func_decl.param_count; i++) {
       ASTNode *param = node->data.func_decl.params[i];
       DataType param_type = string_to_datatype(param->data.param.type);
-      semantic_declare(analyzer, param->data.param.name, SYMBOL_PARAMETER,
-                       param_type);
+      Symbol *param_sym = semantic_declare(analyzer, param->data.param.name,
+                                           SYMBOL_PARAMETER, param_type);
+      if (param_sym)
+        declared_at(analyzer, param, param_sym);
     }
 
     // 分析函数体
@@ -728,3 +784,27 @@ void semantic_analyze(SemanticAnalyzer *analyzer, ASTNode *ast) {
     analyze_declaration(analyzer, ast->data.program.declarations[i]);
   }
 }
+
+/**
+ * 分析一个顶层声明：全局作用域保留到下一次调用
+ */
+void semantic_analyze_declaration(SemanticAnalyzer *analyzer, ASTNode *decl) {
+  if (decl)
+    analyze_declaration(analyzer, decl);
+}
+
+/**
+ * 只声明顶层声明留在全局作用域里的符号：和分析它之后的符号表相同，
+ * 但不检查函数体和初始化表达式，也不报告错误
+ */
+void semantic_declare_declaration(SemanticAnalyzer *analyzer, ASTNode *decl) {
+  if (!decl)
+    return;
+  // 重复声明时 semantic_declare 什么也不做，和分析时一样保留第一个
+  if (decl->type == AST_VAR_DECL) {
+    semantic_declare(analyzer, decl->data.var_decl.name, SYMBOL_VARIABLE,
+                     string_to_datatype(decl->data.var_decl.type));
+  } else if (decl->type == AST_FUNC_DECL) {
+    declare_function(analyzer, decl);
+  }
+}
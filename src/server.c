@@ -0,0 +1,442 @@
+/**
+ * server.c - 常驻编译服务实现
+ */
+
+#define _DEFAULT_SOURCE // struct sockaddr_un
+
+#include "../include/server.h"
+#include "../include/compiler.h"
+#include "../include/diag.h"
+#include "../include/pool.h"
+#include "../include/writer.h"
+#include "../include/memory.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SERVER_SOCKETS 1
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#define SERVER_SOCKETS 0
+#endif
+
+#define REQUEST_MAGIC 0x51524343u // "CCRQ"
+#define REPLY_MAGIC 0x50524343u   // "CCRP"
+#define LISTEN_BACKLOG 64
+#define IDLE_TIMEOUT_SECONDS 5 // 连接上这么久没有数据就断开，把线程让给别的客户端
+
+enum { KIND_COMPILE = 1, KIND_STOP = 2 };
+
+typedef struct {
+  uint32_t magic;
+  uint32_t kind;
+  uint32_t flags;
+  uint32_t wants;
+  uint32_t source_length;
+} RequestHeader;
+
+// lengths: 诊断、IR 文本、目标文件、二进制 IR
+typedef struct {
+  uint32_t magic;
+  uint32_t status;
+  uint32_t lengths[4];
+} ReplyHeader;
+
+void server_reply_free(ServerReply *reply) {
+  free(reply->diagnostics);
+  free(reply->listing);
+  free(reply->object);
+  free(reply->ir);
+  memset(reply, 0, sizeof(*reply));
+}
+
+#if SERVER_SOCKETS
+
+struct ServerConnection {
+  int fd;
+};
+
+/**
+ * 读满 length 字节；对方关闭或出错返回 1
+ */
+static int read_all(int fd, void *data, size_t length) {
+  char *p = (char *)data;
+  while (length > 0) {
+    ssize_t n = read(fd, p, length);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 1;
+    p += n;
+    length -= (size_t)n;
+  }
+  return 0;
+}
+
+static int write_all(int fd, const void *data, size_t length) {
+  const char *p = (const char *)data;
+  while (length > 0) {
+    ssize_t n = write(fd, p, length);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 1;
+    p += n;
+    length -= (size_t)n;
+  }
+  return 0;
+}
+
+static int make_address(const char *path, struct sockaddr_un *address) {
+  if (strlen(path) >= sizeof(address->sun_path))
+    return 1;
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  strcpy(address->sun_path, path);
+  return 0;
+}
+
+// ========== 服务端 ==========
+
+/**
+ * 一个工作线程的状态，在它处理的所有请求之间重复使用
+ */
+typedef struct {
+  CompilerContext *contexts[COMPILER_OPTIMIZE + 1]; // 按 flags 第一次用到时创建
+  Writer *diagnostics;
+  Writer *listing;
+  char *source;
+  size_t capacity;
+  int fd; // 正在处理的连接，没有时为 -1（由 Server.lock 保护）
+} Worker;
+
+typedef struct {
+  int listen_fd;
+  Worker *workers;
+  int worker_count;
+  pthread_mutex_t lock;
+  int stopping;
+} Server;
+
+static CompilerContext *worker_context(Worker *worker, unsigned flags) {
+  flags &= COMPILER_OPTIMIZE;
+  if (!worker->contexts[flags]) {
+    CompilerConfig config = compiler_default_config();
+    config.flags = flags;
+    DiagHandler to_writer = diag_to_writer(worker->diagnostics);
+    config.diagnostic = to_writer.function;
+    config.diagnostic_user = to_writer.user;
+    worker->contexts[flags] = compiler_create(&config);
+  }
+  return worker->contexts[flags];
+}
+
+static void reset(Writer *writer) {
+  writer->length = 0;
+  writer->bytes = 0;
+}
+
+/**
+ * 编译 worker->source 并发送应答；通信失败返回 1
+ */
+static int answer(Worker *worker, int fd, const RequestHeader *header) {
+  CompilerContext *context = worker_context(worker, header->flags);
+  reset(worker->diagnostics);
+  reset(worker->listing);
+  unsigned char *object = NULL, *ir_data = NULL;
+  size_t object_size = 0, ir_size = 0;
+
+  int status = 1;
+  IRProgram *ir =
+      compiler_compile_ir(context, worker->source, header->source_length);
+  if (ir) {
+    status = 0;
+    if (header->wants & SERVER_WANT_LISTING)
+      ir_dump(ir, worker->listing);
+    if (header->wants & SERVER_WANT_IR)
+      status = compiler_encode_ir(context, ir, &ir_data, &ir_size);
+    if (status == 0 && (header->wants & SERVER_WANT_OBJECT))
+      status = compiler_generate_object(context, ir, &object, &object_size);
+    compiler_free_ir(context, ir);
+  }
+
+  ReplyHeader reply = {REPLY_MAGIC,
+                       (uint32_t)status,
+                       {(uint32_t)worker->diagnostics->length,
+                        (uint32_t)worker->listing->length,
+                        (uint32_t)object_size, (uint32_t)ir_size}};
+  int failed =
+      write_all(fd, &reply, sizeof(reply)) ||
+      write_all(fd, worker->diagnostics->buffer, worker->diagnostics->length) ||
+      write_all(fd, worker->listing->buffer, worker->listing->length) ||
+      write_all(fd, object, object_size) || write_all(fd, ir_data, ir_size);
+  compiler_free(context, object);
+  compiler_free(context, ir_data);
+  return failed;
+}
+
+/**
+ * 处理一个连接上的所有请求，直到对方关闭；收到 KIND_STOP 时返回 1
+ */
+static int serve(Worker *worker, int fd) {
+  for (;;) {
+    RequestHeader header;
+    if (read_all(fd, &header, sizeof(header)) != 0)
+      return 0;
+    if (header.magic != REQUEST_MAGIC ||
+        header.source_length > SERVER_MAX_SOURCE)
+      return 0; // 不是客户端发来的，断开
+    if (header.kind == KIND_STOP) {
+      ReplyHeader reply = {REPLY_MAGIC, 0, {0, 0, 0, 0}};
+      write_all(fd, &reply, sizeof(reply));
+      return 1;
+    }
+    if (header.kind != KIND_COMPILE)
+      return 0;
+
+    if (header.source_length > worker->capacity) {
+      while (header.source_length > worker->capacity)
+        worker->capacity *= 2;
+      worker->source = (char *)realloc(worker->source, worker->capacity);
+    }
+    if (read_all(fd, worker->source, header.source_length) != 0 ||
+        answer(worker, fd, &header) != 0)
+      return 0;
+  }
+}
+
+/**
+ * 登记 worker 正在处理 fd；已经在停止时返回 1
+ */
+static int track(Server *server, Worker *worker, int fd) {
+  pthread_mutex_lock(&server->lock);
+  int stopping = server->stopping;
+  worker->fd = stopping ? -1 : fd;
+  pthread_mutex_unlock(&server->lock);
+  return stopping;
+}
+
+static void untrack(Server *server, Worker *worker) {
+  pthread_mutex_lock(&server->lock);
+  worker->fd = -1;
+  pthread_mutex_unlock(&server->lock);
+}
+
+/**
+ * 不再接受新连接，并让其它线程阻塞在 read 上的连接读到结束：
+ * 正在编译的请求照常应答，之后连接关闭、线程退出
+ */
+static void stop(Server *server) {
+  pthread_mutex_lock(&server->lock);
+  server->stopping = 1;
+  for (int i = 0; i < server->worker_count; i++) {
+    if (server->workers[i].fd >= 0)
+      shutdown(server->workers[i].fd, SHUT_RD);
+  }
+  pthread_mutex_unlock(&server->lock);
+  shutdown(server->listen_fd, SHUT_RDWR);
+}
+
+static void worker_main(void *context, int index) {
+  Server *server = (Server *)context;
+  Worker *worker = &server->workers[index];
+  // 空闲的客户端不能一直占着线程，写不出去的应答也不能
+  struct timeval timeout = {IDLE_TIMEOUT_SECONDS, 0};
+  for (;;) {
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return; // 监听套接字已经关闭：正在停止
+    }
+    if (track(server, worker, fd) != 0) {
+      close(fd);
+      return;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    int stopped = serve(worker, fd);
+    // 先注销再关闭，stop 不会 shutdown 一个已经被复用的描述符
+    untrack(server, worker);
+    close(fd);
+    if (stopped) {
+      stop(server);
+      return;
+    }
+  }
+}
+
+int server_run(const char *path, int workers) {
+  struct sockaddr_un address;
+  if (make_address(path, &address) != 0) {
+    diag_printf("Error: Socket path '%s' is too long\n", path);
+    return 1;
+  }
+  // 已经有服务端时不能删掉它的套接字文件
+  ServerConnection *existing = server_connect(path);
+  if (existing) {
+    server_disconnect(existing);
+    diag_printf("Error: A server is already listening on '%s'\n", path);
+    return 1;
+  }
+  unlink(path); // 上次没有正常退出时留下的
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 ||
+      bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(fd, LISTEN_BACKLOG) != 0) {
+    diag_printf("Error: Cannot listen on '%s'\n", path);
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+  // 客户端中途断开时 write 返回错误，而不是结束整个进程
+  signal(SIGPIPE, SIG_IGN);
+
+  if (workers <= 0)
+    workers = pool_default_threads();
+  Server server;
+  server.listen_fd = fd;
+  server.workers = (Worker *)calloc(workers, sizeof(Worker));
+  server.worker_count = workers;
+  pthread_mutex_init(&server.lock, NULL);
+  server.stopping = 0;
+  for (int i = 0; i < workers; i++) {
+    server.workers[i].fd = -1;
+    server.workers[i].diagnostics = writer_memory();
+    server.workers[i].listing = writer_memory();
+    server.workers[i].capacity = 4096;
+    server.workers[i].source = (char *)malloc(server.workers[i].capacity);
+  }
+
+  pool_run(workers, workers, worker_main, &server);
+
+  for (int i = 0; i < workers; i++) {
+    Worker *worker = &server.workers[i];
+    for (int j = 0; j <= (int)COMPILER_OPTIMIZE; j++)
+      compiler_destroy(worker->contexts[j]);
+    writer_close(worker->diagnostics);
+    writer_close(worker->listing);
+    free(worker->source);
+  }
+  free(server.workers);
+  pthread_mutex_destroy(&server.lock);
+  close(fd);
+  unlink(path);
+  return 0;
+}
+
+// ========== 客户端 ==========
+
+ServerConnection *server_connect(const char *path) {
+  struct sockaddr_un address;
+  if (make_address(path, &address) != 0)
+    return NULL;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return NULL;
+  if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    close(fd);
+    return NULL;
+  }
+  ServerConnection *connection =
+      (ServerConnection *)malloc(sizeof(ServerConnection));
+  connection->fd = fd;
+  return connection;
+}
+
+void server_disconnect(ServerConnection *connection) {
+  if (!connection)
+    return;
+  close(connection->fd);
+  free(connection);
+}
+
+static int read_blob(int fd, uint32_t length, void **data) {
+  *data = NULL;
+  if (length == 0)
+    return 0;
+  *data = malloc(length);
+  return read_all(fd, *data, length);
+}
+
+int server_request(ServerConnection *connection, const ServerRequest *request,
+                   ServerReply *reply) {
+  memset(reply, 0, sizeof(*reply));
+  reply->status = 1;
+  if (request->length > SERVER_MAX_SOURCE)
+    return 1;
+
+  int fd = connection->fd;
+  RequestHeader header = {REQUEST_MAGIC, KIND_COMPILE, request->flags,
+                          request->wants, (uint32_t)request->length};
+  ReplyHeader answer;
+  if (write_all(fd, &header, sizeof(header)) != 0 ||
+      write_all(fd, request->source, request->length) != 0 ||
+      read_all(fd, &answer, sizeof(answer)) != 0 ||
+      answer.magic != REPLY_MAGIC)
+    return 1;
+
+  reply->status = (int)answer.status;
+  reply->diagnostics_length = answer.lengths[0];
+  reply->listing_length = answer.lengths[1];
+  reply->object_size = answer.lengths[2];
+  reply->ir_size = answer.lengths[3];
+  if (read_blob(fd, answer.lengths[0], (void **)&reply->diagnostics) != 0 ||
+      read_blob(fd, answer.lengths[1], (void **)&reply->listing) != 0 ||
+      read_blob(fd, answer.lengths[2], (void **)&reply->object) != 0 ||
+      read_blob(fd, answer.lengths[3], (void **)&reply->ir) != 0) {
+    server_reply_free(reply);
+    reply->status = 1;
+    return 1;
+  }
+  return 0;
+}
+
+int server_stop(ServerConnection *connection) {
+  RequestHeader header = {REQUEST_MAGIC, KIND_STOP, 0, 0, 0};
+  ReplyHeader answer;
+  if (write_all(connection->fd, &header, sizeof(header)) != 0 ||
+      read_all(connection->fd, &answer, sizeof(answer)) != 0)
+    return 1;
+  return answer.magic == REPLY_MAGIC ? 0 : 1;
+}
+
+#else // !SERVER_SOCKETS
+
+int server_run(const char *path, int workers) {
+  (void)path;
+  (void)workers;
+  diag_printf("Error: --server needs Unix domain sockets\n");
+  return 1;
+}
+
+ServerConnection *server_connect(const char *path) {
+  (void)path;
+  return NULL;
+}
+
+void server_disconnect(ServerConnection *connection) { (void)connection; }
+
+int server_request(ServerConnection *connection, const ServerRequest *request,
+                   ServerReply *reply) {
+  (void)connection;
+  (void)request;
+  memset(reply, 0, sizeof(*reply));
+  reply->status = 1;
+  return 1;
+}
+
+int server_stop(ServerConnection *connection) {
+  (void)connection;
+  return 1;
+}
+
+#endif
@@ -0,0 +1,222 @@
+/**
+ * stream.c - 按顶层声明流式处理的前端实现
+ */
+
+#include "../include/stream.h"
+#include "../include/diag.h"
+#include "../include/memory.h"
+#include "../include/parser.h"
+#include <stdlib.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STREAM_THREADS 1
+#include <pthread.h>
+#else
+#define STREAM_THREADS 0
+#endif
+
+/**
+ * 调用线程这一侧：语义分析、生成 IR、释放 AST
+ */
+typedef struct {
+  SemanticAnalyzer *analyzer;
+  IRProgram *ir;
+  TimeReport *report;
+  StreamStats *stats;
+} Consumer;
+
+/**
+ * 处理一个声明；parse_error 表示到这个声明为止有没有语法错误
+ * （出错的声明可能不完整，从它开始只释放不分析）。
+ * 调用前刚结束取声明的阶段，节点数记在那个阶段上。
+ */
+static void accept(Consumer *consumer, ASTNode *decl, int parse_error) {
+  StreamStats *stats = consumer->stats;
+  TimeReport *report = consumer->report;
+  long nodes = ast_count_nodes(decl);
+  time_report_items(report, nodes, "nodes");
+  stats->declarations++;
+  stats->nodes += nodes;
+  if (nodes > stats->max_nodes)
+    stats->max_nodes = nodes;
+  if (parse_error)
+    stats->parse_error = 1;
+
+  if (!stats->parse_error) {
+    int symbols = consumer->analyzer->symbol_count;
+    time_report_start(report);
+    semantic_analyze_declaration(consumer->analyzer, decl);
+    time_report_stop(report, "semantic");
+    time_report_items(report, consumer->analyzer->symbol_count - symbols,
+                      "symbols");
+
+    // 有语义错误后 IR 不会被使用，不再生成
+    if (!semantic_has_errors(consumer->analyzer)) {
+      int count = consumer->ir->count;
+      time_report_start(report);
+      ir_generate_declaration(consumer->ir, decl);
+      time_report_stop(report, "ir-generate");
+      time_report_items(report, consumer->ir->count - count, "instructions");
+    }
+  }
+  ast_free(decl);
+}
+
+/**
+ * 在调用线程上依次处理：取一个声明，分析，生成，释放
+ */
+static void run_sequential(const char *source, Consumer *consumer) {
+  TimeReport *report = consumer->report;
+  time_report_start(report);
+  Lexer lexer = lexer_init(source);
+  Parser parser = parser_init(&lexer);
+  for (;;) {
+    ASTNode *decl = parser_next_declaration(&parser);
+    time_report_stop(report, "parse");
+    if (!decl)
+      break;
+    accept(consumer, decl, parser_had_error(&parser));
+    time_report_start(report);
+  }
+  // 最后一个声明出错时没有节点，错误只留在 parser 里
+  if (parser_had_error(&parser))
+    consumer->stats->parse_error = 1;
+}
+
+#if STREAM_THREADS
+
+#define QUEUE_SIZE 16 // 语法分析最多领先这么多个声明
+
+typedef struct {
+  ASTNode *decl; // NULL 表示文件结束
+  int parse_error;
+} Item;
+
+/**
+ * 语法分析线程和调用线程之间的有界队列
+ */
+typedef struct {
+  const char *source;
+  DiagHandler diag;
+  const MemoryAllocator *allocator;
+
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  Item items[QUEUE_SIZE];
+  int head;
+  int count;
+} Queue;
+
+static void push(Queue *queue, ASTNode *decl, int parse_error) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == QUEUE_SIZE)
+    pthread_cond_wait(&queue->not_full, &queue->lock);
+  Item *item = &queue->items[(queue->head + queue->count) % QUEUE_SIZE];
+  item->decl = decl;
+  item->parse_error = parse_error;
+  queue->count++;
+  pthread_cond_signal(&queue->not_empty);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+static Item pop(Queue *queue) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == 0)
+    pthread_cond_wait(&queue->not_empty, &queue->lock);
+  Item item = queue->items[queue->head];
+  queue->head = (queue->head + 1) % QUEUE_SIZE;
+  queue->count--;
+  pthread_cond_signal(&queue->not_full);
+  pthread_mutex_unlock(&queue->lock);
+  return item;
+}
+
+/**
+ * 语法分析线程：用调用线程的诊断输出和分配器（AST 在调用线程上释放）
+ */
+static void *parse_main(void *arg) {
+  Queue *queue = (Queue *)arg;
+  diag_set_handler(queue->diag);
+  memory_set_allocator(queue->allocator);
+
+  Lexer lexer = lexer_init(queue->source);
+  Parser parser = parser_init(&lexer);
+  ASTNode *decl;
+  do {
+    decl = parser_next_declaration(&parser);
+    push(queue, decl, parser_had_error(&parser));
+  } while (decl);
+  return NULL;
+}
+
+/**
+ * 流水线：另一个线程做语法分析，调用线程处理队列里的声明；
+ * 创建线程失败时返回 -1，由调用者顺序执行
+ */
+static int run_pipeline(const char *source, Consumer *consumer) {
+  Queue queue;
+  queue.source = source;
+  // 只能通过换上再换回来读到当前线程的设置
+  DiagHandler to_stderr = {NULL, NULL};
+  queue.diag = diag_set_handler(to_stderr);
+  diag_set_handler(queue.diag);
+  queue.allocator = memory_set_allocator(NULL);
+  memory_set_allocator(queue.allocator);
+  pthread_mutex_init(&queue.lock, NULL);
+  pthread_cond_init(&queue.not_empty, NULL);
+  pthread_cond_init(&queue.not_full, NULL);
+  queue.head = 0;
+  queue.count = 0;
+
+  int status = 0;
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, parse_main, &queue) != 0) {
+    status = -1;
+  } else {
+    // parse-wait 是等语法分析线程的时间，接近 0 说明瓶颈在这一侧
+    Item item;
+    for (;;) {
+      time_report_start(consumer->report);
+      item = pop(&queue);
+      time_report_stop(consumer->report, "parse-wait");
+      if (!item.decl)
+        break;
+      accept(consumer, item.decl, item.parse_error);
+    }
+    if (item.parse_error)
+      consumer->stats->parse_error = 1;
+    pthread_join(thread, NULL);
+  }
+
+  pthread_cond_destroy(&queue.not_full);
+  pthread_cond_destroy(&queue.not_empty);
+  pthread_mutex_destroy(&queue.lock);
+  return status;
+}
+
+#endif // STREAM_THREADS
+
+IRProgram *stream_front_end(const char *source, SemanticAnalyzer *analyzer,
+                            int pipeline, TimeReport *report,
+                            StreamStats *stats) {
+  stats->parse_error = 0;
+  stats->declarations = 0;
+  stats->nodes = 0;
+  stats->max_nodes = 0;
+
+  Consumer consumer;
+  consumer.analyzer = analyzer;
+  consumer.ir = ir_program_create();
+  consumer.report = report;
+  consumer.stats = stats;
+
+#if STREAM_THREADS
+  if (pipeline && run_pipeline(source, &consumer) == 0)
+    return consumer.ir;
+#else
+  (void)pipeline;
+#endif
+  run_sequential(source, &consumer);
+  return consumer.ir;
+}
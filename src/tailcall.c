@@ -0,0 +1,250 @@
+/**
+ * tailcall.c - 尾调用优化实现
+ *
+ * 自递归尾调用：
+ *   function fact:            function fact:
+ *   arg n                     arg n
+ *   ...                       L_entry:
+ *   param t1           →      ...
+ *   t2 = call fact, 1         t3 = t1
+ *   return t2                 n = t3
+ *                             goto L_entry
+ *
+ * 实参先保存到新的临时变量，再统一赋给形参，
+ * 避免 f(b, a) 这样的调用在赋值过程中互相覆盖。
+ */
+
+#include "../include/tailcall.h"
+#include "../include/memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 调用点的分类
+#define CALL_NORMAL 0
+#define CALL_SELF_TAIL 1  // 自递归尾调用 → 循环
+#define CALL_OTHER_TAIL 2 // 其他尾调用 → IR_TAILCALL
+
+/**
+ * 函数里标签 label 的下标，没有时返回 -1
+ */
+static int find_label(IRProgram *program, IRFunction *func, int label) {
+  for (int i = func->begin + 1; i < func->end; i++) {
+    IRInstruction *instr = &program->instructions[i];
+    if (instr->opcode == IR_LABEL && instr->result.value.label_id == label)
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * 判断下标为 i 的 call 是否是尾调用：从它往后只经过标签、跳转和把结果
+ * 复制到另一个临时变量的赋值，就到了返回这个结果的 return，或者函数结束。
+ *
+ * 内联之后常见这种形状（被内联的 return 变成了赋值和跳转）：
+ *   t61 = call loop, 2
+ *   t23 = t61
+ *   goto L12
+ *   ...
+ * L12:
+ *   return t23
+ * 这条路径一定走到 return，所以改写之后中间的赋值不会再执行，
+ * 调用的结果也不会在别的地方被用到。
+ */
+static int is_tail_call(IRProgram *program, int i, IRFunction *func) {
+  IRInstruction *call = &program->instructions[i];
+  int value = call->result.type == OPERAND_TEMP ? call->result.value.temp_id
+                                                : -1;
+
+  // 限制步数，跳转成环时不会一直走下去
+  int j = i + 1;
+  for (int steps = func->end - func->begin; steps > 0; steps--) {
+    // 落到函数末尾：隐式的 return
+    if (j >= func->end)
+      return 1;
+
+    IRInstruction *next = &program->instructions[j];
+    switch (next->opcode) {
+    case IR_LABEL:
+    case IR_NOP:
+      j++;
+      break;
+
+    case IR_GOTO:
+      j = find_label(program, func, next->result.value.label_id);
+      if (j < 0)
+        return 0;
+      break;
+
+    case IR_ASSIGN:
+      if (value < 0 || next->arg1.type != OPERAND_TEMP ||
+          next->arg1.value.temp_id != value ||
+          next->result.type != OPERAND_TEMP)
+        return 0;
+      value = next->result.value.temp_id;
+      j++;
+      break;
+
+    case IR_RETURN:
+      if (next->arg1.type == OPERAND_NONE)
+        return 1;
+      return next->arg1.type == OPERAND_TEMP && value >= 0 &&
+             next->arg1.value.temp_id == value;
+
+    default:
+      return 0;
+    }
+  }
+  return 0;
+}
+
+/**
+ * 给函数中的每个 call 分类，返回是否存在自递归尾调用
+ */
+static int classify_calls(IRProgram *program, IRFunction *func, int *kinds) {
+  int has_self = 0;
+
+  for (int i = func->begin + 1; i < func->end; i++) {
+    IRInstruction *instr = &program->instructions[i];
+    kinds[i - func->begin] = CALL_NORMAL;
+    if (instr->opcode != IR_CALL || !is_tail_call(program, i, func))
+      continue;
+
+    if (strcmp(instr->arg1.value.name, func->name) == 0 &&
+        instr->arg_count == func->param_count) {
+      kinds[i - func->begin] = CALL_SELF_TAIL;
+      has_self = 1;
+    } else {
+      kinds[i - func->begin] = CALL_OTHER_TAIL;
+    }
+  }
+
+  return has_self;
+}
+
+static void copy_instruction(IRProgram *out, IRInstruction *instr) {
+  IRInstruction copy = *instr;
+  copy.result = ir_operand_copy(instr->result);
+  copy.arg1 = ir_operand_copy(instr->arg1);
+  copy.arg2 = ir_operand_copy(instr->arg2);
+  ir_emit_instruction(out, copy);
+}
+
+/**
+ * 复制一个函数，同时改写其中的尾调用
+ */
+static void rewrite_function(IRProgram *program, IRProgram *out,
+                             IRFunction *func, TailCallStats *stats) {
+  int length = func->end - func->begin + 1;
+  int *kinds = (int *)calloc(length, sizeof(int));
+  int has_self = classify_calls(program, func, kinds);
+
+  // FUNC_BEGIN 和形参
+  int body_begin = func->begin + 1 + func->param_count;
+  for (int i = func->begin; i < body_begin; i++)
+    copy_instruction(out, &program->instructions[i]);
+
+  // 自递归尾调用跳回这里
+  int entry_label = -1;
+  if (has_self) {
+    entry_label = ir_new_label(out);
+    ir_emit(out, IR_LABEL, ir_operand_label(entry_label), ir_operand_none(),
+            ir_operand_none());
+  }
+
+  // 输出程序中还没有被 call 消耗的 param 指令
+  int *pending = (int *)malloc(sizeof(int) * (length + 1));
+  int pending_count = 0;
+  int skip_return = 0;
+
+  for (int i = body_begin; i <= func->end && i < program->count; i++) {
+    IRInstruction *instr = &program->instructions[i];
+
+    if (skip_return && instr->opcode == IR_RETURN) {
+      // 紧跟在 tailcall 后面的 return 不会再被执行
+      skip_return = 0;
+      continue;
+    }
+    skip_return = 0;
+
+    if (instr->opcode == IR_PARAM) {
+      copy_instruction(out, instr);
+      pending[pending_count++] = out->count - 1;
+      continue;
+    }
+
+    if (instr->opcode != IR_CALL && instr->opcode != IR_TAILCALL) {
+      copy_instruction(out, instr);
+      continue;
+    }
+
+    int n = instr->arg_count <= pending_count ? instr->arg_count : pending_count;
+    pending_count -= n;
+    int *params = pending + pending_count;
+    int kind = kinds[i - func->begin];
+
+    if (kind == CALL_SELF_TAIL) {
+      // 实参 → 新的临时变量（在 param 的位置求值）
+      IROperand *temps = (IROperand *)malloc(sizeof(IROperand) * (n + 1));
+      for (int k = 0; k < n; k++) {
+        temps[k] = ir_new_temp(out);
+        IRInstruction *param = &out->instructions[params[k]];
+        param->opcode = IR_ASSIGN;
+        param->result = temps[k];
+      }
+
+      // 临时变量 → 形参，然后跳回函数开头
+      for (int k = 0; k < n; k++) {
+        IRInstruction *arg = &program->instructions[func->begin + 1 + k];
+        ir_emit(out, IR_ASSIGN, ir_operand_copy(arg->result), temps[k],
+                ir_operand_none());
+      }
+      ir_emit(out, IR_GOTO, ir_operand_label(entry_label), ir_operand_none(),
+              ir_operand_none());
+      free(temps);
+      stats->self_calls++;
+    } else if (kind == CALL_OTHER_TAIL) {
+      IRInstruction tail = *instr;
+      tail.opcode = IR_TAILCALL;
+      tail.result = ir_operand_none();
+      tail.arg1 = ir_operand_copy(instr->arg1);
+      tail.arg2 = ir_operand_none();
+      ir_emit_instruction(out, tail);
+      skip_return = 1;
+      stats->other_calls++;
+    } else {
+      copy_instruction(out, instr);
+    }
+  }
+
+  free(pending);
+  free(kinds);
+}
+
+TailCallStats ir_optimize_tail_calls(IRProgram *program) {
+  TailCallStats stats = {0, 0};
+  if (!program)
+    return stats;
+
+  IRFunction *functions = NULL;
+  int func_count = ir_collect_functions(program, &functions);
+
+  IRProgram *out = ir_program_create();
+  out->temp_counter = program->temp_counter;
+  out->label_counter = program->label_counter;
+
+  int f = 0;
+  for (int i = 0; i < program->count; i++) {
+    if (f < func_count && i == functions[f].begin) {
+      rewrite_function(program, out, &functions[f], &stats);
+      i = functions[f].end;
+      f++;
+    } else {
+      // 函数之外的指令（全局变量初始化）
+      copy_instruction(out, &program->instructions[i]);
+    }
+  }
+
+  free(functions);
+  ir_program_replace(program, out);
+  return stats;
+}
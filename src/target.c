@@ -0,0 +1,54 @@
+/**
+ * target.c - 目标机器描述实现
+ */
+
+#include "../include/target.h"
+
+const X86Reg INT_ARG_REGS[INT_ARG_REG_COUNT] = {REG_RDI, REG_RSI, REG_RDX,
+                                                REG_RCX, REG_R8,  REG_R9};
+
+static const char *names64[16] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp",
+                                  "rsi", "rdi", "r8",  "r9",  "r10", "r11",
+                                  "r12", "r13", "r14", "r15"};
+static const char *names32[16] = {"eax",  "ecx",  "edx",  "ebx",
+                                  "esp",  "ebp",  "esi",  "edi",
+                                  "r8d",  "r9d",  "r10d", "r11d",
+                                  "r12d", "r13d", "r14d", "r15d"};
+static const char *names8[16] = {"al",   "cl",   "dl",   "bl",
+                                 "spl",  "bpl",  "sil",  "dil",
+                                 "r8b",  "r9b",  "r10b", "r11b",
+                                 "r12b", "r13b", "r14b", "r15b"};
+static const char *xmm_names[16] = {
+    "xmm0", "xmm1", "xmm2",  "xmm3",  "xmm4",  "xmm5",  "xmm6",  "xmm7",
+    "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15"};
+
+const char *x86_reg_name(X86Reg reg, int size) {
+  if (reg < 0 || reg >= REG_COUNT)
+    return "?";
+  if (x86_is_float_reg(reg))
+    return xmm_names[reg - REG_XMM0];
+  switch (size) {
+  case 1:
+    return names8[reg];
+  case 4:
+    return names32[reg];
+  default:
+    return names64[reg];
+  }
+}
+
+int x86_is_float_reg(X86Reg reg) { return reg >= REG_XMM0 && reg <= REG_XMM15; }
+
+int x86_is_callee_saved(X86Reg reg) {
+  switch (reg) {
+  case REG_RBX:
+  case REG_RBP:
+  case REG_R12:
+  case REG_R13:
+  case REG_R14:
+  case REG_R15:
+    return 1;
+  default:
+    return 0;
+  }
+}
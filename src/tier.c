@@ -0,0 +1,233 @@
+/**
+ * tier.c - 分层执行实现
+ */
+
+#include "../include/tier.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_INT_ARGS 6   // rdi, rsi, rdx, rcx, r8, r9
+#define MAX_FLOAT_ARGS 8 // xmm0..xmm7
+
+// 本地函数的统一调用形式：整数和浮点实参分别按顺序放进各自的寄存器
+typedef int (*IntEntry)(long, long, long, long, long, long, double, double,
+                        double, double, double, double, double, double);
+typedef double (*FloatEntry)(long, long, long, long, long, long, double,
+                             double, double, double, double, double, double,
+                             double);
+
+static void add_event(Tier *tier, int func, VMTier to, const char *reason) {
+  if (tier->event_count >= tier->event_capacity) {
+    tier->event_capacity =
+        tier->event_capacity == 0 ? 8 : tier->event_capacity * 2;
+    tier->events = (TierEvent *)realloc(
+        tier->events, sizeof(TierEvent) * tier->event_capacity);
+  }
+  TierEvent *event = &tier->events[tier->event_count++];
+  event->func = func;
+  event->tier = to;
+  event->calls = tier->vm->calls[func];
+  event->back_edges = tier->vm->back_edges[func];
+  event->reason = reason;
+}
+
+/**
+ * 第一次有函数变热时编译整个程序
+ */
+static void compile_program(Tier *tier) {
+  clock_t start = clock();
+  tier->jit = jit_compile(tier->ir);
+  tier->compile_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  if (!tier->jit) {
+    tier->jit_failed = 1;
+    return;
+  }
+
+  const BCProgram *bc = tier->vm->program;
+  for (int i = 0; i < bc->global_count; i++)
+    tier->global_addresses[i] =
+        jit_lookup_global(tier->jit, bc->global_names[i]);
+}
+
+static VMTier on_hot(void *context, int func) {
+  Tier *tier = (Tier *)context;
+  const BCProgram *bc = tier->vm->program;
+
+  if (func == bc->init_function) {
+    add_event(tier, func, VM_TIER_PINNED, "global initializer");
+    return VM_TIER_PINNED;
+  }
+  if (!tier->jit && !tier->jit_failed)
+    compile_program(tier);
+  if (tier->jit_failed) {
+    add_event(tier, func, VM_TIER_PINNED, "JIT unavailable");
+    return VM_TIER_PINNED;
+  }
+
+  int ints = 0, floats = 0;
+  for (int i = 0; i < tier->param_counts[func]; i++) {
+    if (tier->param_types[func][i] == IR_TYPE_FLOAT)
+      floats++;
+    else
+      ints++;
+  }
+  if (ints > MAX_INT_ARGS || floats > MAX_FLOAT_ARGS) {
+    add_event(tier, func, VM_TIER_PINNED, "arguments passed on the stack");
+    return VM_TIER_PINNED;
+  }
+
+  tier->entries[func] = jit_lookup(tier->jit, bc->functions[func].name);
+  if (!tier->entries[func]) {
+    add_event(tier, func, VM_TIER_PINNED, "no native code");
+    return VM_TIER_PINNED;
+  }
+  add_event(tier, func, VM_TIER_NATIVE, NULL);
+  return VM_TIER_NATIVE;
+}
+
+/**
+ * 解释器和本地代码交换全局变量：to_native 为真时解释器 → .data
+ */
+static void sync_globals(Tier *tier, int to_native) {
+  const BCProgram *bc = tier->vm->program;
+  VMValue *globals = tier->vm->globals;
+  for (int i = 0; i < bc->global_count; i++) {
+    void *address = tier->global_addresses[i];
+    if (!address)
+      continue;
+    if (bc->global_types[i] == IR_TYPE_FLOAT) {
+      if (to_native)
+        memcpy(address, &globals[i].f, sizeof(double));
+      else
+        memcpy(&globals[i].f, address, sizeof(double));
+    } else {
+      if (to_native)
+        memcpy(address, &globals[i].i, sizeof(int32_t));
+      else
+        memcpy(&globals[i].i, address, sizeof(int32_t));
+    }
+  }
+}
+
+static int call_native(void *context, int func, const VMValue *args,
+                       VMValue *result) {
+  Tier *tier = (Tier *)context;
+  long ints[MAX_INT_ARGS] = {0};
+  double floats[MAX_FLOAT_ARGS] = {0};
+  int int_count = 0, float_count = 0;
+  for (int i = 0; i < tier->param_counts[func]; i++) {
+    if (tier->param_types[func][i] == IR_TYPE_FLOAT)
+      floats[float_count++] = args[i].f;
+    else
+      ints[int_count++] = args[i].i;
+  }
+
+  sync_globals(tier, 1);
+  // 对象指针和函数指针之间的转换：和 jit_run_main 一样用 memcpy
+  if (tier->vm->program->functions[func].return_type == IR_TYPE_FLOAT) {
+    FloatEntry entry;
+    memcpy(&entry, &tier->entries[func], sizeof(entry));
+    result->f = entry(ints[0], ints[1], ints[2], ints[3], ints[4], ints[5],
+                      floats[0], floats[1], floats[2], floats[3], floats[4],
+                      floats[5], floats[6], floats[7]);
+  } else {
+    IntEntry entry;
+    memcpy(&entry, &tier->entries[func], sizeof(entry));
+    result->i = entry(ints[0], ints[1], ints[2], ints[3], ints[4], ints[5],
+                      floats[0], floats[1], floats[2], floats[3], floats[4],
+                      floats[5], floats[6], floats[7]);
+  }
+  sync_globals(tier, 0);
+  return 0;
+}
+
+Tier *tier_attach(VM *vm, IRProgram *ir, uint32_t threshold) {
+  const BCProgram *bc = vm->program;
+  Tier *tier = (Tier *)calloc(1, sizeof(Tier));
+  tier->ir = ir;
+  tier->vm = vm;
+
+  int count = bc->func_count ? bc->func_count : 1;
+  tier->entries = (void **)calloc(count, sizeof(void *));
+  tier->param_types = (IRValueType **)calloc(count, sizeof(IRValueType *));
+  tier->param_counts = (int *)calloc(count, sizeof(int));
+  tier->global_addresses = (void **)calloc(
+      bc->global_count ? bc->global_count : 1, sizeof(void *));
+
+  // 形参类型在 IR 的 ARG 上
+  IRFunction *functions = NULL;
+  int func_count = ir_collect_functions(ir, &functions);
+  for (int f = 0; f < func_count; f++) {
+    int index = bc_find_function(bc, functions[f].name);
+    if (index < 0)
+      continue;
+    int params = functions[f].param_count;
+    tier->param_counts[index] = params;
+    tier->param_types[index] =
+        (IRValueType *)malloc(sizeof(IRValueType) * (params ? params : 1));
+    for (int i = 0; i < params; i++)
+      tier->param_types[index][i] =
+          ir->instructions[functions[f].begin + 1 + i].result.vtype;
+  }
+  free(functions);
+
+  VMTierHooks hooks;
+  hooks.threshold = threshold;
+  hooks.on_hot = on_hot;
+  hooks.call_native = call_native;
+  hooks.context = tier;
+  vm_enable_tiering(vm, hooks);
+  return tier;
+}
+
+void tier_free(Tier *tier) {
+  if (!tier)
+    return;
+  jit_free(tier->jit);
+  for (int f = 0; f < tier->vm->program->func_count; f++)
+    free(tier->param_types[f]);
+  free(tier->param_types);
+  free(tier->param_counts);
+  free(tier->entries);
+  free(tier->global_addresses);
+  free(tier->events);
+  free(tier);
+}
+
+static const char *tier_name(VMTier tier) {
+  switch (tier) {
+  case VM_TIER_NATIVE: return "native";
+  case VM_TIER_PINNED: return "pinned";
+  default: return "interpreted";
+  }
+}
+
+void tier_print_stats(const Tier *tier) {
+  const VM *vm = tier->vm;
+  const BCProgram *bc = vm->program;
+
+  printf("Tiered execution (threshold %u):\n", vm->hooks.threshold);
+  printf("  %-20s %10s %12s %13s  %s\n", "function", "calls", "back-edges",
+         "native calls", "tier");
+  for (int f = 0; f < bc->func_count; f++) {
+    printf("  %-20s %10u %12u %13llu  %s\n", bc->functions[f].name,
+           vm->calls[f], vm->back_edges[f],
+           (unsigned long long)vm->native_calls[f],
+           tier_name((VMTier)vm->tiers[f]));
+  }
+
+  if (tier->jit)
+    printf("  JIT compile: %.1f us\n", tier->compile_seconds * 1e6);
+  for (int i = 0; i < tier->event_count; i++) {
+    const TierEvent *event = &tier->events[i];
+    printf("  #%d %s -> %s after %u calls, %u back-edges", i + 1,
+           bc->functions[event->func].name, tier_name(event->tier),
+           event->calls, event->back_edges);
+    if (event->reason)
+      printf(" (%s)", event->reason);
+    printf("\n");
+  }
+}
@@ -0,0 +1,179 @@
+/**
+ * timing.c - 各阶段的耗时和内存报告实现
+ */
+
+#define _DEFAULT_SOURCE  // clock_gettime、getrusage
+#define MEMORY_UNCOUNTED // 报告自己的分配不算进任何阶段
+
+#include "../include/timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+static TimingSample sample(void) {
+  TimingSample s;
+#ifdef _WIN32
+  s.wall = s.cpu = (double)clock() / CLOCKS_PER_SEC;
+  s.rss_kb = 0;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  s.wall = ts.tv_sec + ts.tv_nsec / 1e9;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  s.cpu = ts.tv_sec + ts.tv_nsec / 1e9;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  s.rss_kb = usage.ru_maxrss / 1024; // macOS 以字节为单位
+#else
+  s.rss_kb = usage.ru_maxrss;
+#endif
+#endif
+  s.memory = memory_stats();
+  return s;
+}
+
+long time_report_peak_rss(void) { return sample().rss_kb; }
+
+TimeReport *time_report_create(void) {
+  TimeReport *report = (TimeReport *)calloc(1, sizeof(TimeReport));
+  report->last = -1;
+  // 第一次读时钟和 getrusage 明显更慢，先读一次，不让它算进第一个阶段
+  report->start = sample();
+  return report;
+}
+
+void time_report_free(TimeReport *report) {
+  if (!report)
+    return;
+  free(report->phases);
+  free(report);
+}
+
+void time_report_start(TimeReport *report) {
+  if (report)
+    report->start = sample();
+}
+
+void time_report_stop(TimeReport *report, const char *name) {
+  if (!report)
+    return;
+  TimingSample end = sample();
+
+  int index = 0;
+  while (index < report->count &&
+         strcmp(report->phases[index].name, name) != 0)
+    index++;
+  if (index == report->count) {
+    if (report->count >= report->capacity) {
+      report->capacity = report->capacity == 0 ? 16 : report->capacity * 2;
+      report->phases = (PhaseTiming *)realloc(
+          report->phases, sizeof(PhaseTiming) * report->capacity);
+    }
+    memset(&report->phases[index], 0, sizeof(PhaseTiming));
+    report->phases[index].name = name;
+    report->count++;
+  }
+
+  PhaseTiming *phase = &report->phases[index];
+  phase->runs++;
+  phase->wall += end.wall - report->start.wall;
+  phase->cpu += end.cpu - report->start.cpu;
+  phase->rss_delta_kb += end.rss_kb - report->start.rss_kb;
+  phase->allocations +=
+      end.memory.allocations - report->start.memory.allocations;
+  phase->bytes += end.memory.bytes - report->start.memory.bytes;
+  report->last = index;
+}
+
+void time_report_items(TimeReport *report, long items, const char *unit) {
+  if (!report || report->last < 0)
+    return;
+  report->phases[report->last].items += items;
+  report->phases[report->last].unit = unit;
+}
+
+static PhaseTiming total_of(const TimeReport *report) {
+  PhaseTiming total;
+  memset(&total, 0, sizeof(total));
+  total.name = "total";
+  for (int i = 0; i < report->count; i++) {
+    const PhaseTiming *phase = &report->phases[i];
+    total.runs += phase->runs;
+    total.wall += phase->wall;
+    total.cpu += phase->cpu;
+    total.rss_delta_kb += phase->rss_delta_kb;
+    total.allocations += phase->allocations;
+    total.bytes += phase->bytes;
+  }
+  return total;
+}
+
+static void print_row(const PhaseTiming *phase) {
+  printf("  %-16s %5d %10.3f %10.3f %8ld %9llu %10.1f", phase->name,
+         phase->runs, phase->wall * 1e3, phase->cpu * 1e3, phase->rss_delta_kb,
+         (unsigned long long)phase->allocations, phase->bytes / 1024.0);
+  if (phase->unit)
+    printf("  %ld %s", phase->items, phase->unit);
+  printf("\n");
+}
+
+void time_report_print(const TimeReport *report) {
+  if (!report)
+    return;
+  printf("Time report:\n");
+  printf("  %-16s %5s %10s %10s %8s %9s %10s  %s\n", "phase", "runs",
+         "wall(ms)", "cpu(ms)", "rss(KB)", "allocs", "alloc(KB)", "items");
+  for (int i = 0; i < report->count; i++)
+    print_row(&report->phases[i]);
+  PhaseTiming total = total_of(report);
+  print_row(&total);
+  printf("  peak RSS %ld KB\n", time_report_peak_rss());
+}
+
+static void write_phase(FILE *out, const PhaseTiming *phase) {
+  fprintf(out,
+          "{\"name\": \"%s\", \"runs\": %d, \"wall_ms\": %.6f, "
+          "\"cpu_ms\": %.6f, \"rss_delta_kb\": %ld, \"allocations\": %llu, "
+          "\"allocated_bytes\": %llu",
+          phase->name, phase->runs, phase->wall * 1e3, phase->cpu * 1e3,
+          phase->rss_delta_kb, (unsigned long long)phase->allocations,
+          (unsigned long long)phase->bytes);
+  if (phase->unit)
+    fprintf(out, ", \"items\": %ld, \"unit\": \"%s\"", phase->items,
+            phase->unit);
+  fprintf(out, "}");
+}
+
+int time_report_write_json(const TimeReport *report, const char *path) {
+  if (!report)
+    return 0;
+  int to_stdout = strcmp(path, "-") == 0;
+  FILE *out = to_stdout ? stdout : fopen(path, "w");
+  if (!out) {
+    fprintf(stderr, "Error: Cannot write file '%s'\n", path);
+    return 1;
+  }
+
+  fprintf(out, "{\n  \"phases\": [\n");
+  for (int i = 0; i < report->count; i++) {
+    fprintf(out, "    ");
+    write_phase(out, &report->phases[i]);
+    fprintf(out, i + 1 < report->count ? ",\n" : "\n");
+  }
+  PhaseTiming total = total_of(report);
+  fprintf(out, "  ],\n  \"total\": ");
+  write_phase(out, &total);
+  fprintf(out, ",\n  \"peak_rss_kb\": %ld\n}\n", time_report_peak_rss());
+
+  if (!to_stdout && fclose(out) != 0) {
+    fprintf(stderr, "Error: Cannot write file '%s'\n", path);
+    return 1;
+  }
+  return 0;
+}
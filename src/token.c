@@ -43,3 +43,14 @@ const char* token_type_to_string(TokenType type) {
 void print_token(Token token) {
     printf("[%-12s] \"%s\"\n", token_type_to_string(token.type), token.value);
 }
+
+/**
+ * token_dump - 和 print_token 格式相同，经过 out 的缓冲区输出
+ */
+void token_dump(const Token *token, Writer *out) {
+    writer_putc(out, '[');
+    writer_puts_width(out, token_type_to_string(token->type), 12);
+    writer_puts(out, "] \"");
+    writer_puts(out, token->value);
+    writer_puts(out, "\"\n");
+}
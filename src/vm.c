@@ -0,0 +1,512 @@
+/**
+ * vm.c - 字节码解释器实现
+ */
+
+#include "../include/vm.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+VM *vm_create(const BCProgram *program) {
+  VM *vm = (VM *)calloc(1, sizeof(VM));
+  vm->program = program;
+  vm->stack = (VMValue *)calloc(VM_STACK_SLOTS, sizeof(VMValue));
+  vm->globals = (VMValue *)calloc(
+      program->global_count ? program->global_count : 1, sizeof(VMValue));
+  vm->args = (VMValue *)malloc(sizeof(VMValue) * VM_MAX_ARGS);
+  vm->frames = (VMFrame *)malloc(sizeof(VMFrame) * VM_MAX_FRAMES);
+  return vm;
+}
+
+void vm_free(VM *vm) {
+  if (!vm)
+    return;
+  free(vm->stack);
+  free(vm->globals);
+  free(vm->args);
+  free(vm->frames);
+  free(vm->pair_counts);
+  free(vm->calls);
+  free(vm->back_edges);
+  free(vm->native_calls);
+  free(vm->tiers);
+  free(vm);
+}
+
+void vm_enable_profile(VM *vm) {
+  if (!vm->pair_counts)
+    vm->pair_counts = (uint64_t *)calloc(BC_OPCODE_COUNT * BC_OPCODE_COUNT,
+                                         sizeof(uint64_t));
+}
+
+void vm_enable_tiering(VM *vm, VMTierHooks hooks) {
+  int count = vm->program->func_count ? vm->program->func_count : 1;
+  vm->hooks = hooks;
+  if (!vm->tiers) {
+    vm->calls = (uint32_t *)calloc(count, sizeof(uint32_t));
+    vm->back_edges = (uint32_t *)calloc(count, sizeof(uint32_t));
+    vm->native_calls = (uint64_t *)calloc(count, sizeof(uint64_t));
+    vm->tiers = (unsigned char *)calloc(count, sizeof(unsigned char));
+  }
+}
+
+/**
+ * 函数的热度（调用 + 回边）到达阈值：请求编译，只请求一次
+ */
+static void become_hot(VM *vm, int func) {
+  if (vm->tiers[func] == VM_TIER_INTERPRETED)
+    vm->tiers[func] = (unsigned char)vm->hooks.on_hot(vm->hooks.context, func);
+}
+
+static void runtime_error(const BCProgram *program, const int32_t *pc,
+                          const char *message) {
+  int offset = (int)(pc - program->code);
+  const char *name = "?";
+  for (int f = 0; f < program->func_count; f++) {
+    if (program->functions[f].entry <= offset)
+      name = program->functions[f].name;
+  }
+  fprintf(stderr, "Runtime error: %s (in %s at %d)\n", message, name, offset);
+}
+
+// 和 cvttsd2si 一样：NaN 和超出范围的值变成 INT_MIN
+static int32_t float_to_int(double value) {
+  if (value >= -2147483648.0 && value < 2147483648.0)
+    return (int32_t)value;
+  return INT32_MIN;
+}
+
+// 整数运算按 32 位补码回绕
+static int32_t wrap(uint32_t value) { return (int32_t)value; }
+
+int vm_call(VM *vm, int func, const VMValue *args, int arg_count,
+            VMValue *result) {
+  const BCProgram *program = vm->program;
+  const BCFunction *functions = program->functions;
+  const int32_t *code = program->code;
+  const double *floats = program->floats;
+  VMValue *globals = vm->globals;
+  VMValue *stack_end = vm->stack + VM_STACK_SLOTS;
+  VMValue *arg_top = vm->args;
+  VMValue *arg_end = vm->args + VM_MAX_ARGS;
+  VMFrame *frames = vm->frames;
+  int depth = 0;
+  uint64_t executed = 0;
+  uint64_t *pair_counts = vm->pair_counts;
+  int previous = BC_NOP;
+
+  unsigned char *tiers = vm->tiers;
+  uint32_t *calls = vm->calls;
+  uint32_t *back_edges = vm->back_edges;
+  uint32_t threshold = vm->hooks.threshold;
+  if (tiers) {
+    if (++calls[func] + back_edges[func] == threshold)
+      become_hot(vm, func);
+    if (tiers[func] == VM_TIER_NATIVE) {
+      vm->native_calls[func]++;
+      return vm->hooks.call_native(vm->hooks.context, func, args, result);
+    }
+  }
+  int current = func;
+
+  const BCFunction *entry = &functions[func];
+  if (entry->frame_size > VM_STACK_SLOTS) {
+    runtime_error(program, code + entry->entry, "stack overflow");
+    return 1;
+  }
+  VMValue *base = vm->stack;
+  int frame_size = entry->frame_size;
+  if (arg_count > 0)
+    memcpy(base, args, sizeof(VMValue) * arg_count);
+  const int32_t *pc = code + entry->entry;
+  VMValue value;
+
+#define A pc[1]
+#define B pc[2]
+#define C pc[3]
+#define R(x) base[x]
+
+#if VM_COMPUTED_GOTO
+  // 统计指令对时换一张表：每个操作码都先跳到 profile，不统计时没有额外开销
+#define BC_LABEL(name, format) &&op_##name,
+#define BC_PROFILE(name, format) &&profile,
+  static void *const dispatch_table[BC_OPCODE_COUNT] = {BC_OPCODES(BC_LABEL)};
+  static void *const profile_table[BC_OPCODE_COUNT] = {BC_OPCODES(BC_PROFILE)};
+#undef BC_LABEL
+#undef BC_PROFILE
+  void *const *table = pair_counts ? profile_table : dispatch_table;
+#define CASE(name) op_##name:
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    executed++;                                                                \
+    goto *table[*pc];                                                          \
+  } while (0)
+#else
+#define CASE(name) case BC_##name:
+#define DISPATCH() goto dispatch
+#endif
+// 跳转；分层执行时向后跳转算一次回边
+#define JUMP(target)                                                           \
+  do {                                                                         \
+    const int32_t *target_pc = code + (target);                                \
+    if (tiers && target_pc <= pc &&                                            \
+        ++back_edges[current] + calls[current] == threshold)                   \
+      become_hot(vm, current);                                                 \
+    pc = target_pc;                                                            \
+    DISPATCH();                                                                \
+  } while (0)
+// 跳过当前指令（操作码 + n 个操作数）
+#define NEXT(n)                                                                \
+  do {                                                                         \
+    pc += (n) + 1;                                                             \
+    DISPATCH();                                                                \
+  } while (0)
+
+#define INT_BINARY(name, expr)                                                 \
+  CASE(name) {                                                                 \
+    int32_t x = R(B).i, y = R(C).i;                                            \
+    R(A).i = (expr);                                                           \
+    NEXT(3);                                                                   \
+  }
+#define FLOAT_BINARY(name, expr)                                               \
+  CASE(name) {                                                                 \
+    double x = R(B).f, y = R(C).f;                                             \
+    R(A).f = (expr);                                                           \
+    NEXT(3);                                                                   \
+  }
+#define INT_IMMEDIATE(name, expr)                                              \
+  CASE(name) {                                                                 \
+    int32_t x = R(B).i, y = C;                                                 \
+    R(A).i = (expr);                                                           \
+    NEXT(3);                                                                   \
+  }
+#define FLOAT_CONSTANT(name, expr)                                             \
+  CASE(name) {                                                                 \
+    double x = R(B).f, y = floats[C];                                          \
+    R(A).f = (expr);                                                           \
+    NEXT(3);                                                                   \
+  }
+// 比较 + 分支：y 是槽位或立即数
+#define COMPARE_BRANCH(name, y_value, cmp)                                     \
+  CASE(name) {                                                                 \
+    int32_t x = R(A).i, y = (y_value);                                         \
+    if (x cmp y)                                                               \
+      JUMP(C);                                                                 \
+    NEXT(3);                                                                   \
+  }
+#define FLOAT_COMPARE(name, expr)                                              \
+  CASE(name) {                                                                 \
+    double x = R(B).f, y = R(C).f;                                             \
+    R(A).i = (expr);                                                           \
+    NEXT(3);                                                                   \
+  }
+
+#if VM_COMPUTED_GOTO
+  DISPATCH();
+profile:
+  pair_counts[previous * BC_OPCODE_COUNT + *pc]++;
+  previous = *pc;
+  goto *dispatch_table[*pc];
+#else
+dispatch:
+  executed++;
+  if (pair_counts) {
+    pair_counts[previous * BC_OPCODE_COUNT + *pc]++;
+    previous = *pc;
+  }
+  switch ((BCOpcode)*pc) {
+#endif
+
+  CASE(NOP) { NEXT(0); }
+  CASE(MOV) {
+    R(A) = R(B);
+    NEXT(2);
+  }
+  CASE(LOADI) {
+    R(A).i = B;
+    NEXT(2);
+  }
+  CASE(LOADF) {
+    R(A).f = floats[B];
+    NEXT(2);
+  }
+  CASE(GETG) {
+    R(A) = globals[B];
+    NEXT(2);
+  }
+  CASE(SETG) {
+    globals[A] = R(B);
+    NEXT(2);
+  }
+  CASE(I2F) {
+    R(A).f = (double)R(B).i;
+    NEXT(2);
+  }
+  CASE(F2I) {
+    R(A).i = float_to_int(R(B).f);
+    NEXT(2);
+  }
+
+  INT_BINARY(ADDI, wrap((uint32_t)x + (uint32_t)y))
+  INT_BINARY(SUBI, wrap((uint32_t)x - (uint32_t)y))
+  INT_BINARY(MULI, wrap((uint32_t)x * (uint32_t)y))
+  CASE(DIVI) {
+    int32_t x = R(B).i, y = R(C).i;
+    if (y == 0)
+      goto division_by_zero;
+    R(A).i = (x == INT32_MIN && y == -1) ? INT32_MIN : x / y;
+    NEXT(3);
+  }
+  CASE(MODI) {
+    int32_t x = R(B).i, y = R(C).i;
+    if (y == 0)
+      goto division_by_zero;
+    R(A).i = (x == INT32_MIN && y == -1) ? 0 : x % y;
+    NEXT(3);
+  }
+  INT_BINARY(SHL, wrap((uint32_t)x << (y & 31)))
+  INT_BINARY(SHR, x >> (y & 31))
+  INT_BINARY(USHR, wrap((uint32_t)x >> (y & 31)))
+  INT_BINARY(BAND, x & y)
+  CASE(NEGI) {
+    R(A).i = wrap(0u - (uint32_t)R(B).i);
+    NEXT(2);
+  }
+  CASE(NOTI) {
+    R(A).i = R(B).i == 0;
+    NEXT(2);
+  }
+
+  FLOAT_BINARY(ADDF, x + y)
+  FLOAT_BINARY(SUBF, x - y)
+  FLOAT_BINARY(MULF, x * y)
+  FLOAT_BINARY(DIVF, x / y)
+  CASE(NEGF) {
+    R(A).f = -R(B).f;
+    NEXT(2);
+  }
+  CASE(NOTF) {
+    R(A).i = R(B).f == 0.0;
+    NEXT(2);
+  }
+  CASE(TRUTHF) {
+    R(A).i = R(B).f != 0.0;
+    NEXT(2);
+  }
+
+  INT_BINARY(EQI, x == y)
+  INT_BINARY(NEI, x != y)
+  INT_BINARY(LTI, x < y)
+  INT_BINARY(GTI, x > y)
+  INT_BINARY(LEI, x <= y)
+  INT_BINARY(GEI, x >= y)
+  FLOAT_COMPARE(EQF, x == y)
+  FLOAT_COMPARE(NEF, x != y)
+  FLOAT_COMPARE(LTF, x < y)
+  FLOAT_COMPARE(GTF, x > y)
+  FLOAT_COMPARE(LEF, x <= y)
+  FLOAT_COMPARE(GEF, x >= y)
+  INT_BINARY(ANDL, x != 0 && y != 0)
+  INT_BINARY(ORL, x != 0 || y != 0)
+
+  CASE(JMP) { JUMP(A); }
+  CASE(JT) {
+    if (R(A).i != 0)
+      JUMP(B);
+    NEXT(2);
+  }
+  CASE(JF) {
+    if (R(A).i == 0)
+      JUMP(B);
+    NEXT(2);
+  }
+
+  CASE(PARAM) {
+    if (arg_top == arg_end)
+      goto stack_overflow;
+    *arg_top++ = R(A);
+    NEXT(1);
+  }
+  CASE(CALL) {
+    const BCFunction *callee = &functions[B];
+    VMValue *next = base + frame_size;
+    int argc = C;
+    if (tiers) {
+      if (++calls[B] + back_edges[B] == threshold)
+        become_hot(vm, B);
+      if (tiers[B] == VM_TIER_NATIVE) {
+        vm->native_calls[B]++;
+        arg_top -= argc;
+        if (vm->hooks.call_native(vm->hooks.context, B, arg_top, &R(A)) != 0)
+          goto native_error;
+        NEXT(3);
+      }
+    }
+    if (depth == VM_MAX_FRAMES || stack_end - next < callee->frame_size)
+      goto stack_overflow;
+    memcpy(next, arg_top - argc, sizeof(VMValue) * argc);
+    arg_top -= argc;
+    frames[depth].return_pc = pc + 4;
+    frames[depth].base = base;
+    frames[depth].frame_size = frame_size;
+    frames[depth].func = current;
+    frames[depth].dst = A;
+    depth++;
+    current = B;
+    base = next;
+    frame_size = callee->frame_size;
+    pc = code + callee->entry;
+    DISPATCH();
+  }
+  CASE(RET) {
+    value = R(A);
+    goto do_return;
+  }
+  CASE(RETZ) {
+    value.f = 0.0; // 全 0：整数 0 和浮点 0.0 都是它
+    goto do_return;
+  }
+
+  // 超级指令
+  INT_IMMEDIATE(ADDIK, wrap((uint32_t)x + (uint32_t)y))
+  INT_IMMEDIATE(MULIK, wrap((uint32_t)x * (uint32_t)y))
+  INT_IMMEDIATE(DIVIK, y == -1 ? wrap(0u - (uint32_t)x) : x / y)
+  INT_IMMEDIATE(MODIK, y == -1 ? 0 : x % y)
+  INT_IMMEDIATE(EQIK, x == y)
+  INT_IMMEDIATE(NEIK, x != y)
+  INT_IMMEDIATE(LTIK, x < y)
+  INT_IMMEDIATE(GTIK, x > y)
+  INT_IMMEDIATE(LEIK, x <= y)
+  INT_IMMEDIATE(GEIK, x >= y)
+  FLOAT_CONSTANT(ADDFK, x + y)
+  FLOAT_CONSTANT(SUBFK, x - y)
+  FLOAT_CONSTANT(MULFK, x * y)
+  FLOAT_CONSTANT(DIVFK, x / y)
+  FLOAT_CONSTANT(RSUBFK, y - x)
+  FLOAT_CONSTANT(RDIVFK, y / x)
+  COMPARE_BRANCH(JEQI, R(B).i, ==)
+  COMPARE_BRANCH(JNEI, R(B).i, !=)
+  COMPARE_BRANCH(JLTI, R(B).i, <)
+  COMPARE_BRANCH(JGTI, R(B).i, >)
+  COMPARE_BRANCH(JLEI, R(B).i, <=)
+  COMPARE_BRANCH(JGEI, R(B).i, >=)
+  COMPARE_BRANCH(JEQIK, B, ==)
+  COMPARE_BRANCH(JNEIK, B, !=)
+  COMPARE_BRANCH(JLTIK, B, <)
+  COMPARE_BRANCH(JGTIK, B, >)
+  COMPARE_BRANCH(JLEIK, B, <=)
+  COMPARE_BRANCH(JGEIK, B, >=)
+
+#if !VM_COMPUTED_GOTO
+  default:
+    runtime_error(program, pc, "invalid opcode");
+    vm->executed += executed;
+    return 1;
+  }
+#endif
+
+do_return:
+  if (depth == 0) {
+    *result = value;
+    vm->executed += executed;
+    return 0;
+  }
+  depth--;
+  base = frames[depth].base;
+  frame_size = frames[depth].frame_size;
+  current = frames[depth].func;
+  base[frames[depth].dst] = value;
+  pc = frames[depth].return_pc;
+  DISPATCH();
+
+division_by_zero:
+  runtime_error(program, pc, "division by zero");
+  vm->executed += executed;
+  return 1;
+
+stack_overflow:
+  runtime_error(program, pc, "stack overflow");
+  vm->executed += executed;
+  return 1;
+
+native_error:
+  vm->executed += executed;
+  return 1;
+
+#undef A
+#undef B
+#undef C
+#undef R
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef INT_BINARY
+#undef FLOAT_BINARY
+#undef FLOAT_COMPARE
+#undef INT_IMMEDIATE
+#undef FLOAT_CONSTANT
+#undef COMPARE_BRANCH
+}
+
+/**
+ * 按次数从多到少打印最常见的 limit 个相邻指令对
+ */
+void vm_print_profile(const VM *vm, int limit) {
+  if (!vm->pair_counts)
+    return;
+  int pair_total = BC_OPCODE_COUNT * BC_OPCODE_COUNT;
+  int *order = (int *)malloc(sizeof(int) * pair_total);
+  int count = 0;
+  uint64_t total = 0;
+  for (int i = 0; i < pair_total; i++) {
+    total += vm->pair_counts[i];
+    if (vm->pair_counts[i] > 0)
+      order[count++] = i;
+  }
+  // 只需要前 limit 个：部分选择排序
+  if (limit > count)
+    limit = count;
+  for (int i = 0; i < limit; i++) {
+    int best = i;
+    for (int j = i + 1; j < count; j++) {
+      if (vm->pair_counts[order[j]] > vm->pair_counts[order[best]])
+        best = j;
+    }
+    int tmp = order[i];
+    order[i] = order[best];
+    order[best] = tmp;
+  }
+
+  printf("Bytecode profile: %llu instructions\n", (unsigned long long)total);
+  printf("  %-8s %-8s %14s %7s\n", "first", "second", "count", "share");
+  for (int i = 0; i < limit; i++) {
+    uint64_t n = vm->pair_counts[order[i]];
+    printf("  %-8s %-8s %14llu %6.1f%%\n",
+           bc_opcode_names[order[i] / BC_OPCODE_COUNT],
+           bc_opcode_names[order[i] % BC_OPCODE_COUNT], (unsigned long long)n,
+           100.0 * n / total);
+  }
+  free(order);
+}
+
+int vm_run_main(VM *vm, int *exit_code) {
+  const BCProgram *program = vm->program;
+  VMValue result;
+  if (program->init_function >= 0 &&
+      vm_call(vm, program->init_function, NULL, 0, &result) != 0)
+    return 1;
+
+  int main_index = bc_find_function(program, "main");
+  if (main_index < 0) {
+    fprintf(stderr, "Runtime error: no main function\n");
+    return 1;
+  }
+  if (vm_call(vm, main_index, NULL, 0, &result) != 0)
+    return 1;
+  *exit_code = program->functions[main_index].return_type == IR_TYPE_FLOAT
+                   ? float_to_int(result.f)
+                   : result.i;
+  return 0;
+}
@@ -0,0 +1,178 @@
+/**
+ * writer.c - 带大缓冲区的文本输出实现
+ */
+
+#include "../include/writer.h"
+#include "../include/diag.h"
+#include "../include/memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+static Writer *writer_create(FILE *file, int owns_file, size_t capacity) {
+  Writer *writer = (Writer *)calloc(1, sizeof(Writer));
+  writer->file = file;
+  writer->owns_file = owns_file;
+  writer->capacity = capacity;
+  writer->buffer = (char *)malloc(capacity);
+  return writer;
+}
+
+Writer *writer_open(const char *path) {
+  if (strcmp(path, "-") == 0)
+    return writer_create(stdout, 0, WRITER_BUFFER_SIZE);
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    diag_printf("Error: Cannot create file '%s'\n", path);
+    return NULL;
+  }
+  return writer_create(file, 1, WRITER_BUFFER_SIZE);
+}
+
+Writer *writer_from_file(FILE *file) {
+  return writer_create(file, 0, WRITER_BUFFER_SIZE);
+}
+
+Writer *writer_memory(void) { return writer_create(NULL, 0, 256); }
+
+int writer_flush(Writer *writer) {
+  if (!writer->file)
+    return writer->error;
+  if (writer->length > 0 &&
+      fwrite(writer->buffer, 1, writer->length, writer->file) !=
+          writer->length)
+    writer->error = 1;
+  writer->length = 0;
+  if (fflush(writer->file) != 0)
+    writer->error = 1;
+  return writer->error;
+}
+
+int writer_close(Writer *writer) {
+  if (!writer)
+    return 0;
+  int status = writer_flush(writer);
+  if (writer->owns_file && fclose(writer->file) != 0)
+    status = 1;
+  free(writer->buffer);
+  free(writer);
+  return status;
+}
+
+char *writer_take(Writer *writer) {
+  char *text = (char *)malloc(writer->length + 1);
+  memcpy(text, writer->buffer, writer->length);
+  text[writer->length] = '\0';
+  writer_close(writer);
+  return text;
+}
+
+/**
+ * 缓冲区放不下 length 字节时：文件先写出，内存的扩大
+ */
+static void make_room(Writer *writer, size_t length) {
+  if (writer->file) {
+    writer_flush(writer);
+    return;
+  }
+  while (writer->length + length > writer->capacity)
+    writer->capacity *= 2;
+  writer->buffer = (char *)realloc(writer->buffer, writer->capacity);
+}
+
+void writer_write(Writer *writer, const char *data, size_t length) {
+  writer->bytes += length;
+  if (writer->length + length > writer->capacity) {
+    make_room(writer, length);
+    if (length > writer->capacity) {
+      // 比文件的缓冲区还大，直接写
+      if (fwrite(data, 1, length, writer->file) != length)
+        writer->error = 1;
+      return;
+    }
+  }
+  memcpy(writer->buffer + writer->length, data, length);
+  writer->length += length;
+}
+
+void writer_puts(Writer *writer, const char *text) {
+  writer_write(writer, text, strlen(text));
+}
+
+void writer_putc(Writer *writer, char c) {
+  if (writer->length == writer->capacity)
+    make_room(writer, 1);
+  writer->buffer[writer->length++] = c;
+  writer->bytes++;
+}
+
+/**
+ * 从 end 往前写十进制数字，返回第一个字符的位置
+ */
+static char *format_int(char *end, long long value) {
+  // 用无符号数取绝对值，LLONG_MIN 也不会溢出
+  unsigned long long magnitude =
+      value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+  char *p = end;
+  do {
+    *--p = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude);
+  if (value < 0)
+    *--p = '-';
+  return p;
+}
+
+void writer_int(Writer *writer, long long value) {
+  char digits[24];
+  char *end = digits + sizeof(digits);
+  char *start = format_int(end, value);
+  writer_write(writer, start, (size_t)(end - start));
+}
+
+void writer_int_width(Writer *writer, long long value, int width) {
+  char digits[24];
+  char *end = digits + sizeof(digits);
+  char *start = format_int(end, value);
+  for (int pad = width - (int)(end - start); pad > 0; pad--)
+    writer_putc(writer, ' ');
+  writer_write(writer, start, (size_t)(end - start));
+}
+
+void writer_puts_width(Writer *writer, const char *text, int width) {
+  size_t length = strlen(text);
+  writer_write(writer, text, length);
+  for (int pad = width - (int)length; pad > 0; pad--)
+    writer_putc(writer, ' ');
+}
+
+void writer_fixed(Writer *writer, double value, int decimals) {
+  char text[512]; // 最大的 double 按 %f 也只有 300 多位
+  int length = snprintf(text, sizeof(text), "%.*f", decimals, value);
+  if (length > 0)
+    writer_write(writer, text,
+                 length < (int)sizeof(text) ? (size_t)length
+                                            : sizeof(text) - 1);
+}
+
+void writer_vprintf(Writer *writer, const char *format, va_list args) {
+  char text[1024];
+  va_list copy;
+  va_copy(copy, args);
+  int length = vsnprintf(text, sizeof(text), format, args);
+  if (length >= (int)sizeof(text)) {
+    char *long_text = (char *)malloc((size_t)length + 1);
+    vsnprintf(long_text, (size_t)length + 1, format, copy);
+    writer_write(writer, long_text, (size_t)length);
+    free(long_text);
+  } else if (length > 0) {
+    writer_write(writer, text, (size_t)length);
+  }
+  va_end(copy);
+}
+
+void writer_printf(Writer *writer, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  writer_vprintf(writer, format, args);
+  va_end(args);
+}
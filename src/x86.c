@@ -0,0 +1,356 @@
+/**
+ * x86.c - x86-64 机器指令表示和 GAS 输出
+ */
+
+#include "../include/x86.h"
+#include "../include/memory.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *str_dup(const char *s) {
+  size_t len = strlen(s) + 1;
+  char *copy = (char *)malloc(len);
+  memcpy(copy, s, len);
+  return copy;
+}
+
+// ========== 操作数构造 ==========
+
+static X86Operand operand(X86OperandKind kind) {
+  X86Operand op;
+  memset(&op, 0, sizeof(op));
+  op.kind = kind;
+  op.reg = REG_NONE;
+  return op;
+}
+
+X86Operand x86_reg(X86Reg reg) {
+  X86Operand op = operand(X86_OPND_REG);
+  op.reg = reg;
+  return op;
+}
+
+X86Operand x86_imm(int64_t value) {
+  X86Operand op = operand(X86_OPND_IMM);
+  op.imm = value;
+  return op;
+}
+
+X86Operand x86_mem(X86Reg base, int disp) {
+  X86Operand op = operand(X86_OPND_MEM);
+  op.reg = base;
+  op.disp = disp;
+  return op;
+}
+
+X86Operand x86_global(const char *name) {
+  X86Operand op = operand(X86_OPND_GLOBAL);
+  op.name = name;
+  return op;
+}
+
+X86Operand x86_const(int index) {
+  X86Operand op = operand(X86_OPND_CONST);
+  op.index = index;
+  return op;
+}
+
+X86Operand x86_label(int label) {
+  X86Operand op = operand(X86_OPND_LABEL);
+  op.index = label;
+  return op;
+}
+
+X86Operand x86_func(const char *name) {
+  X86Operand op = operand(X86_OPND_FUNC);
+  op.name = name;
+  return op;
+}
+
+// ========== 模块 ==========
+
+X86Module *x86_module_create(void) {
+  return (X86Module *)calloc(1, sizeof(X86Module));
+}
+
+void x86_module_free(X86Module *module) {
+  if (!module)
+    return;
+  for (int i = 0; i < module->func_count; i++) {
+    free(module->functions[i].name);
+    free(module->functions[i].code);
+  }
+  free(module->functions);
+  for (int i = 0; i < module->global_count; i++)
+    free(module->globals[i].name);
+  free(module->globals);
+  name_map_free(&module->global_index);
+  free(module->consts);
+  free(module);
+}
+
+X86Function *x86_add_function(X86Module *module, const char *name) {
+  if (module->func_count >= module->func_capacity) {
+    module->func_capacity =
+        module->func_capacity == 0 ? 8 : module->func_capacity * 2;
+    module->functions = (X86Function *)realloc(
+        module->functions, sizeof(X86Function) * module->func_capacity);
+  }
+  X86Function *func = &module->functions[module->func_count++];
+  memset(func, 0, sizeof(*func));
+  func->name = str_dup(name);
+  return func;
+}
+
+X86Global *x86_add_global(X86Module *module, const char *name,
+                          IRValueType type) {
+  if (module->global_count >= module->global_capacity) {
+    module->global_capacity =
+        module->global_capacity == 0 ? 8 : module->global_capacity * 2;
+    module->globals = (X86Global *)realloc(
+        module->globals, sizeof(X86Global) * module->global_capacity);
+  }
+  X86Global *global = &module->globals[module->global_count++];
+  memset(global, 0, sizeof(*global));
+  global->name = str_dup(name);
+  global->type = type;
+  if (!module->global_index.names)
+    name_map_init(&module->global_index, 0);
+  name_map_put(&module->global_index, global->name, module->global_count - 1);
+  return global;
+}
+
+X86Global *x86_find_global(X86Module *module, const char *name) {
+  int index = name_map_get(&module->global_index, name);
+  return index >= 0 ? &module->globals[index] : NULL;
+}
+
+int x86_add_const(X86Module *module, uint64_t bits) {
+  for (int i = 0; i < module->const_count; i++) {
+    if (module->consts[i].bits == bits)
+      return i;
+  }
+  if (module->const_count >= module->const_capacity) {
+    module->const_capacity =
+        module->const_capacity == 0 ? 8 : module->const_capacity * 2;
+    module->consts = (X86Const *)realloc(
+        module->consts, sizeof(X86Const) * module->const_capacity);
+  }
+  module->consts[module->const_count].bits = bits;
+  return module->const_count++;
+}
+
+int x86_layout_globals(const X86Module *module, int *offsets) {
+  int size = 0;
+  for (int i = 0; i < module->global_count; i++) {
+    int width = module->globals[i].type == IR_TYPE_FLOAT ? 8 : 4;
+    size = (size + width - 1) / width * width;
+    offsets[i] = size;
+    size += width;
+  }
+  return size;
+}
+
+void x86_emit(X86Function *func, X86Opcode op, int size, X86Operand src,
+              X86Operand dst) {
+  if (func->count >= func->capacity) {
+    func->capacity = func->capacity == 0 ? 64 : func->capacity * 2;
+    func->code =
+        (X86Instr *)realloc(func->code, sizeof(X86Instr) * func->capacity);
+  }
+  X86Instr *instr = &func->code[func->count++];
+  instr->op = op;
+  instr->cond = CC_E;
+  instr->size = size;
+  instr->src = src;
+  instr->dst = dst;
+}
+
+void x86_emit_cc(X86Function *func, X86Opcode op, X86Cond cond,
+                 X86Operand dst) {
+  x86_emit(func, op, 1, operand(X86_OPND_NONE), dst);
+  func->code[func->count - 1].cond = cond;
+}
+
+// ========== GAS 输出 ==========
+
+static const char *mnemonics[X86_OPCODE_COUNT] = {
+    [X86_LABEL] = "",           [X86_MOV] = "mov",
+    [X86_MOVZB] = "movzb",      [X86_ADD] = "add",
+    [X86_SUB] = "sub",          [X86_IMUL] = "imul",
+    [X86_IDIV] = "idiv",        [X86_CDQ] = "cltd",
+    [X86_NEG] = "neg",          [X86_SHL] = "shl",
+    [X86_SAR] = "sar",          [X86_SHR] = "shr",
+    [X86_AND] = "and",          [X86_OR] = "or",
+    [X86_XOR] = "xor",          [X86_CMP] = "cmp",
+    [X86_TEST] = "test",        [X86_SETCC] = "set",
+    [X86_JMP] = "jmp",          [X86_JCC] = "j",
+    [X86_CALL] = "call",        [X86_RET] = "ret",
+    [X86_PUSH] = "push",        [X86_POP] = "pop",
+    [X86_MOVSD] = "movsd",      [X86_MOVAPD] = "movapd",
+    [X86_ADDSD] = "addsd",
+    [X86_SUBSD] = "subsd",      [X86_MULSD] = "mulsd",
+    [X86_DIVSD] = "divsd",      [X86_UCOMISD] = "ucomisd",
+    [X86_XORPD] = "xorpd",      [X86_CVTSI2SD] = "cvtsi2sdl",
+    [X86_CVTTSD2SI] = "cvttsd2si"};
+
+static const char *cond_name(X86Cond cond) {
+  switch (cond) {
+  case CC_B:
+    return "b";
+  case CC_AE:
+    return "ae";
+  case CC_E:
+    return "e";
+  case CC_NE:
+    return "ne";
+  case CC_BE:
+    return "be";
+  case CC_A:
+    return "a";
+  case CC_P:
+    return "p";
+  case CC_NP:
+    return "np";
+  case CC_L:
+    return "l";
+  case CC_GE:
+    return "ge";
+  case CC_LE:
+    return "le";
+  case CC_G:
+    return "g";
+  }
+  return "?";
+}
+
+static char size_suffix(int size) {
+  switch (size) {
+  case 1:
+    return 'b';
+  case 8:
+    return 'q';
+  default:
+    return 'l';
+  }
+}
+
+// 带整数后缀的指令（SSE、跳转等不带）
+static int has_suffix(X86Opcode op) {
+  return (op >= X86_MOV && op <= X86_TEST && op != X86_CDQ) ||
+         op == X86_PUSH || op == X86_POP;
+}
+
+static void print_operand(FILE *out, X86Operand op, int size) {
+  switch (op.kind) {
+  case X86_OPND_REG:
+    fprintf(out, "%%%s", x86_reg_name(op.reg, size));
+    break;
+  case X86_OPND_IMM:
+    fprintf(out, "$%" PRId64, op.imm);
+    break;
+  case X86_OPND_MEM:
+    if (op.disp != 0)
+      fprintf(out, "%d", op.disp);
+    fprintf(out, "(%%%s)", x86_reg_name(op.reg, 8));
+    break;
+  case X86_OPND_GLOBAL:
+    fprintf(out, "%s(%%rip)", op.name);
+    break;
+  case X86_OPND_CONST:
+    fprintf(out, ".LC%d(%%rip)", op.index);
+    break;
+  case X86_OPND_LABEL:
+    fprintf(out, ".L%d", op.index);
+    break;
+  case X86_OPND_FUNC:
+    fprintf(out, "%s", op.name);
+    break;
+  default:
+    break;
+  }
+}
+
+static void print_instr(FILE *out, const X86Instr *instr) {
+  if (instr->op == X86_LABEL) {
+    fprintf(out, ".L%d:\n", instr->dst.index);
+    return;
+  }
+
+  if (instr->op == X86_CDQ) {
+    fprintf(out, "\t%s\n", instr->size == 8 ? "cqto" : "cltd");
+    return;
+  }
+
+  fprintf(out, "\t%s", mnemonics[instr->op]);
+  if (instr->op == X86_SETCC || instr->op == X86_JCC)
+    fprintf(out, "%s", cond_name(instr->cond));
+  else if (has_suffix(instr->op))
+    fprintf(out, "%c", size_suffix(instr->size));
+
+  // 源操作数的宽度：移位次数是 %cl，movzb 的源是 8 位，
+  // cvtsi2sd 的源是 32 位整数
+  int src_size = instr->size;
+  int dst_size = instr->size;
+  if (instr->op == X86_SHL || instr->op == X86_SAR || instr->op == X86_SHR ||
+      instr->op == X86_MOVZB)
+    src_size = 1;
+  if (instr->op == X86_CVTSI2SD)
+    src_size = 4;
+  if (instr->op == X86_CVTTSD2SI)
+    dst_size = 4;
+
+  if (instr->src.kind != X86_OPND_NONE) {
+    fprintf(out, "\t");
+    print_operand(out, instr->src, src_size);
+    if (instr->dst.kind != X86_OPND_NONE)
+      fprintf(out, ", ");
+  } else if (instr->dst.kind != X86_OPND_NONE) {
+    fprintf(out, "\t");
+  }
+  if (instr->dst.kind != X86_OPND_NONE) {
+    if (instr->op == X86_CALL && instr->dst.kind == X86_OPND_REG)
+      fprintf(out, "*");
+    print_operand(out, instr->dst, dst_size);
+  }
+  fprintf(out, "\n");
+}
+
+void x86_print_gas(const X86Module *module, FILE *out) {
+  if (module->global_count > 0) {
+    fprintf(out, "\t.data\n");
+    for (int i = 0; i < module->global_count; i++) {
+      const X86Global *g = &module->globals[i];
+      fprintf(out, "\t.globl\t%s\n", g->name);
+      if (g->type == IR_TYPE_FLOAT) {
+        uint64_t bits;
+        memcpy(&bits, &g->float_value, sizeof(bits));
+        fprintf(out, "\t.p2align 3\n%s:\n\t.quad\t0x%016" PRIx64 "\n", g->name,
+                bits);
+      } else {
+        fprintf(out, "\t.p2align 2\n%s:\n\t.long\t%d\n", g->name,
+                g->int_value);
+      }
+    }
+  }
+
+  if (module->const_count > 0) {
+    fprintf(out, "\t.section\t.rodata\n\t.p2align 4\n");
+    for (int i = 0; i < module->const_count; i++)
+      fprintf(out, ".LC%d:\n\t.quad\t0x%016" PRIx64 ", 0\n", i,
+              module->consts[i].bits);
+  }
+
+  fprintf(out, "\t.text\n");
+  for (int f = 0; f < module->func_count; f++) {
+    const X86Function *func = &module->functions[f];
+    fprintf(out, "\t.globl\t%s\n\t.type\t%s, @function\n%s:\n", func->name,
+            func->name, func->name);
+    for (int i = 0; i < func->count; i++)
+      print_instr(out, &func->code[i]);
+    fprintf(out, "\t.size\t%s, .-%s\n", func->name, func->name);
+  }
+
+  fprintf(out, "\t.section\t.note.GNU-stack,\"\",@progbits\n");
+}